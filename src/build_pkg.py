@@ -134,7 +134,6 @@ def build_linux_pkg():
     os.chmod('dist/usr/bin/redapid', 0755)
     os.chmod('dist/etc/redapid.conf', 0644)
     os.chmod('dist/etc/init.d/redapid', 0755)
-    os.chmod('dist/etc/cron.d/redapid-delete-purged-programs', 0644)
     os.chmod('dist/etc/logrotate.d/redapid', 0644)
     os.chmod('dist/usr/share/doc/redapid/changelog.gz', 0644)
     os.chmod('dist/usr/share/doc/redapid/copyright', 0644)
@@ -19,11 +19,12 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-#include <pwd.h>
 #include <stdbool.h>
 #include <string.h>
 #include <sys/acl.h>
 
+#include "identity.h"
+
 // sets errno on error
 static int acl_remove_user_entry(acl_t acl, uid_t uid) {
 	int rc;
@@ -98,13 +99,11 @@ static int acl_entry_set_permissions(acl_entry_t entry, const char *permissions)
 // sets errno on error
 int acl_add_user(const char *directory, const char *user, const char *permissions) {
 	bool success = false;
-	struct passwd *pw;
+	uid_t uid;
 	acl_t acl = NULL;
 	acl_entry_t entry;
 
-	pw = getpwnam(user);
-
-	if (pw == NULL) {
+	if (identity_get_uid(user, &uid) < 0) {
 		goto cleanup;
 	}
 
@@ -116,7 +115,7 @@ int acl_add_user(const char *directory, const char *user, const char *permission
 	}
 
 	// remove USER entry, if existing
-	if (acl_remove_user_entry(acl, pw->pw_uid) < 0) {
+	if (acl_remove_user_entry(acl, uid) < 0) {
 		goto cleanup;
 	}
 
@@ -133,7 +132,7 @@ int acl_add_user(const char *directory, const char *user, const char *permission
 		goto cleanup;
 	}
 
-	if (acl_set_qualifier(entry, &pw->pw_uid) < 0) {
+	if (acl_set_qualifier(entry, &uid) < 0) {
 		goto cleanup;
 	}
 
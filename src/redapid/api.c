@@ -29,15 +29,20 @@
 #include "api.h"
 
 #include "api_packet.h"
+#include "delta.h"
 #include "directory.h"
+#include "disk_usage.h"
 #include "file.h"
 #include "inventory.h"
 #include "list.h"
+#include "manifest.h"
 #include "network.h"
 #include "process.h"
 #include "program.h"
+#include "purge.h"
 #include "string.h"
 #include "version.h"
+#include "watch.h"
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
@@ -116,16 +121,85 @@ typedef enum {
 	FUNCTION_GET_CUSTOM_PROGRAM_OPTION_VALUE,
 	FUNCTION_REMOVE_CUSTOM_PROGRAM_OPTION,
 	CALLBACK_PROGRAM_SCHEDULER_STATE_CHANGED,
-	CALLBACK_PROGRAM_PROCESS_SPAWNED
+	CALLBACK_PROGRAM_PROCESS_SPAWNED,
+
+	FUNCTION_CREATE_FILE_SIGNATURE,
+	FUNCTION_APPLY_FILE_DELTA,
+
+	FUNCTION_READ_FILE_ASYNC_COMPRESSED,
+	FUNCTION_WRITE_FILE_ASYNC_COMPRESSED,
+
+	FUNCTION_WATCH_PATH,
+	FUNCTION_GET_WATCH_INFO,
+	CALLBACK_WATCH_EVENTS_OCCURRED,
+
+	FUNCTION_SET_FILE_WRITE_WINDOW,
+	CALLBACK_ASYNC_FILE_WRITES_ACKNOWLEDGED,
+
+	FUNCTION_SET_FILE_SIZE_HINT,
+
+	FUNCTION_STAT_PATHS,
+	CALLBACK_PATH_INFO_REPORTED,
+
+	FUNCTION_READ_DIRECTORY_ASYNC,
+	CALLBACK_ASYNC_DIRECTORY_READ,
+
+	FUNCTION_WALK_DIRECTORY_ASYNC,
+	FUNCTION_ABORT_ASYNC_DIRECTORY_READ,
+
+	FUNCTION_GET_DIRECTORY_USAGE,
+
+	FUNCTION_GET_PURGE_PROGRESS,
+
+	FUNCTION_GET_DIRECTORY_MANIFEST,
+	FUNCTION_DIFF_DIRECTORY_MANIFEST,
+
+	FUNCTION_GET_PROCESS_RESOURCE_USAGE,
+
+	FUNCTION_SET_PROGRAM_LIMITS,
+	FUNCTION_GET_PROGRAM_LIMITS,
+	FUNCTION_GET_PROGRAM_RESOURCE_USAGE,
+
+	FUNCTION_GET_PROCESS_OUTPUT_TAIL,
+	FUNCTION_SET_PROGRAM_OUTPUT_BUFFER_SIZE,
+	FUNCTION_GET_PROGRAM_OUTPUT_BUFFER_SIZE,
+
+	FUNCTION_START_FILE_STREAM,
+	FUNCTION_ADD_FILE_STREAM_CREDIT,
+	FUNCTION_STOP_FILE_STREAM,
+	CALLBACK_FILE_STREAM_DATA,
+
+	FUNCTION_KILL_PROCESS_TREE,
+	CALLBACK_PROCESS_TREE_KILLED,
+
+	FUNCTION_SET_PROGRAM_SCHEDULING_ATTRIBUTES,
+	FUNCTION_GET_PROGRAM_SCHEDULING_ATTRIBUTES,
+
+	FUNCTION_SET_PROGRAM_ZYGOTE,
+	FUNCTION_GET_PROGRAM_ZYGOTE,
+
+	CALLBACK_DIRECTORY_MANIFEST_WRITTEN,
+
+	CALLBACK_FILE_SIGNATURE_CREATED,
+	CALLBACK_FILE_DELTA_APPLIED
 } APIFunctionID;
 
 static uint32_t _uid = 0; // always little endian
 static AsyncFileReadCallback _async_file_read_callback;
 static AsyncFileWriteCallback _async_file_write_callback;
+static AsyncFileWritesAcknowledgedCallback _async_file_writes_acknowledged_callback;
 static FileEventsOccurredCallback _file_events_occurred_callback;
+static FileStreamDataCallback _file_stream_data_callback;
+static PathInfoReportedCallback _path_info_reported_callback;
+static FileSignatureCreatedCallback _file_signature_created_callback;
+static FileDeltaAppliedCallback _file_delta_applied_callback;
+static AsyncDirectoryReadCallback _async_directory_read_callback;
+static DirectoryManifestWrittenCallback _directory_manifest_written_callback;
 static ProcessStateChangedCallback _process_state_changed_callback;
+static ProcessTreeKilledCallback _process_tree_killed_callback;
 static ProgramSchedulerStateChangedCallback _program_scheduler_state_changed_callback;
 static ProgramProcessSpawnedCallback _program_process_spawned_callback;
+static WatchEventsOccurredCallback _watch_events_occurred_callback;
 
 static void api_prepare_response(Packet *request, Packet *response, uint8_t length) {
 	// memset'ing the whole response to zero first ensures that all members
@@ -518,6 +592,26 @@ CALL_FILE_PROCEDURE(WriteFileAsync, write_file_async, {
 	error_code = file_write_async(file, request->buffer, request->length_to_write);
 })
 
+CALL_FILE_PROCEDURE(ReadFileAsyncCompressed, read_file_async_compressed, {
+	// FIXME: this callback should be delivered after the response of this function
+	api_send_async_file_read_callback(request->file_id, error_code, NULL, 0);
+}, {
+	error_code = file_read_async_compressed(file, request->length_to_read,
+	                                        request->block_length);
+})
+
+CALL_FILE_PROCEDURE(WriteFileAsyncCompressed, write_file_async_compressed, {
+	// FIXME: this callback should be delivered after the response of this function
+	api_send_async_file_write_callback(request->file_id, error_code, 0);
+}, {
+	error_code = file_write_async_compressed(file, request->buffer, request->length_to_write);
+})
+
+CALL_FILE_FUNCTION(SetFileWriteWindow, set_file_write_window, {
+	response.error_code = file_set_write_window(file, request->acknowledge_length,
+	                                            request->acknowledge_interval);
+})
+
 CALL_FILE_FUNCTION(SetFilePosition, set_file_position, {
 	response.error_code = file_set_position(file, request->offset, request->origin,
 	                                        &response.position);
@@ -527,6 +621,22 @@ CALL_FILE_FUNCTION(GetFilePosition, get_file_position, {
 	response.error_code = file_get_position(file, &response.position);
 })
 
+CALL_FILE_FUNCTION(SetFileSizeHint, set_file_size_hint, {
+	response.error_code = file_set_size_hint(file, request->length, request->flags);
+})
+
+CALL_FILE_FUNCTION(StartFileStream, start_file_stream, {
+	response.error_code = file_start_stream(file, request->credit);
+})
+
+CALL_FILE_FUNCTION(AddFileStreamCredit, add_file_stream_credit, {
+	response.error_code = file_add_stream_credit(file, request->credit);
+})
+
+CALL_FILE_FUNCTION(StopFileStream, stop_file_stream, {
+	response.error_code = file_stop_stream(file);
+})
+
 CALL_FILE_FUNCTION(SetFileEvents, set_file_events, {
 	response.error_code = file_set_events(file, request->events);
 })
@@ -535,6 +645,25 @@ CALL_FILE_FUNCTION(GetFileEvents, get_file_events, {
 	response.error_code = file_get_events(file, &response.events);
 })
 
+CALL_FUNCTION(CreateFileSignature, create_file_signature, {
+	response.error_code = delta_create_signature(request->file_id,
+	                                             request->block_length,
+	                                             request->signature_file_id);
+})
+
+CALL_FUNCTION(StatPaths, stat_paths, {
+	response.error_code = file_stat_paths(request->names_list_id, request->flags);
+})
+
+CALL_FUNCTION(ApplyFileDelta, apply_file_delta, {
+	response.error_code = delta_apply(request->basis_file_id,
+	                                  request->delta_file_id,
+	                                  request->block_length,
+	                                  request->target_name_string_id,
+	                                  request->permissions,
+	                                  request->uid, request->gid);
+})
+
 #undef CALL_FILE_PROCEDURE
 #undef CALL_FILE_FUNCTION_WITH_SESSION
 #undef CALL_FILE_FUNCTION
@@ -571,6 +700,37 @@ CALL_DIRECTORY_FUNCTION(RewindDirectory, rewind_directory, {
 	response.error_code = directory_rewind(directory);
 })
 
+CALL_DIRECTORY_FUNCTION(ReadDirectoryAsync, read_directory_async, {
+	response.error_code = directory_read_async(directory, request->flags);
+})
+
+CALL_DIRECTORY_FUNCTION(WalkDirectoryAsync, walk_directory_async, {
+	response.error_code = directory_walk_async(directory, request->max_depth,
+	                                           request->flags);
+})
+
+CALL_DIRECTORY_FUNCTION(AbortAsyncDirectoryRead, abort_async_directory_read, {
+	response.error_code = directory_abort_async_read(directory);
+})
+
+CALL_FUNCTION_WITH_STRING(GetDirectoryUsage, get_directory_usage, name, {
+	response.error_code = disk_usage_get(name->buffer, &response.length,
+	                                     &response.allocated_length,
+	                                     &response.file_count,
+	                                     &response.directory_count,
+	                                     &response.timestamp);
+})
+
+CALL_FUNCTION_WITH_STRING(GetDirectoryManifest, get_directory_manifest, name, {
+	response.error_code = manifest_get(name->buffer, request->flags,
+	                                   request->manifest_file_id);
+})
+
+CALL_FUNCTION_WITH_STRING(DiffDirectoryManifest, diff_directory_manifest, name, {
+	response.error_code = manifest_diff(name->buffer, request->manifest_id,
+	                                    request->diff_file_id);
+})
+
 CALL_FUNCTION_WITH_STRING(CreateDirectory, create_directory, name, {
 	response.error_code = directory_create(name->buffer, request->flags,
 	                                       request->permissions,
@@ -605,7 +765,7 @@ CALL_FUNCTION_WITH_SESSION(SpawnProcess, spawn_process, {
 	                                    request->stdin_file_id,
 	                                    request->stdout_file_id,
 	                                    request->stderr_file_id,
-	                                    session,
+	                                    NULL, 0, NULL, NULL, 0, NULL, session,
 	                                    OBJECT_CREATE_FLAG_INTERNAL |
 	                                    OBJECT_CREATE_FLAG_EXTERNAL,
 	                                    true, NULL, NULL,
@@ -616,6 +776,11 @@ CALL_PROCESS_FUNCTION(KillProcess, kill_process, {
 	response.error_code = process_kill(process, request->signal);
 })
 
+CALL_PROCESS_FUNCTION(KillProcessTree, kill_process_tree, {
+	response.error_code = process_kill_tree(process, request->signal,
+	                                        request->timeout, NULL, NULL);
+})
+
 CALL_PROCESS_FUNCTION_WITH_SESSION(GetProcessCommand, get_process_command, {
 	response.error_code = process_get_command(process, session,
 	                                          &response.executable_string_id,
@@ -645,6 +810,23 @@ CALL_PROCESS_FUNCTION(GetProcessState, get_process_state, {
 	                                        &response.exit_code);
 })
 
+CALL_PROCESS_FUNCTION(GetProcessResourceUsage, get_process_resource_usage, {
+	response.error_code = process_get_resource_usage(process,
+	                                                 &response.user_time,
+	                                                 &response.system_time,
+	                                                 &response.resident_set_size,
+	                                                 &response.peak_resident_set_size,
+	                                                 &response.read_bytes,
+	                                                 &response.write_bytes,
+	                                                 &response.voluntary_context_switches,
+	                                                 &response.involuntary_context_switches);
+})
+
+CALL_PROCESS_FUNCTION_WITH_SESSION(GetProcessOutputTail, get_process_output_tail, {
+	response.error_code = process_get_output_tail(process, request->max_length, session,
+	                                              &response.output_string_id);
+})
+
 #undef CALL_PROCESS_FUNCTION_WITH_SESSION
 #undef CALL_PROCESS_FUNCTION
 
@@ -673,6 +855,12 @@ CALL_PROGRAM_FUNCTION(PurgeProgram, purge_program, {
 	response.error_code = program_purge(program, request->cookie);
 })
 
+CALL_FUNCTION(GetPurgeProgress, get_purge_progress, {
+	response.error_code = purge_get_progress(&response.pending_count,
+	                                         &response.removed_count,
+	                                         &response.error_count);
+})
+
 CALL_PROGRAM_FUNCTION_WITH_SESSION(GetProgramIdentifier, get_program_identifier, {
 	response.error_code = program_get_identifier(program, session,
 	                                             &response.identifier_string_id);
@@ -735,6 +923,69 @@ CALL_PROGRAM_FUNCTION_WITH_SESSION(GetProgramSchedule, get_program_schedule, {
 	                                           &response.start_fields_string_id);
 })
 
+CALL_PROGRAM_FUNCTION(SetProgramLimits, set_program_limits, {
+	response.error_code = program_set_limits(program,
+	                                         request->cpu_max,
+	                                         request->memory_max,
+	                                         request->io_max,
+	                                         request->pids_max);
+})
+
+CALL_PROGRAM_FUNCTION(GetProgramLimits, get_program_limits, {
+	response.error_code = program_get_limits(program,
+	                                         &response.cpu_max,
+	                                         &response.memory_max,
+	                                         &response.io_max,
+	                                         &response.pids_max);
+})
+
+CALL_PROGRAM_FUNCTION(GetProgramResourceUsage, get_program_resource_usage, {
+	response.error_code = program_get_resource_usage(program,
+	                                                 &response.cpu_time,
+	                                                 &response.memory_usage,
+	                                                 &response.memory_peak,
+	                                                 &response.read_bytes,
+	                                                 &response.write_bytes,
+	                                                 &response.process_count);
+})
+
+CALL_PROGRAM_FUNCTION(SetProgramOutputBufferSize, set_program_output_buffer_size, {
+	response.error_code = program_set_output_buffer_size(program, request->output_buffer_size);
+})
+
+CALL_PROGRAM_FUNCTION(GetProgramOutputBufferSize, get_program_output_buffer_size, {
+	response.error_code = program_get_output_buffer_size(program, &response.output_buffer_size);
+})
+
+CALL_PROGRAM_FUNCTION(SetProgramSchedulingAttributes, set_program_scheduling_attributes, {
+	response.error_code = program_set_scheduling_attributes(program,
+	                                                        request->nice,
+	                                                        request->policy,
+	                                                        request->cpu_affinity,
+	                                                        request->io_priority_class,
+	                                                        request->io_priority_level);
+})
+
+CALL_PROGRAM_FUNCTION(GetProgramSchedulingAttributes, get_program_scheduling_attributes, {
+	response.error_code = program_get_scheduling_attributes(program,
+	                                                        &response.nice,
+	                                                        &response.policy,
+	                                                        &response.cpu_affinity,
+	                                                        &response.io_priority_class,
+	                                                        &response.io_priority_level);
+})
+
+CALL_PROGRAM_FUNCTION(SetProgramZygote, set_program_zygote, {
+	response.error_code = program_set_zygote(program, request->enabled,
+	                                         request->modules_list_id);
+})
+
+CALL_PROGRAM_FUNCTION_WITH_SESSION(GetProgramZygote, get_program_zygote, {
+	response.error_code = program_get_zygote(program, session,
+	                                         &response.enabled,
+	                                         &response.modules_list_id);
+})
+
 CALL_PROGRAM_FUNCTION_WITH_SESSION(GetProgramSchedulerState, get_program_scheduler_state, {
 	response.error_code = program_get_scheduler_state(program, session,
 	                                                  &response.state,
@@ -781,6 +1032,28 @@ CALL_PROGRAM_FUNCTION(RemoveCustomProgramOption, remove_custom_program_option, {
 #undef CALL_PROGRAM_FUNCTION_WITH_SESSION
 #undef CALL_PROGRAM_FUNCTION
 
+//
+// watch
+//
+
+#define CALL_WATCH_FUNCTION_WITH_SESSION(packet_prefix, function_suffix, body) \
+	CALL_TYPE_FUNCTION_WITH_SESSION(packet_prefix, function_suffix, body, \
+	                                OBJECT_TYPE_WATCH, Watch, watch)
+
+CALL_FUNCTION_WITH_SESSION(WatchPath, watch_path, {
+	response.error_code = watch_path(request->name_string_id, request->events,
+	                                 session, OBJECT_CREATE_FLAG_EXTERNAL,
+	                                 &response.watch_id, NULL);
+})
+
+CALL_WATCH_FUNCTION_WITH_SESSION(GetWatchInfo, get_watch_info, {
+	response.error_code = watch_get_info(watch, session,
+	                                     &response.name_string_id,
+	                                     &response.events);
+})
+
+#undef CALL_WATCH_FUNCTION_WITH_SESSION
+
 //
 // misc
 //
@@ -835,14 +1108,46 @@ int api_init(void) {
 	                     sizeof(_async_file_write_callback),
 	                     CALLBACK_ASYNC_FILE_WRITE);
 
+	api_prepare_callback((Packet *)&_async_file_writes_acknowledged_callback,
+	                     sizeof(_async_file_writes_acknowledged_callback),
+	                     CALLBACK_ASYNC_FILE_WRITES_ACKNOWLEDGED);
+
 	api_prepare_callback((Packet *)&_file_events_occurred_callback,
 	                     sizeof(_file_events_occurred_callback),
 	                     CALLBACK_FILE_EVENTS_OCCURRED);
 
+	api_prepare_callback((Packet *)&_file_stream_data_callback,
+	                     sizeof(_file_stream_data_callback),
+	                     CALLBACK_FILE_STREAM_DATA);
+
+	api_prepare_callback((Packet *)&_path_info_reported_callback,
+	                     sizeof(_path_info_reported_callback),
+	                     CALLBACK_PATH_INFO_REPORTED);
+
+	api_prepare_callback((Packet *)&_file_signature_created_callback,
+	                     sizeof(_file_signature_created_callback),
+	                     CALLBACK_FILE_SIGNATURE_CREATED);
+
+	api_prepare_callback((Packet *)&_file_delta_applied_callback,
+	                     sizeof(_file_delta_applied_callback),
+	                     CALLBACK_FILE_DELTA_APPLIED);
+
+	api_prepare_callback((Packet *)&_async_directory_read_callback,
+	                     sizeof(_async_directory_read_callback),
+	                     CALLBACK_ASYNC_DIRECTORY_READ);
+
+	api_prepare_callback((Packet *)&_directory_manifest_written_callback,
+	                     sizeof(_directory_manifest_written_callback),
+	                     CALLBACK_DIRECTORY_MANIFEST_WRITTEN);
+
 	api_prepare_callback((Packet *)&_process_state_changed_callback,
 	                     sizeof(_process_state_changed_callback),
 	                     CALLBACK_PROCESS_STATE_CHANGED);
 
+	api_prepare_callback((Packet *)&_process_tree_killed_callback,
+	                     sizeof(_process_tree_killed_callback),
+	                     CALLBACK_PROCESS_TREE_KILLED);
+
 	api_prepare_callback((Packet *)&_program_scheduler_state_changed_callback,
 	                     sizeof(_program_scheduler_state_changed_callback),
 	                     CALLBACK_PROGRAM_SCHEDULER_STATE_CHANGED);
@@ -851,6 +1156,10 @@ int api_init(void) {
 	                     sizeof(_program_process_spawned_callback),
 	                     CALLBACK_PROGRAM_PROCESS_SPAWNED);
 
+	api_prepare_callback((Packet *)&_watch_events_occurred_callback,
+	                     sizeof(_watch_events_occurred_callback),
+	                     CALLBACK_WATCH_EVENTS_OCCURRED);
+
 	return 0;
 }
 
@@ -914,6 +1223,16 @@ void api_handle_request(Packet *request) {
 	DISPATCH_FUNCTION(GET_FILE_POSITION,                GetFilePosition,              get_file_position)
 	DISPATCH_FUNCTION(SET_FILE_EVENTS,                  SetFileEvents,                set_file_events)
 	DISPATCH_FUNCTION(GET_FILE_EVENTS,                  GetFileEvents,                get_file_events)
+	DISPATCH_FUNCTION(CREATE_FILE_SIGNATURE,            CreateFileSignature,          create_file_signature)
+	DISPATCH_FUNCTION(APPLY_FILE_DELTA,                 ApplyFileDelta,               apply_file_delta)
+	DISPATCH_FUNCTION(READ_FILE_ASYNC_COMPRESSED,       ReadFileAsyncCompressed,      read_file_async_compressed)
+	DISPATCH_FUNCTION(WRITE_FILE_ASYNC_COMPRESSED,      WriteFileAsyncCompressed,     write_file_async_compressed)
+	DISPATCH_FUNCTION(SET_FILE_WRITE_WINDOW,            SetFileWriteWindow,           set_file_write_window)
+	DISPATCH_FUNCTION(SET_FILE_SIZE_HINT,               SetFileSizeHint,              set_file_size_hint)
+	DISPATCH_FUNCTION(STAT_PATHS,                       StatPaths,                    stat_paths)
+	DISPATCH_FUNCTION(START_FILE_STREAM,                StartFileStream,              start_file_stream)
+	DISPATCH_FUNCTION(ADD_FILE_STREAM_CREDIT,           AddFileStreamCredit,          add_file_stream_credit)
+	DISPATCH_FUNCTION(STOP_FILE_STREAM,                 StopFileStream,               stop_file_stream)
 
 	// directory
 	DISPATCH_FUNCTION(OPEN_DIRECTORY,                   OpenDirectory,                open_directory)
@@ -921,6 +1240,12 @@ void api_handle_request(Packet *request) {
 	DISPATCH_FUNCTION(GET_NEXT_DIRECTORY_ENTRY,         GetNextDirectoryEntry,        get_next_directory_entry)
 	DISPATCH_FUNCTION(REWIND_DIRECTORY,                 RewindDirectory,              rewind_directory)
 	DISPATCH_FUNCTION(CREATE_DIRECTORY,                 CreateDirectory,              create_directory)
+	DISPATCH_FUNCTION(READ_DIRECTORY_ASYNC,             ReadDirectoryAsync,           read_directory_async)
+	DISPATCH_FUNCTION(WALK_DIRECTORY_ASYNC,             WalkDirectoryAsync,           walk_directory_async)
+	DISPATCH_FUNCTION(ABORT_ASYNC_DIRECTORY_READ,       AbortAsyncDirectoryRead,      abort_async_directory_read)
+	DISPATCH_FUNCTION(GET_DIRECTORY_USAGE,              GetDirectoryUsage,            get_directory_usage)
+	DISPATCH_FUNCTION(GET_DIRECTORY_MANIFEST,           GetDirectoryManifest,         get_directory_manifest)
+	DISPATCH_FUNCTION(DIFF_DIRECTORY_MANIFEST,          DiffDirectoryManifest,        diff_directory_manifest)
 
 	// process
 	DISPATCH_FUNCTION(GET_PROCESSES,                    GetProcesses,                 get_processes)
@@ -930,11 +1255,15 @@ void api_handle_request(Packet *request) {
 	DISPATCH_FUNCTION(GET_PROCESS_IDENTITY,             GetProcessIdentity,           get_process_identity)
 	DISPATCH_FUNCTION(GET_PROCESS_STDIO,                GetProcessStdio,              get_process_stdio)
 	DISPATCH_FUNCTION(GET_PROCESS_STATE,                GetProcessState,              get_process_state)
+	DISPATCH_FUNCTION(GET_PROCESS_RESOURCE_USAGE,       GetProcessResourceUsage,      get_process_resource_usage)
+	DISPATCH_FUNCTION(GET_PROCESS_OUTPUT_TAIL,          GetProcessOutputTail,         get_process_output_tail)
+	DISPATCH_FUNCTION(KILL_PROCESS_TREE,                KillProcessTree,              kill_process_tree)
 
 	// program
 	DISPATCH_FUNCTION(GET_PROGRAMS,                     GetPrograms,                  get_programs)
 	DISPATCH_FUNCTION(DEFINE_PROGRAM,                   DefineProgram,                define_program)
 	DISPATCH_FUNCTION(PURGE_PROGRAM,                    PurgeProgram,                 purge_program)
+	DISPATCH_FUNCTION(GET_PURGE_PROGRESS,               GetPurgeProgress,             get_purge_progress)
 	DISPATCH_FUNCTION(GET_PROGRAM_IDENTIFIER,           GetProgramIdentifier,         get_program_identifier)
 	DISPATCH_FUNCTION(GET_PROGRAM_ROOT_DIRECTORY,       GetProgramRootDirectory,      get_program_root_directory)
 	DISPATCH_FUNCTION(SET_PROGRAM_COMMAND,              SetProgramCommand,            set_program_command)
@@ -943,6 +1272,15 @@ void api_handle_request(Packet *request) {
 	DISPATCH_FUNCTION(GET_PROGRAM_STDIO_REDIRECTION,    GetProgramStdioRedirection,   get_program_stdio_redirection)
 	DISPATCH_FUNCTION(SET_PROGRAM_SCHEDULE,             SetProgramSchedule,           set_program_schedule)
 	DISPATCH_FUNCTION(GET_PROGRAM_SCHEDULE,             GetProgramSchedule,           get_program_schedule)
+	DISPATCH_FUNCTION(SET_PROGRAM_LIMITS,               SetProgramLimits,             set_program_limits)
+	DISPATCH_FUNCTION(GET_PROGRAM_LIMITS,               GetProgramLimits,             get_program_limits)
+	DISPATCH_FUNCTION(GET_PROGRAM_RESOURCE_USAGE,       GetProgramResourceUsage,      get_program_resource_usage)
+	DISPATCH_FUNCTION(SET_PROGRAM_OUTPUT_BUFFER_SIZE,   SetProgramOutputBufferSize,   set_program_output_buffer_size)
+	DISPATCH_FUNCTION(GET_PROGRAM_OUTPUT_BUFFER_SIZE,   GetProgramOutputBufferSize,   get_program_output_buffer_size)
+	DISPATCH_FUNCTION(SET_PROGRAM_SCHEDULING_ATTRIBUTES,SetProgramSchedulingAttributes,set_program_scheduling_attributes)
+	DISPATCH_FUNCTION(GET_PROGRAM_SCHEDULING_ATTRIBUTES,GetProgramSchedulingAttributes,get_program_scheduling_attributes)
+	DISPATCH_FUNCTION(SET_PROGRAM_ZYGOTE,               SetProgramZygote,             set_program_zygote)
+	DISPATCH_FUNCTION(GET_PROGRAM_ZYGOTE,               GetProgramZygote,             get_program_zygote)
 	DISPATCH_FUNCTION(GET_PROGRAM_SCHEDULER_STATE,      GetProgramSchedulerState,     get_program_scheduler_state)
 	DISPATCH_FUNCTION(CONTINUE_PROGRAM_SCHEDULE,        ContinueProgramSchedule,      continue_program_schedule)
 	DISPATCH_FUNCTION(START_PROGRAM,                    StartProgram,                 start_program)
@@ -952,6 +1290,10 @@ void api_handle_request(Packet *request) {
 	DISPATCH_FUNCTION(GET_CUSTOM_PROGRAM_OPTION_VALUE,  GetCustomProgramOptionValue,  get_custom_program_option_value)
 	DISPATCH_FUNCTION(REMOVE_CUSTOM_PROGRAM_OPTION,     RemoveCustomProgramOption,    remove_custom_program_option)
 
+	// watch
+	DISPATCH_FUNCTION(WATCH_PATH,                       WatchPath,                    watch_path)
+	DISPATCH_FUNCTION(GET_WATCH_INFO,                   GetWatchInfo,                 get_watch_info)
+
 	// misc
 	DISPATCH_FUNCTION(GET_IDENTITY,                     GetIdentity,                  get_identity)
 
@@ -1006,9 +1348,24 @@ const char *api_get_function_name(int function_id) {
 	case FUNCTION_GET_FILE_POSITION:                return "get-file-position";
 	case FUNCTION_SET_FILE_EVENTS:                  return "set-file-events";
 	case FUNCTION_GET_FILE_EVENTS:                  return "get-file-events";
+	case FUNCTION_CREATE_FILE_SIGNATURE:            return "create-file-signature";
+	case FUNCTION_APPLY_FILE_DELTA:                 return "apply-file-delta";
+	case FUNCTION_READ_FILE_ASYNC_COMPRESSED:       return "read-file-async-compressed";
+	case FUNCTION_WRITE_FILE_ASYNC_COMPRESSED:      return "write-file-async-compressed";
+	case FUNCTION_SET_FILE_WRITE_WINDOW:            return "set-file-write-window";
+	case FUNCTION_SET_FILE_SIZE_HINT:               return "set-file-size-hint";
+	case FUNCTION_STAT_PATHS:                       return "stat-paths";
+	case FUNCTION_START_FILE_STREAM:                return "start-file-stream";
+	case FUNCTION_ADD_FILE_STREAM_CREDIT:           return "add-file-stream-credit";
+	case FUNCTION_STOP_FILE_STREAM:                 return "stop-file-stream";
 	case CALLBACK_ASYNC_FILE_READ:                  return "async-file-read";
 	case CALLBACK_ASYNC_FILE_WRITE:                 return "async-file-write";
+	case CALLBACK_ASYNC_FILE_WRITES_ACKNOWLEDGED:   return "async-file-writes-acknowledged";
 	case CALLBACK_FILE_EVENTS_OCCURRED:             return "file-events-occurred";
+	case CALLBACK_FILE_STREAM_DATA:                 return "file-stream-data";
+	case CALLBACK_PATH_INFO_REPORTED:               return "path-info-reported";
+	case CALLBACK_FILE_SIGNATURE_CREATED:           return "file-signature-created";
+	case CALLBACK_FILE_DELTA_APPLIED:               return "file-delta-applied";
 
 	// directory
 	case FUNCTION_OPEN_DIRECTORY:                   return "open-directory";
@@ -1016,6 +1373,14 @@ const char *api_get_function_name(int function_id) {
 	case FUNCTION_GET_NEXT_DIRECTORY_ENTRY:         return "get-next-directory-entry";
 	case FUNCTION_REWIND_DIRECTORY:                 return "rewind-directory";
 	case FUNCTION_CREATE_DIRECTORY:                 return "create-directory";
+	case FUNCTION_READ_DIRECTORY_ASYNC:             return "read-directory-async";
+	case FUNCTION_WALK_DIRECTORY_ASYNC:             return "walk-directory-async";
+	case FUNCTION_ABORT_ASYNC_DIRECTORY_READ:       return "abort-async-directory-read";
+	case FUNCTION_GET_DIRECTORY_USAGE:              return "get-directory-usage";
+	case FUNCTION_GET_DIRECTORY_MANIFEST:           return "get-directory-manifest";
+	case FUNCTION_DIFF_DIRECTORY_MANIFEST:          return "diff-directory-manifest";
+	case CALLBACK_ASYNC_DIRECTORY_READ:             return "async-directory-read";
+	case CALLBACK_DIRECTORY_MANIFEST_WRITTEN:       return "directory-manifest-written";
 
 	// process
 	case FUNCTION_GET_PROCESSES:                    return "get-processes";
@@ -1025,12 +1390,17 @@ const char *api_get_function_name(int function_id) {
 	case FUNCTION_GET_PROCESS_IDENTITY:             return "get-process-identity";
 	case FUNCTION_GET_PROCESS_STDIO:                return "get-process-stdio";
 	case FUNCTION_GET_PROCESS_STATE:                return "get-process-state";
+	case FUNCTION_GET_PROCESS_RESOURCE_USAGE:       return "get-process-resource-usage";
+	case FUNCTION_GET_PROCESS_OUTPUT_TAIL:          return "get-process-output-tail";
+	case FUNCTION_KILL_PROCESS_TREE:                return "kill-process-tree";
 	case CALLBACK_PROCESS_STATE_CHANGED:            return "process-state-changed";
+	case CALLBACK_PROCESS_TREE_KILLED:              return "process-tree-killed";
 
 	// program
 	case FUNCTION_GET_PROGRAMS:                     return "get-programs";
 	case FUNCTION_DEFINE_PROGRAM:                   return "define-program";
 	case FUNCTION_PURGE_PROGRAM:                    return "purge-program";
+	case FUNCTION_GET_PURGE_PROGRESS:               return "get-purge-progress";
 	case FUNCTION_GET_PROGRAM_IDENTIFIER:           return "get-program-identifier";
 	case FUNCTION_GET_PROGRAM_ROOT_DIRECTORY:       return "get-program-root-directory";
 	case FUNCTION_SET_PROGRAM_COMMAND:              return "set-program-command";
@@ -1039,6 +1409,15 @@ const char *api_get_function_name(int function_id) {
 	case FUNCTION_GET_PROGRAM_STDIO_REDIRECTION:    return "get-program-stdio-redirection";
 	case FUNCTION_SET_PROGRAM_SCHEDULE:             return "set-program-schedule";
 	case FUNCTION_GET_PROGRAM_SCHEDULE:             return "get-program-schedule";
+	case FUNCTION_SET_PROGRAM_LIMITS:               return "set-program-limits";
+	case FUNCTION_GET_PROGRAM_LIMITS:               return "get-program-limits";
+	case FUNCTION_GET_PROGRAM_RESOURCE_USAGE:       return "get-program-resource-usage";
+	case FUNCTION_SET_PROGRAM_OUTPUT_BUFFER_SIZE:   return "set-program-output-buffer-size";
+	case FUNCTION_GET_PROGRAM_OUTPUT_BUFFER_SIZE:   return "get-program-output-buffer-size";
+	case FUNCTION_SET_PROGRAM_SCHEDULING_ATTRIBUTES:return "set-program-scheduling-attributes";
+	case FUNCTION_GET_PROGRAM_SCHEDULING_ATTRIBUTES:return "get-program-scheduling-attributes";
+	case FUNCTION_SET_PROGRAM_ZYGOTE:               return "set-program-zygote";
+	case FUNCTION_GET_PROGRAM_ZYGOTE:               return "get-program-zygote";
 	case FUNCTION_GET_PROGRAM_SCHEDULER_STATE:      return "get-program-scheduler-state";
 	case FUNCTION_CONTINUE_PROGRAM_SCHEDULE:        return "continue-program-schedule";
 	case FUNCTION_START_PROGRAM:                    return "start-program";
@@ -1050,6 +1429,11 @@ const char *api_get_function_name(int function_id) {
 	case CALLBACK_PROGRAM_PROCESS_SPAWNED:          return "program-process-spawned";
 	case CALLBACK_PROGRAM_SCHEDULER_STATE_CHANGED:  return "program-scheduler-state-changed";
 
+	// watch
+	case FUNCTION_WATCH_PATH:                       return "watch-path";
+	case FUNCTION_GET_WATCH_INFO:                   return "get-watch-info";
+	case CALLBACK_WATCH_EVENTS_OCCURRED:            return "watch-events-occurred";
+
 	// misc
 	case FUNCTION_GET_IDENTITY:                     return "get-identity";
 
@@ -1085,6 +1469,15 @@ void api_send_async_file_write_callback(ObjectID file_id, APIE error_code,
 	network_dispatch_response((Packet *)&_async_file_write_callback);
 }
 
+void api_send_async_file_writes_acknowledged_callback(ObjectID file_id, APIE error_code,
+                                                      uint64_t length_written) {
+	_async_file_writes_acknowledged_callback.file_id = file_id;
+	_async_file_writes_acknowledged_callback.error_code = error_code;
+	_async_file_writes_acknowledged_callback.length_written = length_written;
+
+	network_dispatch_response((Packet *)&_async_file_writes_acknowledged_callback);
+}
+
 void api_send_file_events_occurred_callback(ObjectID file_id, uint16_t events) {
 	_file_events_occurred_callback.file_id = file_id;
 	_file_events_occurred_callback.events = events;
@@ -1092,6 +1485,93 @@ void api_send_file_events_occurred_callback(ObjectID file_id, uint16_t events) {
 	network_dispatch_response((Packet *)&_file_events_occurred_callback);
 }
 
+void api_send_file_stream_data_callback(ObjectID file_id, APIE error_code,
+                                        uint8_t *buffer, uint8_t length_read) {
+	_file_stream_data_callback.file_id = file_id;
+	_file_stream_data_callback.error_code = error_code;
+	_file_stream_data_callback.length_read = length_read;
+
+	// buffer can be NULL if length_read is zero
+	if (length_read > 0) {
+		memcpy(_file_stream_data_callback.buffer, buffer, length_read);
+	}
+
+	// memset'ing the rest of the buffer to zero ensures that no random
+	// heap/stack data can leak to the client
+	memset(_file_stream_data_callback.buffer + length_read, 0,
+	       sizeof(_file_stream_data_callback.buffer) - length_read);
+
+	network_dispatch_response((Packet *)&_file_stream_data_callback);
+}
+
+void api_send_path_info_reported_callback(ObjectID names_list_id, uint16_t index,
+                                          APIE error_code, uint8_t type,
+                                          uint16_t permissions, uint32_t uid,
+                                          uint32_t gid, uint64_t length,
+                                          uint64_t access_timestamp,
+                                          uint64_t modification_timestamp,
+                                          uint64_t status_change_timestamp) {
+	_path_info_reported_callback.names_list_id = names_list_id;
+	_path_info_reported_callback.index = index;
+	_path_info_reported_callback.error_code = error_code;
+	_path_info_reported_callback.type = type;
+	_path_info_reported_callback.permissions = permissions;
+	_path_info_reported_callback.uid = uid;
+	_path_info_reported_callback.gid = gid;
+	_path_info_reported_callback.length = length;
+	_path_info_reported_callback.access_timestamp = access_timestamp;
+	_path_info_reported_callback.modification_timestamp = modification_timestamp;
+	_path_info_reported_callback.status_change_timestamp = status_change_timestamp;
+
+	network_dispatch_response((Packet *)&_path_info_reported_callback);
+}
+
+void api_send_file_signature_created_callback(ObjectID signature_file_id,
+                                              APIE error_code, uint32_t block_count) {
+	_file_signature_created_callback.signature_file_id = signature_file_id;
+	_file_signature_created_callback.error_code = error_code;
+	_file_signature_created_callback.block_count = block_count;
+
+	network_dispatch_response((Packet *)&_file_signature_created_callback);
+}
+
+void api_send_file_delta_applied_callback(ObjectID delta_file_id, APIE error_code,
+                                          uint64_t length) {
+	_file_delta_applied_callback.delta_file_id = delta_file_id;
+	_file_delta_applied_callback.error_code = error_code;
+	_file_delta_applied_callback.length = length;
+
+	network_dispatch_response((Packet *)&_file_delta_applied_callback);
+}
+
+void api_send_async_directory_read_callback(ObjectID directory_id, APIE error_code,
+                                            uint8_t *buffer, uint8_t length_read) {
+	_async_directory_read_callback.directory_id = directory_id;
+	_async_directory_read_callback.error_code = error_code;
+	_async_directory_read_callback.length_read = length_read;
+
+	// buffer can be NULL if length_read is zero
+	if (length_read > 0) {
+		memcpy(_async_directory_read_callback.buffer, buffer, length_read);
+	}
+
+	// memset'ing the rest of the buffer to zero ensures that no random
+	// heap/stack data can leak to the client
+	memset(_async_directory_read_callback.buffer + length_read, 0,
+	       sizeof(_async_directory_read_callback.buffer) - length_read);
+
+	network_dispatch_response((Packet *)&_async_directory_read_callback);
+}
+
+void api_send_directory_manifest_written_callback(ObjectID file_id, APIE error_code,
+                                                  uint32_t count) {
+	_directory_manifest_written_callback.file_id = file_id;
+	_directory_manifest_written_callback.error_code = error_code;
+	_directory_manifest_written_callback.count = count;
+
+	network_dispatch_response((Packet *)&_directory_manifest_written_callback);
+}
+
 void api_send_process_state_changed_callback(ObjectID process_id, uint8_t state,
                                              uint64_t timestamp, uint8_t exit_code) {
 	_process_state_changed_callback.process_id = process_id;
@@ -1102,6 +1582,12 @@ void api_send_process_state_changed_callback(ObjectID process_id, uint8_t state,
 	network_dispatch_response((Packet *)&_process_state_changed_callback);
 }
 
+void api_send_process_tree_killed_callback(ObjectID process_id) {
+	_process_tree_killed_callback.process_id = process_id;
+
+	network_dispatch_response((Packet *)&_process_tree_killed_callback);
+}
+
 void api_send_program_scheduler_state_changed_callback(ObjectID program_id) {
 	_program_scheduler_state_changed_callback.program_id = program_id;
 
@@ -1113,3 +1599,10 @@ void api_send_program_process_spawned_callback(ObjectID program_id) {
 
 	network_dispatch_response((Packet *)&_program_process_spawned_callback);
 }
+
+void api_send_watch_events_occurred_callback(ObjectID watch_id, uint16_t events) {
+	_watch_events_occurred_callback.watch_id = watch_id;
+	_watch_events_occurred_callback.events = events;
+
+	network_dispatch_response((Packet *)&_watch_events_occurred_callback);
+}
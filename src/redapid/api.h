@@ -44,12 +44,35 @@ void api_send_async_file_read_callback(ObjectID file_id, APIE error_code,
                                        uint8_t *buffer, uint8_t length_read);
 void api_send_async_file_write_callback(ObjectID file_id, APIE error_code,
                                         uint8_t length_written);
+void api_send_async_file_writes_acknowledged_callback(ObjectID file_id, APIE error_code,
+                                                      uint64_t length_written);
 void api_send_file_events_occurred_callback(ObjectID file_id, uint16_t events);
+void api_send_file_stream_data_callback(ObjectID file_id, APIE error_code,
+                                        uint8_t *buffer, uint8_t length_read);
+void api_send_path_info_reported_callback(ObjectID names_list_id, uint16_t index,
+                                          APIE error_code, uint8_t type,
+                                          uint16_t permissions, uint32_t uid,
+                                          uint32_t gid, uint64_t length,
+                                          uint64_t access_timestamp,
+                                          uint64_t modification_timestamp,
+                                          uint64_t status_change_timestamp);
+void api_send_file_signature_created_callback(ObjectID signature_file_id,
+                                              APIE error_code, uint32_t block_count);
+void api_send_file_delta_applied_callback(ObjectID delta_file_id, APIE error_code,
+                                          uint64_t length);
+
+void api_send_async_directory_read_callback(ObjectID directory_id, APIE error_code,
+                                            uint8_t *buffer, uint8_t length_read);
+void api_send_directory_manifest_written_callback(ObjectID file_id, APIE error_code,
+                                                  uint32_t count);
 
 void api_send_process_state_changed_callback(ObjectID process_id, uint8_t state,
                                              uint64_t timestamp, uint8_t exit_code);
+void api_send_process_tree_killed_callback(ObjectID process_id);
 
 void api_send_program_scheduler_state_changed_callback(ObjectID process_id);
 void api_send_program_process_spawned_callback(ObjectID process_id);
 
+void api_send_watch_events_occurred_callback(ObjectID watch_id, uint16_t events);
+
 #endif // REDAPID_API_H
@@ -27,6 +27,7 @@
 #include <daemonlib/packed_begin.h>
 
 #include "api.h"
+#include "directory.h"
 #include "file.h"
 #include "string.h"
 
@@ -374,6 +375,115 @@ typedef struct {
 	uint16_t events;
 } ATTRIBUTE_PACKED GetFileEventsResponse;
 
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint32_t block_length;
+	uint16_t signature_file_id;
+} ATTRIBUTE_PACKED CreateFileSignatureRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED CreateFileSignatureResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t basis_file_id;
+	uint16_t delta_file_id;
+	uint32_t block_length;
+	uint16_t target_name_string_id;
+	uint16_t permissions;
+	uint32_t uid;
+	uint32_t gid;
+} ATTRIBUTE_PACKED ApplyFileDeltaRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED ApplyFileDeltaResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint64_t length_to_read;
+	uint32_t block_length;
+} ATTRIBUTE_PACKED ReadFileAsyncCompressedRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint8_t buffer[FILE_MAX_WRITE_ASYNC_BUFFER_LENGTH];
+	uint8_t length_to_write;
+} ATTRIBUTE_PACKED WriteFileAsyncCompressedRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint32_t acknowledge_length;
+	uint16_t acknowledge_interval;
+} ATTRIBUTE_PACKED SetFileWriteWindowRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED SetFileWriteWindowResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint64_t length;
+	uint16_t flags;
+} ATTRIBUTE_PACKED SetFileSizeHintRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED SetFileSizeHintResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t names_list_id;
+	uint16_t flags;
+} ATTRIBUTE_PACKED StatPathsRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED StatPathsResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint32_t credit;
+} ATTRIBUTE_PACKED StartFileStreamRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED StartFileStreamResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint32_t credit;
+} ATTRIBUTE_PACKED AddFileStreamCreditRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED AddFileStreamCreditResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+} ATTRIBUTE_PACKED StopFileStreamRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED StopFileStreamResponse;
+
 typedef struct {
 	PacketHeader header;
 	uint16_t file_id;
@@ -389,12 +499,56 @@ typedef struct {
 	uint8_t length_written;
 } ATTRIBUTE_PACKED AsyncFileWriteCallback;
 
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint8_t error_code;
+	uint64_t length_written;
+} ATTRIBUTE_PACKED AsyncFileWritesAcknowledgedCallback;
+
 typedef struct {
 	PacketHeader header;
 	uint16_t file_id;
 	uint16_t events;
 } ATTRIBUTE_PACKED FileEventsOccurredCallback;
 
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint8_t error_code;
+	uint8_t buffer[FILE_MAX_READ_ASYNC_BUFFER_LENGTH];
+	uint8_t length_read;
+} ATTRIBUTE_PACKED FileStreamDataCallback;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t names_list_id;
+	uint16_t index;
+	uint8_t error_code;
+	uint8_t type;
+	uint16_t permissions;
+	uint32_t uid;
+	uint32_t gid;
+	uint64_t length;
+	uint64_t access_timestamp;
+	uint64_t modification_timestamp;
+	uint64_t status_change_timestamp;
+} ATTRIBUTE_PACKED PathInfoReportedCallback;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t signature_file_id;
+	uint8_t error_code;
+	uint32_t block_count;
+} ATTRIBUTE_PACKED FileSignatureCreatedCallback;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t delta_file_id;
+	uint8_t error_code;
+	uint64_t length;
+} ATTRIBUTE_PACKED FileDeltaAppliedCallback;
+
 //
 // directory
 //
@@ -460,6 +614,93 @@ typedef struct {
 	uint8_t error_code;
 } ATTRIBUTE_PACKED CreateDirectoryResponse;
 
+typedef struct {
+	PacketHeader header;
+	uint16_t directory_id;
+	uint16_t flags;
+} ATTRIBUTE_PACKED ReadDirectoryAsyncRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED ReadDirectoryAsyncResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t directory_id;
+	uint16_t max_depth;
+	uint16_t flags;
+} ATTRIBUTE_PACKED WalkDirectoryAsyncRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED WalkDirectoryAsyncResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t directory_id;
+} ATTRIBUTE_PACKED AbortAsyncDirectoryReadRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED AbortAsyncDirectoryReadResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t name_string_id;
+} ATTRIBUTE_PACKED GetDirectoryUsageRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint64_t length;
+	uint64_t allocated_length;
+	uint32_t file_count;
+	uint32_t directory_count;
+	uint64_t timestamp;
+} ATTRIBUTE_PACKED GetDirectoryUsageResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t name_string_id;
+	uint16_t flags;
+	uint16_t manifest_file_id;
+} ATTRIBUTE_PACKED GetDirectoryManifestRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED GetDirectoryManifestResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t name_string_id;
+	uint16_t manifest_id;
+	uint16_t diff_file_id;
+} ATTRIBUTE_PACKED DiffDirectoryManifestRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED DiffDirectoryManifestResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint8_t error_code;
+	uint32_t count;
+} ATTRIBUTE_PACKED DirectoryManifestWrittenCallback;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t directory_id;
+	uint8_t error_code;
+	uint8_t buffer[DIRECTORY_MAX_READ_ASYNC_BUFFER_LENGTH];
+	uint8_t length_read;
+} ATTRIBUTE_PACKED AsyncDirectoryReadCallback;
+
 //
 // process
 //
@@ -561,6 +802,49 @@ typedef struct {
 	uint8_t exit_code;
 } ATTRIBUTE_PACKED GetProcessStateResponse;
 
+typedef struct {
+	PacketHeader header;
+	uint16_t process_id;
+} ATTRIBUTE_PACKED GetProcessResourceUsageRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint64_t user_time;
+	uint64_t system_time;
+	uint32_t resident_set_size;
+	uint32_t peak_resident_set_size;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint32_t voluntary_context_switches;
+	uint32_t involuntary_context_switches;
+} ATTRIBUTE_PACKED GetProcessResourceUsageResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t process_id;
+	uint32_t max_length;
+	uint16_t session_id;
+} ATTRIBUTE_PACKED GetProcessOutputTailRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint16_t output_string_id;
+} ATTRIBUTE_PACKED GetProcessOutputTailResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t process_id;
+	uint8_t signal;
+	uint32_t timeout;
+} ATTRIBUTE_PACKED KillProcessTreeRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED KillProcessTreeResponse;
+
 typedef struct {
 	PacketHeader header;
 	uint16_t process_id;
@@ -569,6 +853,11 @@ typedef struct {
 	uint8_t exit_code;
 } ATTRIBUTE_PACKED ProcessStateChangedCallback;
 
+typedef struct {
+	PacketHeader header;
+	uint16_t process_id;
+} ATTRIBUTE_PACKED ProcessTreeKilledCallback;
+
 //
 // program
 //
@@ -607,6 +896,18 @@ typedef struct {
 	uint8_t error_code;
 } ATTRIBUTE_PACKED PurgeProgramResponse;
 
+typedef struct {
+	PacketHeader header;
+} ATTRIBUTE_PACKED GetPurgeProgressRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint32_t pending_count;
+	uint64_t removed_count;
+	uint32_t error_count;
+} ATTRIBUTE_PACKED GetPurgeProgressResponse;
+
 typedef struct {
 	PacketHeader header;
 	uint16_t program_id;
@@ -722,6 +1023,127 @@ typedef struct {
 	uint16_t start_fields_string_id;
 } ATTRIBUTE_PACKED GetProgramScheduleResponse;
 
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+	uint32_t cpu_max;
+	uint64_t memory_max;
+	uint64_t io_max;
+	uint32_t pids_max;
+} ATTRIBUTE_PACKED SetProgramLimitsRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED SetProgramLimitsResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+} ATTRIBUTE_PACKED GetProgramLimitsRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint32_t cpu_max;
+	uint64_t memory_max;
+	uint64_t io_max;
+	uint32_t pids_max;
+} ATTRIBUTE_PACKED GetProgramLimitsResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+} ATTRIBUTE_PACKED GetProgramResourceUsageRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint64_t cpu_time;
+	uint64_t memory_usage;
+	uint64_t memory_peak;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint32_t process_count;
+} ATTRIBUTE_PACKED GetProgramResourceUsageResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+	uint32_t output_buffer_size;
+} ATTRIBUTE_PACKED SetProgramOutputBufferSizeRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED SetProgramOutputBufferSizeResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+} ATTRIBUTE_PACKED GetProgramOutputBufferSizeRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint32_t output_buffer_size;
+} ATTRIBUTE_PACKED GetProgramOutputBufferSizeResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+	int8_t nice;
+	uint8_t policy;
+	uint32_t cpu_affinity;
+	uint8_t io_priority_class;
+	uint8_t io_priority_level;
+} ATTRIBUTE_PACKED SetProgramSchedulingAttributesRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED SetProgramSchedulingAttributesResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+} ATTRIBUTE_PACKED GetProgramSchedulingAttributesRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	int8_t nice;
+	uint8_t policy;
+	uint32_t cpu_affinity;
+	uint8_t io_priority_class;
+	uint8_t io_priority_level;
+} ATTRIBUTE_PACKED GetProgramSchedulingAttributesResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+	tfpbool enabled;
+	uint16_t modules_list_id;
+} ATTRIBUTE_PACKED SetProgramZygoteRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED SetProgramZygoteResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t program_id;
+	uint16_t session_id;
+} ATTRIBUTE_PACKED GetProgramZygoteRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	tfpbool enabled;
+	uint16_t modules_list_id;
+} ATTRIBUTE_PACKED GetProgramZygoteResponse;
+
 typedef struct {
 	PacketHeader header;
 	uint16_t program_id;
@@ -827,6 +1249,42 @@ typedef struct {
 	uint16_t program_id;
 } ATTRIBUTE_PACKED ProgramProcessSpawnedCallback;
 
+//
+// watch
+//
+
+typedef struct {
+	PacketHeader header;
+	uint16_t name_string_id;
+	uint16_t events;
+	uint16_t session_id;
+} ATTRIBUTE_PACKED WatchPathRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint16_t watch_id;
+} ATTRIBUTE_PACKED WatchPathResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t watch_id;
+	uint16_t session_id;
+} ATTRIBUTE_PACKED GetWatchInfoRequest;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+	uint16_t name_string_id;
+	uint16_t events;
+} ATTRIBUTE_PACKED GetWatchInfoResponse;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t watch_id;
+	uint16_t events;
+} ATTRIBUTE_PACKED WatchEventsOccurredCallback;
+
 //
 // misc
 //
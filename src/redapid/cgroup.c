@@ -0,0 +1,605 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * cgroup.c: Control group v2 based resource limits for programs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * each program gets its own control group below a redapid-programs control
+ * group next to redapid's own control group:
+ *
+ *   <mount><own>/redapid-programs/program-<identifier>
+ *
+ * cgroup v2 doesn't allow processes in a non-root control group that has
+ * controllers enabled for its children. if redapid is not in the root control
+ * group then it moves itself into a redapid-daemon leaf control group first.
+ * if cgroup v2 is not available then all of this is disabled and program
+ * limits are stored, but not applied.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <daemonlib/log.h>
+#include <daemonlib/utils.h>
+
+#include "cgroup.h"
+
+#include "api.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+#define CGROUP2_SUPER_MAGIC 0x63677270
+
+typedef enum { // bitmask
+	CGROUP_CONTROLLER_CPU    = 0x0001,
+	CGROUP_CONTROLLER_MEMORY = 0x0002,
+	CGROUP_CONTROLLER_IO     = 0x0004,
+	CGROUP_CONTROLLER_PIDS   = 0x0008
+} CgroupController;
+
+static const char *_controller_names[] = { "cpu", "memory", "io", "pids" };
+static bool _available = false;
+static int _controllers = 0;
+static char _programs_directory[CGROUP_MAX_NAME_LENGTH];
+
+static bool cgroup_is_mounted(const char *directory) {
+	struct statfs buffer;
+
+	return statfs(directory, &buffer) == 0 && buffer.f_type == CGROUP2_SUPER_MAGIC;
+}
+
+static int cgroup_write_file(const char *directory, const char *name, const char *value) {
+	char filename[CGROUP_MAX_NAME_LENGTH];
+	int fd;
+	int length = strlen(value);
+	int rc;
+
+	if (robust_snprintf(filename, sizeof(filename), "%s/%s", directory, name) < 0) {
+		return -1;
+	}
+
+	fd = open(filename, O_WRONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	rc = robust_write(fd, value, length);
+
+	close(fd);
+
+	return rc == length ? 0 : -1;
+}
+
+// returns the length of the NUL-terminated content
+static int cgroup_read_file(const char *directory, const char *name,
+                            char *buffer, int length) {
+	char filename[CGROUP_MAX_NAME_LENGTH];
+	int fd;
+	int rc;
+
+	if (robust_snprintf(filename, sizeof(filename), "%s/%s", directory, name) < 0) {
+		return -1;
+	}
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	rc = robust_read(fd, buffer, length - 1);
+
+	close(fd);
+
+	if (rc < 0) {
+		return -1;
+	}
+
+	buffer[rc] = '\0';
+
+	return rc;
+}
+
+// returns the value of a "<key> <value>" line, as used by cpu.stat
+static uint64_t cgroup_get_value(const char *buffer, const char *key) {
+	const char *line = buffer;
+	int key_length = strlen(key);
+
+	while (line != NULL) {
+		if (strncmp(line, key, key_length) == 0 && line[key_length] == ' ') {
+			return strtoull(line + key_length + 1, NULL, 10);
+		}
+
+		line = strchr(line, '\n');
+
+		if (line != NULL) {
+			++line;
+		}
+	}
+
+	return 0;
+}
+
+// returns the sum of all "<key>=<value>" fields, as used by io.stat
+static uint64_t cgroup_get_field_sum(const char *buffer, const char *key) {
+	const char *p = buffer;
+	int key_length = strlen(key);
+	uint64_t sum = 0;
+
+	while ((p = strstr(p, key)) != NULL) {
+		if ((p == buffer || p[-1] == ' ') && p[key_length] == '=') {
+			sum += strtoull(p + key_length + 1, NULL, 10);
+		}
+
+		p += key_length;
+	}
+
+	return sum;
+}
+
+// enables all wanted controllers that are available, one by one, so that a
+// single unavailable controller doesn't disable the others
+static int cgroup_enable_controllers(const char *directory, int wanted) {
+	char buffer[256];
+	int enabled = 0;
+	int i;
+
+	for (i = 0; i < (int)(sizeof(_controller_names) / sizeof(_controller_names[0])); ++i) {
+		if ((wanted & (1 << i)) == 0) {
+			continue;
+		}
+
+		snprintf(buffer, sizeof(buffer), "+%s", _controller_names[i]);
+
+		if (cgroup_write_file(directory, "cgroup.subtree_control", buffer) < 0) {
+			log_warn("Could not enable %s controller in control group '%s': %s (%d)",
+			         _controller_names[i], directory, get_errno_name(errno), errno);
+
+			continue;
+		}
+
+		enabled |= 1 << i;
+	}
+
+	return enabled;
+}
+
+static int cgroup_get_available_controllers(const char *directory) {
+	char buffer[256];
+	char *name;
+	char *saveptr;
+	int available = 0;
+	int i;
+
+	if (cgroup_read_file(directory, "cgroup.controllers", buffer, sizeof(buffer)) < 0) {
+		log_warn("Could not read available controllers of control group '%s': %s (%d)",
+		         directory, get_errno_name(errno), errno);
+
+		return 0;
+	}
+
+	for (name = strtok_r(buffer, " \n", &saveptr); name != NULL;
+	     name = strtok_r(NULL, " \n", &saveptr)) {
+		for (i = 0; i < (int)(sizeof(_controller_names) / sizeof(_controller_names[0])); ++i) {
+			if (strcmp(name, _controller_names[i]) == 0) {
+				available |= 1 << i;
+			}
+		}
+	}
+
+	return available;
+}
+
+// returns the path of the control group of redapid, as listed for the unified
+// hierarchy in /proc/self/cgroup
+static int cgroup_get_own_path(char *path, int length) {
+	char buffer[4096];
+	int fd;
+	int rc;
+	char *line;
+	char *end;
+
+	fd = open("/proc/self/cgroup", O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	rc = robust_read(fd, buffer, sizeof(buffer) - 1);
+
+	close(fd);
+
+	if (rc < 0) {
+		return -1;
+	}
+
+	buffer[rc] = '\0';
+
+	for (line = buffer; line != NULL && *line != '\0'; line = end != NULL ? end + 1 : NULL) {
+		end = strchr(line, '\n');
+
+		if (end != NULL) {
+			*end = '\0';
+		}
+
+		if (strncmp(line, "0::", 3) == 0) {
+			string_copy(path, length, line + 3);
+
+			return 0;
+		}
+	}
+
+	errno = ENOENT;
+
+	return -1;
+}
+
+// io.max only accepts whole disks, not partitions
+static int cgroup_get_disk(const char *name, unsigned int *disk_major,
+                           unsigned int *disk_minor) {
+	struct stat st;
+	char buffer[128];
+	char content[64];
+
+	if (stat(name, &st) < 0) {
+		return -1;
+	}
+
+	*disk_major = major(st.st_dev);
+	*disk_minor = minor(st.st_dev);
+
+	if (*disk_major == 0) {
+		errno = ENODEV; // not backed by a block device
+
+		return -1;
+	}
+
+	snprintf(buffer, sizeof(buffer), "/sys/dev/block/%u:%u", *disk_major, *disk_minor);
+
+	if (cgroup_read_file(buffer, "partition", content, sizeof(content)) < 0) {
+		return 0; // not a partition
+	}
+
+	if (cgroup_read_file(buffer, "../dev", content, sizeof(content)) < 0) {
+		return -1;
+	}
+
+	if (sscanf(content, "%u:%u", disk_major, disk_minor) != 2) {
+		errno = EINVAL;
+
+		return -1;
+	}
+
+	return 0;
+}
+
+int cgroup_init(void) {
+	const char *mount_directory;
+	char own_path[CGROUP_MAX_NAME_LENGTH];
+	char base_directory[CGROUP_MAX_NAME_LENGTH];
+	char daemon_directory[CGROUP_MAX_NAME_LENGTH];
+	int wanted;
+
+	log_debug("Initializing cgroup subsystem");
+
+	// use the system mount of the unified hierarchy, or mount it locally
+	if (cgroup_is_mounted(CGROUP_SYSTEM_DIRECTORY)) {
+		mount_directory = CGROUP_SYSTEM_DIRECTORY;
+	} else {
+		if (mkdir(CGROUP_LOCAL_DIRECTORY, 0755) < 0 && errno != EEXIST) {
+			log_warn("Could not create directory '"CGROUP_LOCAL_DIRECTORY"', program limits are disabled: %s (%d)",
+			         get_errno_name(errno), errno);
+
+			return 0;
+		}
+
+		if (!cgroup_is_mounted(CGROUP_LOCAL_DIRECTORY) &&
+		    mount("cgroup2", CGROUP_LOCAL_DIRECTORY, "cgroup2", 0, NULL) < 0) {
+			log_info("Control group v2 is not available, program limits are disabled: %s (%d)",
+			         get_errno_name(errno), errno);
+
+			return 0;
+		}
+
+		mount_directory = CGROUP_LOCAL_DIRECTORY;
+	}
+
+	if (cgroup_get_own_path(own_path, sizeof(own_path)) < 0) {
+		log_warn("Could not get own control group, program limits are disabled: %s (%d)",
+		         get_errno_name(errno), errno);
+
+		return 0;
+	}
+
+	if (strcmp(own_path, "/") == 0) {
+		string_copy(base_directory, sizeof(base_directory), mount_directory);
+	} else if (robust_snprintf(base_directory, sizeof(base_directory), "%s%s",
+	                           mount_directory, own_path) < 0 ||
+	           robust_snprintf(daemon_directory, sizeof(daemon_directory),
+	                           "%s/redapid-daemon", base_directory) < 0) {
+		log_warn("Could not format control group name, program limits are disabled: %s (%d)",
+		         get_errno_name(errno), errno);
+
+		return 0;
+	} else {
+		// move redapid into a leaf control group, so that controllers can be
+		// enabled in its former control group
+		if (mkdir(daemon_directory, 0755) < 0 && errno != EEXIST) {
+			log_warn("Could not create control group '%s', program limits are disabled: %s (%d)",
+			         daemon_directory, get_errno_name(errno), errno);
+
+			return 0;
+		}
+
+		if (cgroup_write_file(daemon_directory, "cgroup.procs", "0") < 0) {
+			log_warn("Could not move redapid into control group '%s', program limits are disabled: %s (%d)",
+			         daemon_directory, get_errno_name(errno), errno);
+
+			return 0;
+		}
+	}
+
+	if (robust_snprintf(_programs_directory, sizeof(_programs_directory),
+	                    "%s/redapid-programs", base_directory) < 0) {
+		log_warn("Could not format control group name, program limits are disabled: %s (%d)",
+		         get_errno_name(errno), errno);
+
+		return 0;
+	}
+
+	wanted = cgroup_get_available_controllers(base_directory);
+	wanted = cgroup_enable_controllers(base_directory, wanted);
+
+	if (mkdir(_programs_directory, 0755) < 0 && errno != EEXIST) {
+		log_warn("Could not create control group '%s', program limits are disabled: %s (%d)",
+		         _programs_directory, get_errno_name(errno), errno);
+
+		return 0;
+	}
+
+	_controllers = cgroup_enable_controllers(_programs_directory, wanted);
+	_available = true;
+
+	log_debug("Using control group '%s' for programs (controllers: 0x%04X)",
+	          _programs_directory, _controllers);
+
+	return 0;
+}
+
+void cgroup_exit(void) {
+	log_debug("Shutting down cgroup subsystem");
+
+	// the control groups are left in place, because programs can outlive
+	// redapid and a restarted redapid will reuse them
+}
+
+bool cgroup_is_available(void) {
+	return _available;
+}
+
+// creates the control group of a program, if necessary, and applies the limits
+APIE cgroup_prepare(const char *identifier, CgroupLimits *limits,
+                    const char *io_directory, char *name, int length) {
+	APIE error_code;
+	char buffer[128];
+	unsigned int disk_major;
+	unsigned int disk_minor;
+
+	if (!_available) {
+		return API_E_NOT_SUPPORTED;
+	}
+
+	if (robust_snprintf(name, length, "%s/program-%s", _programs_directory, identifier) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not format control group name: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if (mkdir(name, 0755) < 0 && errno != EEXIST) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create control group '%s': %s (%d)",
+		          name, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	// cpu.max
+	if ((_controllers & CGROUP_CONTROLLER_CPU) != 0) {
+		if (limits->cpu_max == 0) {
+			snprintf(buffer, sizeof(buffer), "max %u", CGROUP_CPU_PERIOD);
+		} else {
+			snprintf(buffer, sizeof(buffer), "%llu %u",
+			         (unsigned long long)limits->cpu_max * CGROUP_CPU_PERIOD / 100,
+			         CGROUP_CPU_PERIOD);
+		}
+
+		if (cgroup_write_file(name, "cpu.max", buffer) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not set CPU limit of control group '%s': %s (%d)",
+			          name, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+	} else if (limits->cpu_max != 0) {
+		log_warn("Cannot apply CPU limit to control group '%s', cpu controller is not available", name);
+	}
+
+	// memory.max
+	if ((_controllers & CGROUP_CONTROLLER_MEMORY) != 0) {
+		if (limits->memory_max == 0) {
+			string_copy(buffer, sizeof(buffer), "max");
+		} else {
+			snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)limits->memory_max);
+		}
+
+		if (cgroup_write_file(name, "memory.max", buffer) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not set memory limit of control group '%s': %s (%d)",
+			          name, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+	} else if (limits->memory_max != 0) {
+		log_warn("Cannot apply memory limit to control group '%s', memory controller is not available", name);
+	}
+
+	// io.max, for the disk that contains the program
+	if ((_controllers & CGROUP_CONTROLLER_IO) != 0) {
+		if (cgroup_get_disk(io_directory, &disk_major, &disk_minor) < 0) {
+			if (limits->io_max != 0) {
+				log_warn("Cannot apply I/O limit to control group '%s', could not get disk of '%s': %s (%d)",
+				         name, io_directory, get_errno_name(errno), errno);
+			}
+		} else {
+			if (limits->io_max == 0) {
+				snprintf(buffer, sizeof(buffer), "%u:%u rbps=max wbps=max",
+				         disk_major, disk_minor);
+			} else {
+				snprintf(buffer, sizeof(buffer), "%u:%u rbps=%llu wbps=%llu",
+				         disk_major, disk_minor,
+				         (unsigned long long)limits->io_max,
+				         (unsigned long long)limits->io_max);
+			}
+
+			if (cgroup_write_file(name, "io.max", buffer) < 0) {
+				error_code = api_get_error_code_from_errno();
+
+				log_error("Could not set I/O limit of control group '%s': %s (%d)",
+				          name, get_errno_name(errno), errno);
+
+				return error_code;
+			}
+		}
+	} else if (limits->io_max != 0) {
+		log_warn("Cannot apply I/O limit to control group '%s', io controller is not available", name);
+	}
+
+	// pids.max
+	if ((_controllers & CGROUP_CONTROLLER_PIDS) != 0) {
+		if (limits->pids_max == 0) {
+			string_copy(buffer, sizeof(buffer), "max");
+		} else {
+			snprintf(buffer, sizeof(buffer), "%u", limits->pids_max);
+		}
+
+		if (cgroup_write_file(name, "pids.max", buffer) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not set process limit of control group '%s': %s (%d)",
+			          name, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+	} else if (limits->pids_max != 0) {
+		log_warn("Cannot apply process limit to control group '%s', pids controller is not available", name);
+	}
+
+	return API_E_SUCCESS;
+}
+
+// removing a control group only works if it has no processes left
+void cgroup_remove(const char *identifier) {
+	char name[CGROUP_MAX_NAME_LENGTH];
+
+	if (!_available) {
+		return;
+	}
+
+	if (robust_snprintf(name, sizeof(name), "%s/program-%s", _programs_directory, identifier) < 0) {
+		log_error("Could not format control group name: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return;
+	}
+
+	if (rmdir(name) < 0 && errno != ENOENT) {
+		log_warn("Could not remove control group '%s': %s (%d)",
+		         name, get_errno_name(errno), errno);
+	}
+}
+
+// a program without control group, e.g. never started, reports zero usage
+APIE cgroup_get_usage(const char *identifier, uint64_t *cpu_time,
+                      uint64_t *memory_usage, uint64_t *memory_peak,
+                      uint64_t *read_bytes, uint64_t *write_bytes,
+                      uint32_t *process_count) {
+	APIE error_code;
+	char name[CGROUP_MAX_NAME_LENGTH];
+	char buffer[4096];
+
+	*cpu_time = 0;
+	*memory_usage = 0;
+	*memory_peak = 0;
+	*read_bytes = 0;
+	*write_bytes = 0;
+	*process_count = 0;
+
+	if (!_available) {
+		return API_E_NOT_SUPPORTED;
+	}
+
+	if (robust_snprintf(name, sizeof(name), "%s/program-%s", _programs_directory, identifier) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not format control group name: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	// cpu.stat exists even without the cpu controller
+	if (cgroup_read_file(name, "cpu.stat", buffer, sizeof(buffer)) >= 0) {
+		*cpu_time = cgroup_get_value(buffer, "usage_usec");
+	}
+
+	if (cgroup_read_file(name, "memory.current", buffer, sizeof(buffer)) >= 0) {
+		*memory_usage = strtoull(buffer, NULL, 10);
+	}
+
+	// memory.peak only exists since Linux 5.19
+	if (cgroup_read_file(name, "memory.peak", buffer, sizeof(buffer)) >= 0) {
+		*memory_peak = strtoull(buffer, NULL, 10);
+	}
+
+	if (cgroup_read_file(name, "io.stat", buffer, sizeof(buffer)) >= 0) {
+		*read_bytes = cgroup_get_field_sum(buffer, "rbytes");
+		*write_bytes = cgroup_get_field_sum(buffer, "wbytes");
+	}
+
+	if (cgroup_read_file(name, "pids.current", buffer, sizeof(buffer)) >= 0) {
+		*process_count = strtoul(buffer, NULL, 10);
+	}
+
+	return API_E_SUCCESS;
+}
@@ -0,0 +1,56 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * cgroup.h: Control group v2 based resource limits for programs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_CGROUP_H
+#define REDAPID_CGROUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "api_error.h"
+
+#define CGROUP_SYSTEM_DIRECTORY "/sys/fs/cgroup"
+#define CGROUP_LOCAL_DIRECTORY LOCALSTATEDIR"/run/redapid-cgroup" // if the system doesn't mount cgroup v2
+#define CGROUP_CPU_PERIOD 100000 // microseconds
+#define CGROUP_MAX_NAME_LENGTH 1024
+
+typedef struct {
+	uint32_t cpu_max; // percent of one CPU core, 0 for no limit
+	uint64_t memory_max; // bytes, 0 for no limit
+	uint64_t io_max; // bytes per second for reading and writing each, 0 for no limit
+	uint32_t pids_max; // 0 for no limit
+} CgroupLimits;
+
+int cgroup_init(void);
+void cgroup_exit(void);
+
+bool cgroup_is_available(void);
+
+APIE cgroup_prepare(const char *identifier, CgroupLimits *limits,
+                    const char *io_directory, char *name, int length);
+void cgroup_remove(const char *identifier);
+
+APIE cgroup_get_usage(const char *identifier, uint64_t *cpu_time,
+                      uint64_t *memory_usage, uint64_t *memory_peak,
+                      uint64_t *read_bytes, uint64_t *write_bytes,
+                      uint32_t *process_count);
+
+#endif // REDAPID_CGROUP_H
@@ -0,0 +1,1153 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * delta.c: Block signature and delta transfer for files
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * the delta transfer follows the rsync algorithm with the RED Brick being the
+ * receiving side. the client asks for the block signature of the existing
+ * version of a file, searches its local version for matching blocks using the
+ * rolling weak checksum, confirms candidates with the strong checksum and then
+ * sends a delta that consists of literal data and references to blocks of the
+ * existing version. the delta is applied to a temporary file that is renamed
+ * over the target file afterwards, so the target is replaced atomically.
+ *
+ * signature format (little endian):
+ *
+ *   uint32_t block_length
+ *   uint64_t file_length
+ *   uint32_t block_count
+ *   block_count times:
+ *     uint32_t weak_checksum   // rsync style: (a & 0xFFFF) | (b << 16)
+ *     uint64_t strong_checksum // 64-bit FNV-1a
+ *
+ * delta format (little endian), sequence of operations until end-of-file:
+ *
+ *   uint8_t operation
+ *   DELTA_OPERATION_LITERAL: uint32_t length, uint8_t data[length]
+ *   DELTA_OPERATION_COPY:    uint32_t first_block, uint32_t block_count
+ *
+ * the last block of the existing version might be shorter than block_length.
+ *
+ * reading, hashing and writing whole files can take a while, especially on an
+ * SD card. therefore each request is processed by a job on a separate thread.
+ * the objects are acquired and checked on the event loop before the thread is
+ * started. the thread only uses the file descriptors and names of the file
+ * objects and closes its end of a pipe when it is done. the event loop then
+ * reports the outcome by a file-signature-created or file-delta-applied
+ * callback.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <daemonlib/array.h>
+#include <daemonlib/event.h>
+#include <daemonlib/log.h>
+#include <daemonlib/pipe.h>
+#include <daemonlib/threads.h>
+#include <daemonlib/utils.h>
+
+#include "delta.h"
+
+#include "api.h"
+#include "file.h"
+#include "string.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+#define DELTA_SIGNATURE_ENTRIES_PER_WRITE 256
+#define DELTA_MAX_JOBS 4
+
+#include <daemonlib/packed_begin.h>
+
+typedef struct {
+	uint32_t block_length;
+	uint64_t file_length;
+	uint32_t block_count;
+} ATTRIBUTE_PACKED DeltaSignatureHeader;
+
+typedef struct {
+	uint32_t weak_checksum;
+	uint64_t strong_checksum;
+} ATTRIBUTE_PACKED DeltaSignatureEntry;
+
+#include <daemonlib/packed_end.h>
+
+typedef struct {
+	bool apply; // apply_file_delta instead of create_file_signature
+	uint32_t block_length;
+	File *file; // signed file or basis file
+	File *delta_file; // only used by apply_file_delta
+	File *output_file; // signature file or temporary file
+	int output_fd;
+	char *target_name; // copy of the target name string object
+	Pipe pipe;
+	Thread thread;
+	volatile bool aborted;
+	APIE error_code; // of the thread
+	uint32_t block_count; // blocks signed by the thread
+	uint64_t length; // bytes written to the temporary file by the thread
+} DeltaJob;
+
+static Array _jobs; // DeltaJob pointers
+
+static uint32_t delta_get_weak_checksum(uint8_t *buffer, int length) {
+	uint32_t a = 0;
+	uint32_t b = 0;
+	int i;
+
+	for (i = 0; i < length; ++i) {
+		a += buffer[i];
+		b += (uint32_t)(length - i) * buffer[i];
+	}
+
+	return (a & 0xFFFF) | (b << 16);
+}
+
+static uint64_t delta_get_strong_checksum(uint8_t *buffer, int length) {
+	uint64_t hash = UINT64_C(14695981039346656037);
+	int i;
+
+	for (i = 0; i < length; ++i) {
+		hash ^= buffer[i];
+		hash *= UINT64_C(1099511628211);
+	}
+
+	return hash;
+}
+
+// sets errno on error, only returns less than length on end-of-file
+static int delta_read_fully(int fd, void *buffer, int length, off_t offset) {
+	int total = 0;
+	int rc;
+
+	while (total < length) {
+		rc = pread(fd, (uint8_t *)buffer + total, length - total, offset + total);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		if (rc == 0) {
+			break;
+		}
+
+		total += rc;
+	}
+
+	return total;
+}
+
+// sets errno on error
+static int delta_write_fully(int fd, void *buffer, int length) {
+	int total = 0;
+	int rc;
+
+	while (total < length) {
+		rc = write(fd, (uint8_t *)buffer + total, length - total);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		total += rc;
+	}
+
+	return 0;
+}
+
+static APIE delta_check_block_length(uint32_t block_length) {
+	if (block_length < DELTA_MIN_BLOCK_LENGTH || block_length > DELTA_MAX_BLOCK_LENGTH) {
+		log_warn("Block length of %u byte(s) is out-of-range", block_length);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	return API_E_SUCCESS;
+}
+
+static APIE delta_check_regular_file(File *file) {
+	if (file->type != FILE_TYPE_REGULAR) {
+		log_warn("Cannot use non-regular file object (id: %u, name: %s) for delta transfer",
+		         file->base.id, file->name->buffer);
+
+		return API_E_NOT_SUPPORTED;
+	}
+
+	if (file->async_read_in_progress) {
+		log_warn("Cannot use file object (id: %u, name: %s) for delta transfer while reading %"PRIu64" byte(s) from it asynchronously",
+		         file->base.id, file->name->buffer, file->length_to_read_async);
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread
+static APIE delta_copy_literal(DeltaJob *job, off_t *delta_offset,
+                               uint8_t *buffer) {
+	APIE error_code;
+	uint32_t length;
+	int length_to_copy;
+	int rc;
+
+	rc = delta_read_fully(job->delta_file->fd, &length, sizeof(length), *delta_offset);
+
+	if (rc < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not read literal length from delta file '%s': %s (%d)",
+		          job->delta_file->name->buffer, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if (rc < (int)sizeof(length)) {
+		log_warn("Delta file '%s' ends in the middle of a literal operation",
+		         job->delta_file->name->buffer);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	*delta_offset += sizeof(length);
+
+	while (length > 0) {
+		if (job->aborted) {
+			return API_E_OPERATION_ABORTED;
+		}
+
+		length_to_copy = length < job->block_length ? (int)length : (int)job->block_length;
+		rc = delta_read_fully(job->delta_file->fd, buffer, length_to_copy, *delta_offset);
+
+		if (rc < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not read literal data from delta file '%s': %s (%d)",
+			          job->delta_file->name->buffer, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+
+		if (rc < length_to_copy) {
+			log_warn("Delta file '%s' ends in the middle of literal data",
+			         job->delta_file->name->buffer);
+
+			return API_E_INVALID_PARAMETER;
+		}
+
+		if (delta_write_fully(job->output_fd, buffer, length_to_copy) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not write to temporary file '%s': %s (%d)",
+			          job->output_file->name->buffer, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+
+		*delta_offset += length_to_copy;
+		job->length += length_to_copy;
+		length -= length_to_copy;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread
+static APIE delta_copy_blocks(DeltaJob *job, off_t *delta_offset,
+                              uint64_t basis_length, uint8_t *buffer) {
+	APIE error_code;
+	uint32_t block_length = job->block_length;
+	uint32_t arguments[2]; // first_block, block_count
+	uint64_t basis_block_count = (basis_length + block_length - 1) / block_length;
+	uint64_t block;
+	uint64_t offset;
+	int length_to_copy;
+	int rc;
+
+	rc = delta_read_fully(job->delta_file->fd, arguments, sizeof(arguments), *delta_offset);
+
+	if (rc < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not read copy operation from delta file '%s': %s (%d)",
+		          job->delta_file->name->buffer, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if (rc < (int)sizeof(arguments)) {
+		log_warn("Delta file '%s' ends in the middle of a copy operation",
+		         job->delta_file->name->buffer);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	*delta_offset += sizeof(arguments);
+
+	if (arguments[0] >= basis_block_count ||
+	    arguments[1] > basis_block_count - arguments[0]) {
+		log_warn("Delta file '%s' references blocks %u to %u, but basis file '%s' has %"PRIu64" block(s) only",
+		         job->delta_file->name->buffer, arguments[0], arguments[0] + arguments[1],
+		         job->file->name->buffer, basis_block_count);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	for (block = arguments[0]; block < (uint64_t)arguments[0] + arguments[1]; ++block) {
+		if (job->aborted) {
+			return API_E_OPERATION_ABORTED;
+		}
+
+		offset = block * block_length;
+		length_to_copy = basis_length - offset < block_length ? (int)(basis_length - offset) : (int)block_length;
+		rc = delta_read_fully(job->file->fd, buffer, length_to_copy, offset);
+
+		if (rc < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not read block %"PRIu64" from basis file '%s': %s (%d)",
+			          block, job->file->name->buffer, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+
+		if (rc < length_to_copy) {
+			log_warn("Basis file '%s' was truncated while applying delta file '%s'",
+			         job->file->name->buffer, job->delta_file->name->buffer);
+
+			return API_E_INVALID_OPERATION;
+		}
+
+		if (delta_write_fully(job->output_fd, buffer, length_to_copy) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not write to temporary file '%s': %s (%d)",
+			          job->output_file->name->buffer, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+
+		job->length += length_to_copy;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread
+static APIE delta_write_signature(DeltaJob *job) {
+	int phase = 0;
+	APIE error_code;
+	struct stat st;
+	uint8_t *buffer;
+	DeltaSignatureHeader header;
+	DeltaSignatureEntry entries[DELTA_SIGNATURE_ENTRIES_PER_WRITE];
+	int entry_count = 0;
+	uint64_t expected_block_count;
+	off_t offset;
+	int length;
+
+	if (fstat(job->file->fd, &st) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get information for file '%s': %s (%d)",
+		          job->file->name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	expected_block_count = ((uint64_t)st.st_size + job->block_length - 1) / job->block_length;
+
+	if (expected_block_count > UINT32_MAX) {
+		error_code = API_E_OVERFLOW;
+
+		log_warn("File '%s' has too many blocks for a block length of %u byte(s)",
+		         job->file->name->buffer, job->block_length);
+
+		goto cleanup;
+	}
+
+	// allocate block buffer
+	buffer = malloc(job->block_length);
+
+	if (buffer == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate block buffer: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	// write header
+	header.block_length = job->block_length;
+	header.file_length = st.st_size;
+	header.block_count = expected_block_count;
+
+	if (delta_write_fully(job->output_fd, &header, sizeof(header)) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not write signature header to '%s': %s (%d)",
+		          job->output_file->name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	// write entries, collect them to avoid a write call per block
+	for (offset = 0; offset < st.st_size; offset += length) {
+		if (job->aborted) {
+			error_code = API_E_OPERATION_ABORTED;
+
+			goto cleanup;
+		}
+
+		length = delta_read_fully(job->file->fd, buffer, job->block_length, offset);
+
+		if (length < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not read from file '%s': %s (%d)",
+			          job->file->name->buffer, get_errno_name(errno), errno);
+
+			goto cleanup;
+		}
+
+		if (length == 0) {
+			break;
+		}
+
+		entries[entry_count].weak_checksum = delta_get_weak_checksum(buffer, length);
+		entries[entry_count].strong_checksum = delta_get_strong_checksum(buffer, length);
+
+		++entry_count;
+		++job->block_count;
+
+		if (entry_count < DELTA_SIGNATURE_ENTRIES_PER_WRITE && offset + length < st.st_size) {
+			continue;
+		}
+
+		if (delta_write_fully(job->output_fd, entries,
+		                      entry_count * sizeof(DeltaSignatureEntry)) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not write signature entries to '%s': %s (%d)",
+			          job->output_file->name->buffer, get_errno_name(errno), errno);
+
+			goto cleanup;
+		}
+
+		entry_count = 0;
+	}
+
+	if (job->block_count != expected_block_count) {
+		error_code = API_E_INVALID_OPERATION;
+
+		log_warn("File '%s' was modified while creating its signature",
+		         job->file->name->buffer);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	free(buffer);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 1:
+		free(buffer);
+
+	default:
+		break;
+	}
+
+	return phase == 2 ? API_E_SUCCESS : error_code;
+}
+
+// only called from the job thread
+static APIE delta_write_target(DeltaJob *job) {
+	int phase = 0;
+	APIE error_code;
+	struct stat st;
+	uint8_t *buffer;
+	off_t delta_offset = 0;
+	uint8_t operation;
+	int rc;
+
+	if (fstat(job->file->fd, &st) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get information for basis file '%s': %s (%d)",
+		          job->file->name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	// allocate copy buffer
+	buffer = malloc(job->block_length);
+
+	if (buffer == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate block buffer: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	// apply operations
+	for (;;) {
+		if (job->aborted) {
+			error_code = API_E_OPERATION_ABORTED;
+
+			goto cleanup;
+		}
+
+		rc = delta_read_fully(job->delta_file->fd, &operation, sizeof(operation), delta_offset);
+
+		if (rc < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not read operation from delta file '%s': %s (%d)",
+			          job->delta_file->name->buffer, get_errno_name(errno), errno);
+
+			goto cleanup;
+		}
+
+		if (rc == 0) {
+			break; // end-of-delta
+		}
+
+		delta_offset += sizeof(operation);
+
+		switch (operation) {
+		case DELTA_OPERATION_LITERAL:
+			error_code = delta_copy_literal(job, &delta_offset, buffer);
+
+			break;
+
+		case DELTA_OPERATION_COPY:
+			error_code = delta_copy_blocks(job, &delta_offset, st.st_size, buffer);
+
+			break;
+
+		default:
+			error_code = API_E_INVALID_PARAMETER;
+
+			log_warn("Invalid operation %u in delta file '%s'",
+			         operation, job->delta_file->name->buffer);
+
+			break;
+		}
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	// ensure that the data is on disk before replacing the target file with it
+	if (fsync(job->output_fd) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not sync temporary file '%s': %s (%d)",
+		          job->output_file->name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	if (rename(job->output_file->name->buffer, job->target_name) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not rename temporary file '%s' to '%s': %s (%d)",
+		          job->output_file->name->buffer, job->target_name,
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	free(buffer);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 1:
+		free(buffer);
+
+	default:
+		break;
+	}
+
+	return phase == 2 ? API_E_SUCCESS : error_code;
+}
+
+static void delta_run(void *opaque) {
+	DeltaJob *job = opaque;
+
+	if (job->apply) {
+		job->error_code = delta_write_target(job);
+
+		if (job->error_code != API_E_SUCCESS) {
+			unlink(job->output_file->name->buffer);
+		}
+	} else {
+		job->error_code = delta_write_signature(job);
+	}
+
+	// signal the end of the job to the event loop
+	close(job->pipe.write_end);
+}
+
+// a file object can be read by several jobs at the same time, but a job that
+// writes to it has to be the only one using it
+static APIE delta_check_file_unused(File *file, bool writing) {
+	DeltaJob *job;
+	int i;
+
+	for (i = 0; i < _jobs.count; ++i) {
+		job = *(DeltaJob **)array_get(&_jobs, i);
+
+		if (job->output_file == file ||
+		    (writing && (job->file == file || job->delta_file == file))) {
+			log_warn("Cannot use file object (id: %u, name: %s) for delta transfer while another delta transfer %s it",
+			         file->base.id, file->name->buffer,
+			         job->output_file == file ? "writes to" : "reads from");
+
+			return API_E_INVALID_OPERATION;
+		}
+	}
+
+	return API_E_SUCCESS;
+}
+
+static APIE delta_check_job_count(void) {
+	if (_jobs.count >= DELTA_MAX_JOBS) {
+		log_warn("Cannot start delta transfer, all %d jobs are still running",
+		         DELTA_MAX_JOBS);
+
+		return API_E_WOULD_BLOCK;
+	}
+
+	return API_E_SUCCESS;
+}
+
+static void delta_destroy_job(DeltaJob *job) {
+	int i;
+
+	for (i = 0; i < _jobs.count; ++i) {
+		if (*(DeltaJob **)array_get(&_jobs, i) == job) {
+			array_remove(&_jobs, i, NULL);
+
+			break;
+		}
+	}
+
+	file_release(job->output_file);
+
+	if (job->apply) {
+		free(job->target_name);
+		file_release(job->delta_file);
+	}
+
+	file_release(job->file);
+	free(job);
+}
+
+static void delta_stop_job(DeltaJob *job) {
+	job->aborted = true;
+
+	event_remove_source(job->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+	close(job->pipe.read_end);
+
+	thread_join(&job->thread);
+	thread_destroy(&job->thread);
+}
+
+static void delta_finish_job(DeltaJob *job, APIE error_code) {
+	if (job->apply) {
+		if (error_code == API_E_SUCCESS) {
+			log_debug("Applied delta file '%s' to basis file '%s' resulting in %"PRIu64" byte(s) written to '%s'",
+			          job->delta_file->name->buffer, job->file->name->buffer,
+			          job->length, job->target_name);
+		}
+
+		api_send_file_delta_applied_callback(job->delta_file->base.id, error_code,
+		                                     error_code == API_E_SUCCESS ? job->length : 0);
+	} else {
+		if (error_code == API_E_SUCCESS) {
+			log_debug("Created signature with %u block(s) of %u byte(s) for file '%s'",
+			          job->block_count, job->block_length, job->file->name->buffer);
+		}
+
+		api_send_file_signature_created_callback(job->output_file->base.id, error_code,
+		                                         error_code == API_E_SUCCESS ? job->block_count : 0);
+	}
+
+	delta_destroy_job(job);
+}
+
+static void delta_handle_done(void *opaque) {
+	DeltaJob *job = opaque;
+	uint8_t byte;
+	int rc;
+
+	rc = read(job->pipe.read_end, &byte, sizeof(byte));
+
+	if (rc < 0) {
+		if (errno_interrupted() || errno_would_block()) {
+			return;
+		}
+
+		log_error("Could not read from delta job pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		delta_stop_job(job);
+		delta_finish_job(job, API_E_INTERNAL_ERROR);
+
+		return;
+	}
+
+	if (rc > 0) {
+		return; // the job thread doesn't write to the pipe
+	}
+
+	// the job thread is done and closed the write end
+	event_remove_source(job->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+	close(job->pipe.read_end);
+
+	thread_join(&job->thread);
+	thread_destroy(&job->thread);
+
+	delta_finish_job(job, job->error_code);
+}
+
+// takes ownership of the job on success
+static APIE delta_start_job(DeltaJob *job) {
+	int phase = 0;
+	APIE error_code;
+	DeltaJob **job_ptr;
+
+	if (pipe_create(&job->pipe, PIPE_FLAG_NON_BLOCKING_READ) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create delta job pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	job_ptr = array_append(&_jobs);
+
+	if (job_ptr == NULL) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not append to delta job array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	*job_ptr = job;
+
+	phase = 2;
+
+	if (event_add_source(job->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, delta_handle_done, job) < 0) {
+		error_code = API_E_INTERNAL_ERROR;
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	thread_create(&job->thread, delta_run, job);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 2:
+		array_remove(&_jobs, _jobs.count - 1, NULL);
+
+	case 1:
+		pipe_destroy(&job->pipe);
+
+	default:
+		break;
+	}
+
+	return phase == 3 ? API_E_SUCCESS : error_code;
+}
+
+int delta_init(void) {
+	log_debug("Initializing delta subsystem");
+
+	if (array_create(&_jobs, DELTA_MAX_JOBS, sizeof(DeltaJob *), true) < 0) {
+		log_error("Could not create delta job array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+void delta_exit(void) {
+	DeltaJob *job;
+
+	log_debug("Shutting down delta subsystem");
+
+	while (_jobs.count > 0) {
+		job = *(DeltaJob **)array_get(&_jobs, _jobs.count - 1);
+
+		delta_stop_job(job);
+		delta_destroy_job(job);
+	}
+
+	array_destroy(&_jobs, NULL);
+}
+
+// public API
+APIE delta_create_signature(ObjectID file_id, uint32_t block_length,
+                            ObjectID signature_file_id) {
+	int phase = 0;
+	APIE error_code;
+	DeltaJob *job;
+
+	// check parameters
+	error_code = delta_check_block_length(block_length);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	error_code = delta_check_job_count();
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	// allocate job
+	job = calloc(1, sizeof(DeltaJob));
+
+	if (job == NULL) {
+		log_error("Could not allocate delta job: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	job->block_length = block_length;
+
+	phase = 1;
+
+	// acquire file objects
+	error_code = file_get_acquired(file_id, &job->file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	error_code = file_get_acquired(signature_file_id, &job->output_file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	if (job->file == job->output_file) {
+		error_code = API_E_INVALID_PARAMETER;
+
+		log_warn("Cannot write signature of file object (id: %u, name: %s) to itself",
+		         job->file->base.id, job->file->name->buffer);
+
+		goto cleanup;
+	}
+
+	error_code = delta_check_regular_file(job->file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = delta_check_regular_file(job->output_file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = delta_check_file_unused(job->file, false);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = delta_check_file_unused(job->output_file, true);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	job->output_fd = file_get_write_handle(job->output_file);
+
+	error_code = delta_start_job(job);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 4;
+
+	log_debug("Started creating signature with block length of %u byte(s) for file '%s'",
+	          block_length, job->file->name->buffer);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 3:
+		file_release(job->output_file);
+
+	case 2:
+		file_release(job->file);
+
+	case 1:
+		free(job);
+
+	default:
+		break;
+	}
+
+	return phase == 4 ? API_E_SUCCESS : error_code;
+}
+
+// public API
+APIE delta_apply(ObjectID basis_file_id, ObjectID delta_file_id,
+                 uint32_t block_length, ObjectID target_name_id,
+                 uint16_t permissions, uint32_t uid, uint32_t gid) {
+	int phase = 0;
+	APIE error_code;
+	DeltaJob *job;
+	String *target_name;
+	int counter = 0;
+	String *temporary_name;
+
+	// check parameters
+	error_code = delta_check_block_length(block_length);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	error_code = delta_check_job_count();
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	// allocate job
+	job = calloc(1, sizeof(DeltaJob));
+
+	if (job == NULL) {
+		log_error("Could not allocate delta job: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	job->apply = true;
+	job->block_length = block_length;
+
+	phase = 1;
+
+	// acquire file objects
+	error_code = file_get_acquired(basis_file_id, &job->file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	error_code = file_get_acquired(delta_file_id, &job->delta_file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	error_code = delta_check_regular_file(job->file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = delta_check_regular_file(job->delta_file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = delta_check_file_unused(job->file, false);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = delta_check_file_unused(job->delta_file, false);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// acquire and lock target name string object
+	error_code = string_get_acquired_and_locked(target_name_id, &target_name);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 4;
+
+	if (*target_name->buffer != '/') {
+		error_code = API_E_INVALID_PARAMETER;
+
+		log_warn("Cannot apply delta to file with relative name '%s'",
+		         target_name->buffer);
+
+		goto cleanup;
+	}
+
+	// the job thread cannot access the string object, copy it
+	job->target_name = strdup(target_name->buffer);
+
+	if (job->target_name == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not duplicate target name: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 5;
+
+	// create temporary file next to the target file, so it can be renamed
+	// over the target file afterwards. the temporary file is created with the
+	// given identity in the same way open_file would create the target file
+	for (;;) {
+		error_code = string_asprintf(NULL,
+		                             OBJECT_CREATE_FLAG_INTERNAL |
+		                             OBJECT_CREATE_FLAG_LOCKED,
+		                             NULL, &temporary_name, "%s.delta-%u-%d",
+		                             job->target_name, (uint32_t)getpid(), counter);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+
+		error_code = file_open(temporary_name->base.id,
+		                       FILE_FLAG_WRITE_ONLY | FILE_FLAG_CREATE | FILE_FLAG_EXCLUSIVE,
+		                       permissions, uid, gid,
+		                       NULL, OBJECT_CREATE_FLAG_INTERNAL, NULL, &job->output_file);
+
+		string_unlock_and_release(temporary_name);
+
+		if (error_code == API_E_SUCCESS) {
+			break;
+		}
+
+		if (error_code != API_E_ALREADY_EXISTS) {
+			goto cleanup;
+		}
+
+		if (++counter >= 1000) {
+			log_error("Could not create temporary file for '%s' within 1000 attempts",
+			          job->target_name);
+
+			goto cleanup;
+		}
+	}
+
+	job->output_fd = job->output_file->fd;
+
+	phase = 6;
+
+	error_code = delta_start_job(job);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 7;
+
+	log_debug("Started applying delta file '%s' to basis file '%s' for '%s'",
+	          job->delta_file->name->buffer, job->file->name->buffer,
+	          job->target_name);
+
+	string_unlock_and_release(target_name);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 6:
+		unlink(job->output_file->name->buffer);
+		file_release(job->output_file);
+
+	case 5:
+		free(job->target_name);
+
+	case 4:
+		string_unlock_and_release(target_name);
+
+	case 3:
+		file_release(job->delta_file);
+
+	case 2:
+		file_release(job->file);
+
+	case 1:
+		free(job);
+
+	default:
+		break;
+	}
+
+	return phase == 7 ? API_E_SUCCESS : error_code;
+}
@@ -0,0 +1,47 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * delta.h: Block signature and delta transfer for files
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_DELTA_H
+#define REDAPID_DELTA_H
+
+#include <stdint.h>
+
+#include "object.h"
+
+#define DELTA_MIN_BLOCK_LENGTH 64
+#define DELTA_MAX_BLOCK_LENGTH (1024 * 1024)
+
+typedef enum {
+	DELTA_OPERATION_LITERAL = 1, // uint32_t length, uint8_t data[length]
+	DELTA_OPERATION_COPY         // uint32_t first_block, uint32_t block_count
+} DeltaOperation;
+
+int delta_init(void);
+void delta_exit(void);
+
+APIE delta_create_signature(ObjectID file_id, uint32_t block_length,
+                            ObjectID signature_file_id);
+
+APIE delta_apply(ObjectID basis_file_id, ObjectID delta_file_id,
+                 uint32_t block_length, ObjectID target_name_id,
+                 uint16_t permissions, uint32_t uid, uint32_t gid);
+
+#endif // REDAPID_DELTA_H
@@ -20,12 +20,15 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
+#include <daemonlib/event.h>
 #include <daemonlib/log.h>
 #include <daemonlib/utils.h>
 
@@ -33,15 +36,101 @@
 
 #include "api.h"
 #include "file.h"
+#include "identity.h"
 #include "inventory.h"
-#include "process.h"
 #include "string.h"
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
+// layout of the records returned by the getdents64 syscall
+typedef struct {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+} DirectoryDirent64;
+
+#include <daemonlib/packed_begin.h>
+
+typedef struct {
+	uint8_t type;
+	uint8_t name_length;
+	uint64_t length; // 0 if DIRECTORY_READ_FLAG_STAT is not set
+	uint64_t modification_timestamp; // 0 if DIRECTORY_READ_FLAG_STAT is not set
+} ATTRIBUTE_PACKED DirectoryEntryRecordHeader;
+
+typedef struct {
+	uint8_t type;
+	uint16_t permissions;
+	uint64_t length;
+	uint64_t modification_timestamp;
+	uint16_t path_length;
+} ATTRIBUTE_PACKED DirectoryWalkRecordHeader;
+
+#include <daemonlib/packed_end.h>
+
+static void directory_stop_async_read(Directory *directory) {
+	event_remove_source(directory->async_read_eventfd, EVENT_SOURCE_TYPE_GENERIC);
+
+	close(directory->async_read_eventfd);
+	close(directory->async_read_fd);
+
+	free(directory->async_read_dirents);
+
+	directory->async_read_in_progress = false;
+	directory->async_read_dirents = NULL;
+}
+
+static void directory_stop_async_walk(Directory *directory) {
+	uint8_t buffer[512];
+	int rc;
+
+	directory->async_walk_aborted = true;
+
+	event_remove_source(directory->async_walk_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+
+	// the walk thread might be blocked writing to the full pipe. drain the
+	// pipe until the walk thread notices the abort and closes the write end
+	if (fcntl(directory->async_walk_pipe.read_end, F_SETFL, 0) < 0) {
+		log_error("Could not make walk pipe of directory object (id: %u, name: %s) blocking: %s (%d)",
+		          directory->base.id, directory->name->buffer,
+		          get_errno_name(errno), errno);
+	}
+
+	for (;;) {
+		rc = read(directory->async_walk_pipe.read_end, buffer, sizeof(buffer));
+
+		if (rc == 0 || (rc < 0 && !errno_interrupted())) {
+			break;
+		}
+	}
+
+	close(directory->async_walk_pipe.read_end);
+
+	thread_join(&directory->async_walk_thread);
+	thread_destroy(&directory->async_walk_thread);
+
+	directory->async_walk_in_progress = false;
+}
+
 static void directory_destroy(Object *object) {
 	Directory *directory = (Directory *)object;
 
+	if (directory->async_read_in_progress) {
+		log_warn("Destroying directory object (id: %u, name: %s) while an asynchronous read is in progress",
+		         directory->base.id, directory->name->buffer);
+
+		directory_stop_async_read(directory);
+	}
+
+	if (directory->async_walk_in_progress) {
+		log_warn("Destroying directory object (id: %u, name: %s) while an asynchronous walk is in progress",
+		         directory->base.id, directory->name->buffer);
+
+		directory_stop_async_walk(directory);
+	}
+
 	closedir(directory->dp);
 
 	string_unlock_and_release(directory->name);
@@ -56,73 +145,591 @@ static void directory_signature(Object *object, char *signature) {
 	         directory->name->buffer);
 }
 
-// NOTE: assumes that name is absolute (starts with '/')
-static APIE directory_create_helper(char *name, uint32_t flags, mode_t mode) {
-	char *p;
+static DirectoryEntryType directory_get_entry_type_from_dirent_type(unsigned char type) {
+	switch (type) {
+	default:      return DIRECTORY_ENTRY_TYPE_UNKNOWN;
+	case DT_REG:  return DIRECTORY_ENTRY_TYPE_REGULAR;
+	case DT_DIR:  return DIRECTORY_ENTRY_TYPE_DIRECTORY;
+	case DT_CHR:  return DIRECTORY_ENTRY_TYPE_CHARACTER;
+	case DT_BLK:  return DIRECTORY_ENTRY_TYPE_BLOCK;
+	case DT_FIFO: return DIRECTORY_ENTRY_TYPE_FIFO;
+	case DT_LNK:  return DIRECTORY_ENTRY_TYPE_SYMLINK;
+	case DT_SOCK: return DIRECTORY_ENTRY_TYPE_SOCKET;
+	}
+}
+
+DirectoryEntryType directory_get_entry_type_from_stat_mode(mode_t mode) {
+	if (S_ISREG(mode)) {
+		return DIRECTORY_ENTRY_TYPE_REGULAR;
+	} else if (S_ISDIR(mode)) {
+		return DIRECTORY_ENTRY_TYPE_DIRECTORY;
+	} else if (S_ISCHR(mode)) {
+		return DIRECTORY_ENTRY_TYPE_CHARACTER;
+	} else if (S_ISBLK(mode)) {
+		return DIRECTORY_ENTRY_TYPE_BLOCK;
+	} else if (S_ISFIFO(mode)) {
+		return DIRECTORY_ENTRY_TYPE_FIFO;
+	} else if (S_ISLNK(mode)) {
+		return DIRECTORY_ENTRY_TYPE_SYMLINK;
+	} else if (S_ISSOCK(mode)) {
+		return DIRECTORY_ENTRY_TYPE_SOCKET;
+	} else {
+		return DIRECTORY_ENTRY_TYPE_UNKNOWN;
+	}
+}
+
+static void directory_send_async_read_callback(Directory *directory, APIE error_code,
+                                               uint8_t *buffer, uint8_t length_read) {
+	if (directory->base.external_reference_count > 0) {
+		api_send_async_directory_read_callback(directory->base.id, error_code,
+		                                       buffer, length_read);
+	}
+}
+
+// serializes the next directory entry into the record buffer. returns 1 if
+// a record is available, 0 on end-of-directory and -1 on error (sets errno)
+static int directory_prepare_next_record(Directory *directory) {
+	DirectoryDirent64 *dirent;
+	DirectoryEntryRecordHeader *header = (DirectoryEntryRecordHeader *)directory->async_read_record;
+	size_t name_length;
 	struct stat st;
-	APIE error_code;
+	bool need_stat;
+	int rc;
 
-	if (mkdir(name, mode) < 0) {
-		if (errno == ENOENT) {
-			if ((flags & DIRECTORY_FLAG_RECURSIVE) == 0) {
-				log_warn("Cannot create directory '%s' non-recursively", name);
+	for (;;) {
+		if (directory->async_read_dirents_offset >= directory->async_read_dirents_used) {
+			rc = syscall(SYS_getdents64, directory->async_read_fd,
+			             directory->async_read_dirents,
+			             DIRECTORY_READ_ASYNC_DIRENT_BUFFER_LENGTH);
+
+			if (rc < 0) {
+				if (errno_interrupted()) {
+					continue;
+				}
 
-				return API_E_NOT_SUPPORTED;
+				return -1;
 			}
 
-			p = strrchr(name, '/');
+			if (rc == 0) {
+				return 0;
+			}
 
-			if (p != name) {
-				*p = '\0';
+			directory->async_read_dirents_used = rc;
+			directory->async_read_dirents_offset = 0;
+		}
+
+		dirent = (DirectoryDirent64 *)(directory->async_read_dirents +
+		                               directory->async_read_dirents_offset);
+
+		directory->async_read_dirents_offset += dirent->d_reclen;
 
-				// FIXME: if the directory name has really many parts
-				//        then this could trigger a stack overflow
-				error_code = directory_create_helper(name, flags, mode);
+		if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+			continue;
+		}
 
-				*p = '/';
+		name_length = strlen(dirent->d_name);
 
-				if (error_code != API_E_SUCCESS) {
-					return error_code;
+		if (name_length > DIRECTORY_MAX_ENTRY_RECORD_LENGTH - sizeof(DirectoryEntryRecordHeader)) {
+			log_warn("Skipping too long entry name in directory object (id: %u, name: %s)",
+			         directory->base.id, directory->name->buffer);
+
+			continue;
+		}
+
+		header->type = directory_get_entry_type_from_dirent_type(dirent->d_type);
+		header->name_length = name_length;
+		header->length = 0;
+		header->modification_timestamp = 0;
+
+		// only stat if the file system doesn't report the type or if length
+		// and modification timestamp are requested
+		need_stat = header->type == DIRECTORY_ENTRY_TYPE_UNKNOWN ||
+		            (directory->async_read_flags & DIRECTORY_READ_FLAG_STAT) != 0;
+
+		if (need_stat) {
+			if (fstatat(directory->async_read_fd, dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+				// the entry might have been removed in the meantime
+				log_debug("Could not get information for entry '%s' of directory object (id: %u, name: %s): %s (%d)",
+				          dirent->d_name, directory->base.id, directory->name->buffer,
+				          get_errno_name(errno), errno);
+			} else {
+				header->type = directory_get_entry_type_from_stat_mode(st.st_mode);
+
+				if ((directory->async_read_flags & DIRECTORY_READ_FLAG_STAT) != 0) {
+					header->length = st.st_size;
+					header->modification_timestamp = st.st_mtime;
+				}
+			}
+		}
+
+		memcpy(directory->async_read_record + sizeof(DirectoryEntryRecordHeader),
+		       dirent->d_name, name_length);
+
+		directory->async_read_record_used = sizeof(DirectoryEntryRecordHeader) + name_length;
+		directory->async_read_record_offset = 0;
+
+		return 1;
+	}
+}
+
+static void directory_handle_async_read(void *opaque) {
+	Directory *directory = opaque;
+	uint8_t buffer[DIRECTORY_MAX_READ_ASYNC_BUFFER_LENGTH];
+	int length = 0;
+	int callbacks = 0;
+	int chunk;
+	int rc;
+	APIE error_code;
+
+	while (callbacks < DIRECTORY_READ_ASYNC_BATCH_LENGTH) {
+		if (directory->async_read_record_offset >= directory->async_read_record_used) {
+			rc = directory_prepare_next_record(directory);
+
+			if (rc <= 0) {
+				if (rc < 0) {
+					error_code = api_get_error_code_from_errno();
+
+					log_error("Could not read directory object (id: %u, name: %s) asynchronously: %s (%d)",
+					          directory->base.id, directory->name->buffer,
+					          get_errno_name(errno), errno);
+				} else {
+					error_code = API_E_NO_MORE_DATA;
+
+					log_debug("Reached end of directory object (id: %u, name: %s) while reading asynchronously",
+					          directory->base.id, directory->name->buffer);
+				}
+
+				directory_stop_async_read(directory);
+
+				if (length > 0) {
+					directory_send_async_read_callback(directory, API_E_SUCCESS,
+					                                   buffer, length);
 				}
+
+				directory_send_async_read_callback(directory, error_code, NULL, 0);
+
+				return;
 			}
+		}
+
+		chunk = directory->async_read_record_used - directory->async_read_record_offset;
+
+		if (chunk > (int)sizeof(buffer) - length) {
+			chunk = sizeof(buffer) - length;
+		}
+
+		memcpy(buffer + length,
+		       directory->async_read_record + directory->async_read_record_offset,
+		       chunk);
+
+		length += chunk;
+		directory->async_read_record_offset += chunk;
+
+		if (length == sizeof(buffer)) {
+			directory_send_async_read_callback(directory, API_E_SUCCESS, buffer, length);
+
+			length = 0;
+			++callbacks;
+		}
+	}
+}
+
+// only called from the walk thread, sets errno on error
+static int directory_write_walk_record(Directory *directory, struct stat *st,
+                                       int path_length) {
+	DirectoryWalkRecordHeader header;
+	uint8_t record[sizeof(DirectoryWalkRecordHeader) + DIRECTORY_MAX_WALK_PATH_LENGTH];
+	int length = sizeof(header) + path_length;
+	int offset = 0;
+	ssize_t rc;
 
-			if (mkdir(name, mode) >= 0) {
-				return API_E_SUCCESS;
+	header.type = st != NULL ? directory_get_entry_type_from_stat_mode(st->st_mode)
+	                         : DIRECTORY_ENTRY_TYPE_UNKNOWN;
+	header.permissions = st != NULL ? st->st_mode & 07777 : 0;
+	header.length = st != NULL ? (uint64_t)st->st_size : 0;
+	header.modification_timestamp = st != NULL ? (uint64_t)st->st_mtime : 0;
+	header.path_length = path_length;
+
+	memcpy(record, &header, sizeof(header));
+	memcpy(record + sizeof(header), directory->async_walk_path, path_length);
+
+	while (offset < length) {
+		rc = write(directory->async_walk_pipe.write_end, record + offset, length - offset);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
 			}
+
+			return -1;
 		}
 
-		if (errno != EEXIST) {
+		offset += rc;
+	}
+
+	return 0;
+}
+
+// only called from the walk thread, takes ownership of fd. sets errno on error
+static int directory_walk_level(Directory *directory, int fd, int path_length,
+                                int depth) {
+	DIR *dp;
+	struct dirent *dirent;
+	int name_length;
+	int entry_path_length;
+	struct stat st;
+	bool is_directory;
+	bool descend;
+	int child_fd;
+	int rc = 0;
+
+	dp = fdopendir(fd);
+
+	if (dp == NULL) {
+		close(fd);
+
+		return -1;
+	}
+
+	while (!directory->async_walk_aborted) {
+		errno = 0;
+		dirent = readdir(dp);
+
+		if (dirent == NULL) {
+			if (errno != 0) {
+				rc = -1;
+			}
+
+			break;
+		}
+
+		if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+			continue;
+		}
+
+		name_length = strlen(dirent->d_name);
+		entry_path_length = path_length + (path_length > 0 ? 1 : 0) + name_length;
+
+		if (entry_path_length > DIRECTORY_MAX_WALK_PATH_LENGTH) {
+			log_warn("Skipping too long path below directory object (id: %u, name: %s)",
+			         directory->base.id, directory->name->buffer);
+
+			continue;
+		}
+
+		if (path_length > 0) {
+			directory->async_walk_path[path_length] = '/';
+		}
+
+		memcpy(directory->async_walk_path + entry_path_length - name_length,
+		       dirent->d_name, name_length);
+
+		directory->async_walk_path[entry_path_length] = '\0';
+
+		if (fstatat(dirfd(dp), dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+			if (errno == ENOENT) {
+				continue; // removed in the meantime
+			}
+
+			log_debug("Could not get information for '%s' below directory object (id: %u, name: %s): %s (%d)",
+			          directory->async_walk_path, directory->base.id,
+			          directory->name->buffer, get_errno_name(errno), errno);
+
+			if (directory_write_walk_record(directory, NULL, entry_path_length) < 0) {
+				rc = -1;
+
+				break;
+			}
+
+			continue;
+		}
+
+		// symlinks are never followed, because of AT_SYMLINK_NOFOLLOW
+		is_directory = S_ISDIR(st.st_mode);
+		descend = is_directory &&
+		          (directory->async_walk_max_depth == 0 || depth < directory->async_walk_max_depth) &&
+		          ((directory->async_walk_flags & DIRECTORY_WALK_FLAG_SAME_FILESYSTEM) == 0 ||
+		           st.st_dev == directory->async_walk_device);
+
+		if (!is_directory || (directory->async_walk_flags & DIRECTORY_WALK_FLAG_DIRECTORIES_LAST) == 0) {
+			if (directory_write_walk_record(directory, &st, entry_path_length) < 0) {
+				rc = -1;
+
+				break;
+			}
+		}
+
+		if (descend) {
+			child_fd = openat(dirfd(dp), dirent->d_name,
+			                  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+			if (child_fd < 0) {
+				log_warn("Could not open '%s' below directory object (id: %u, name: %s), skipping it: %s (%d)",
+				         directory->async_walk_path, directory->base.id,
+				         directory->name->buffer, get_errno_name(errno), errno);
+			} else if (directory_walk_level(directory, child_fd, entry_path_length, depth + 1) < 0) {
+				rc = -1;
+
+				break;
+			}
+		}
+
+		if (is_directory && (directory->async_walk_flags & DIRECTORY_WALK_FLAG_DIRECTORIES_LAST) != 0) {
+			if (directory_write_walk_record(directory, &st, entry_path_length) < 0) {
+				rc = -1;
+
+				break;
+			}
+		}
+	}
+
+	closedir(dp);
+
+	return rc;
+}
+
+static void directory_walk(void *opaque) {
+	Directory *directory = opaque;
+
+	if (directory_walk_level(directory, directory->async_walk_root_fd, 0, 1) < 0) {
+		directory->async_walk_error_code = api_get_error_code_from_errno();
+
+		log_error("Could not walk directory object (id: %u, name: %s): %s (%d)",
+		          directory->base.id, directory->name->buffer,
+		          get_errno_name(errno), errno);
+	} else if (directory->async_walk_aborted) {
+		directory->async_walk_error_code = API_E_OPERATION_ABORTED;
+	} else {
+		directory->async_walk_error_code = API_E_NO_MORE_DATA;
+	}
+
+	// signal the end of the walk to the event loop
+	close(directory->async_walk_pipe.write_end);
+}
+
+static void directory_handle_async_walk(void *opaque) {
+	Directory *directory = opaque;
+	uint8_t buffer[DIRECTORY_MAX_READ_ASYNC_BUFFER_LENGTH];
+	int callbacks;
+	int rc;
+
+	for (callbacks = 0; callbacks < DIRECTORY_READ_ASYNC_BATCH_LENGTH; ++callbacks) {
+		rc = read(directory->async_walk_pipe.read_end, buffer, sizeof(buffer));
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			if (errno_would_block()) {
+				return;
+			}
+
+			log_error("Could not read from walk pipe of directory object (id: %u, name: %s): %s (%d)",
+			          directory->base.id, directory->name->buffer,
+			          get_errno_name(errno), errno);
+
+			directory_stop_async_walk(directory);
+			directory_send_async_read_callback(directory, API_E_INTERNAL_ERROR, NULL, 0);
+
+			return;
+		}
+
+		if (rc == 0) {
+			// the walk thread is done and closed the write end
+			event_remove_source(directory->async_walk_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+			close(directory->async_walk_pipe.read_end);
+
+			thread_join(&directory->async_walk_thread);
+			thread_destroy(&directory->async_walk_thread);
+
+			directory->async_walk_in_progress = false;
+
+			log_debug("Finished walking directory object (id: %u, name: %s) asynchronously",
+			          directory->base.id, directory->name->buffer);
+
+			directory_send_async_read_callback(directory, directory->async_walk_error_code, NULL, 0);
+
+			return;
+		}
+
+		directory_send_async_read_callback(directory, API_E_SUCCESS, buffer, rc);
+	}
+}
+
+typedef struct {
+	char *name;
+	uint32_t flags;
+	mode_t mode;
+} DirectoryCreateOperation;
+
+static APIE directory_check_existing(int parent_fd, const char *component,
+                                     const char *name, uint32_t flags) {
+	struct stat st;
+	APIE error_code;
+
+	if (fstatat(parent_fd, component, &st, 0) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get information for '%s': %s (%d)",
+		          name, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if (!S_ISDIR(st.st_mode)) {
+		log_error("Expecting '%s' to be a directory", name);
+
+		return API_E_NOT_A_DIRECTORY;
+	}
+
+	if ((flags & DIRECTORY_FLAG_EXCLUSIVE) != 0) {
+		log_error("Could not create already existing directory '%s'", name);
+
+		return API_E_ALREADY_EXISTS;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// NOTE: assumes that name is absolute (starts with '/'). walks from the root
+// directory and creates all missing components relative to an open parent.
+// temporarily modifies name, so the current prefix appears in log messages
+static APIE directory_create_recursively(char *name, uint32_t flags, mode_t mode) {
+	APIE error_code = API_E_SUCCESS;
+	int fd;
+	int child_fd;
+	char *component = name + 1;
+	char *end;
+	char *next;
+	char saved;
+
+	fd = open("/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (fd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not open root directory: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	for (;;) {
+		while (*component == '/') {
+			++component;
+		}
+
+		if (*component == '\0') {
+			break; // name is the root directory or has a trailing slash
+		}
+
+		end = component;
+
+		while (*end != '\0' && *end != '/') {
+			++end;
+		}
+
+		next = end;
+
+		while (*next == '/') {
+			++next;
+		}
+
+		saved = *end;
+		*end = '\0';
+
+		if (*next == '\0') {
+			// last component
+			if (mkdirat(fd, component, mode) < 0) {
+				if (errno == EEXIST) {
+					error_code = directory_check_existing(fd, component, name, flags);
+				} else {
+					error_code = api_get_error_code_from_errno();
+
+					log_error("Could not create directory '%s': %s (%d)",
+					          name, get_errno_name(errno), errno);
+				}
+			}
+
+			*end = saved;
+
+			break;
+		}
+
+		if (mkdirat(fd, component, mode) < 0 && errno != EEXIST) {
 			error_code = api_get_error_code_from_errno();
 
 			log_error("Could not create directory '%s': %s (%d)",
 			          name, get_errno_name(errno), errno);
 
-			return error_code;
+			*end = saved;
+
+			break;
 		}
 
-		if (stat(name, &st) < 0) {
+		child_fd = openat(fd, component, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+		if (child_fd < 0) {
 			error_code = api_get_error_code_from_errno();
 
-			log_error("Could not get information for '%s': %s (%d)",
-			          name, get_errno_name(errno), errno);
+			if (errno == ENOTDIR) {
+				log_error("Expecting '%s' to be a directory", name);
+			} else {
+				log_error("Could not open directory '%s': %s (%d)",
+				          name, get_errno_name(errno), errno);
+			}
+
+			*end = saved;
 
-			return error_code;
+			break;
 		}
 
-		if (!S_ISDIR(st.st_mode)) {
-			log_error("Expecting '%s' to be a directory", name);
+		*end = saved;
 
-			return API_E_NOT_A_DIRECTORY;
-		}
+		close(fd);
 
-		if ((flags & DIRECTORY_FLAG_EXCLUSIVE) != 0) {
-			log_error("Could not create already existing directory '%s'", name);
+		fd = child_fd;
+		component = next;
+	}
 
-			return API_E_ALREADY_EXISTS;
-		}
+	close(fd);
+
+	return error_code;
+}
+
+// NOTE: assumes that name is absolute (starts with '/')
+static APIE directory_create_helper(void *opaque) {
+	DirectoryCreateOperation *operation = opaque;
+	APIE error_code;
+
+	// try the whole name first, the parent directory usually exists already
+	if (mkdir(operation->name, operation->mode) >= 0) {
+		return API_E_SUCCESS;
 	}
 
-	return API_E_SUCCESS;
+	if (errno == EEXIST) {
+		return directory_check_existing(AT_FDCWD, operation->name,
+		                                operation->name, operation->flags);
+	}
+
+	if (errno != ENOENT) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create directory '%s': %s (%d)",
+		          operation->name, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if ((operation->flags & DIRECTORY_FLAG_RECURSIVE) == 0) {
+		log_warn("Cannot create directory '%s' non-recursively", operation->name);
+
+		return API_E_NOT_SUPPORTED;
+	}
+
+	return directory_create_recursively(operation->name, operation->flags,
+	                                    operation->mode);
 }
 
 // public API
@@ -295,16 +902,7 @@ APIE directory_get_next_entry(Directory *directory, Session *session,
 
 		string_append(directory->buffer, sizeof(directory->buffer), dirent->d_name);
 
-		switch (dirent->d_type) {
-		default:      *type = DIRECTORY_ENTRY_TYPE_UNKNOWN;   break;
-		case DT_REG:  *type = DIRECTORY_ENTRY_TYPE_REGULAR;   break;
-		case DT_DIR:  *type = DIRECTORY_ENTRY_TYPE_DIRECTORY; break;
-		case DT_CHR:  *type = DIRECTORY_ENTRY_TYPE_CHARACTER; break;
-		case DT_BLK:  *type = DIRECTORY_ENTRY_TYPE_BLOCK;     break;
-		case DT_FIFO: *type = DIRECTORY_ENTRY_TYPE_FIFO;      break;
-		case DT_LNK:  *type = DIRECTORY_ENTRY_TYPE_SYMLINK;   break;
-		case DT_SOCK: *type = DIRECTORY_ENTRY_TYPE_SOCKET;    break;
-		}
+		*type = directory_get_entry_type_from_dirent_type(dirent->d_type);
 
 		if (*type == DIRECTORY_ENTRY_TYPE_UNKNOWN) {
 			if (lstat(directory->buffer, &st) < 0) {
@@ -317,23 +915,7 @@ APIE directory_get_next_entry(Directory *directory, Session *session,
 				return error_code;
 			}
 
-			if (S_ISREG(st.st_mode)) {
-				*type = DIRECTORY_ENTRY_TYPE_REGULAR;
-			} else if (S_ISDIR(st.st_mode)) {
-				*type = DIRECTORY_ENTRY_TYPE_DIRECTORY;
-			} else if (S_ISCHR(st.st_mode)) {
-				*type = DIRECTORY_ENTRY_TYPE_CHARACTER;
-			} else if (S_ISBLK(st.st_mode)) {
-				*type = DIRECTORY_ENTRY_TYPE_BLOCK;
-			} else if (S_ISFIFO(st.st_mode)) {
-				*type = DIRECTORY_ENTRY_TYPE_FIFO;
-			} else if (S_ISLNK(st.st_mode)) {
-				*type = DIRECTORY_ENTRY_TYPE_SYMLINK;
-			} else if (S_ISSOCK(st.st_mode)) {
-				*type = DIRECTORY_ENTRY_TYPE_SOCKET;
-			} else {
-				*type = DIRECTORY_ENTRY_TYPE_UNKNOWN;
-			}
+			*type = directory_get_entry_type_from_stat_mode(st.st_mode);
 		}
 
 		return string_wrap(directory->buffer,
@@ -350,106 +932,262 @@ APIE directory_rewind(Directory *directory) {
 }
 
 // public API
-APIE directory_create(const char *name, uint32_t flags, uint16_t permissions,
-                      uint32_t uid, uint32_t gid) {
-	mode_t mode;
-	char *tmp;
+APIE directory_read_async(Directory *directory, uint16_t flags) {
+	int phase = 0;
 	APIE error_code;
-	pid_t pid;
-	int rc;
-	int status;
 
-	if (*name == '\0') {
-		log_warn("Directory name cannot be empty");
+	if ((flags & ~DIRECTORY_READ_FLAG_ALL) != 0) {
+		log_warn("Invalid directory read flags 0x%04X", flags);
 
 		return API_E_INVALID_PARAMETER;
 	}
 
-	if (*name != '/') {
-		log_warn("Cannot create directory with relative name '%s'", name);
+	if (directory->async_read_in_progress || directory->async_walk_in_progress) {
+		log_warn("Still reading directory object (id: %u, name: %s) asynchronously",
+		         directory->base.id, directory->name->buffer);
 
-		return API_E_INVALID_PARAMETER;
+		return API_E_INVALID_OPERATION;
 	}
 
-	if ((flags & ~DIRECTORY_FLAG_ALL) != 0) {
-		log_warn("Invalid directory flags 0x%04X", flags);
+	// use a separate file descriptor, so the readdir position of the
+	// directory object is not affected
+	directory->async_read_fd = open(directory->name->buffer,
+	                                O_RDONLY | O_DIRECTORY | O_CLOEXEC);
 
-		return API_E_INVALID_PARAMETER;
+	if (directory->async_read_fd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not open directory '%s': %s (%d)",
+		          directory->name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
 	}
 
-	if ((permissions & ~FILE_PERMISSION_ALL) != 0) {
-		log_warn("Invalid file permissions %04o", permissions);
+	phase = 1;
 
-		return API_E_INVALID_PARAMETER;
+	directory->async_read_eventfd = eventfd(1, EFD_NONBLOCK);
+
+	if (directory->async_read_eventfd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create asynchronous read eventfd: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
 	}
 
-	mode = file_get_mode_from_permissions(permissions);
+	phase = 2;
 
-	// duplicate name, because directory_create_helper might modify it
-	tmp = strdup(name);
+	directory->async_read_dirents = malloc(DIRECTORY_READ_ASYNC_DIRENT_BUFFER_LENGTH);
 
-	if (tmp == NULL) {
-		log_error("Could not duplicate directory name: %s (%d)",
+	if (directory->async_read_dirents == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate directory entry buffer: %s (%d)",
 		          get_errno_name(ENOMEM), ENOMEM);
 
-		return API_E_NO_FREE_MEMORY;
+		goto cleanup;
 	}
 
-	if (geteuid() == uid && getegid() == gid) {
-		error_code = directory_create_helper(tmp, flags, mode);
-	} else {
-		error_code = process_fork(&pid);
+	phase = 3;
 
-		if (error_code != API_E_SUCCESS) {
-			goto cleanup;
-		}
+	directory->async_read_flags = flags;
+	directory->async_read_dirents_used = 0;
+	directory->async_read_dirents_offset = 0;
+	directory->async_read_record_used = 0;
+	directory->async_read_record_offset = 0;
 
-		if (pid == 0) { // child
-			// change user and groups
-			error_code = process_set_identity(uid, gid);
+	// generate the callbacks in batches on every event loop iteration while
+	// the eventfd stays readable, the same way file_read_async does
+	if (event_add_source(directory->async_read_eventfd, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, directory_handle_async_read, directory) < 0) {
+		error_code = API_E_INTERNAL_ERROR;
 
-			if (error_code != API_E_SUCCESS) {
-				goto child_cleanup;
-			}
+		goto cleanup;
+	}
 
-			// create directory
-			error_code = directory_create_helper(tmp, flags, mode);
+	phase = 4;
 
-		child_cleanup:
-			// report error code as exit status
-			_exit(error_code);
-		}
+	directory->async_read_in_progress = true;
 
-		// wait for child to exit
-		do {
-			rc = waitpid(pid, &status, 0);
-		} while (rc < 0 && errno_interrupted());
+	log_debug("Started reading directory object (id: %u, name: %s) asynchronously",
+	          directory->base.id, directory->name->buffer);
 
-		if (rc < 0) {
-			error_code = api_get_error_code_from_errno();
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 3:
+		free(directory->async_read_dirents);
 
-			log_error("Could not wait for child process creating directory '%s' as %u:%u: %s (%d)",
-			          name, uid, gid, get_errno_name(errno), errno);
+		directory->async_read_dirents = NULL;
 
-			goto cleanup;
-		}
+	case 2:
+		close(directory->async_read_eventfd);
+
+	case 1:
+		close(directory->async_read_fd);
+
+	default:
+		break;
+	}
 
-		// check if child exited normally
-		if (!WIFEXITED(status)) {
-			error_code = API_E_INTERNAL_ERROR;
+	return phase == 4 ? API_E_SUCCESS : error_code;
+}
 
-			log_error("Child process creating directory '%s' as %u:%u did not exit normally",
-			          name, uid, gid);
+// public API
+APIE directory_walk_async(Directory *directory, uint16_t max_depth, uint16_t flags) {
+	int phase = 0;
+	APIE error_code;
+	struct stat st;
 
-			goto cleanup;
-		}
+	if ((flags & ~DIRECTORY_WALK_FLAG_ALL) != 0) {
+		log_warn("Invalid directory walk flags 0x%04X", flags);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (directory->async_read_in_progress || directory->async_walk_in_progress) {
+		log_warn("Still reading directory object (id: %u, name: %s) asynchronously",
+		         directory->base.id, directory->name->buffer);
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	directory->async_walk_root_fd = open(directory->name->buffer,
+	                                     O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (directory->async_walk_root_fd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not open directory '%s': %s (%d)",
+		          directory->name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 1;
 
-		// get child error code from child exit status
-		error_code = WEXITSTATUS(status);
+	if (fstat(directory->async_walk_root_fd, &st) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get information for directory '%s': %s (%d)",
+		          directory->name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	// the walk thread blocks on the write end if the pipe is full, this
+	// limits the amount of walk results buffered ahead of the callbacks
+	if (pipe_create(&directory->async_walk_pipe, PIPE_FLAG_NON_BLOCKING_READ) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create walk pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	if (event_add_source(directory->async_walk_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, directory_handle_async_walk, directory) < 0) {
+		error_code = API_E_INTERNAL_ERROR;
+
+		goto cleanup;
 	}
 
+	phase = 3;
+
+	directory->async_walk_in_progress = true;
+	directory->async_walk_max_depth = max_depth;
+	directory->async_walk_flags = flags;
+	directory->async_walk_device = st.st_dev;
+	directory->async_walk_aborted = false;
+	directory->async_walk_error_code = API_E_SUCCESS;
+
+	thread_create(&directory->async_walk_thread, directory_walk, directory);
+
+	log_debug("Started walking directory object (id: %u, name: %s, max-depth: %u, flags: 0x%04X) asynchronously",
+	          directory->base.id, directory->name->buffer, max_depth, flags);
+
 cleanup:
-	free(tmp);
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 2:
+		pipe_destroy(&directory->async_walk_pipe);
+
+	case 1:
+		close(directory->async_walk_root_fd);
+
+	default:
+		break;
+	}
+
+	return phase == 3 ? API_E_SUCCESS : error_code;
+}
+
+// public API
+APIE directory_abort_async_read(Directory *directory) {
+	if (directory->async_read_in_progress) {
+		directory_stop_async_read(directory);
+
+		// FIXME: this callback should be delivered after the response of this function
+		directory_send_async_read_callback(directory, API_E_OPERATION_ABORTED, NULL, 0);
+	} else if (directory->async_walk_in_progress) {
+		directory_stop_async_walk(directory);
+
+		// FIXME: this callback should be delivered after the response of this function
+		directory_send_async_read_callback(directory, API_E_OPERATION_ABORTED, NULL, 0);
+	}
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE directory_create(const char *name, uint32_t flags, uint16_t permissions,
+                      uint32_t uid, uint32_t gid) {
+	DirectoryCreateOperation operation;
+	APIE error_code;
+
+	if (*name == '\0') {
+		log_warn("Directory name cannot be empty");
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (*name != '/') {
+		log_warn("Cannot create directory with relative name '%s'", name);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if ((flags & ~DIRECTORY_FLAG_ALL) != 0) {
+		log_warn("Invalid directory flags 0x%04X", flags);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if ((permissions & ~FILE_PERMISSION_ALL) != 0) {
+		log_warn("Invalid file permissions %04o", permissions);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	// duplicate name, because directory_create_recursively modifies it
+	operation.name = strdup(name);
+
+	if (operation.name == NULL) {
+		log_error("Could not duplicate directory name: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	operation.flags = flags;
+	operation.mode = file_get_mode_from_permissions(permissions);
+
+	// create directory as the given user and group
+	error_code = identity_run_as(uid, gid, directory_create_helper, &operation);
+
+	free(operation.name);
 
 	return error_code;
 }
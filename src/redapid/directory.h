@@ -23,12 +23,23 @@
 #define REDAPID_DIRECTORY_H
 
 #include <dirent.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <daemonlib/io.h>
+#include <daemonlib/pipe.h>
+#include <daemonlib/threads.h>
 
 #include "object.h"
 #include "string.h"
 
 #define DIRECTORY_MAX_NAME_LENGTH 1024
 #define DIRECTORY_MAX_ENTRY_LENGTH 1024
+#define DIRECTORY_MAX_READ_ASYNC_BUFFER_LENGTH 68
+#define DIRECTORY_MAX_ENTRY_RECORD_LENGTH (18 + 255) // record header and NAME_MAX
+#define DIRECTORY_READ_ASYNC_DIRENT_BUFFER_LENGTH 32768
+#define DIRECTORY_READ_ASYNC_BATCH_LENGTH 16 // callbacks per event loop iteration
+#define DIRECTORY_MAX_WALK_PATH_LENGTH 4096 // relative to the walked directory
 
 typedef enum { // bitmask
 	DIRECTORY_FLAG_RECURSIVE = 0x0001,
@@ -38,6 +49,20 @@ typedef enum { // bitmask
 #define DIRECTORY_FLAG_ALL (DIRECTORY_FLAG_RECURSIVE | \
                             DIRECTORY_FLAG_EXCLUSIVE)
 
+typedef enum { // bitmask
+	DIRECTORY_READ_FLAG_STAT = 0x0001 // include length and modification timestamp
+} DirectoryReadFlag;
+
+#define DIRECTORY_READ_FLAG_ALL DIRECTORY_READ_FLAG_STAT
+
+typedef enum { // bitmask
+	DIRECTORY_WALK_FLAG_SAME_FILESYSTEM = 0x0001, // don't descend into other mounted file systems
+	DIRECTORY_WALK_FLAG_DIRECTORIES_LAST = 0x0002 // report directories after their content
+} DirectoryWalkFlag;
+
+#define DIRECTORY_WALK_FLAG_ALL (DIRECTORY_WALK_FLAG_SAME_FILESYSTEM | \
+                                 DIRECTORY_WALK_FLAG_DIRECTORIES_LAST)
+
 typedef enum {
 	DIRECTORY_ENTRY_TYPE_UNKNOWN = 0,
 	DIRECTORY_ENTRY_TYPE_REGULAR,
@@ -56,8 +81,30 @@ typedef struct {
 	int name_length; // length of name in buffer
 	DIR *dp;
 	char buffer[DIRECTORY_MAX_NAME_LENGTH + 1 /* for / */ + DIRECTORY_MAX_ENTRY_LENGTH + 1 /* for \0 */];
+	bool async_read_in_progress;
+	uint16_t async_read_flags;
+	IOHandle async_read_fd; // separate from dp to keep its position untouched
+	IOHandle async_read_eventfd;
+	uint8_t *async_read_dirents; // getdents64 buffer
+	int async_read_dirents_used;
+	int async_read_dirents_offset;
+	uint8_t async_read_record[DIRECTORY_MAX_ENTRY_RECORD_LENGTH];
+	int async_read_record_used;
+	int async_read_record_offset;
+	bool async_walk_in_progress;
+	uint16_t async_walk_max_depth; // 0 means unlimited
+	uint16_t async_walk_flags;
+	IOHandle async_walk_root_fd; // handed over to the walk thread
+	dev_t async_walk_device;
+	Pipe async_walk_pipe; // the walk thread closes the write end when done
+	Thread async_walk_thread;
+	volatile bool async_walk_aborted;
+	APIE async_walk_error_code; // set by the walk thread before closing the write end
+	char async_walk_path[DIRECTORY_MAX_WALK_PATH_LENGTH + 1]; // only used by the walk thread
 } Directory;
 
+DirectoryEntryType directory_get_entry_type_from_stat_mode(mode_t mode);
+
 APIE directory_open(ObjectID name_id, Session *session, ObjectID *id);
 
 APIE directory_get_name(Directory *directory, Session *session, ObjectID *name_id);
@@ -66,6 +113,10 @@ APIE directory_get_next_entry(Directory *directory, Session *session,
                               ObjectID *name_id, uint8_t *type);
 APIE directory_rewind(Directory *directory);
 
+APIE directory_read_async(Directory *directory, uint16_t flags);
+APIE directory_walk_async(Directory *directory, uint16_t max_depth, uint16_t flags);
+APIE directory_abort_async_read(Directory *directory);
+
 APIE directory_create(const char *name, uint32_t flags, uint16_t permissions,
                       uint32_t uid, uint32_t gid);
 
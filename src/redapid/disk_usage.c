@@ -0,0 +1,678 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * disk_usage.c: Cached disk usage computation for directory trees
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * the usage of a directory tree is computed on a separate thread, the event
+ * loop is notified about the completion through a pipe. the result is cached
+ * per directory name and stays current until the modification time of the
+ * directory changes or an inotify event occurs for any directory of the tree.
+ * while computing, the thread adds an inotify watch for every directory it
+ * enters, before reading it. so no modification can be missed. the inotify
+ * watches are added to the shared inotify instance of the watch subsystem.
+ * the number of inotify watches per user is limited (8192 by default). to
+ * leave room for watch objects and other internal consumers, the number of
+ * inotify watches used for disk usage is capped. a tree that needs more of
+ * them is computed anyway, but its result is stale right away, so the next
+ * request computes it again.
+ *
+ * a stale result is still returned while the new result is computed. this
+ * keeps frequently refreshed dashboards responsive for trees that change all
+ * the time, like log directories.
+ *
+ * inotify returns the same watch descriptor if the same directory is added
+ * multiple times. the watch subsystem counts the references to it, so entries
+ * sharing a watch descriptor can release it independently.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <daemonlib/array.h>
+#include <daemonlib/event.h>
+#include <daemonlib/log.h>
+#include <daemonlib/pipe.h>
+#include <daemonlib/threads.h>
+#include <daemonlib/utils.h>
+
+#include "disk_usage.h"
+
+#include "api.h"
+#include "watch.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+#define DISK_USAGE_MAX_WATCHES 2048 // for all entries together
+#define DISK_USAGE_MAX_ENTRY_WATCHES 512
+
+typedef struct {
+	APIE error_code;
+	uint64_t length;
+	uint64_t allocated_length;
+	uint32_t file_count;
+	uint32_t directory_count;
+	Array wds; // inotify watch descriptors added while computing
+	int max_watch_count; // reserved by the event loop before computing
+	bool watches_complete;
+	dev_t device;
+	char path[DISK_USAGE_MAX_NAME_LENGTH + 1];
+} DiskUsageResult;
+
+typedef struct {
+	char name[DISK_USAGE_MAX_NAME_LENGTH + 1];
+	dev_t device;
+	struct timespec modification_time; // of the directory itself
+	bool computed; // usage values are valid, but might be stale
+	bool current; // usage values are not stale
+	APIE error_code; // of the last failed computation
+	uint64_t length;
+	uint64_t allocated_length;
+	uint32_t file_count;
+	uint32_t directory_count;
+	uint64_t timestamp; // of the last successful computation
+	Array wds; // inotify watch descriptors of the directories of the tree
+	bool computing;
+	bool dirty; // got an event that could not be attributed while computing
+	Thread thread;
+	DiskUsageResult result; // only used by the thread while computing
+	uint64_t last_used;
+} DiskUsageEntry;
+
+static Array _entries; // DiskUsageEntry pointers
+static Pipe _completion_pipe;
+static volatile bool _exiting = false;
+static uint64_t _use_counter = 0;
+
+static bool disk_usage_has_wd(DiskUsageEntry *entry, int wd) {
+	int i;
+
+	for (i = 0; i < entry->wds.count; ++i) {
+		if (*(int *)array_get(&entry->wds, i) == wd) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void disk_usage_mark_computing_dirty(void) {
+	int i;
+	DiskUsageEntry *entry;
+
+	for (i = 0; i < _entries.count; ++i) {
+		entry = *(DiskUsageEntry **)array_get(&_entries, i);
+
+		if (entry->computing) {
+			entry->dirty = true;
+		}
+	}
+}
+
+static void disk_usage_handle_inotify(int wd, uint32_t mask, const char *name,
+                                      void *opaque) {
+	int i;
+	DiskUsageEntry *entry;
+	bool found = false;
+
+	(void)mask;
+	(void)name;
+	(void)opaque;
+
+	for (i = 0; i < _entries.count; ++i) {
+		entry = *(DiskUsageEntry **)array_get(&_entries, i);
+
+		if (disk_usage_has_wd(entry, wd)) {
+			entry->current = false;
+			found = true;
+		}
+	}
+
+	// the event might belong to a running computation
+	if (!found) {
+		disk_usage_mark_computing_dirty();
+	}
+}
+
+static void disk_usage_release_watches(Array *wds) {
+	while (wds->count > 0) {
+		watch_remove_inotify_watch(*(int *)array_get(wds, wds->count - 1),
+		                           disk_usage_handle_inotify, NULL);
+
+		array_remove(wds, wds->count - 1, NULL);
+	}
+}
+
+static void disk_usage_destroy_entry(void *item) {
+	DiskUsageEntry *entry = *(DiskUsageEntry **)item;
+
+	if (entry->computing) {
+		thread_join(&entry->thread);
+		thread_destroy(&entry->thread);
+
+		disk_usage_release_watches(&entry->result.wds);
+		array_destroy(&entry->result.wds, NULL);
+	}
+
+	disk_usage_release_watches(&entry->wds);
+	array_destroy(&entry->wds, NULL);
+
+	free(entry);
+}
+
+// only called from the computing thread
+static void disk_usage_add_watch(DiskUsageResult *result, int path_length) {
+	int wd;
+	int *wd_ptr;
+
+	if (result->wds.count >= result->max_watch_count) {
+		if (result->watches_complete) {
+			log_debug("Reached inotify watch limit of %d while computing disk usage of '%s'",
+			          result->max_watch_count, result->path);
+		}
+
+		result->watches_complete = false;
+
+		return;
+	}
+
+	wd = watch_add_inotify_watch(path_length > 0 ? result->path : "/",
+	                             IN_ONLYDIR | IN_DONT_FOLLOW,
+	                             disk_usage_handle_inotify, NULL);
+
+	if (wd < 0) {
+		log_debug("Could not add inotify watch for '%s': %s (%d)",
+		          result->path, get_errno_name(errno), errno);
+
+		result->watches_complete = false;
+
+		return;
+	}
+
+	wd_ptr = array_append(&result->wds);
+
+	if (wd_ptr == NULL) {
+		watch_remove_inotify_watch(wd, disk_usage_handle_inotify, NULL);
+
+		result->watches_complete = false;
+
+		return;
+	}
+
+	*wd_ptr = wd;
+}
+
+// only called from the computing thread
+static void disk_usage_compute_level(DiskUsageResult *result, int fd, int path_length) {
+	DIR *dp;
+	struct dirent *dirent;
+	int name_length;
+	struct stat st;
+	int child_fd;
+
+	// add the watch before reading the directory, so no change can be missed
+	disk_usage_add_watch(result, path_length);
+
+	dp = fdopendir(fd);
+
+	if (dp == NULL) {
+		log_warn("Could not open directory '%s', skipping it: %s (%d)",
+		         result->path, get_errno_name(errno), errno);
+
+		close(fd);
+
+		return;
+	}
+
+	while (!_exiting) {
+		errno = 0;
+		dirent = readdir(dp);
+
+		if (dirent == NULL) {
+			if (errno != 0) {
+				log_warn("Could not read directory '%s', skipping the rest of it: %s (%d)",
+				         result->path, get_errno_name(errno), errno);
+			}
+
+			break;
+		}
+
+		if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+			continue;
+		}
+
+		if (fstatat(dirfd(dp), dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+			continue; // removed in the meantime or not accessible
+		}
+
+		result->allocated_length += (uint64_t)st.st_blocks * 512;
+
+		if (!S_ISDIR(st.st_mode)) {
+			++result->file_count;
+			result->length += st.st_size;
+
+			continue;
+		}
+
+		++result->directory_count;
+
+		// don't descend into other mounted file systems
+		if (st.st_dev != result->device) {
+			continue;
+		}
+
+		name_length = strlen(dirent->d_name);
+
+		if (path_length + 1 + name_length > DISK_USAGE_MAX_NAME_LENGTH) {
+			result->watches_complete = false;
+
+			continue;
+		}
+
+		result->path[path_length] = '/';
+
+		memcpy(result->path + path_length + 1, dirent->d_name, name_length + 1);
+
+		child_fd = openat(dirfd(dp), dirent->d_name,
+		                  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+		if (child_fd < 0) {
+			log_debug("Could not open directory '%s', skipping it: %s (%d)",
+			          result->path, get_errno_name(errno), errno);
+		} else {
+			disk_usage_compute_level(result, child_fd, path_length + 1 + name_length);
+		}
+
+		result->path[path_length] = '\0';
+	}
+
+	closedir(dp);
+}
+
+static void disk_usage_compute(void *opaque) {
+	DiskUsageEntry *entry = opaque;
+	DiskUsageResult *result = &entry->result;
+	int fd;
+	struct stat st;
+
+	fd = open(entry->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (fd < 0) {
+		result->error_code = api_get_error_code_from_errno();
+
+		log_warn("Could not open directory '%s': %s (%d)",
+		         entry->name, get_errno_name(errno), errno);
+	} else if (fstat(fd, &st) < 0) {
+		result->error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get information for directory '%s': %s (%d)",
+		          entry->name, get_errno_name(errno), errno);
+
+		close(fd);
+	} else {
+		result->device = st.st_dev;
+		result->allocated_length = (uint64_t)st.st_blocks * 512;
+
+		string_copy(result->path, sizeof(result->path), entry->name);
+
+		// avoid a double slash in subdirectory paths
+		if (strcmp(result->path, "/") == 0) {
+			result->path[0] = '\0';
+		}
+
+		disk_usage_compute_level(result, fd, strlen(result->path));
+
+		if (_exiting) {
+			result->error_code = API_E_OPERATION_ABORTED;
+		}
+	}
+
+	if (pipe_write(&_completion_pipe, &entry, sizeof(entry)) < 0) {
+		log_error("Could not write to disk usage completion pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+	}
+}
+
+static void disk_usage_handle_completion(void *opaque) {
+	DiskUsageEntry *entry;
+	DiskUsageResult *result;
+
+	(void)opaque;
+
+	if (pipe_read(&_completion_pipe, &entry, sizeof(entry)) < 0) {
+		if (!errno_would_block()) {
+			log_error("Could not read from disk usage completion pipe: %s (%d)",
+			          get_errno_name(errno), errno);
+		}
+
+		return;
+	}
+
+	thread_join(&entry->thread);
+	thread_destroy(&entry->thread);
+
+	result = &entry->result;
+	entry->computing = false;
+
+	if (result->error_code != API_E_SUCCESS) {
+		entry->error_code = result->error_code;
+		entry->current = false;
+
+		// the watches added so far are useless
+		disk_usage_release_watches(&result->wds);
+		array_destroy(&result->wds, NULL);
+
+		return;
+	}
+
+	entry->computed = true;
+	entry->current = !entry->dirty && result->watches_complete;
+	entry->error_code = API_E_SUCCESS;
+	entry->length = result->length;
+	entry->allocated_length = result->allocated_length;
+	entry->file_count = result->file_count;
+	entry->directory_count = result->directory_count;
+	entry->timestamp = time(NULL);
+
+	// the watches were released when the computation started
+	array_destroy(&entry->wds, NULL);
+	memcpy(&entry->wds, &result->wds, sizeof(Array));
+
+	log_debug("Computed disk usage of '%s' (length: %llu, files: %u, directories: %u%s)",
+	          entry->name, (unsigned long long)entry->length, entry->file_count,
+	          entry->directory_count, entry->current ? "" : ", already stale");
+}
+
+// the watch descriptors of the computed entries and the reserved watch
+// descriptors of the running computations count against the limit
+static int disk_usage_get_available_watch_count(void) {
+	int i;
+	DiskUsageEntry *entry;
+	int count = DISK_USAGE_MAX_WATCHES;
+
+	for (i = 0; i < _entries.count; ++i) {
+		entry = *(DiskUsageEntry **)array_get(&_entries, i);
+
+		count -= entry->computing ? entry->result.max_watch_count : entry->wds.count;
+	}
+
+	if (count > DISK_USAGE_MAX_ENTRY_WATCHES) {
+		return DISK_USAGE_MAX_ENTRY_WATCHES;
+	}
+
+	return count > 0 ? count : 0;
+}
+
+static APIE disk_usage_start_computation(DiskUsageEntry *entry) {
+	if (array_create(&entry->result.wds, 32, sizeof(int), true) < 0) {
+		log_error("Could not create disk usage watch descriptor array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	// the tree is walked again, including adding new watches
+	disk_usage_release_watches(&entry->wds);
+
+	entry->result.error_code = API_E_SUCCESS;
+	entry->result.length = 0;
+	entry->result.allocated_length = 0;
+	entry->result.file_count = 0;
+	entry->result.directory_count = 0;
+	entry->result.max_watch_count = disk_usage_get_available_watch_count();
+	entry->result.watches_complete = true;
+	entry->computing = true;
+	entry->dirty = false;
+
+	thread_create(&entry->thread, disk_usage_compute, entry);
+
+	log_debug("Started computing disk usage of '%s'", entry->name);
+
+	return API_E_SUCCESS;
+}
+
+static DiskUsageEntry *disk_usage_create_entry(const char *name) {
+	int i;
+	int candidate = -1;
+	DiskUsageEntry *entry;
+	DiskUsageEntry **entry_ptr;
+
+	if (_entries.count >= DISK_USAGE_MAX_ENTRIES) {
+		for (i = 0; i < _entries.count; ++i) {
+			entry = *(DiskUsageEntry **)array_get(&_entries, i);
+
+			if (!entry->computing &&
+			    (candidate < 0 ||
+			     entry->last_used < (*(DiskUsageEntry **)array_get(&_entries, candidate))->last_used)) {
+				candidate = i;
+			}
+		}
+
+		if (candidate < 0) {
+			log_warn("Cannot compute disk usage of '%s', all %d computations are still running",
+			         name, DISK_USAGE_MAX_ENTRIES);
+
+			errno = EWOULDBLOCK;
+
+			return NULL;
+		}
+
+		array_remove(&_entries, candidate, disk_usage_destroy_entry);
+	}
+
+	entry = calloc(1, sizeof(DiskUsageEntry));
+
+	if (entry == NULL) {
+		errno = ENOMEM;
+
+		return NULL;
+	}
+
+	if (array_create(&entry->wds, 32, sizeof(int), true) < 0) {
+		free(entry);
+
+		return NULL;
+	}
+
+	entry_ptr = array_append(&_entries);
+
+	if (entry_ptr == NULL) {
+		array_destroy(&entry->wds, NULL);
+		free(entry);
+
+		return NULL;
+	}
+
+	*entry_ptr = entry;
+
+	string_copy(entry->name, sizeof(entry->name), name);
+
+	entry->computed = false;
+	entry->current = false;
+	entry->error_code = API_E_SUCCESS;
+	entry->computing = false;
+
+	return entry;
+}
+
+int disk_usage_init(void) {
+	int phase = 0;
+
+	log_debug("Initializing disk usage subsystem");
+
+	if (array_create(&_entries, DISK_USAGE_MAX_ENTRIES, sizeof(DiskUsageEntry *), true) < 0) {
+		log_error("Could not create disk usage entry array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	if (pipe_create(&_completion_pipe, PIPE_FLAG_NON_BLOCKING_READ) < 0) {
+		log_error("Could not create disk usage completion pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	if (event_add_source(_completion_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, disk_usage_handle_completion, NULL) < 0) {
+		goto cleanup;
+	}
+
+	phase = 3;
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 2:
+		pipe_destroy(&_completion_pipe);
+
+	case 1:
+		array_destroy(&_entries, NULL);
+
+	default:
+		break;
+	}
+
+	return phase == 3 ? 0 : -1;
+}
+
+void disk_usage_exit(void) {
+	log_debug("Shutting down disk usage subsystem");
+
+	// running computations check this and stop early
+	_exiting = true;
+
+	array_destroy(&_entries, disk_usage_destroy_entry);
+
+	event_remove_source(_completion_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+	pipe_destroy(&_completion_pipe);
+}
+
+// public API
+APIE disk_usage_get(const char *name, uint64_t *length,
+                    uint64_t *allocated_length, uint32_t *file_count,
+                    uint32_t *directory_count, uint64_t *timestamp) {
+	int i;
+	DiskUsageEntry *entry = NULL;
+	DiskUsageEntry *candidate;
+	struct stat st;
+	APIE error_code;
+
+	if (*name != '/') {
+		log_warn("Cannot compute disk usage of relative directory name '%s'", name);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (strlen(name) > DISK_USAGE_MAX_NAME_LENGTH) {
+		log_warn("Directory name '%s' is too long", name);
+
+		return API_E_NAME_TOO_LONG;
+	}
+
+	if (stat(name, &st) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_warn("Could not get information for directory '%s': %s (%d)",
+		         name, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if (!S_ISDIR(st.st_mode)) {
+		log_warn("Cannot compute disk usage of non-directory '%s'", name);
+
+		return API_E_NOT_A_DIRECTORY;
+	}
+
+	for (i = 0; i < _entries.count; ++i) {
+		candidate = *(DiskUsageEntry **)array_get(&_entries, i);
+
+		if (strcmp(candidate->name, name) == 0) {
+			entry = candidate;
+
+			break;
+		}
+	}
+
+	if (entry == NULL) {
+		entry = disk_usage_create_entry(name);
+
+		if (entry == NULL) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not create disk usage entry for '%s': %s (%d)",
+			          name, get_errno_name(errno), errno);
+
+			return error_code;
+		}
+	}
+
+	entry->last_used = ++_use_counter;
+
+	// catch modifications that happened without a watch in place
+	if (entry->device != st.st_dev ||
+	    entry->modification_time.tv_sec != st.st_mtim.tv_sec ||
+	    entry->modification_time.tv_nsec != st.st_mtim.tv_nsec) {
+		entry->device = st.st_dev;
+		entry->modification_time = st.st_mtim;
+		entry->current = false;
+	}
+
+	if (!entry->current && !entry->computing) {
+		error_code = disk_usage_start_computation(entry);
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+	}
+
+	if (entry->computed) {
+		*length = entry->length;
+		*allocated_length = entry->allocated_length;
+		*file_count = entry->file_count;
+		*directory_count = entry->directory_count;
+		*timestamp = entry->timestamp;
+
+		return API_E_SUCCESS;
+	}
+
+	// report the failure of the last computation only once, the next call
+	// reports the outcome of the computation just started
+	if (entry->error_code != API_E_SUCCESS) {
+		error_code = entry->error_code;
+		entry->error_code = API_E_SUCCESS;
+
+		return error_code;
+	}
+
+	return API_E_WOULD_BLOCK;
+}
@@ -0,0 +1,39 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * disk_usage.h: Cached disk usage computation for directory trees
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_DISK_USAGE_H
+#define REDAPID_DISK_USAGE_H
+
+#include <stdint.h>
+
+#include "api_error.h"
+
+#define DISK_USAGE_MAX_ENTRIES 32
+#define DISK_USAGE_MAX_NAME_LENGTH 4096
+
+int disk_usage_init(void);
+void disk_usage_exit(void);
+
+APIE disk_usage_get(const char *name, uint64_t *length,
+                    uint64_t *allocated_length, uint32_t *file_count,
+                    uint32_t *directory_count, uint64_t *timestamp);
+
+#endif // REDAPID_DISK_USAGE_H
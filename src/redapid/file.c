@@ -39,11 +39,30 @@
 #include "file.h"
 
 #include "api.h"
+#include "identity.h"
 #include "inventory.h"
+#include "list.h"
+#include "lz4.h"
 #include "process.h"
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
+#include <daemonlib/packed_begin.h>
+
+typedef struct {
+	uint32_t length; // uncompressed length
+	uint32_t compressed_length; // 0 if data is stored uncompressed
+} ATTRIBUTE_PACKED FileCompressedBlockHeader;
+
+#include <daemonlib/packed_end.h>
+
+typedef struct {
+	List *names;
+	uint16_t flags;
+	int index; // of the next name to report
+	IOHandle eventfd;
+} FileStatPathsJob;
+
 #define FILE_SIGNATURE_FORMAT "id: %u, type: %s, name: %s, flags: 0x%04X"
 
 #define file_expand_signature(file) (file)->base.id, \
@@ -207,6 +226,22 @@ static void file_destroy(Object *object) {
 		event_remove_source(file->async_read_eventfd, EVENT_SOURCE_TYPE_GENERIC);
 	}
 
+	if (file->write_window_acknowledge_length > 0) {
+		timer_destroy(&file->write_window_timer);
+	}
+
+	if (file->compressed_write_block_used > 0) {
+		log_warn("Destroying file object ("FILE_SIGNATURE_FORMAT") while %d byte(s) of a compressed block are pending",
+		         file_expand_signature(file), file->compressed_write_block_used);
+	}
+
+	free(file->async_read_block);
+	free(file->compressed_write_block);
+
+	if (file->read_cache_entry != NULL) {
+		read_cache_release(file->read_cache_entry);
+	}
+
 	if (file->type == FILE_TYPE_PIPE) {
 		if ((file->events & FILE_EVENT_READABLE) != 0) {
 			event_remove_source(file->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
@@ -216,8 +251,21 @@ static void file_destroy(Object *object) {
 			event_remove_source(file->pipe.write_end, EVENT_SOURCE_TYPE_GENERIC);
 		}
 
+		if (file->stream_reading) {
+			event_remove_source(file->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+		}
+
 		pipe_destroy(&file->pipe);
 	} else {
+		if (file->truncate_on_close) {
+			// release the preallocated, but unused part of the file
+			if (ftruncate(file->fd, file->truncate_length) < 0) {
+				log_warn("Could not truncate file object ("FILE_SIGNATURE_FORMAT") to %"PRIu64" byte(s): %s (%d)",
+				         file_expand_signature(file), file->truncate_length,
+				         get_errno_name(errno), errno);
+			}
+		}
+
 		// unlink before close, this is safe on POSIX systems
 		if ((file->flags & FILE_FLAG_TEMPORARY) != 0) {
 			unlink(file->name->buffer);
@@ -261,6 +309,105 @@ static void file_send_async_write_callback(File *file, APIE error_code,
 	}
 }
 
+static void file_send_async_writes_acknowledged_callback(File *file, APIE error_code,
+                                                       uint64_t length_written) {
+	// only send a async-file-writes-acknowledged callback if there is at least
+	// one external reference to the file object. otherwise there is no one that
+	// could be interested in this callback anyway
+	if (file->base.external_reference_count > 0) {
+		api_send_async_file_writes_acknowledged_callback(file->base.id, error_code,
+		                                                 length_written);
+	}
+}
+
+static void file_acknowledge_async_writes(File *file) {
+	if (file->write_window_timer_armed) {
+		timer_configure(&file->write_window_timer, 0, 0);
+
+		file->write_window_timer_armed = false;
+	}
+
+	file->write_window_length_acknowledged = file->write_window_length_written;
+
+	file_send_async_writes_acknowledged_callback(file, file->write_window_error_code,
+	                                             file->write_window_length_written);
+}
+
+static void file_handle_write_window_timer(void *opaque) {
+	File *file = opaque;
+
+	file->write_window_timer_armed = false;
+
+	if (file->write_window_length_written > file->write_window_length_acknowledged) {
+		file_acknowledge_async_writes(file);
+	}
+}
+
+// without a write window every async write is acknowledged by its own
+// callback. with a write window the written bytes are acknowledged
+// cumulatively, either if the acknowledge length is reached, if the
+// acknowledge interval elapsed or if an error occurred.
+//
+// length_completed is the number of bytes that can be acknowledged. it only
+// differs from length_written for compressed writes, where the bytes of a
+// block are not acknowledged before the whole block got decompressed and
+// written. otherwise a resend from the acknowledged position could start in
+// the middle of a block
+static void file_report_async_write(File *file, APIE error_code,
+                                    int length_to_write, int length_written,
+                                    int length_completed) {
+	if (file->write_window_acknowledge_length == 0) {
+		file_send_async_write_callback(file, error_code, length_written);
+
+		return;
+	}
+
+	file->write_window_length_written += length_completed;
+
+	if (error_code == API_E_SUCCESS && length_written < length_to_write) {
+		// a short write breaks the contiguity of the stream, report it as
+		// error, so the client resends from the acknowledged position
+		error_code = API_E_WOULD_BLOCK;
+	}
+
+	if (error_code != API_E_SUCCESS) {
+		file->write_window_error_code = error_code;
+
+		file_acknowledge_async_writes(file);
+
+		return;
+	}
+
+	if (file->write_window_length_written - file->write_window_length_acknowledged >=
+	    file->write_window_acknowledge_length) {
+		file_acknowledge_async_writes(file);
+	} else if (!file->write_window_timer_armed) {
+		if (timer_configure(&file->write_window_timer,
+		                    (uint64_t)file->write_window_acknowledge_interval * 1000, 0) < 0) {
+			log_error("Could not start write window timer for file object ("FILE_SIGNATURE_FORMAT"): %s (%d)",
+			          file_expand_signature(file), get_errno_name(errno), errno);
+
+			file_acknowledge_async_writes(file);
+		} else {
+			file->write_window_timer_armed = true;
+		}
+	}
+}
+
+// returns true if the write has to be dropped, because an earlier write in
+// the current write window failed
+static bool file_drop_async_write(File *file, uint8_t length_to_write) {
+	if (file->write_window_acknowledge_length == 0 ||
+	    file->write_window_error_code == API_E_SUCCESS) {
+		return false;
+	}
+
+	log_debug("Dropping asynchronous write of %u byte(s) to file object ("FILE_SIGNATURE_FORMAT") after write error",
+	          length_to_write, file_expand_signature(file));
+
+	return true;
+}
+
 static void file_send_events_occurred_callback(File *file, uint16_t events) {
 	// only send a file-events-occurred callback if there is at least one
 	// external reference to the file object. otherwise there is no one that
@@ -280,6 +427,146 @@ static void file_handle_readable_event(void *opaque) {
 	file_send_events_occurred_callback(file, FILE_EVENT_READABLE);
 }
 
+static void file_send_stream_data_callback(File *file, APIE error_code,
+                                           uint8_t *buffer, uint8_t length_read) {
+	// only send a file-stream-data callback if there is at least one
+	// external reference to the file object. otherwise there is no one that
+	// could be interested in this callback anyway
+	if (file->base.external_reference_count > 0) {
+		api_send_file_stream_data_callback(file->base.id, error_code, buffer, length_read);
+	}
+}
+
+static void file_stop_stream_reading(File *file) {
+	if (file->stream_reading) {
+		event_remove_source(file->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+
+		file->stream_reading = false;
+	}
+}
+
+// the stream reads until the pipe is drained, which requires a non-blocking
+// read end. without PIPE_FLAG_NON_BLOCKING_READ the read end is switched to
+// non-blocking mode while streaming and switched back afterwards
+static int file_set_stream_non_blocking(File *file, bool non_blocking) {
+	int flags;
+
+	if ((file->flags & PIPE_FLAG_NON_BLOCKING_READ) != 0) {
+		return 0;
+	}
+
+	flags = fcntl(file->pipe.read_end, F_GETFL);
+
+	if (flags < 0) {
+		return -1;
+	}
+
+	if (non_blocking) {
+		flags |= O_NONBLOCK;
+	} else {
+		flags &= ~O_NONBLOCK;
+	}
+
+	return fcntl(file->pipe.read_end, F_SETFL, flags);
+}
+
+static void file_end_stream(File *file) {
+	file_stop_stream_reading(file);
+
+	if (file_set_stream_non_blocking(file, false) < 0) {
+		log_error("Could not restore blocking read end of file object ("FILE_SIGNATURE_FORMAT"): %s (%d)",
+		          file_expand_signature(file), get_errno_name(errno), errno);
+	}
+
+	file->streaming = false;
+	file->stream_credit = 0;
+}
+
+// reads up to FILE_MAX_STREAM_CHUNKS_PER_EVENT chunks from the pipe and pushes
+// them to the client, but never more than the granted credit. once the credit
+// is used up the read end is removed from the event loop, so the pipe fills up
+// and the writer is throttled until the client grants more credit
+static void file_handle_stream_readable(void *opaque) {
+	File *file = opaque;
+	uint8_t buffer[FILE_MAX_READ_ASYNC_BUFFER_LENGTH];
+	int length_to_read;
+	int length_read;
+	int i;
+	APIE error_code;
+
+	for (i = 0; i < FILE_MAX_STREAM_CHUNKS_PER_EVENT && file->stream_credit > 0; ++i) {
+		length_to_read = sizeof(buffer);
+
+		if ((uint64_t)length_to_read > file->stream_credit) {
+			length_to_read = file->stream_credit;
+		}
+
+		// read from the pipe directly, the read end is non-blocking while
+		// streaming, so a drained pipe reports EAGAIN instead of blocking
+		length_read = pipe_read(&file->pipe, buffer, length_to_read);
+
+		if (length_read < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			if (errno_would_block()) {
+				return;
+			}
+
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not read %d byte(s) from file object ("FILE_SIGNATURE_FORMAT") for streaming: %s (%d)",
+			          length_to_read, file_expand_signature(file),
+			          get_errno_name(errno), errno);
+
+			file_end_stream(file);
+			file_send_stream_data_callback(file, error_code, NULL, 0);
+
+			return;
+		}
+
+		if (length_read == 0) {
+			// cannot happen while redapid holds the write end, but avoid
+			// spinning on a readable end-of-file forever
+			file_end_stream(file);
+			file_send_stream_data_callback(file, API_E_SUCCESS, NULL, 0);
+
+			return;
+		}
+
+		file->stream_credit -= length_read;
+
+		file_send_stream_data_callback(file, API_E_SUCCESS, buffer, length_read);
+
+		if (length_read < length_to_read) {
+			return; // pipe is drained
+		}
+	}
+
+	if (file->stream_credit == 0) {
+		log_debug("Stream credit of file object ("FILE_SIGNATURE_FORMAT") is used up",
+		          file_expand_signature(file));
+
+		file_stop_stream_reading(file);
+	}
+}
+
+static APIE file_start_stream_reading(File *file) {
+	if (file->stream_reading || file->stream_credit == 0) {
+		return API_E_SUCCESS;
+	}
+
+	if (event_add_source(file->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC, EVENT_READ,
+	                     file_handle_stream_readable, file) < 0) {
+		return API_E_INTERNAL_ERROR;
+	}
+
+	file->stream_reading = true;
+
+	return API_E_SUCCESS;
+}
+
 static void file_handle_writable_event(void *opaque) {
 	File *file = opaque;
 
@@ -303,13 +590,31 @@ static int file_handle_read(File *file, void *buffer, int length) {
 
 // sets errno on error
 static int file_handle_write(File *file, void *buffer, int length) {
+	int rc;
+	off_t position;
+
 	if ((file->flags & FILE_FLAG_NON_BLOCKING) == 0) {
 		errno = ENOTSUP;
 
 		return -1;
 	}
 
-	return write(file->fd, buffer, length);
+	rc = write(file->fd, buffer, length);
+
+	if (rc > 0) {
+		read_cache_invalidate(file->device, file->inode);
+	}
+
+	// track the end of the written data to know where to truncate to on close
+	if (rc > 0 && file->truncate_on_close) {
+		position = lseek(file->fd, 0, SEEK_CUR);
+
+		if (position > 0 && (uint64_t)position > file->truncate_length) {
+			file->truncate_length = position;
+		}
+	}
+
+	return rc;
 }
 
 // sets errno on error
@@ -317,6 +622,51 @@ static off_t file_handle_seek(File *file, off_t offset, int whence) {
 	return lseek(file->fd, offset, whence);
 }
 
+// sets errno on error. the cache entry is acquired on the first read, so
+// opening a file that is never read doesn't take up space in the cache. the
+// position is the offset of the file descriptor, it might be moved by another
+// process using the read handle, e.g. as stdin
+static int file_handle_cached_read(File *file, void *buffer, int length) {
+	struct stat st;
+	off_t position;
+	int rc;
+
+	if ((file->flags & FILE_FLAG_NON_BLOCKING) == 0) {
+		errno = ENOTSUP;
+
+		return -1;
+	}
+
+	if (file->read_cache_entry == NULL) {
+		if (fstat(file->fd, &st) < 0) {
+			return -1;
+		}
+
+		file->read_cache_entry = read_cache_acquire(file->fd, &st);
+
+		// the file cannot be cached, read it directly from now on
+		if (file->read_cache_entry == NULL) {
+			file->read = file_handle_read;
+
+			return file_handle_read(file, buffer, length);
+		}
+	}
+
+	position = lseek(file->fd, 0, SEEK_CUR);
+
+	if (position < 0) {
+		return -1;
+	}
+
+	rc = read_cache_read(file->read_cache_entry, file->fd, position, buffer, length);
+
+	if (rc > 0 && lseek(file->fd, position + rc, SEEK_SET) < 0) {
+		return -1;
+	}
+
+	return rc;
+}
+
 // sets errno on error
 static int pipe_handle_read(File *file, void *buffer, int length) {
 	if ((file->flags & PIPE_FLAG_NON_BLOCKING_READ) == 0) {
@@ -423,6 +773,164 @@ static void file_handle_async_read(void *opaque) {
 	}
 }
 
+static void file_stop_async_read(File *file) {
+	event_remove_source(file->async_read_eventfd, EVENT_SOURCE_TYPE_GENERIC);
+
+	file->async_read_in_progress = false;
+	file->length_to_read_async = 0;
+	file->async_read_block_length = 0;
+	file->async_read_block_used = 0;
+	file->async_read_block_offset = 0;
+
+	free(file->async_read_block);
+
+	file->async_read_block = NULL;
+}
+
+// reads and compresses one block at a time and sends it in chunks of up to
+// FILE_MAX_READ_ASYNC_BUFFER_LENGTH bytes. the stream is terminated by an
+// empty callback
+static void file_handle_async_read_compressed(void *opaque) {
+	File *file = opaque;
+	FileCompressedBlockHeader *header;
+	uint8_t *data;
+	uint8_t *raw;
+	int maximum_compressed_length;
+	uint32_t length_to_read;
+	uint32_t length_read = 0;
+	int rc;
+	int compressed_length;
+	int length_to_send;
+	APIE error_code;
+
+	if (!file->async_read_in_progress) {
+		log_error("Got asynchronous read event for file object ("FILE_SIGNATURE_FORMAT") without an asynchronous read in progress",
+		          file_expand_signature(file));
+
+		event_remove_source(file->async_read_eventfd, EVENT_SOURCE_TYPE_GENERIC);
+
+		return;
+	}
+
+	if (file->async_read_block_offset >= file->async_read_block_used) {
+		// previous block is sent completely, read and compress the next one
+		header = (FileCompressedBlockHeader *)file->async_read_block;
+		data = file->async_read_block + sizeof(FileCompressedBlockHeader);
+		maximum_compressed_length = lz4_get_max_compressed_length(file->async_read_block_length);
+		raw = data + maximum_compressed_length;
+		length_to_read = file->async_read_block_length;
+
+		if (length_to_read > file->length_to_read_async) {
+			length_to_read = file->length_to_read_async;
+		}
+
+		while (length_read < length_to_read) {
+			rc = file->read(file, raw + length_read, length_to_read - length_read);
+
+			if (rc < 0) {
+				if (errno_interrupted()) {
+					continue;
+				}
+
+				if (errno_would_block()) {
+					break;
+				}
+
+				error_code = api_get_error_code_from_errno();
+
+				log_error("Could not read %u byte(s) from file object ("FILE_SIGNATURE_FORMAT") asynchronously: %s (%d)",
+				          length_to_read - length_read, file_expand_signature(file),
+				          get_errno_name(errno), errno);
+
+				file_stop_async_read(file);
+				file_send_async_read_callback(file, error_code, NULL, 0);
+
+				return;
+			}
+
+			if (rc == 0) {
+				break;
+			}
+
+			length_read += rc;
+		}
+
+		if (length_read < length_to_read) {
+			// end-of-file or nothing to read at this time, this is the last block
+			file->length_to_read_async = 0;
+		} else {
+			file->length_to_read_async -= length_read;
+		}
+
+		if (length_read == 0) {
+			file_stop_async_read(file);
+			file_send_async_read_callback(file, API_E_SUCCESS, NULL, 0);
+
+			log_debug("Finished compressed asynchronous reading from file object ("FILE_SIGNATURE_FORMAT")",
+			          file_expand_signature(file));
+
+			return;
+		}
+
+		compressed_length = lz4_compress_block(raw, length_read, data,
+		                                       maximum_compressed_length);
+
+		if (compressed_length < 0 || compressed_length >= (int)length_read) {
+			// data is incompressible, store it as is
+			memcpy(data, raw, length_read);
+
+			compressed_length = 0;
+			file->async_read_block_used = sizeof(FileCompressedBlockHeader) + length_read;
+		} else {
+			file->async_read_block_used = sizeof(FileCompressedBlockHeader) + compressed_length;
+		}
+
+		header->length = length_read;
+		header->compressed_length = compressed_length;
+		file->async_read_block_offset = 0;
+
+		log_debug("Read and compressed %u byte(s) from file object ("FILE_SIGNATURE_FORMAT") to %d byte(s), %"PRIu64" byte(s) left to read",
+		          length_read, file_expand_signature(file), compressed_length,
+		          file->length_to_read_async);
+	}
+
+	length_to_send = file->async_read_block_used - file->async_read_block_offset;
+
+	if (length_to_send > FILE_MAX_READ_ASYNC_BUFFER_LENGTH) {
+		length_to_send = FILE_MAX_READ_ASYNC_BUFFER_LENGTH;
+	}
+
+	file_send_async_read_callback(file, API_E_SUCCESS,
+	                              file->async_read_block + file->async_read_block_offset,
+	                              length_to_send);
+
+	file->async_read_block_offset += length_to_send;
+
+	// the empty callback that terminates the stream is sent on the next event
+}
+
+// sets errno on error
+static int file_write_fully(File *file, uint8_t *buffer, int length) {
+	int offset = 0;
+	int rc;
+
+	while (offset < length) {
+		rc = file->write(file, buffer + offset, length - offset);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		offset += rc;
+	}
+
+	return 0;
+}
+
 // NOTE: assumes that name is absolute (starts with '/')
 static APIE file_open_as(const char *name, uint32_t flags, int oflags,
                          mode_t mode, uint32_t uid, uint32_t gid, IOHandle *fd_) {
@@ -432,6 +940,15 @@ static APIE file_open_as(const char *name, uint32_t flags, int oflags,
 	int fd = -1;
 	int rc;
 	int status;
+	const gid_t *groups;
+	int group_count;
+
+	// resolve groups here, getpwuid cannot be used in the child process
+	error_code = identity_get_groups(uid, &groups, &group_count);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
 
 	// create socket pair to pass FD from child to parent
 	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) {
@@ -454,7 +971,7 @@ static APIE file_open_as(const char *name, uint32_t flags, int oflags,
 		close(pair[0]);
 
 		// change user and groups
-		error_code = process_set_identity(uid, gid);
+		error_code = process_set_identity(uid, gid, groups, group_count);
 
 		if (error_code != API_E_SUCCESS) {
 			goto child_cleanup;
@@ -845,10 +1362,31 @@ APIE file_open(ObjectID name_id, uint32_t flags, uint16_t permissions,
 	file->name = name;
 	file->flags = flags;
 	file->events = 0;
+	file->streaming = false;
+	file->stream_reading = false;
+	file->stream_credit = 0;
 	file->fd = fd;
 	file->async_read_eventfd = async_read_eventfd;
 	file->async_read_in_progress = false;
 	file->length_to_read_async = 0;
+	file->async_read_block_length = 0;
+	file->async_read_block = NULL;
+	file->async_read_block_used = 0;
+	file->async_read_block_offset = 0;
+	file->compressed_write_block = NULL;
+	file->compressed_write_block_used = 0;
+	file->write_window_acknowledge_length = 0;
+	file->write_window_acknowledge_interval = 0;
+	file->write_window_length_written = 0;
+	file->write_window_length_acknowledged = 0;
+	file->write_window_error_code = API_E_SUCCESS;
+	file->write_window_timer_armed = false;
+	file->truncate_on_close = false;
+	file->truncate_length = 0;
+	file->write_handle_shared = false;
+	file->device = st.st_dev;
+	file->inode = st.st_ino;
+	file->read_cache_entry = NULL;
 	file->read = file_handle_read;
 	file->write = file_handle_write;
 	file->seek = file_handle_seek;
@@ -862,6 +1400,16 @@ APIE file_open(ObjectID name_id, uint32_t flags, uint16_t permissions,
 
 	phase = 5;
 
+	// reads of read-only regular files are served from the shared read cache,
+	// writable files invalidate the cached content of other file objects
+	if (file->type == FILE_TYPE_REGULAR) {
+		if ((flags & (FILE_FLAG_WRITE_ONLY | FILE_FLAG_READ_WRITE)) != 0) {
+			read_cache_invalidate(st.st_dev, st.st_ino);
+		} else if ((flags & FILE_FLAG_TEMPORARY) == 0) {
+			file->read = file_handle_cached_read;
+		}
+	}
+
 	if (id != NULL) {
 		*id = file->base.id;
 	}
@@ -989,10 +1537,31 @@ APIE pipe_create_(uint32_t flags, uint64_t length, Session *session,
 	file->name = name;
 	file->flags = flags;
 	file->events = 0;
+	file->streaming = false;
+	file->stream_reading = false;
+	file->stream_credit = 0;
 	file->fd = -1;
 	file->async_read_eventfd = async_read_eventfd;
 	file->async_read_in_progress = false;
 	file->length_to_read_async = 0;
+	file->async_read_block_length = 0;
+	file->async_read_block = NULL;
+	file->async_read_block_used = 0;
+	file->async_read_block_offset = 0;
+	file->compressed_write_block = NULL;
+	file->compressed_write_block_used = 0;
+	file->write_window_acknowledge_length = 0;
+	file->write_window_acknowledge_interval = 0;
+	file->write_window_length_written = 0;
+	file->write_window_length_acknowledged = 0;
+	file->write_window_error_code = API_E_SUCCESS;
+	file->write_window_timer_armed = false;
+	file->truncate_on_close = false;
+	file->truncate_length = 0;
+	file->write_handle_shared = false;
+	file->device = 0;
+	file->inode = 0;
+	file->read_cache_entry = NULL;
 	file->read = pipe_handle_read;
 	file->write = pipe_handle_write;
 	file->seek = pipe_handle_seek;
@@ -1118,13 +1687,160 @@ APIE file_get_info(File *file, Session *session, uint8_t *type,
 	return API_E_SUCCESS;
 }
 
-// public API
-APIE file_read(File *file, uint8_t *buffer, uint8_t length_to_read,
-               uint8_t *length_read) {
-	int rc;
-	APIE error_code;
+static void file_finish_stat_paths(FileStatPathsJob *job) {
+	log_debug("Finished reporting information for %d of %d path(s) of list object (id: %u)",
+	          job->index, job->names->items.count, job->names->base.id);
 
-	if (length_to_read > FILE_MAX_READ_BUFFER_LENGTH) {
+	event_remove_source(job->eventfd, EVENT_SOURCE_TYPE_GENERIC);
+	close(job->eventfd);
+
+	list_unlock_and_release(job->names);
+
+	free(job);
+}
+
+static void file_handle_stat_paths(void *opaque) {
+	FileStatPathsJob *job = opaque;
+	int i;
+	String *name;
+	struct stat st;
+	APIE error_code;
+
+	for (i = 0; i < FILE_STAT_PATHS_BATCH_LENGTH &&
+	     job->index < job->names->items.count; ++i, ++job->index) {
+		// nobody is interested in the remaining callbacks anymore
+		if (job->names->base.external_reference_count == 0) {
+			break;
+		}
+
+		name = *(String **)array_get(&job->names->items, job->index);
+
+		memset(&st, 0, sizeof(st));
+
+		if (*name->buffer != '/') {
+			error_code = API_E_INVALID_PARAMETER;
+
+			log_warn("Cannot get information for relative path '%s'", name->buffer);
+		} else if (fstatat(AT_FDCWD, name->buffer, &st,
+		                   (job->flags & FILE_STAT_FLAG_FOLLOW_SYMLINKS) != 0 ? 0 : AT_SYMLINK_NOFOLLOW) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_debug("Could not get information for '%s': %s (%d)",
+			          name->buffer, get_errno_name(errno), errno);
+
+			memset(&st, 0, sizeof(st));
+		} else {
+			error_code = API_E_SUCCESS;
+		}
+
+		api_send_path_info_reported_callback(job->names->base.id, job->index,
+		                                     error_code,
+		                                     error_code == API_E_SUCCESS
+		                                     ? file_get_type_from_stat_mode(st.st_mode)
+		                                     : FILE_TYPE_UNKNOWN,
+		                                     file_get_permissions_from_stat_mode(st.st_mode),
+		                                     st.st_uid, st.st_gid, st.st_size,
+		                                     st.st_atime, st.st_mtime, st.st_ctime);
+	}
+
+	if (i < FILE_STAT_PATHS_BATCH_LENGTH || job->index >= job->names->items.count) {
+		file_finish_stat_paths(job);
+	}
+}
+
+// public API
+APIE file_stat_paths(ObjectID names_list_id, uint16_t flags) {
+	int phase = 0;
+	APIE error_code;
+	List *names;
+	FileStatPathsJob *job;
+
+	if ((flags & ~FILE_STAT_FLAG_ALL) != 0) {
+		log_warn("Invalid file stat flags 0x%04X", flags);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	// lock names list object
+	error_code = list_get_acquired_and_locked(names_list_id, OBJECT_TYPE_STRING,
+	                                          &names);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	job = calloc(1, sizeof(FileStatPathsJob));
+
+	if (job == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate stat job: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	job->names = names;
+	job->flags = flags;
+	job->index = 0;
+	job->eventfd = eventfd(1, EFD_NONBLOCK);
+
+	if (job->eventfd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create stat job eventfd: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	// like an asynchronous read the callbacks are generated in batches on
+	// every event loop iteration while the eventfd stays readable. this keeps
+	// long lists from blocking the event loop and ensures that the callbacks
+	// are delivered after the response of this function
+	if (event_add_source(job->eventfd, EVENT_SOURCE_TYPE_GENERIC, EVENT_READ,
+	                     file_handle_stat_paths, job) < 0) {
+		error_code = API_E_INTERNAL_ERROR;
+
+		goto cleanup;
+	}
+
+	phase = 4;
+
+	log_debug("Started reporting information for %d path(s) of list object (id: %u)",
+	          names->items.count, names->base.id);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 3:
+		close(job->eventfd);
+
+	case 2:
+		free(job);
+
+	case 1:
+		list_unlock_and_release(names);
+
+	default:
+		break;
+	}
+
+	return phase == 4 ? API_E_SUCCESS : error_code;
+}
+
+// public API
+APIE file_read(File *file, uint8_t *buffer, uint8_t length_to_read,
+               uint8_t *length_read) {
+	int rc;
+	APIE error_code;
+
+	if (length_to_read > FILE_MAX_READ_BUFFER_LENGTH) {
 		log_warn("Length of %u byte(s) exceeds maximum length of file read buffer",
 		         length_to_read);
 
@@ -1138,6 +1854,13 @@ APIE file_read(File *file, uint8_t *buffer, uint8_t length_to_read,
 		return API_E_INVALID_OPERATION;
 	}
 
+	if (file->streaming) {
+		log_warn("Cannot read %u byte(s) synchronously from streaming file object ("FILE_SIGNATURE_FORMAT")",
+		         length_to_read, file_expand_signature(file));
+
+		return API_E_INVALID_OPERATION;
+	}
+
 	rc = file->read(file, buffer, length_to_read); // FIXME: handle EINTR
 
 	if (rc < 0) {
@@ -1161,8 +1884,10 @@ APIE file_read(File *file, uint8_t *buffer, uint8_t length_to_read,
 	return API_E_SUCCESS;
 }
 
-// public API
-PacketE file_read_async(File *file, uint64_t length_to_read) {
+static PacketE file_start_async_read(File *file, uint64_t length_to_read,
+                                     uint32_t block_length) {
+	EventFunction function = file_handle_async_read;
+
 	if (length_to_read > INT64_MAX) {
 		log_warn("Length of %"PRIu64" byte(s) exceeds maximum length of file",
 		         length_to_read);
@@ -1183,6 +1908,38 @@ PacketE file_read_async(File *file, uint64_t length_to_read) {
 		return PACKET_E_UNKNOWN_ERROR;
 	}
 
+	if (file->streaming) {
+		log_warn("Cannot read %"PRIu64" byte(s) asynchronously from streaming file object ("FILE_SIGNATURE_FORMAT")",
+		         length_to_read, file_expand_signature(file));
+
+		// FIXME: this callback should be delivered after the response of this function
+		file_send_async_read_callback(file, API_E_INVALID_OPERATION, NULL, 0);
+
+		return PACKET_E_UNKNOWN_ERROR;
+	}
+
+	if (block_length > 0) {
+		file->async_read_block = malloc(sizeof(FileCompressedBlockHeader) +
+		                                lz4_get_max_compressed_length(block_length) +
+		                                block_length);
+
+		if (file->async_read_block == NULL) {
+			log_error("Could not allocate compression buffer: %s (%d)",
+			          get_errno_name(ENOMEM), ENOMEM);
+
+			// FIXME: this callback should be delivered after the response of this function
+			file_send_async_read_callback(file, API_E_NO_FREE_MEMORY, NULL, 0);
+
+			return PACKET_E_UNKNOWN_ERROR;
+		}
+
+		file->async_read_block_length = block_length;
+		file->async_read_block_used = 0;
+		file->async_read_block_offset = 0;
+
+		function = file_handle_async_read_compressed;
+	}
+
 	file->async_read_in_progress = true;
 	file->length_to_read_async = length_to_read;
 
@@ -1191,26 +1948,55 @@ PacketE file_read_async(File *file, uint64_t length_to_read) {
 	// when done reading asynchronously then remove the eventfd from the event
 	// loop again
 	if (event_add_source(file->async_read_eventfd, EVENT_SOURCE_TYPE_GENERIC,
-	                     EVENT_READ, file_handle_async_read, file) < 0) {
+	                     EVENT_READ, function, file) < 0) {
+		file->async_read_in_progress = false;
+		file->length_to_read_async = 0;
+		file->async_read_block_length = 0;
+
+		free(file->async_read_block);
+
+		file->async_read_block = NULL;
+
 		// FIXME: this callback should be delivered after the response of this function
 		file_send_async_read_callback(file, API_E_INTERNAL_ERROR, NULL, 0);
 
 		return PACKET_E_UNKNOWN_ERROR;
 	}
 
-	log_debug("Started reading of %"PRIu64" byte(s) from file object ("FILE_SIGNATURE_FORMAT") asynchronously",
-	          length_to_read, file_expand_signature(file));
+	log_debug("Started %sreading of %"PRIu64" byte(s) from file object ("FILE_SIGNATURE_FORMAT") asynchronously",
+	          block_length > 0 ? "compressed " : "", length_to_read,
+	          file_expand_signature(file));
 
 	return PACKET_E_SUCCESS;
 }
 
+// public API
+PacketE file_read_async(File *file, uint64_t length_to_read) {
+	return file_start_async_read(file, length_to_read, 0);
+}
+
+// public API
+PacketE file_read_async_compressed(File *file, uint64_t length_to_read,
+                                   uint32_t block_length) {
+	if (block_length < FILE_MIN_COMPRESSION_BLOCK_LENGTH ||
+	    block_length > FILE_MAX_COMPRESSION_BLOCK_LENGTH) {
+		log_warn("Compression block length of %u byte(s) is out of range [%d..%d]",
+		         block_length, FILE_MIN_COMPRESSION_BLOCK_LENGTH,
+		         FILE_MAX_COMPRESSION_BLOCK_LENGTH);
+
+		// FIXME: this callback should be delivered after the response of this function
+		file_send_async_read_callback(file, API_E_OUT_OF_RANGE, NULL, 0);
+
+		return PACKET_E_INVALID_PARAMETER;
+	}
+
+	return file_start_async_read(file, length_to_read, block_length);
+}
+
 // public API
 APIE file_abort_async_read(File *file) {
 	if (file->async_read_in_progress) {
-		event_remove_source(file->async_read_eventfd, EVENT_SOURCE_TYPE_GENERIC);
-
-		file->async_read_in_progress = false;
-		file->length_to_read_async = 0;
+		file_stop_async_read(file);
 
 		// FIXME: this callback should be delivered after the response of this function
 		file_send_async_read_callback(file, API_E_OPERATION_ABORTED, NULL, 0);
@@ -1298,12 +2084,16 @@ PacketE file_write_async(File *file, uint8_t *buffer, uint8_t length_to_write) {
 	int length_written;
 	APIE error_code;
 
+	if (file_drop_async_write(file, length_to_write)) {
+		return PACKET_E_UNKNOWN_ERROR;
+	}
+
 	if (length_to_write > FILE_MAX_WRITE_ASYNC_BUFFER_LENGTH) {
 		log_warn("Length of %u byte(s) exceeds maximum length of file async write buffer",
 		         length_to_write);
 
 		// FIXME: this callback should be delivered after the response of this function
-		file_send_async_write_callback(file, API_E_OUT_OF_RANGE, 0);
+		file_report_async_write(file, API_E_OUT_OF_RANGE, length_to_write, 0, 0);
 
 		return PACKET_E_INVALID_PARAMETER;
 	}
@@ -1313,7 +2103,7 @@ PacketE file_write_async(File *file, uint8_t *buffer, uint8_t length_to_write) {
 		         length_to_write, file->length_to_read_async, file_expand_signature(file));
 
 		// FIXME: this callback should be delivered after the response of this function
-		file_send_async_write_callback(file, API_E_INVALID_OPERATION, 0);
+		file_report_async_write(file, API_E_INVALID_OPERATION, length_to_write, 0, 0);
 
 		return PACKET_E_UNKNOWN_ERROR;
 	}
@@ -1333,15 +2123,238 @@ PacketE file_write_async(File *file, uint8_t *buffer, uint8_t length_to_write) {
 		}
 
 		// FIXME: this callback should be delivered after the response of this function
-		file_send_async_write_callback(file, error_code, 0);
+		file_report_async_write(file, error_code, length_to_write, 0, 0);
+
+		return PACKET_E_UNKNOWN_ERROR;
+	}
+
+	// FIXME: this callback should be delivered after the response of this function
+	file_report_async_write(file, API_E_SUCCESS, length_to_write, length_written, length_written);
+
+	return PACKET_E_SUCCESS;
+}
+
+// public API
+PacketE file_write_async_compressed(File *file, uint8_t *buffer, uint8_t length_to_write) {
+	int maximum_compressed_length = lz4_get_max_compressed_length(FILE_MAX_COMPRESSION_BLOCK_LENGTH);
+	FileCompressedBlockHeader *header;
+	uint8_t *data;
+	uint8_t *raw;
+	int length_consumed = 0;
+	int length_completed = 0; // stream bytes of completed blocks
+	int length_flushed = 0; // bytes of this write that belong to completed blocks
+	int length_required;
+	int length_to_append;
+	int length;
+	off_t position = -1;
+	APIE error_code;
+
+	if (file_drop_async_write(file, length_to_write)) {
+		return PACKET_E_UNKNOWN_ERROR;
+	}
+
+	if (length_to_write > FILE_MAX_WRITE_ASYNC_BUFFER_LENGTH) {
+		log_warn("Length of %u byte(s) exceeds maximum length of file async write buffer",
+		         length_to_write);
+
+		// the client resends from the start of the partially received block
+		file->compressed_write_block_used = 0;
+
+		// FIXME: this callback should be delivered after the response of this function
+		file_report_async_write(file, API_E_OUT_OF_RANGE, length_to_write, 0, 0);
+
+		return PACKET_E_INVALID_PARAMETER;
+	}
+
+	if (file->async_read_in_progress) {
+		log_warn("Cannot write %u byte(s) asynchronously while reading %"PRIu64" byte(s) from file object ("FILE_SIGNATURE_FORMAT") asynchronously",
+		         length_to_write, file->length_to_read_async, file_expand_signature(file));
+
+		// the client resends from the start of the partially received block
+		file->compressed_write_block_used = 0;
+
+		// FIXME: this callback should be delivered after the response of this function
+		file_report_async_write(file, API_E_INVALID_OPERATION, length_to_write, 0, 0);
 
 		return PACKET_E_UNKNOWN_ERROR;
 	}
 
+	if (file->compressed_write_block == NULL) {
+		file->compressed_write_block = malloc(sizeof(FileCompressedBlockHeader) +
+		                                      maximum_compressed_length +
+		                                      FILE_MAX_COMPRESSION_BLOCK_LENGTH);
+
+		if (file->compressed_write_block == NULL) {
+			log_error("Could not allocate compression buffer: %s (%d)",
+			          get_errno_name(ENOMEM), ENOMEM);
+
+			// FIXME: this callback should be delivered after the response of this function
+			file_report_async_write(file, API_E_NO_FREE_MEMORY, length_to_write, 0, 0);
+
+			return PACKET_E_UNKNOWN_ERROR;
+		}
+
+		file->compressed_write_block_used = 0;
+	}
+
+	header = (FileCompressedBlockHeader *)file->compressed_write_block;
+	data = file->compressed_write_block + sizeof(FileCompressedBlockHeader);
+	raw = data + maximum_compressed_length;
+
+	// a block can span multiple writes and a write can contain the end of one
+	// block and the start of the next one. collect the header first, then the
+	// data of the block
+	while (length_consumed < length_to_write) {
+		if (file->compressed_write_block_used < (int)sizeof(FileCompressedBlockHeader)) {
+			length_required = sizeof(FileCompressedBlockHeader);
+		} else if (header->compressed_length > 0) {
+			length_required = sizeof(FileCompressedBlockHeader) + header->compressed_length;
+		} else {
+			length_required = sizeof(FileCompressedBlockHeader) + header->length;
+		}
+
+		length_to_append = length_required - file->compressed_write_block_used;
+
+		if (length_to_append > length_to_write - length_consumed) {
+			length_to_append = length_to_write - length_consumed;
+		}
+
+		memcpy(file->compressed_write_block + file->compressed_write_block_used,
+		       buffer + length_consumed, length_to_append);
+
+		file->compressed_write_block_used += length_to_append;
+		length_consumed += length_to_append;
+
+		if (file->compressed_write_block_used < length_required) {
+			break;
+		}
+
+		if (length_required == (int)sizeof(FileCompressedBlockHeader)) {
+			if (header->length < 1 || header->length > FILE_MAX_COMPRESSION_BLOCK_LENGTH ||
+			    header->compressed_length > (uint32_t)maximum_compressed_length) {
+				log_warn("Invalid compressed block header (length: %u, compressed-length: %u) for file object ("FILE_SIGNATURE_FORMAT")",
+				         header->length, header->compressed_length, file_expand_signature(file));
+
+				error_code = API_E_INVALID_PARAMETER;
+
+				goto error;
+			}
+
+			continue;
+		}
+
+		// remember the position of the block to rewind a partial write of it.
+		// fails for pipes, their partially written data cannot be taken back
+		position = file->seek(file, 0, SEEK_CUR);
+
+		if (header->compressed_length > 0) {
+			length = lz4_decompress_block(data, header->compressed_length,
+			                              raw, FILE_MAX_COMPRESSION_BLOCK_LENGTH);
+
+			if (length < 0 || length != (int)header->length) {
+				log_warn("Could not decompress %u byte(s) for file object ("FILE_SIGNATURE_FORMAT"), block is malformed",
+				         header->compressed_length, file_expand_signature(file));
+
+				error_code = API_E_INVALID_PARAMETER;
+
+				goto error;
+			}
+
+			if (file_write_fully(file, raw, length) < 0) {
+				goto write_error;
+			}
+		} else if (file_write_fully(file, data, header->length) < 0) {
+			goto write_error;
+		}
+
+		log_debug("Decompressed and wrote %u byte(s) to file object ("FILE_SIGNATURE_FORMAT") asynchronously",
+		          header->length, file_expand_signature(file));
+
+		file->compressed_write_block_used = 0;
+		length_completed += length_required;
+		length_flushed = length_consumed;
+	}
+
 	// FIXME: this callback should be delivered after the response of this function
-	file_send_async_write_callback(file, API_E_SUCCESS, length_written);
+	file_report_async_write(file, API_E_SUCCESS, length_to_write, length_consumed,
+	                        length_completed);
 
 	return PACKET_E_SUCCESS;
+
+write_error:
+	error_code = api_get_error_code_from_errno();
+
+	log_error("Could not write %u byte(s) to file object ("FILE_SIGNATURE_FORMAT") asynchronously: %s (%d)",
+	          header->length, file_expand_signature(file),
+	          get_errno_name(errno), errno);
+
+	if (position >= 0 && file->seek(file, position, SEEK_SET) < 0) {
+		log_error("Could not rewind file object ("FILE_SIGNATURE_FORMAT") to start of failed block: %s (%d)",
+		          file_expand_signature(file), get_errno_name(errno), errno);
+	}
+
+error:
+	// only the blocks completed before the error are acknowledged. discard the
+	// partially received block, so the stream continues at the acknowledged
+	// position when the client resends from there
+	file->compressed_write_block_used = 0;
+
+	// FIXME: this callback should be delivered after the response of this function
+	file_report_async_write(file, error_code, length_to_write, length_flushed,
+	                        length_completed);
+
+	return PACKET_E_UNKNOWN_ERROR;
+}
+
+// public API
+APIE file_set_write_window(File *file, uint32_t acknowledge_length,
+                           uint16_t acknowledge_interval) {
+	if (acknowledge_length > 0 &&
+	    (acknowledge_interval < 1 ||
+	     acknowledge_interval > FILE_MAX_WRITE_WINDOW_ACKNOWLEDGE_INTERVAL)) {
+		log_warn("Write window acknowledge interval of %u millisecond(s) is out of range [1..%d]",
+		         acknowledge_interval, FILE_MAX_WRITE_WINDOW_ACKNOWLEDGE_INTERVAL);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	if (acknowledge_length > 0 && file->write_window_acknowledge_length == 0) {
+		if (timer_create_(&file->write_window_timer, file_handle_write_window_timer, file) < 0) {
+			log_error("Could not create write window timer for file object ("FILE_SIGNATURE_FORMAT"): %s (%d)",
+			          file_expand_signature(file), get_errno_name(errno), errno);
+
+			return API_E_INTERNAL_ERROR;
+		}
+	} else if (acknowledge_length == 0 && file->write_window_acknowledge_length > 0) {
+		timer_destroy(&file->write_window_timer);
+	} else if (file->write_window_timer_armed) {
+		timer_configure(&file->write_window_timer, 0, 0);
+	}
+
+	if (file->compressed_write_block_used > 0) {
+		// the new write window starts at a block boundary
+		log_debug("Discarding %d byte(s) of partially received compressed block for file object ("FILE_SIGNATURE_FORMAT")",
+		          file->compressed_write_block_used, file_expand_signature(file));
+
+		file->compressed_write_block_used = 0;
+	}
+
+	file->write_window_acknowledge_length = acknowledge_length;
+	file->write_window_acknowledge_interval = acknowledge_interval;
+	file->write_window_length_written = 0;
+	file->write_window_length_acknowledged = 0;
+	file->write_window_error_code = API_E_SUCCESS;
+	file->write_window_timer_armed = false;
+
+	if (acknowledge_length > 0) {
+		log_debug("Set write window of file object ("FILE_SIGNATURE_FORMAT") to acknowledge every %u byte(s) or %u millisecond(s)",
+		          file_expand_signature(file), acknowledge_length, acknowledge_interval);
+	} else {
+		log_debug("Removed write window of file object ("FILE_SIGNATURE_FORMAT")",
+		          file_expand_signature(file));
+	}
+
+	return API_E_SUCCESS;
 }
 
 // public API
@@ -1407,6 +2420,89 @@ APIE file_get_position(File *file, uint64_t *position) {
 	return API_E_SUCCESS;
 }
 
+// public API
+APIE file_set_size_hint(File *file, uint64_t length, uint16_t flags) {
+	struct stat st;
+	int mode = 0;
+	int rc;
+	APIE error_code;
+
+	if ((flags & ~FILE_SIZE_HINT_FLAG_ALL) != 0) {
+		log_warn("Invalid file size hint flags 0x%04X", flags);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (file->type != FILE_TYPE_REGULAR) {
+		log_warn("Cannot set size hint for file object ("FILE_SIGNATURE_FORMAT"), it is not a regular file",
+		         file_expand_signature(file));
+
+		return API_E_NOT_SUPPORTED;
+	}
+
+	if (length > INT64_MAX) {
+		log_warn("Length of %"PRIu64" byte(s) exceeds maximum length of file",
+		         length);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	if (fstat(file->fd, &st) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get information for file object ("FILE_SIGNATURE_FORMAT"): %s (%d)",
+		          file_expand_signature(file), get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if ((flags & FILE_SIZE_HINT_FLAG_KEEP_SIZE) != 0) {
+		mode = FALLOC_FL_KEEP_SIZE;
+	}
+
+	if (length <= (uint64_t)st.st_size) {
+		log_debug("Ignoring size hint of %"PRIu64" byte(s) for file object ("FILE_SIGNATURE_FORMAT"), file is already %"PRIu64" byte(s) long",
+		          length, file_expand_signature(file), (uint64_t)st.st_size);
+
+		return API_E_SUCCESS;
+	}
+
+	rc = fallocate(file->fd, mode, 0, length);
+
+	if (rc < 0 && (errno == EOPNOTSUPP || errno == ENOSYS) && mode == 0) {
+		// file system doesn't support fallocate, let the C library
+		// emulate it. posix_fallocate doesn't set errno
+		rc = posix_fallocate(file->fd, 0, length);
+
+		if (rc != 0) {
+			errno = rc;
+			rc = -1;
+		}
+	}
+
+	if (rc < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not preallocate %"PRIu64" byte(s) for file object ("FILE_SIGNATURE_FORMAT"): %s (%d)",
+		          length, file_expand_signature(file), get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	// only truncate if the file got extended and all writes to it go through
+	// file->write. a previous size hint might have extended the file already,
+	// keep the length to truncate to in that case
+	if (mode == 0 && !file->truncate_on_close && !file->write_handle_shared) {
+		file->truncate_on_close = true;
+		file->truncate_length = st.st_size;
+	}
+
+	log_debug("Set size hint of file object ("FILE_SIGNATURE_FORMAT") to %"PRIu64" byte(s) (flags: 0x%04X)",
+	          file_expand_signature(file), length, flags);
+
+	return API_E_SUCCESS;
+}
+
 // public API
 APIE file_set_events(File *file, uint16_t events) {
 	if (file->type != FILE_TYPE_PIPE) {
@@ -1422,6 +2518,13 @@ APIE file_set_events(File *file, uint16_t events) {
 		return API_E_INVALID_PARAMETER;
 	}
 
+	if ((events & FILE_EVENT_READABLE) != 0 && file->streaming) {
+		log_warn("Cannot enable readable event for streaming file object ("FILE_SIGNATURE_FORMAT")",
+		         file_expand_signature(file));
+
+		return API_E_INVALID_OPERATION;
+	}
+
 	if ((events & FILE_EVENT_READABLE) != 0 && (file->events & FILE_EVENT_READABLE) == 0) {
 		if (event_add_source(file->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC, EVENT_READ,
 		                     file_handle_readable_event, file) < 0) {
@@ -1458,6 +2561,94 @@ APIE file_get_events(File *file, uint16_t *events) {
 	return API_E_SUCCESS;
 }
 
+// public API
+APIE file_start_stream(File *file, uint32_t credit) {
+	APIE error_code;
+
+	if (file->type != FILE_TYPE_PIPE) {
+		log_warn("Cannot stream non-pipe file object ("FILE_SIGNATURE_FORMAT")",
+		         file_expand_signature(file));
+
+		return API_E_NOT_SUPPORTED;
+	}
+
+	if (file->streaming) {
+		log_warn("File object ("FILE_SIGNATURE_FORMAT") is already streaming",
+		         file_expand_signature(file));
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	// the readable event and the stream would both poll the read end
+	if ((file->events & FILE_EVENT_READABLE) != 0 || file->async_read_in_progress) {
+		log_warn("Cannot stream file object ("FILE_SIGNATURE_FORMAT") while it is read otherwise",
+		         file_expand_signature(file));
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	if (file_set_stream_non_blocking(file, true) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not make read end of file object ("FILE_SIGNATURE_FORMAT") non-blocking: %s (%d)",
+		          file_expand_signature(file), get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	file->streaming = true;
+	file->stream_credit = credit;
+
+	error_code = file_start_stream_reading(file);
+
+	if (error_code != API_E_SUCCESS) {
+		file_end_stream(file);
+
+		return error_code;
+	}
+
+	log_debug("Started streaming file object ("FILE_SIGNATURE_FORMAT") with a credit of %u byte(s)",
+	          file_expand_signature(file), credit);
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE file_add_stream_credit(File *file, uint32_t credit) {
+	APIE error_code;
+
+	if (!file->streaming) {
+		log_warn("Cannot add stream credit to non-streaming file object ("FILE_SIGNATURE_FORMAT")",
+		         file_expand_signature(file));
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	file->stream_credit += credit;
+
+	error_code = file_start_stream_reading(file);
+
+	if (error_code != API_E_SUCCESS) {
+		file->stream_credit -= credit;
+
+		return error_code;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE file_stop_stream(File *file) {
+	if (file->streaming) {
+		file_end_stream(file);
+
+		log_debug("Stopped streaming file object ("FILE_SIGNATURE_FORMAT")",
+		          file_expand_signature(file));
+	}
+
+	return API_E_SUCCESS;
+}
+
 IOHandle file_get_read_handle(File *file) {
 	if (file->type == FILE_TYPE_PIPE) {
 		return file->pipe.read_end;
@@ -1466,12 +2657,51 @@ IOHandle file_get_read_handle(File *file) {
 	}
 }
 
+// writes through the returned handle are not tracked. the end of the written
+// data is unknown from now on, therefore a file extended by a size hint is not
+// truncated on close anymore
 IOHandle file_get_write_handle(File *file) {
 	if (file->type == FILE_TYPE_PIPE) {
 		return file->pipe.write_end;
-	} else {
-		return file->fd;
 	}
+
+	if (file->truncate_on_close) {
+		log_debug("Not truncating file object ("FILE_SIGNATURE_FORMAT") on close, its write handle is shared",
+		          file_expand_signature(file));
+
+		file->truncate_on_close = false;
+	}
+
+	file->write_handle_shared = true;
+
+	return file->fd;
+}
+
+// truncating a regular file to its current length frees the space that a size
+// hint with FILE_SIZE_HINT_FLAG_KEEP_SIZE preallocated beyond its end
+void file_release_preallocation(File *file) {
+	struct stat st;
+
+	if (file->type != FILE_TYPE_REGULAR) {
+		return;
+	}
+
+	if (fstat(file->fd, &st) < 0) {
+		log_warn("Could not get information for file object ("FILE_SIGNATURE_FORMAT"): %s (%d)",
+		         file_expand_signature(file), get_errno_name(errno), errno);
+
+		return;
+	}
+
+	if (ftruncate(file->fd, st.st_size) < 0) {
+		log_warn("Could not release preallocated space of file object ("FILE_SIGNATURE_FORMAT"): %s (%d)",
+		         file_expand_signature(file), get_errno_name(errno), errno);
+
+		return;
+	}
+
+	log_debug("Released preallocated space of file object ("FILE_SIGNATURE_FORMAT")",
+	          file_expand_signature(file));
 }
 
 APIE file_get_acquired(ObjectID id, File **file) {
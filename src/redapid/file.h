@@ -28,8 +28,10 @@
 #include <daemonlib/io.h>
 #include <daemonlib/packet.h>
 #include <daemonlib/pipe.h>
+#include <daemonlib/timer.h>
 
 #include "object.h"
+#include "read_cache.h"
 #include "string.h"
 
 typedef enum { // bitmask
@@ -101,6 +103,18 @@ typedef enum { // bitmask
 #define FILE_EVENT_ALL (FILE_EVENT_READABLE | \
                         FILE_EVENT_WRITABLE)
 
+typedef enum { // bitmask
+	FILE_SIZE_HINT_FLAG_KEEP_SIZE = 0x0001 // preallocate without changing the file length
+} FileSizeHintFlag;
+
+#define FILE_SIZE_HINT_FLAG_ALL FILE_SIZE_HINT_FLAG_KEEP_SIZE
+
+typedef enum { // bitmask
+	FILE_STAT_FLAG_FOLLOW_SYMLINKS = 0x0001 // report the symlink target instead of the symlink
+} FileStatFlag;
+
+#define FILE_STAT_FLAG_ALL FILE_STAT_FLAG_FOLLOW_SYMLINKS
+
 typedef enum {
 	FILE_TYPE_UNKNOWN = 0,
 	FILE_TYPE_REGULAR,
@@ -119,6 +133,15 @@ typedef enum {
 #define FILE_MAX_WRITE_UNCHECKED_BUFFER_LENGTH 61
 #define FILE_MAX_WRITE_ASYNC_BUFFER_LENGTH 61
 
+#define FILE_MAX_WRITE_WINDOW_ACKNOWLEDGE_INTERVAL 10000 // milliseconds
+
+#define FILE_MAX_STREAM_CHUNKS_PER_EVENT 16
+
+#define FILE_MIN_COMPRESSION_BLOCK_LENGTH 256
+#define FILE_MAX_COMPRESSION_BLOCK_LENGTH 65536
+
+#define FILE_STAT_PATHS_BATCH_LENGTH 16 // paths per event loop iteration
+
 typedef struct _File File;
 
 typedef int (*FileReadFunction)(File *file, void *buffer, int length);
@@ -133,12 +156,34 @@ struct _File {
 	uint32_t flags; // refers to PipeFlag if type == FILE_TYPE_PIPE,
 	                // refers to FileFlag otherwise
 	uint16_t events;
+	bool streaming; // pipe is read by redapid and pushed to the client, only if type == FILE_TYPE_PIPE
+	bool stream_reading; // read end is an event source, only while stream_credit > 0
+	uint64_t stream_credit; // bytes the client is still willing to receive
 	IOHandle fd; // only opened if type != FILE_TYPE_PIPE
 	Pipe pipe; // only created if type == FILE_TYPE_PIPE
 	IOHandle async_read_eventfd;
 	Pipe async_read_pipe; // only created if type == FILE_TYPE_REGULAR
 	bool async_read_in_progress;
 	uint64_t length_to_read_async;
+	uint32_t async_read_block_length; // 0 if async read is uncompressed
+	uint8_t *async_read_block; // compressed block header and data
+	int async_read_block_used;
+	int async_read_block_offset;
+	uint8_t *compressed_write_block; // compressed block header and data
+	int compressed_write_block_used;
+	uint32_t write_window_acknowledge_length; // 0 if async writes are acknowledged individually
+	uint16_t write_window_acknowledge_interval; // milliseconds
+	uint64_t write_window_length_written; // contiguous bytes written since the window was set
+	uint64_t write_window_length_acknowledged;
+	APIE write_window_error_code; // once set all further async writes are dropped
+	Timer write_window_timer; // only created if write_window_acknowledge_length > 0
+	bool write_window_timer_armed;
+	bool truncate_on_close; // set if a size hint without FILE_SIZE_HINT_FLAG_KEEP_SIZE extended the file
+	uint64_t truncate_length; // end of the written data
+	bool write_handle_shared; // writes through the shared handle bypass truncate_length tracking
+	dev_t device; // only valid if type != FILE_TYPE_PIPE
+	ino_t inode; // only valid if type != FILE_TYPE_PIPE
+	ReadCacheEntry *read_cache_entry; // only used for read-only regular files
 	FileWriteFunction read;
 	FileWriteFunction write;
 	FileSeekFunction seek;
@@ -153,6 +198,8 @@ APIE file_open(ObjectID name_id, uint32_t flags, uint16_t permissions,
 APIE pipe_create_(uint32_t flags, uint64_t length, Session *session,
                   uint16_t object_create_flags, ObjectID *id, File **object);
 
+APIE file_stat_paths(ObjectID names_list_id, uint16_t flags);
+
 APIE file_get_info(File *file, Session *session, uint8_t *type,
                    ObjectID *name_id, uint32_t *flags,
                    uint16_t *permissions, uint32_t *uid, uint32_t *gid,
@@ -163,22 +210,34 @@ APIE file_get_info(File *file, Session *session, uint8_t *type,
 APIE file_read(File *file, uint8_t *buffer, uint8_t length_to_read,
                uint8_t *length_read);
 PacketE file_read_async(File *file, uint64_t length_to_read);
+PacketE file_read_async_compressed(File *file, uint64_t length_to_read,
+                                   uint32_t block_length);
 APIE file_abort_async_read(File *file);
 
 APIE file_write(File *file, uint8_t *buffer, uint8_t length_to_write,
                 uint8_t *length_written);
 PacketE file_write_unchecked(File *file, uint8_t *buffer, uint8_t length_to_write);
 PacketE file_write_async(File *file, uint8_t *buffer, uint8_t length_to_write);
+PacketE file_write_async_compressed(File *file, uint8_t *buffer, uint8_t length_to_write);
+APIE file_set_write_window(File *file, uint32_t acknowledge_length,
+                           uint16_t acknowledge_interval);
 
 APIE file_set_position(File *file, int64_t offset, FileOrigin origin,
                        uint64_t *position);
 APIE file_get_position(File *file, uint64_t *position);
 
+APIE file_set_size_hint(File *file, uint64_t length, uint16_t flags);
+
 APIE file_set_events(File *file, uint16_t events);
 APIE file_get_events(File *file, uint16_t *events);
 
+APIE file_start_stream(File *file, uint32_t credit);
+APIE file_add_stream_credit(File *file, uint32_t credit);
+APIE file_stop_stream(File *file);
+
 IOHandle file_get_read_handle(File *file);
 IOHandle file_get_write_handle(File *file);
+void file_release_preallocation(File *file);
 
 APIE file_get_acquired(ObjectID id, File **file);
 
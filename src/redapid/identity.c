@@ -0,0 +1,560 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * identity.c: User and group identity handling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * identity_run_as executes file system operations with the permissions of
+ * another user without forking. on Linux the credentials are a property of
+ * the thread, not of the process. a dedicated thread switches its file system
+ * user and group ID with setfsuid/setfsgid and its secondary groups with the
+ * raw setgroups syscall, runs the operation and switches back. the glibc
+ * setgroups function cannot be used here, because it changes the groups of
+ * all threads of the process.
+ *
+ * the caller blocks until the operation is done. only the event loop thread
+ * calls identity_run_as, so there is at most one pending operation at a time.
+ *
+ * user names, primary groups and secondary groups are cached, so that not
+ * every spawn and file operation has to parse /etc/passwd and /etc/group. an
+ * inotify watch on /etc, added through the watch subsystem, clears the cache
+ * whenever one of these files changes.
+ * the cache is only accessed by the event loop thread. if the watch cannot be
+ * added then nothing is cached.
+ */
+
+#define _GNU_SOURCE // for getgrouplist from grp.h
+
+#include <errno.h>
+#include <grp.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/fsuid.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <daemonlib/array.h>
+#include <daemonlib/log.h>
+#include <daemonlib/threads.h>
+#include <daemonlib/utils.h>
+
+#include "identity.h"
+
+#include "api.h"
+#include "watch.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+// the 16-bit ID syscalls cannot represent all user and group IDs on ARM
+#ifdef SYS_setgroups32
+	#define IDENTITY_SYS_SETGROUPS SYS_setgroups32
+	#define IDENTITY_SYS_SETREUID SYS_setreuid32
+	#define IDENTITY_SYS_SETREGID SYS_setregid32
+#else
+	#define IDENTITY_SYS_SETGROUPS SYS_setgroups
+	#define IDENTITY_SYS_SETREUID SYS_setreuid
+	#define IDENTITY_SYS_SETREGID SYS_setregid
+#endif
+
+#define IDENTITY_INITIAL_GROUP_COUNT 32 // grown as needed by getgrouplist
+
+typedef struct {
+	uid_t uid;
+	gid_t gid; // primary group
+	char *name;
+	gid_t *groups; // primary and secondary groups
+	int group_count;
+} IdentityUser;
+
+typedef struct {
+	uid_t uid;
+	gid_t gid;
+	const gid_t *groups; // owned by the user cache
+	int group_count;
+	IdentityFunction function;
+	void *opaque;
+	APIE error_code;
+} IdentityOperation;
+
+static Thread _thread;
+static Semaphore _request;
+static Semaphore _response;
+static volatile bool _running = false;
+static IdentityOperation _operation;
+static gid_t *_original_groups = NULL;
+static int _original_group_count;
+static Array _users;
+static int _etc_wd = -1; // -1 if the user cache is disabled
+
+static void identity_destroy_user(void *item) {
+	IdentityUser *user = item;
+
+	free(user->groups);
+	free(user->name);
+}
+
+static void identity_clear_users(void) {
+	if (_users.count > 0) {
+		log_debug("Clearing user cache (count: %d)", _users.count);
+	}
+
+	while (_users.count > 0) {
+		array_remove(&_users, _users.count - 1, identity_destroy_user);
+	}
+}
+
+static void identity_handle_inotify(int wd, uint32_t mask, const char *name,
+                                    void *opaque) {
+	(void)wd;
+	(void)opaque;
+
+	// the kernel removed the inotify watch, changes cannot be noticed anymore
+	if ((mask & IN_IGNORED) != 0) {
+		log_warn("Inotify watch for '/etc' got removed, disabling user cache");
+
+		_etc_wd = -1;
+	}
+
+	// name is NULL if some events got lost, one of them might have been relevant
+	if (name == NULL || strcmp(name, "passwd") == 0 || strcmp(name, "group") == 0) {
+		identity_clear_users();
+	}
+}
+
+// sets errno on error
+static IdentityUser *identity_add_user(struct passwd *pw) {
+	IdentityUser *user;
+	gid_t *groups;
+	int length = IDENTITY_INITIAL_GROUP_COUNT;
+	int previous_length;
+
+	groups = malloc(length * sizeof(gid_t));
+
+	if (groups == NULL) {
+		errno = ENOMEM;
+
+		return NULL;
+	}
+
+	// getgrouplist reports the required length if the array is too short
+	for (;;) {
+		previous_length = length;
+
+		if (getgrouplist(pw->pw_name, pw->pw_gid, groups, &length) >= 0) {
+			break;
+		}
+
+		if (length <= previous_length) {
+			free(groups);
+
+			errno = ENOENT;
+
+			return NULL;
+		}
+
+		free(groups);
+
+		groups = malloc(length * sizeof(gid_t));
+
+		if (groups == NULL) {
+			errno = ENOMEM;
+
+			return NULL;
+		}
+	}
+
+	user = array_append(&_users);
+
+	if (user == NULL) {
+		free(groups);
+
+		return NULL;
+	}
+
+	user->name = strdup(pw->pw_name);
+
+	if (user->name == NULL) {
+		array_remove(&_users, _users.count - 1, NULL);
+		free(groups);
+
+		errno = ENOMEM;
+
+		return NULL;
+	}
+
+	user->uid = pw->pw_uid;
+	user->gid = pw->pw_gid;
+	user->groups = groups;
+	user->group_count = length;
+
+	return user;
+}
+
+// sets errno on error. without inotify watch the cache only holds the
+// looked-up user until the next lookup
+static IdentityUser *identity_lookup_uid(uid_t uid) {
+	int i;
+	IdentityUser *user;
+	struct passwd *pw;
+
+	if (_etc_wd < 0) {
+		identity_clear_users();
+	}
+
+	for (i = 0; i < _users.count; ++i) {
+		user = array_get(&_users, i);
+
+		if (user->uid == uid) {
+			return user;
+		}
+	}
+
+	errno = 0; // getpwuid doesn't set errno if the user doesn't exist
+	pw = getpwuid(uid);
+
+	if (pw == NULL) {
+		if (errno == 0) {
+			errno = ENOENT;
+		}
+
+		return NULL;
+	}
+
+	return identity_add_user(pw);
+}
+
+// sets errno on error
+static IdentityUser *identity_lookup_name(const char *name) {
+	int i;
+	IdentityUser *user;
+	struct passwd *pw;
+
+	if (_etc_wd < 0) {
+		identity_clear_users();
+	}
+
+	for (i = 0; i < _users.count; ++i) {
+		user = array_get(&_users, i);
+
+		if (strcmp(user->name, name) == 0) {
+			return user;
+		}
+	}
+
+	errno = 0; // getpwnam doesn't set errno if the user doesn't exist
+	pw = getpwnam(name);
+
+	if (pw == NULL) {
+		if (errno == 0) {
+			errno = ENOENT;
+		}
+
+		return NULL;
+	}
+
+	return identity_add_user(pw);
+}
+
+static APIE identity_switch(IdentityOperation *operation) {
+	APIE error_code;
+
+	if (identity_set_thread_groups(operation->group_count, operation->groups) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not set secondary group IDs of user ID %u: %s (%d)",
+		          operation->uid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	// setfsgid and setfsuid don't report errors, but they return the current
+	// ID on a second call
+	setfsgid(operation->gid);
+
+	if ((gid_t)setfsgid(operation->gid) != operation->gid) {
+		log_error("Could not change file system group ID to %u", operation->gid);
+
+		return API_E_ACCESS_DENIED;
+	}
+
+	setfsuid(operation->uid);
+
+	if ((uid_t)setfsuid(operation->uid) != operation->uid) {
+		log_error("Could not change file system user ID to %u", operation->uid);
+
+		return API_E_ACCESS_DENIED;
+	}
+
+	return API_E_SUCCESS;
+}
+
+static void identity_restore(void) {
+	uid_t uid = geteuid();
+	gid_t gid = getegid();
+
+	setfsuid(uid);
+
+	if ((uid_t)setfsuid(uid) != uid) {
+		log_error("Could not restore file system user ID to %u", uid);
+	}
+
+	setfsgid(gid);
+
+	if ((gid_t)setfsgid(gid) != gid) {
+		log_error("Could not restore file system group ID to %u", gid);
+	}
+
+	if (identity_set_thread_groups(_original_group_count, _original_groups) < 0) {
+		log_error("Could not restore secondary group IDs: %s (%d)",
+		          get_errno_name(errno), errno);
+	}
+}
+
+static void identity_handle_operations(void *opaque) {
+	(void)opaque;
+
+	for (;;) {
+		semaphore_acquire(&_request);
+
+		if (!_running) {
+			break;
+		}
+
+		_operation.error_code = identity_switch(&_operation);
+
+		if (_operation.error_code == API_E_SUCCESS) {
+			_operation.error_code = _operation.function(_operation.opaque);
+		}
+
+		identity_restore();
+
+		semaphore_release(&_response);
+	}
+}
+
+int identity_init(void) {
+	int phase = 0;
+
+	log_debug("Initializing identity subsystem");
+
+	_original_group_count = getgroups(0, NULL);
+
+	if (_original_group_count < 0) {
+		log_error("Could not get secondary group ID count: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	// allocate at least one item, malloc(0) might return NULL
+	_original_groups = calloc(_original_group_count + 1, sizeof(gid_t));
+
+	if (_original_groups == NULL) {
+		log_error("Could not allocate secondary group ID array: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	_original_group_count = getgroups(_original_group_count, _original_groups);
+
+	if (_original_group_count < 0) {
+		log_error("Could not get secondary group IDs: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	if (array_create(&_users, 8, sizeof(IdentityUser), true) < 0) {
+		log_error("Could not create user cache array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	// watch /etc instead of the files themselves, tools like useradd replace
+	// /etc/passwd and /etc/group by renaming a new file over them
+	_etc_wd = watch_add_inotify_watch("/etc", IN_ONLYDIR, identity_handle_inotify, NULL);
+
+	if (_etc_wd < 0) {
+		log_warn("Could not add inotify watch for '/etc', disabling user cache: %s (%d)",
+		         get_errno_name(errno), errno);
+	}
+
+	phase = 3;
+
+	if (semaphore_create(&_request) < 0) {
+		log_error("Could not create identity request semaphore: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 4;
+
+	if (semaphore_create(&_response) < 0) {
+		log_error("Could not create identity response semaphore: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 5;
+
+	_running = true;
+
+	thread_create(&_thread, identity_handle_operations, NULL);
+
+	phase = 6;
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 5:
+		semaphore_destroy(&_response);
+
+	case 4:
+		semaphore_destroy(&_request);
+
+	case 3:
+		if (_etc_wd >= 0) {
+			watch_remove_inotify_watch(_etc_wd, identity_handle_inotify, NULL);
+
+			_etc_wd = -1;
+		}
+
+	case 2:
+		array_destroy(&_users, identity_destroy_user);
+
+	case 1:
+		free(_original_groups);
+
+	default:
+		break;
+	}
+
+	return phase == 6 ? 0 : -1;
+}
+
+void identity_exit(void) {
+	log_debug("Shutting down identity subsystem");
+
+	_running = false;
+
+	semaphore_release(&_request);
+
+	thread_join(&_thread);
+	thread_destroy(&_thread);
+
+	semaphore_destroy(&_response);
+	semaphore_destroy(&_request);
+
+	if (_etc_wd >= 0) {
+		watch_remove_inotify_watch(_etc_wd, identity_handle_inotify, NULL);
+	}
+
+	array_destroy(&_users, identity_destroy_user);
+	free(_original_groups);
+}
+
+// groups stays valid until control returns to the event loop, or until the
+// next lookup if the cache is disabled. resolve them before forking, getpwuid
+// cannot be used in a child process
+APIE identity_get_groups(uid_t uid, const gid_t **groups, int *length) {
+	APIE error_code;
+	IdentityUser *user;
+
+	user = identity_lookup_uid(uid);
+
+	if (user == NULL) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get groups for user ID %u: %s (%d)",
+		          uid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	*groups = user->groups;
+	*length = user->group_count;
+
+	return API_E_SUCCESS;
+}
+
+// sets errno on error
+int identity_get_uid(const char *name, uid_t *uid) {
+	IdentityUser *user = identity_lookup_name(name);
+
+	if (user == NULL) {
+		return -1;
+	}
+
+	*uid = user->uid;
+
+	return 0;
+}
+
+// runs function with the file system permissions of uid and gid, it has to
+// use file system operations only and report errors as APIE
+APIE identity_run_as(uid_t uid, gid_t gid, IdentityFunction function, void *opaque) {
+	APIE error_code;
+
+	if (geteuid() == uid && getegid() == gid) {
+		return function(opaque);
+	}
+
+	// resolve groups here, getpwuid is not thread-safe and the user cache is
+	// only accessed by the event loop thread
+	error_code = identity_get_groups(uid, &_operation.groups, &_operation.group_count);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	_operation.uid = uid;
+	_operation.gid = gid;
+	_operation.function = function;
+	_operation.opaque = opaque;
+
+	semaphore_release(&_request);
+	semaphore_acquire(&_response);
+
+	return _operation.error_code;
+}
+
+// the glibc functions to change IDs and groups change all threads of the
+// process. the following functions only change the calling thread. they are
+// also safe to use in a child process that shares memory with redapid
+int identity_set_thread_groups(int length, const gid_t *groups) {
+	return syscall(IDENTITY_SYS_SETGROUPS, length, groups);
+}
+
+int identity_set_thread_uid(uid_t uid) {
+	return syscall(IDENTITY_SYS_SETREUID, uid, uid);
+}
+
+int identity_set_thread_gid(gid_t gid) {
+	return syscall(IDENTITY_SYS_SETREGID, gid, gid);
+}
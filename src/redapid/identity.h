@@ -0,0 +1,43 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * identity.h: User and group identity handling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_IDENTITY_H
+#define REDAPID_IDENTITY_H
+
+#include <sys/types.h>
+
+#include "api_error.h"
+
+typedef APIE (*IdentityFunction)(void *opaque);
+
+int identity_init(void);
+void identity_exit(void);
+
+APIE identity_get_groups(uid_t uid, const gid_t **groups, int *length);
+int identity_get_uid(const char *name, uid_t *uid);
+
+int identity_set_thread_groups(int length, const gid_t *groups);
+int identity_set_thread_uid(uid_t uid);
+int identity_set_thread_gid(gid_t gid);
+
+APIE identity_run_as(uid_t uid, gid_t gid, IdentityFunction function, void *opaque);
+
+#endif // REDAPID_IDENTITY_H
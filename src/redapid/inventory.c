@@ -57,7 +57,7 @@ static char _programs_directory[1024]; // <home>/programs
 static SessionID _next_session_id = 1; // don't use session ID zero
 static Array _sessions;
 static ObjectID _next_object_id = 1; // don't use object ID zero
-static Array _objects[OBJECT_TYPE_PROGRAM - OBJECT_TYPE_STRING + 1];
+static Array _objects[OBJECT_TYPE_WATCH - OBJECT_TYPE_STRING + 1];
 static Array _stock_strings;
 
 static void inventory_destroy_session(void *item) {
@@ -131,7 +131,7 @@ static APIE inventory_get_next_object_id(ObjectID *id) {
 		candidate = _next_object_id++;
 		collision = false;
 
-		for (type = OBJECT_TYPE_STRING; type <= OBJECT_TYPE_PROGRAM; ++type) {
+		for (type = OBJECT_TYPE_STRING; type <= OBJECT_TYPE_WATCH; ++type) {
 			for (k = 0; k < _objects[type].count; ++k) {
 				object = *(Object **)array_get(&_objects[type], k);
 
@@ -193,7 +193,7 @@ int inventory_init(void) {
 	phase = 1;
 
 	// create object arrays
-	for (type = OBJECT_TYPE_STRING; type <= OBJECT_TYPE_PROGRAM; ++type) {
+	for (type = OBJECT_TYPE_STRING; type <= OBJECT_TYPE_WATCH; ++type) {
 		if (array_create(&_objects[type], 32, sizeof(Object *), true) < 0) {
 			log_error("Could not create %s object array: %s (%d)",
 			          object_get_type_name(type), get_errno_name(errno), errno);
@@ -249,12 +249,14 @@ void inventory_exit(void) {
 	// when type A objects try to release them
 	//
 	// there are the following relationships:
+	// - watch uses string
 	// - program uses process, list and string
 	// - process uses file, list and string
 	// - directory uses string
 	// - file uses string
 	// - list can contain any object as item, currently only string is used
 	// - string doesn't use other objects
+	array_destroy(&_objects[OBJECT_TYPE_WATCH], inventory_destroy_object);
 	array_destroy(&_objects[OBJECT_TYPE_PROGRAM], inventory_destroy_object);
 	array_destroy(&_objects[OBJECT_TYPE_PROCESS], inventory_destroy_object);
 	array_destroy(&_objects[OBJECT_TYPE_DIRECTORY], inventory_destroy_object);
@@ -547,7 +549,7 @@ APIE inventory_get_object(ObjectType type, ObjectID id, Object **object) {
 
 	if (type == OBJECT_TYPE_ANY) {
 		start_type = OBJECT_TYPE_STRING;
-		end_type = OBJECT_TYPE_PROGRAM;
+		end_type = OBJECT_TYPE_WATCH;
 	} else {
 		start_type = type;
 		end_type = type;
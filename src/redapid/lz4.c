@@ -0,0 +1,272 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * lz4.c: LZ4 block format compression
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * a small and dependency-free implementation of the LZ4 block format. the
+ * output can be decompressed by every LZ4 block decoder (e.g. LZ4_decompress_safe
+ * or lz4.block.decompress in Python) and vice versa. the compressor is a simple
+ * greedy single-probe matcher. it doesn't reach the ratio of the reference
+ * implementation, but it is fast enough to keep up with the RED Brick's USB
+ * bandwidth and the output is valid LZ4 all the same.
+ *
+ * a block is a sequence of:
+ *
+ *   token:        upper 4 bits literal length, lower 4 bits match length - 4
+ *   [length]:     literal length continuation, 255 bytes until not 255
+ *   literals:     literal length bytes
+ *   offset:       uint16_t little endian, 1 to 65535
+ *   [length]:     match length continuation, 255 bytes until not 255
+ *
+ * the last sequence only contains literals. the last 5 bytes of a block are
+ * always literals and the last match has to start at least 12 bytes before
+ * the end of the block.
+ */
+
+#include <string.h>
+
+#include "lz4.h"
+
+#define MIN_MATCH_LENGTH 4
+#define LAST_LITERALS_LENGTH 5
+#define MATCH_FIND_LIMIT 12
+#define MAX_OFFSET 65535
+#define HASH_BITS 12
+
+static uint32_t lz4_read32(uint8_t *p) {
+	uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+static int lz4_hash(uint32_t sequence) {
+	return (int)((sequence * 2654435761U) >> (32 - HASH_BITS));
+}
+
+static int lz4_write_length(uint8_t *target, int offset, int length) {
+	while (length >= 255) {
+		target[offset++] = 255;
+		length -= 255;
+	}
+
+	target[offset++] = (uint8_t)length;
+
+	return offset;
+}
+
+// returns the new target offset or -1 if the sequence doesn't fit. if match
+// length is 0 then a literals-only sequence is written
+static int lz4_write_sequence(uint8_t *source, int literal_start, int literal_length,
+                              int match_offset, int match_length,
+                              uint8_t *target, int target_offset, int target_length) {
+	int required = 1 + literal_length + literal_length / 255 + 1;
+	int token_offset;
+	uint8_t token;
+
+	if (match_length > 0) {
+		required += 2 + (match_length - MIN_MATCH_LENGTH) / 255 + 1;
+	}
+
+	if (target_offset + required > target_length) {
+		return -1;
+	}
+
+	token_offset = target_offset++;
+
+	if (literal_length >= 15) {
+		token = 15 << 4;
+		target_offset = lz4_write_length(target, target_offset, literal_length - 15);
+	} else {
+		token = (uint8_t)(literal_length << 4);
+	}
+
+	memcpy(target + target_offset, source + literal_start, literal_length);
+	target_offset += literal_length;
+
+	if (match_length > 0) {
+		target[target_offset++] = match_offset & 0xFF;
+		target[target_offset++] = (match_offset >> 8) & 0xFF;
+
+		match_length -= MIN_MATCH_LENGTH;
+
+		if (match_length >= 15) {
+			token |= 15;
+			target_offset = lz4_write_length(target, target_offset, match_length - 15);
+		} else {
+			token |= (uint8_t)match_length;
+		}
+	}
+
+	target[token_offset] = token;
+
+	return target_offset;
+}
+
+// public API
+// returns the compressed length or -1 if the compressed block doesn't fit
+// into target_length bytes
+int lz4_compress_block(uint8_t *source, int source_length,
+                       uint8_t *target, int target_length) {
+	int table[1 << HASH_BITS];
+	int i;
+	int anchor = 0;
+	int position = 0;
+	int target_offset = 0;
+	int match_find_end = source_length - MATCH_FIND_LIMIT;
+	int match_end = source_length - LAST_LITERALS_LENGTH;
+	uint32_t sequence;
+	int hash;
+	int reference;
+	int match_length;
+
+	if (source_length > LZ4_MAX_BLOCK_LENGTH) {
+		return -1;
+	}
+
+	for (i = 0; i < 1 << HASH_BITS; ++i) {
+		table[i] = -1;
+	}
+
+	while (position < match_find_end) {
+		sequence = lz4_read32(source + position);
+		hash = lz4_hash(sequence);
+		reference = table[hash];
+		table[hash] = position;
+
+		if (reference < 0 || position - reference > MAX_OFFSET ||
+		    lz4_read32(source + reference) != sequence) {
+			++position;
+
+			continue;
+		}
+
+		match_length = MIN_MATCH_LENGTH;
+
+		while (position + match_length < match_end &&
+		       source[reference + match_length] == source[position + match_length]) {
+			++match_length;
+		}
+
+		target_offset = lz4_write_sequence(source, anchor, position - anchor,
+		                                   position - reference, match_length,
+		                                   target, target_offset, target_length);
+
+		if (target_offset < 0) {
+			return -1;
+		}
+
+		position += match_length;
+		anchor = position;
+	}
+
+	return lz4_write_sequence(source, anchor, source_length - anchor, 0, 0,
+	                          target, target_offset, target_length);
+}
+
+// public API
+// returns the decompressed length or -1 if the block is malformed or doesn't
+// fit into target_length bytes
+int lz4_decompress_block(uint8_t *source, int source_length,
+                         uint8_t *target, int target_length) {
+	int source_offset = 0;
+	int target_offset = 0;
+	uint8_t token;
+	uint8_t byte;
+	int literal_length;
+	int match_offset;
+	int match_length;
+
+	while (source_offset < source_length) {
+		token = source[source_offset++];
+		literal_length = token >> 4;
+
+		if (literal_length == 15) {
+			do {
+				if (source_offset >= source_length) {
+					return -1;
+				}
+
+				byte = source[source_offset++];
+				literal_length += byte;
+
+				if (literal_length > target_length) {
+					return -1;
+				}
+			} while (byte == 255);
+		}
+
+		if (literal_length > source_length - source_offset ||
+		    literal_length > target_length - target_offset) {
+			return -1;
+		}
+
+		memcpy(target + target_offset, source + source_offset, literal_length);
+
+		source_offset += literal_length;
+		target_offset += literal_length;
+
+		if (source_offset == source_length) {
+			break; // last sequence contains literals only
+		}
+
+		if (source_length - source_offset < 2) {
+			return -1;
+		}
+
+		match_offset = source[source_offset] | (source[source_offset + 1] << 8);
+		source_offset += 2;
+
+		if (match_offset == 0 || match_offset > target_offset) {
+			return -1;
+		}
+
+		match_length = token & 0x0F;
+
+		if (match_length == 15) {
+			do {
+				if (source_offset >= source_length) {
+					return -1;
+				}
+
+				byte = source[source_offset++];
+				match_length += byte;
+
+				if (match_length > target_length) {
+					return -1;
+				}
+			} while (byte == 255);
+		}
+
+		match_length += MIN_MATCH_LENGTH;
+
+		if (match_length > target_length - target_offset) {
+			return -1;
+		}
+
+		// source and target of the copy might overlap, copy byte by byte
+		for (; match_length > 0; --match_length, ++target_offset) {
+			target[target_offset] = target[target_offset - match_offset];
+		}
+	}
+
+	return target_offset;
+}
@@ -0,0 +1,36 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * lz4.h: LZ4 block format compression
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_LZ4_H
+#define REDAPID_LZ4_H
+
+#include <stdint.h>
+
+#define LZ4_MAX_BLOCK_LENGTH 65536
+
+#define lz4_get_max_compressed_length(length) ((length) + (length) / 255 + 16)
+
+int lz4_compress_block(uint8_t *source, int source_length,
+                       uint8_t *target, int target_length);
+int lz4_decompress_block(uint8_t *source, int source_length,
+                         uint8_t *target, int target_length);
+
+#endif // REDAPID_LZ4_H
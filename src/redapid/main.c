@@ -39,11 +39,20 @@
 #include <daemonlib/utils.h>
 
 #include "api.h"
+#include "cgroup.h"
 #include "cron.h"
+#include "delta.h"
+#include "disk_usage.h"
+#include "identity.h"
 #include "inventory.h"
+#include "manifest.h"
 #include "network.h"
+#include "process.h"
 #include "process_monitor.h"
+#include "purge.h"
+#include "read_cache.h"
 #include "version.h"
+#include "watch.h"
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
@@ -340,6 +349,10 @@ int main(int argc, char **argv) {
 		goto error_signal;
 	}
 
+	if (process_init() < 0) {
+		goto error_process;
+	}
+
 	if (process_monitor_init() < 0) {
 		goto error_process_monitor;
 	}
@@ -348,10 +361,42 @@ int main(int argc, char **argv) {
 		goto error_cron;
 	}
 
+	if (watch_init() < 0) {
+		goto error_watch;
+	}
+
+	if (read_cache_init() < 0) {
+		goto error_read_cache;
+	}
+
+	if (disk_usage_init() < 0) {
+		goto error_disk_usage;
+	}
+
+	if (purge_init() < 0) {
+		goto error_purge;
+	}
+
+	if (identity_init() < 0) {
+		goto error_identity;
+	}
+
+	if (cgroup_init() < 0) {
+		goto error_cgroup;
+	}
+
 	if (inventory_init() < 0) {
 		goto error_inventory;
 	}
 
+	if (manifest_init() < 0) {
+		goto error_manifest;
+	}
+
+	if (delta_init() < 0) {
+		goto error_delta;
+	}
+
 	if (api_init() < 0) {
 		goto error_api;
 	}
@@ -380,15 +425,42 @@ error_network:
 	api_exit();
 
 error_api:
+	delta_exit();
+
+error_delta:
+	manifest_exit();
+
+error_manifest:
 	inventory_exit();
 
 error_inventory:
+	cgroup_exit();
+
+error_cgroup:
+	identity_exit();
+
+error_identity:
+	purge_exit();
+
+error_purge:
+	disk_usage_exit();
+
+error_disk_usage:
+	read_cache_exit();
+
+error_read_cache:
+	watch_exit();
+
+error_watch:
 	cron_exit();
 
 error_cron:
 	process_monitor_exit();
 
 error_process_monitor:
+	process_exit();
+
+error_process:
 	signal_exit();
 
 error_signal:
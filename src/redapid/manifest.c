@@ -0,0 +1,1313 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * manifest.c: Directory manifest creation and comparison
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * a manifest lists all entries of a directory tree, sorted by their path
+ * relative to the directory. a client syncing a local tree to the RED Brick
+ * creates a manifest of its local tree and lets redapid compare it to the
+ * remote tree. the result only contains the paths that differ.
+ *
+ * the manifest is line based text, because the client can pass it as string
+ * object and string objects cannot contain NULL bytes. numbers are hex to
+ * keep it compact:
+ *
+ *   <type> <length> <modification_timestamp> <hash> <path>\n
+ *
+ * type is a DirectoryEntryType in decimal, the other numbers are lowercase
+ * hex. the length of a directory is 0. hash is the 64-bit FNV-1a hash of
+ * the content of a regular file or - if there is none. in path a backslash
+ * is escaped as \\ and a newline as \n. the diff has one line per change:
+ *
+ *   <change> <path>\n
+ *
+ * change is a ManifestChange in decimal. if both sides have a regular file
+ * with the same length then the content hash is compared if the given
+ * manifest has one, otherwise the modification timestamp is compared.
+ *
+ * collecting, hashing and comparing the tree can take a while. therefore each
+ * request is processed by a job on a separate thread. the thread streams the
+ * output through a pipe to the event loop, that writes it to the file object
+ * and reports the outcome by a directory-manifest-written callback. the pipe
+ * limits the amount of output buffered ahead of the file.
+ */
+
+#define _GNU_SOURCE // for O_CLOEXEC from fcntl.h
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <daemonlib/array.h>
+#include <daemonlib/event.h>
+#include <daemonlib/log.h>
+#include <daemonlib/pipe.h>
+#include <daemonlib/threads.h>
+#include <daemonlib/utils.h>
+
+#include "manifest.h"
+
+#include "api.h"
+#include "directory.h"
+#include "file.h"
+#include "inventory.h"
+#include "string.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+#define MANIFEST_WRITE_BUFFER_LENGTH 4096
+#define MANIFEST_HASH_BUFFER_LENGTH 65536
+#define MANIFEST_MAX_LINE_PREFIX_LENGTH 64 // type, length, timestamp and hash
+#define MANIFEST_MAX_JOBS 4
+
+typedef struct {
+	char *path;
+	uint8_t type;
+	uint64_t length;
+	uint64_t modification_timestamp;
+	bool hash_valid;
+	uint64_t hash;
+} ManifestEntry;
+
+typedef struct {
+	bool diff; // diff_directory_manifest instead of get_directory_manifest
+	uint16_t flags;
+	char *name;
+	int root_fd;
+	File *file; // output
+	char *given_buffer; // copy of the given manifest string object
+	int given_length;
+	int given_fd; // duplicate of the given manifest file object, -1 if none
+	Pipe pipe;
+	Thread thread;
+	volatile bool aborted;
+	APIE error_code; // of the thread
+	uint32_t count; // entries or changes written by the thread
+	APIE write_error_code; // of writing the output to the file object
+	char buffer[MANIFEST_WRITE_BUFFER_LENGTH]; // only used by the thread
+	int used;
+	uint8_t hash_buffer[MANIFEST_HASH_BUFFER_LENGTH]; // only used by the thread
+} ManifestJob;
+
+static Array _jobs; // ManifestJob pointers
+
+static void manifest_destroy_entry(void *item) {
+	ManifestEntry *entry = item;
+
+	free(entry->path);
+}
+
+static int manifest_compare_entries(const void *a, const void *b) {
+	return strcmp(((const ManifestEntry *)a)->path, ((const ManifestEntry *)b)->path);
+}
+
+static APIE manifest_check_output_file(File *file) {
+	if (file->type != FILE_TYPE_REGULAR) {
+		log_warn("Cannot write manifest to non-regular file object (id: %u, name: %s)",
+		         file->base.id, file->name->buffer);
+
+		return API_E_NOT_SUPPORTED;
+	}
+
+	if (file->async_read_in_progress) {
+		log_warn("Cannot write manifest to file object (id: %u, name: %s) while reading %"PRIu64" byte(s) from it asynchronously",
+		         file->base.id, file->name->buffer, file->length_to_read_async);
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	// like write_file, writing to a regular file is only supported if it
+	// cannot block the event loop
+	if ((file->flags & FILE_FLAG_NON_BLOCKING) == 0) {
+		log_warn("Cannot write manifest to blocking file object (id: %u, name: %s)",
+		         file->base.id, file->name->buffer);
+
+		return API_E_NOT_SUPPORTED;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread
+static APIE manifest_flush(ManifestJob *job) {
+	int offset = 0;
+	int rc;
+
+	while (offset < job->used) {
+		if (job->aborted) {
+			return API_E_OPERATION_ABORTED;
+		}
+
+		// blocks if the pipe is full
+		rc = write(job->pipe.write_end, job->buffer + offset, job->used - offset);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			log_error("Could not write to manifest job pipe: %s (%d)",
+			          get_errno_name(errno), errno);
+
+			return API_E_INTERNAL_ERROR;
+		}
+
+		offset += rc;
+	}
+
+	job->used = 0;
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread
+static APIE manifest_write(ManifestJob *job, const char *buffer, int length) {
+	APIE error_code;
+	int chunk_length;
+
+	while (length > 0) {
+		if (job->used == MANIFEST_WRITE_BUFFER_LENGTH) {
+			error_code = manifest_flush(job);
+
+			if (error_code != API_E_SUCCESS) {
+				return error_code;
+			}
+		}
+
+		chunk_length = MIN(length, MANIFEST_WRITE_BUFFER_LENGTH - job->used);
+
+		memcpy(job->buffer + job->used, buffer, chunk_length);
+
+		job->used += chunk_length;
+		buffer += chunk_length;
+		length -= chunk_length;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread. writes the path escaped and terminates
+// the line
+static APIE manifest_write_path(ManifestJob *job, const char *path) {
+	APIE error_code;
+	const char *p;
+	const char *escape;
+
+	for (p = path; *p != '\0'; ++p) {
+		if (*p == '\\') {
+			escape = "\\\\";
+		} else if (*p == '\n') {
+			escape = "\\n";
+		} else {
+			continue;
+		}
+
+		error_code = manifest_write(job, path, p - path);
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+
+		error_code = manifest_write(job, escape, 2);
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+
+		path = p + 1;
+	}
+
+	error_code = manifest_write(job, path, p - path);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	return manifest_write(job, "\n", 1);
+}
+
+// only called from the job thread
+static APIE manifest_get_hash(ManifestJob *job, ManifestEntry *entry) {
+	APIE error_code;
+	int fd;
+	uint64_t hash = UINT64_C(14695981039346656037);
+	int rc;
+	int i;
+
+	if (entry->hash_valid) {
+		return API_E_SUCCESS;
+	}
+
+	fd = openat(job->root_fd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+	if (fd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not open '%s' to compute its hash: %s (%d)",
+		          entry->path, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	for (;;) {
+		if (job->aborted) {
+			close(fd);
+
+			return API_E_OPERATION_ABORTED;
+		}
+
+		rc = read(fd, job->hash_buffer, sizeof(job->hash_buffer));
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not read from '%s' to compute its hash: %s (%d)",
+			          entry->path, get_errno_name(errno), errno);
+
+			close(fd);
+
+			return error_code;
+		}
+
+		if (rc == 0) {
+			break;
+		}
+
+		for (i = 0; i < rc; ++i) {
+			hash ^= job->hash_buffer[i];
+			hash *= UINT64_C(1099511628211);
+		}
+	}
+
+	close(fd);
+
+	entry->hash_valid = true;
+	entry->hash = hash;
+
+	return API_E_SUCCESS;
+}
+
+static APIE manifest_append_entry(Array *entries, const char *path, uint8_t type,
+                                  uint64_t length, uint64_t modification_timestamp,
+                                  bool hash_valid, uint64_t hash) {
+	ManifestEntry *entry;
+	char *path_copy;
+
+	if (entries->count >= MANIFEST_MAX_ENTRY_COUNT) {
+		log_warn("Manifest exceeds maximum of %d entries", MANIFEST_MAX_ENTRY_COUNT);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	path_copy = strdup(path);
+
+	if (path_copy == NULL) {
+		log_error("Could not duplicate manifest entry path: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	entry = array_append(entries);
+
+	if (entry == NULL) {
+		log_error("Could not append to manifest entry array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		free(path_copy);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	entry->path = path_copy;
+	entry->type = type;
+	entry->length = length;
+	entry->modification_timestamp = modification_timestamp;
+	entry->hash_valid = hash_valid;
+	entry->hash = hash;
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread. takes ownership of fd. path has room for
+// MANIFEST_MAX_PATH_LENGTH + 1 bytes and contains the path of the directory
+// relative to the root
+static APIE manifest_collect(ManifestJob *job, int fd, char *path, int path_length,
+                             Array *entries) {
+	APIE error_code = API_E_SUCCESS;
+	DIR *dp;
+	struct dirent *dirent;
+	int name_length;
+	int entry_path_length;
+	struct stat st;
+	uint8_t type;
+	int child_fd;
+
+	dp = fdopendir(fd);
+
+	if (dp == NULL) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not open directory '%s': %s (%d)",
+		          path_length > 0 ? path : ".", get_errno_name(errno), errno);
+
+		close(fd);
+
+		return error_code;
+	}
+
+	for (;;) {
+		if (job->aborted) {
+			error_code = API_E_OPERATION_ABORTED;
+
+			break;
+		}
+
+		errno = 0;
+		dirent = readdir(dp);
+
+		if (dirent == NULL) {
+			if (errno != 0) {
+				error_code = api_get_error_code_from_errno();
+
+				log_error("Could not get next entry of directory '%s': %s (%d)",
+				          path_length > 0 ? path : ".", get_errno_name(errno), errno);
+			}
+
+			break;
+		}
+
+		if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+			continue;
+		}
+
+		name_length = strlen(dirent->d_name);
+		entry_path_length = path_length + (path_length > 0 ? 1 : 0) + name_length;
+
+		if (entry_path_length > MANIFEST_MAX_PATH_LENGTH) {
+			error_code = API_E_NAME_TOO_LONG;
+
+			log_warn("Path of entry '%s' in directory '%s' is too long for a manifest",
+			         dirent->d_name, path_length > 0 ? path : ".");
+
+			break;
+		}
+
+		if (path_length > 0) {
+			path[path_length] = '/';
+		}
+
+		memcpy(path + entry_path_length - name_length, dirent->d_name, name_length + 1);
+
+		if (fstatat(dirfd(dp), dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+			// the entry might have been removed in the meantime
+			log_debug("Could not get information for '%s', skipping it: %s (%d)",
+			          path, get_errno_name(errno), errno);
+
+			path[path_length] = '\0';
+
+			continue;
+		}
+
+		type = directory_get_entry_type_from_stat_mode(st.st_mode);
+		error_code = manifest_append_entry(entries, path, type,
+		                                   type == DIRECTORY_ENTRY_TYPE_DIRECTORY ? 0 : st.st_size,
+		                                   st.st_mtime, false, 0);
+
+		if (error_code != API_E_SUCCESS) {
+			break;
+		}
+
+		if (type == DIRECTORY_ENTRY_TYPE_DIRECTORY) {
+			child_fd = openat(dirfd(dp), dirent->d_name,
+			                  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+			if (child_fd < 0) {
+				error_code = api_get_error_code_from_errno();
+
+				log_error("Could not open directory '%s': %s (%d)",
+				          path, get_errno_name(errno), errno);
+
+				break;
+			}
+
+			error_code = manifest_collect(job, child_fd, path, entry_path_length, entries);
+
+			if (error_code != API_E_SUCCESS) {
+				break;
+			}
+		}
+
+		path[path_length] = '\0';
+	}
+
+	closedir(dp);
+
+	return error_code;
+}
+
+// only called from the job thread. on success entries is sorted by path
+static APIE manifest_scan(ManifestJob *job, Array *entries) {
+	APIE error_code;
+	int fd;
+	char path[MANIFEST_MAX_PATH_LENGTH + 1];
+
+	// manifest_collect takes ownership of the duplicate
+	fd = dup(job->root_fd);
+
+	if (fd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not duplicate file descriptor: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	path[0] = '\0';
+
+	error_code = manifest_collect(job, fd, path, 0, entries);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	qsort(entries->bytes, entries->count, sizeof(ManifestEntry), manifest_compare_entries);
+
+	return API_E_SUCCESS;
+}
+
+static bool manifest_parse_number(const char **p, const char *end, int base,
+                                  uint64_t *value) {
+	const char *start = *p;
+	int digit;
+
+	*value = 0;
+
+	while (*p < end && **p != ' ') {
+		if (**p >= '0' && **p <= '9') {
+			digit = **p - '0';
+		} else if (**p >= 'a' && **p <= 'f') {
+			digit = **p - 'a' + 10;
+		} else {
+			return false;
+		}
+
+		if (digit >= base || *value > (UINT64_MAX - digit) / base) {
+			return false;
+		}
+
+		*value = *value * base + digit;
+		++*p;
+	}
+
+	if (*p == start || *p == end) {
+		return false;
+	}
+
+	++*p; // skip space
+
+	return true;
+}
+
+static APIE manifest_parse(const char *buffer, int length, Array *entries) {
+	APIE error_code;
+	const char *line = buffer;
+	const char *end = buffer + length;
+	const char *line_end;
+	const char *p;
+	uint64_t type;
+	uint64_t entry_length;
+	uint64_t modification_timestamp;
+	uint64_t hash = 0;
+	bool hash_valid;
+	char path[MANIFEST_MAX_PATH_LENGTH + 1];
+	int path_length;
+	int line_number = 0;
+
+	for (; line < end; line = line_end + 1) {
+		++line_number;
+		line_end = memchr(line, '\n', end - line);
+
+		if (line_end == NULL) {
+			line_end = end;
+		}
+
+		if (line_end == line) {
+			continue; // ignore empty lines
+		}
+
+		p = line;
+
+		if (!manifest_parse_number(&p, line_end, 10, &type) ||
+		    type > DIRECTORY_ENTRY_TYPE_SOCKET ||
+		    !manifest_parse_number(&p, line_end, 16, &entry_length) ||
+		    !manifest_parse_number(&p, line_end, 16, &modification_timestamp)) {
+			goto malformed;
+		}
+
+		if (p + 1 < line_end && *p == '-' && p[1] == ' ') {
+			hash_valid = false;
+			p += 2;
+		} else if (manifest_parse_number(&p, line_end, 16, &hash)) {
+			hash_valid = true;
+		} else {
+			goto malformed;
+		}
+
+		path_length = 0;
+
+		for (; p < line_end; ++p) {
+			if (path_length >= MANIFEST_MAX_PATH_LENGTH) {
+				goto malformed;
+			}
+
+			if (*p == '\\') {
+				if (++p == line_end || (*p != '\\' && *p != 'n')) {
+					goto malformed;
+				}
+
+				path[path_length++] = *p == 'n' ? '\n' : '\\';
+			} else if (*p == '\0') {
+				goto malformed;
+			} else {
+				path[path_length++] = *p;
+			}
+		}
+
+		if (path_length == 0) {
+			goto malformed;
+		}
+
+		path[path_length] = '\0';
+
+		error_code = manifest_append_entry(entries, path, type, entry_length,
+		                                   modification_timestamp, hash_valid, hash);
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+	}
+
+	qsort(entries->bytes, entries->count, sizeof(ManifestEntry), manifest_compare_entries);
+
+	return API_E_SUCCESS;
+
+malformed:
+	log_warn("Manifest line %d is malformed", line_number);
+
+	return API_E_INVALID_PARAMETER;
+}
+
+
+// only called from the job thread. parses the copy of the given string object
+// or the given regular file object from its start
+static APIE manifest_load(ManifestJob *job, Array *entries) {
+	APIE error_code;
+	struct stat st;
+	char *buffer;
+	int length = 0;
+	int rc;
+
+	if (job->given_fd < 0) {
+		return manifest_parse(job->given_buffer, job->given_length, entries);
+	}
+
+	if (fstat(job->given_fd, &st) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not get information for manifest file: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if (st.st_size > MANIFEST_MAX_LENGTH) {
+		log_warn("Manifest file exceeds maximum length of %d bytes",
+		         MANIFEST_MAX_LENGTH);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	buffer = malloc(st.st_size > 0 ? st.st_size : 1);
+
+	if (buffer == NULL) {
+		log_error("Could not allocate manifest buffer: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	while (length < st.st_size) {
+		rc = pread(job->given_fd, buffer + length, st.st_size - length, length);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not read from manifest file: %s (%d)",
+			          get_errno_name(errno), errno);
+
+			free(buffer);
+
+			return error_code;
+		}
+
+		if (rc == 0) {
+			break; // truncated in the meantime
+		}
+
+		length += rc;
+	}
+
+	error_code = manifest_parse(buffer, length, entries);
+
+	free(buffer);
+
+	return error_code;
+}
+
+// only called from the job thread
+static APIE manifest_write_entries(ManifestJob *job, Array *entries) {
+	APIE error_code;
+	ManifestEntry *entry;
+	char prefix[MANIFEST_MAX_LINE_PREFIX_LENGTH];
+	int i;
+
+	for (i = 0; i < entries->count; ++i) {
+		entry = array_get(entries, i);
+
+		if ((job->flags & MANIFEST_FLAG_HASH) != 0 && entry->type == DIRECTORY_ENTRY_TYPE_REGULAR) {
+			error_code = manifest_get_hash(job, entry);
+
+			if (error_code != API_E_SUCCESS) {
+				return error_code;
+			}
+		}
+
+		if (entry->hash_valid) {
+			snprintf(prefix, sizeof(prefix), "%u %"PRIx64" %"PRIx64" %016"PRIx64" ",
+			         entry->type, entry->length, entry->modification_timestamp,
+			         entry->hash);
+		} else {
+			snprintf(prefix, sizeof(prefix), "%u %"PRIx64" %"PRIx64" - ",
+			         entry->type, entry->length, entry->modification_timestamp);
+		}
+
+		error_code = manifest_write(job, prefix, strlen(prefix));
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+
+		error_code = manifest_write_path(job, entry->path);
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+
+		++job->count;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// only called from the job thread. merges both sorted entry arrays
+static APIE manifest_write_changes(ManifestJob *job, Array *given_entries,
+                                   Array *entries) {
+	APIE error_code;
+	ManifestEntry *given_entry;
+	ManifestEntry *entry;
+	int i = 0;
+	int k = 0;
+	int order;
+	int change;
+	const char *path;
+	char prefix[4];
+
+	while (i < given_entries->count || k < entries->count) {
+		given_entry = i < given_entries->count ? array_get(given_entries, i) : NULL;
+		entry = k < entries->count ? array_get(entries, k) : NULL;
+
+		if (given_entry == NULL) {
+			order = 1;
+		} else if (entry == NULL) {
+			order = -1;
+		} else {
+			order = strcmp(given_entry->path, entry->path);
+		}
+
+		if (order < 0) {
+			change = MANIFEST_CHANGE_ADDED;
+			path = given_entry->path;
+			++i;
+		} else if (order > 0) {
+			change = MANIFEST_CHANGE_REMOVED;
+			path = entry->path;
+			++k;
+		} else {
+			change = 0;
+			path = entry->path;
+			++i;
+			++k;
+
+			if (given_entry->type != entry->type) {
+				change = MANIFEST_CHANGE_MODIFIED;
+			} else if (entry->type == DIRECTORY_ENTRY_TYPE_REGULAR) {
+				if (given_entry->length != entry->length) {
+					change = MANIFEST_CHANGE_MODIFIED;
+				} else if (given_entry->hash_valid) {
+					error_code = manifest_get_hash(job, entry);
+
+					if (error_code != API_E_SUCCESS) {
+						return error_code;
+					}
+
+					if (given_entry->hash != entry->hash) {
+						change = MANIFEST_CHANGE_MODIFIED;
+					}
+				} else if (given_entry->modification_timestamp != entry->modification_timestamp) {
+					change = MANIFEST_CHANGE_MODIFIED;
+				}
+			} else if (entry->type == DIRECTORY_ENTRY_TYPE_SYMLINK) {
+				if (given_entry->length != entry->length ||
+				    given_entry->modification_timestamp != entry->modification_timestamp) {
+					change = MANIFEST_CHANGE_MODIFIED;
+				}
+			}
+
+			if (change == 0) {
+				continue;
+			}
+		}
+
+		snprintf(prefix, sizeof(prefix), "%d ", change);
+
+		error_code = manifest_write(job, prefix, strlen(prefix));
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+
+		error_code = manifest_write_path(job, path);
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+
+		++job->count;
+	}
+
+	return API_E_SUCCESS;
+}
+
+static void manifest_run(void *opaque) {
+	ManifestJob *job = opaque;
+	int phase = 0;
+	APIE error_code;
+	Array given_entries;
+	Array entries;
+
+	if (job->diff) {
+		if (array_create(&given_entries, 64, sizeof(ManifestEntry), true) < 0) {
+			error_code = api_get_error_code_from_errno();
+
+			log_error("Could not create manifest entry array: %s (%d)",
+			          get_errno_name(errno), errno);
+
+			goto cleanup;
+		}
+
+		phase = 1;
+
+		error_code = manifest_load(job, &given_entries);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	phase = 1;
+
+	if (array_create(&entries, 64, sizeof(ManifestEntry), true) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create manifest entry array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	error_code = manifest_scan(job, &entries);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	if (job->diff) {
+		error_code = manifest_write_changes(job, &given_entries, &entries);
+	} else {
+		error_code = manifest_write_entries(job, &entries);
+	}
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = manifest_flush(job);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 2:
+		array_destroy(&entries, manifest_destroy_entry);
+
+	case 1:
+		if (job->diff) {
+			array_destroy(&given_entries, manifest_destroy_entry);
+		}
+
+	default:
+		break;
+	}
+
+	job->error_code = error_code;
+
+	// signal the end of the job to the event loop
+	close(job->pipe.write_end);
+}
+
+static void manifest_destroy_job(ManifestJob *job) {
+	int i;
+
+	for (i = 0; i < _jobs.count; ++i) {
+		if (*(ManifestJob **)array_get(&_jobs, i) == job) {
+			array_remove(&_jobs, i, NULL);
+
+			break;
+		}
+	}
+
+	if (job->given_fd >= 0) {
+		close(job->given_fd);
+	}
+
+	free(job->given_buffer);
+	close(job->root_fd);
+	file_release(job->file);
+	free(job->name);
+	free(job);
+}
+
+static void manifest_stop_job(ManifestJob *job) {
+	uint8_t buffer[512];
+	int rc;
+
+	job->aborted = true;
+
+	event_remove_source(job->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+
+	// the job thread might be blocked writing to the full pipe. drain the
+	// pipe until the job thread notices the abort and closes the write end
+	if (fcntl(job->pipe.read_end, F_SETFL, 0) < 0) {
+		log_error("Could not make manifest job pipe blocking: %s (%d)",
+		          get_errno_name(errno), errno);
+	}
+
+	for (;;) {
+		rc = read(job->pipe.read_end, buffer, sizeof(buffer));
+
+		if (rc == 0 || (rc < 0 && !errno_interrupted())) {
+			break;
+		}
+	}
+
+	close(job->pipe.read_end);
+
+	thread_join(&job->thread);
+	thread_destroy(&job->thread);
+}
+
+static void manifest_finish_job(ManifestJob *job, APIE error_code) {
+	if (error_code == API_E_SUCCESS) {
+		log_debug("Wrote %s of directory '%s' with %u %s to file object (id: %u, name: %s)",
+		          job->diff ? "manifest diff" : "manifest", job->name, job->count,
+		          job->diff ? "change(s)" : "entries",
+		          job->file->base.id, job->file->name->buffer);
+	}
+
+	api_send_directory_manifest_written_callback(job->file->base.id, error_code,
+	                                             error_code == API_E_SUCCESS ? job->count : 0);
+
+	manifest_destroy_job(job);
+}
+
+// writes the output of the job thread to the file object. after a write
+// error the rest of the output is discarded and the job thread is told to
+// stop early
+static void manifest_handle_output(void *opaque) {
+	ManifestJob *job = opaque;
+	uint8_t buffer[MANIFEST_WRITE_BUFFER_LENGTH];
+	int length;
+	int offset;
+	int rc;
+
+	length = read(job->pipe.read_end, buffer, sizeof(buffer));
+
+	if (length < 0) {
+		if (errno_interrupted() || errno_would_block()) {
+			return;
+		}
+
+		log_error("Could not read from manifest job pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		manifest_stop_job(job);
+		manifest_finish_job(job, API_E_INTERNAL_ERROR);
+
+		return;
+	}
+
+	if (length == 0) {
+		// the job thread is done and closed the write end
+		event_remove_source(job->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+		close(job->pipe.read_end);
+
+		thread_join(&job->thread);
+		thread_destroy(&job->thread);
+
+		manifest_finish_job(job, job->write_error_code != API_E_SUCCESS
+		                         ? job->write_error_code : job->error_code);
+
+		return;
+	}
+
+	if (job->write_error_code != API_E_SUCCESS) {
+		return;
+	}
+
+	for (offset = 0; offset < length; offset += rc) {
+		rc = job->file->write(job->file, buffer + offset, length - offset);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				rc = 0;
+
+				continue;
+			}
+
+			job->write_error_code = api_get_error_code_from_errno();
+			job->aborted = true;
+
+			log_error("Could not write to file object (id: %u, name: %s): %s (%d)",
+			          job->file->base.id, job->file->name->buffer,
+			          get_errno_name(errno), errno);
+
+			return;
+		}
+	}
+}
+
+// checks the parameters, then starts the job thread
+static APIE manifest_start(bool diff, const char *name, uint16_t flags,
+                           ObjectID given_id, ObjectID file_id) {
+	int phase = 0;
+	APIE error_code;
+	ManifestJob *job;
+	ManifestJob **job_ptr;
+	Object *object;
+	String *string;
+	File *given_file;
+	int i;
+
+	if ((flags & ~MANIFEST_FLAG_ALL) != 0) {
+		log_warn("Invalid manifest flags 0x%04X", flags);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (*name != '/') {
+		log_warn("Cannot create manifest of relative directory name '%s'", name);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (_jobs.count >= MANIFEST_MAX_JOBS) {
+		log_warn("Cannot create manifest of directory '%s', all %d jobs are still running",
+		         name, MANIFEST_MAX_JOBS);
+
+		return API_E_WOULD_BLOCK;
+	}
+
+	// allocate job, it's too big for the stack
+	job = calloc(1, sizeof(ManifestJob));
+
+	if (job == NULL) {
+		log_error("Could not allocate manifest job: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	job->diff = diff;
+	job->flags = flags;
+	job->given_fd = -1;
+
+	phase = 1;
+
+	// acquire output file object
+	error_code = file_get_acquired(file_id, &job->file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	error_code = manifest_check_output_file(job->file);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (i = 0; i < _jobs.count; ++i) {
+		if ((*(ManifestJob **)array_get(&_jobs, i))->file == job->file) {
+			log_warn("Cannot write manifest to file object (id: %u, name: %s) while another manifest is written to it",
+			         job->file->base.id, job->file->name->buffer);
+
+			error_code = API_E_INVALID_OPERATION;
+
+			goto cleanup;
+		}
+	}
+
+	job->name = strdup(name);
+
+	if (job->name == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not duplicate directory name: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	// get given manifest. the job thread cannot access objects, a string
+	// object is copied and a file object is duplicated
+	if (diff) {
+		error_code = inventory_get_object(OBJECT_TYPE_ANY, given_id, &object);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+
+		if (object->type == OBJECT_TYPE_STRING) {
+			string = (String *)object;
+
+			job->given_buffer = malloc(string->length > 0 ? string->length : 1);
+
+			if (job->given_buffer == NULL) {
+				error_code = API_E_NO_FREE_MEMORY;
+
+				log_error("Could not allocate manifest buffer: %s (%d)",
+				          get_errno_name(ENOMEM), ENOMEM);
+
+				goto cleanup;
+			}
+
+			memcpy(job->given_buffer, string->buffer, string->length);
+
+			job->given_length = string->length;
+		} else if (object->type == OBJECT_TYPE_FILE) {
+			given_file = (File *)object;
+
+			if (given_file->type != FILE_TYPE_REGULAR) {
+				log_warn("Cannot read manifest from non-regular file object (id: %u, name: %s)",
+				         given_file->base.id, given_file->name->buffer);
+
+				error_code = API_E_NOT_SUPPORTED;
+
+				goto cleanup;
+			}
+
+			job->given_fd = fcntl(given_file->fd, F_DUPFD_CLOEXEC, 0);
+
+			if (job->given_fd < 0) {
+				error_code = api_get_error_code_from_errno();
+
+				log_error("Could not duplicate file descriptor: %s (%d)",
+				          get_errno_name(errno), errno);
+
+				goto cleanup;
+			}
+		} else {
+			log_warn("Cannot read manifest from %s object (id: %u)",
+			         object_get_type_name(object->type), given_id);
+
+			error_code = API_E_INVALID_PARAMETER;
+
+			goto cleanup;
+		}
+	}
+
+	phase = 4;
+
+	job->root_fd = open(name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (job->root_fd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_warn("Could not open directory '%s': %s (%d)",
+		         name, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 5;
+
+	// the job thread blocks on the write end if the pipe is full, this
+	// limits the amount of output buffered ahead of the file object
+	if (pipe_create(&job->pipe, PIPE_FLAG_NON_BLOCKING_READ) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create manifest job pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 6;
+
+	job_ptr = array_append(&_jobs);
+
+	if (job_ptr == NULL) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not append to manifest job array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	*job_ptr = job;
+
+	phase = 7;
+
+	if (event_add_source(job->pipe.read_end, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, manifest_handle_output, job) < 0) {
+		error_code = API_E_INTERNAL_ERROR;
+
+		goto cleanup;
+	}
+
+	phase = 8;
+
+	thread_create(&job->thread, manifest_run, job);
+
+	log_debug("Started writing %s of directory '%s' to file object (id: %u, name: %s)",
+	          diff ? "manifest diff" : "manifest", name,
+	          job->file->base.id, job->file->name->buffer);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 7:
+		array_remove(&_jobs, _jobs.count - 1, NULL);
+
+	case 6:
+		pipe_destroy(&job->pipe);
+
+	case 5:
+		close(job->root_fd);
+
+	case 4:
+		if (job->given_fd >= 0) {
+			close(job->given_fd);
+		}
+
+		free(job->given_buffer);
+
+	case 3:
+		free(job->name);
+
+	case 2:
+		file_release(job->file);
+
+	case 1:
+		free(job);
+
+	default:
+		break;
+	}
+
+	return phase == 8 ? API_E_SUCCESS : error_code;
+}
+
+int manifest_init(void) {
+	log_debug("Initializing manifest subsystem");
+
+	if (array_create(&_jobs, MANIFEST_MAX_JOBS, sizeof(ManifestJob *), true) < 0) {
+		log_error("Could not create manifest job array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+void manifest_exit(void) {
+	ManifestJob *job;
+
+	log_debug("Shutting down manifest subsystem");
+
+	while (_jobs.count > 0) {
+		job = *(ManifestJob **)array_get(&_jobs, _jobs.count - 1);
+
+		manifest_stop_job(job);
+		manifest_destroy_job(job);
+	}
+
+	array_destroy(&_jobs, NULL);
+}
+
+// public API
+APIE manifest_get(const char *name, uint16_t flags, ObjectID manifest_file_id) {
+	return manifest_start(false, name, flags, OBJECT_ID_ZERO, manifest_file_id);
+}
+
+// public API
+APIE manifest_diff(const char *name, ObjectID manifest_id, ObjectID diff_file_id) {
+	return manifest_start(true, name, 0, manifest_id, diff_file_id);
+}
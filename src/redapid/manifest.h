@@ -0,0 +1,52 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * manifest.h: Directory manifest creation and comparison
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_MANIFEST_H
+#define REDAPID_MANIFEST_H
+
+#include <stdint.h>
+
+#include "object.h"
+
+#define MANIFEST_MAX_ENTRY_COUNT 65536
+#define MANIFEST_MAX_PATH_LENGTH 4096 // relative to the manifest directory
+#define MANIFEST_MAX_LENGTH (16 * 1024 * 1024) // of a manifest given as file object
+
+typedef enum { // bitmask
+	MANIFEST_FLAG_HASH = 0x0001 // include a content hash for regular files
+} ManifestFlag;
+
+#define MANIFEST_FLAG_ALL MANIFEST_FLAG_HASH
+
+typedef enum {
+	MANIFEST_CHANGE_ADDED = 1, // only in the given manifest
+	MANIFEST_CHANGE_MODIFIED,  // in both, but different
+	MANIFEST_CHANGE_REMOVED    // only in the directory
+} ManifestChange;
+
+int manifest_init(void);
+void manifest_exit(void);
+
+APIE manifest_get(const char *name, uint16_t flags, ObjectID manifest_file_id);
+
+APIE manifest_diff(const char *name, ObjectID manifest_id, ObjectID diff_file_id);
+
+#endif // REDAPID_MANIFEST_H
@@ -57,6 +57,7 @@ const char *object_get_type_name(ObjectType type) {
 	case OBJECT_TYPE_DIRECTORY: return "directory";
 	case OBJECT_TYPE_PROCESS:   return "process";
 	case OBJECT_TYPE_PROGRAM:   return "program";
+	case OBJECT_TYPE_WATCH:     return "watch";
 
 	default:                    return "<unknown>";
 	}
@@ -70,6 +71,7 @@ bool object_is_valid_type(ObjectType type) {
 	case OBJECT_TYPE_DIRECTORY:
 	case OBJECT_TYPE_PROCESS:
 	case OBJECT_TYPE_PROGRAM:
+	case OBJECT_TYPE_WATCH:
 		return true;
 
 	default:
@@ -45,7 +45,8 @@ typedef enum {
 	OBJECT_TYPE_FILE,
 	OBJECT_TYPE_DIRECTORY,
 	OBJECT_TYPE_PROCESS,
-	OBJECT_TYPE_PROGRAM
+	OBJECT_TYPE_PROGRAM,
+	OBJECT_TYPE_WATCH
 } ObjectType;
 
 typedef enum { // bitmask
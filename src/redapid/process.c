@@ -19,17 +19,27 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-#define _GNU_SOURCE // for execvpe from unistd.h
-#define _BSD_SOURCE // for getgrouplist and setgroups from grp.h
+#define _GNU_SOURCE // for execvpe from unistd.h and clone from sched.h
+#define _BSD_SOURCE // for setgroups from grp.h
 
 #include <errno.h>
+#include <fcntl.h>
 #include <grp.h>
-#include <pwd.h>
+#include <inttypes.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <daemonlib/array.h>
 #include <daemonlib/event.h>
 #include <daemonlib/log.h>
 #include <daemonlib/utils.h>
@@ -38,17 +48,22 @@
 
 #include "api.h"
 #include "file.h"
+#include "identity.h"
 #include "list.h"
 #include "inventory.h"
 #include "string.h"
+#include "zygote.h"
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
-typedef struct {
-	ProcessState state;
-	uint64_t timestamp;
-	uint8_t exit_code;
-} ProcessStateChange;
+#define PROCESS_SPAWN_STACK_SIZE (64 * 1024) // for the child process before execvpe
+
+// child processes are reaped by the event loop thread. SIGCHLD is received
+// through a signalfd and each signal triggers a non-blocking waitpid sweep over
+// all tracked child processes. only tracked PIDs are waited for, other child
+// processes (e.g. the one forked by file_create) are left alone
+static Array _processes; // Process pointers, spawned and not yet dead
+static int _sigchld_fd = -1;
 
 static bool process_state_is_alive(ProcessState state) {
 	switch (state) {
@@ -76,16 +91,581 @@ static const char *process_get_state_name(ProcessState state) {
 	}
 }
 
+// stops tracking the child process of a process object, it is either dead
+// or its process object is about to be destroyed
+static void process_untrack(Process *process) {
+	int i;
+
+	if (process->zygote != NULL) {
+		zygote_untrack(process->zygote, process);
+
+		return;
+	}
+
+	for (i = 0; i < _processes.count; ++i) {
+		if (*(Process **)array_get(&_processes, i) == process) {
+			array_remove(&_processes, i, NULL);
+
+			return;
+		}
+	}
+}
+
+// opens a private non-blocking descriptor for forwarding captured output to a
+// pipe, FIFO or character device. setting O_NONBLOCK on the descriptor of the
+// file object itself would affect everyone else using it. regular files and
+// block devices don't block on a full reader and are written directly
+static APIE process_output_open_forward_fd(File *file, int *forward_fd) {
+	APIE error_code;
+	char buffer[64];
+
+	if (file->type == FILE_TYPE_REGULAR || file->type == FILE_TYPE_BLOCK) {
+		*forward_fd = -1;
+
+		return API_E_SUCCESS;
+	}
+
+	snprintf(buffer, sizeof(buffer), "/proc/self/fd/%d", file_get_write_handle(file));
+
+	*forward_fd = open(buffer, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+
+	if (*forward_fd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not open non-blocking descriptor for forwarding output to file object (id: %u): %s (%d)",
+		          file->base.id, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// creates the capture pipes and the ring buffer. the read ends are
+// non-blocking, the write ends are passed to the child process as stdout and
+// stderr. if both are redirected to the same file then they share one pipe,
+// so their output stays in order
+static APIE process_output_create(ProcessOutput **output, uint32_t size,
+                                  File *stdout, File *stderr) {
+	int phase = 0;
+	APIE error_code;
+	bool shared = stdout == stderr;
+	int stdout_pipe[2];
+	int stderr_pipe[2];
+	int stdout_forward_fd;
+	int stderr_forward_fd = -1;
+
+	if (size > PROCESS_MAX_OUTPUT_BUFFER_SIZE) {
+		log_warn("Output buffer size of %u bytes exceeds maximum of %u bytes",
+		         size, PROCESS_MAX_OUTPUT_BUFFER_SIZE);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	*output = calloc(1, sizeof(ProcessOutput));
+
+	if (*output == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate process output: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	(*output)->buffer = malloc(size);
+
+	if ((*output)->buffer == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate %u byte output buffer: %s (%d)",
+		          size, get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	if (pipe2(stdout_pipe, O_CLOEXEC) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create stdout capture pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	if (shared) {
+		stderr_pipe[0] = -1;
+		stderr_pipe[1] = dup(stdout_pipe[1]);
+	} else if (pipe2(stderr_pipe, O_CLOEXEC) < 0) {
+		stderr_pipe[1] = -1;
+	}
+
+	if (stderr_pipe[1] < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create stderr capture pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 4;
+
+	if (fcntl(stdout_pipe[0], F_SETFL, O_NONBLOCK) < 0 ||
+	    (stderr_pipe[0] >= 0 && fcntl(stderr_pipe[0], F_SETFL, O_NONBLOCK) < 0)) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not enable non-blocking mode for capture pipe: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	error_code = process_output_open_forward_fd(stdout, &stdout_forward_fd);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 5;
+
+	if (!shared) {
+		error_code = process_output_open_forward_fd(stderr, &stderr_forward_fd);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	(*output)->size = size;
+	(*output)->end = 0;
+	(*output)->length = 0;
+	(*output)->stdout_stream.fd = stdout_pipe[0];
+	(*output)->stdout_stream.write_fd = stdout_pipe[1];
+	(*output)->stdout_stream.forward_fd = stdout_forward_fd;
+	(*output)->stdout_stream.pending_offset = 0;
+	(*output)->stdout_stream.pending_length = 0;
+	(*output)->stderr_stream.fd = stderr_pipe[0];
+	(*output)->stderr_stream.write_fd = stderr_pipe[1];
+	(*output)->stderr_stream.forward_fd = stderr_forward_fd;
+	(*output)->stderr_stream.pending_offset = 0;
+	(*output)->stderr_stream.pending_length = 0;
+	(*output)->dropped_length = 0;
+	(*output)->registered = false;
+
+	phase = 6;
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 5:
+		if (stdout_forward_fd >= 0) {
+			close(stdout_forward_fd);
+		}
+
+	case 4:
+		if (stderr_pipe[0] >= 0) {
+			close(stderr_pipe[0]);
+		}
+
+		close(stderr_pipe[1]);
+
+	case 3:
+		close(stdout_pipe[0]);
+		close(stdout_pipe[1]);
+
+	case 2:
+		free((*output)->buffer);
+
+	case 1:
+		free(*output);
+
+	default:
+		break;
+	}
+
+	return phase == 6 ? API_E_SUCCESS : error_code;
+}
+
+static void process_output_close_write_ends(ProcessOutput *output) {
+	if (output->stdout_stream.write_fd >= 0) {
+		close(output->stdout_stream.write_fd);
+
+		output->stdout_stream.write_fd = -1;
+	}
+
+	if (output->stderr_stream.write_fd >= 0) {
+		close(output->stderr_stream.write_fd);
+
+		output->stderr_stream.write_fd = -1;
+	}
+}
+
+static void process_output_close_read_end(ProcessOutput *output,
+                                          ProcessOutputStream *stream) {
+	if (stream->fd < 0) {
+		return;
+	}
+
+	// the read end is not polled while forwarded output is pending
+	if (output->registered && stream->pending_length == 0) {
+		event_remove_source(stream->fd, EVENT_SOURCE_TYPE_GENERIC);
+	}
+
+	close(stream->fd);
+
+	stream->fd = -1;
+}
+
+static void process_output_destroy(ProcessOutput *output) {
+	process_output_close_read_end(output, &output->stderr_stream);
+	process_output_close_read_end(output, &output->stdout_stream);
+	process_output_close_write_ends(output);
+
+	if (output->stderr_stream.forward_fd >= 0) {
+		close(output->stderr_stream.forward_fd);
+	}
+
+	if (output->stdout_stream.forward_fd >= 0) {
+		close(output->stdout_stream.forward_fd);
+	}
+
+	free(output->buffer);
+	free(output);
+}
+
+static void process_output_append(ProcessOutput *output, uint8_t *buffer, uint32_t length) {
+	uint32_t chunk;
+
+	// only the last size bytes can be kept
+	if (length > output->size) {
+		buffer += length - output->size;
+		length = output->size;
+	}
+
+	while (length > 0) {
+		chunk = output->size - output->end;
+
+		if (chunk > length) {
+			chunk = length;
+		}
+
+		memcpy(output->buffer + output->end, buffer, chunk);
+
+		output->end = (output->end + chunk) % output->size;
+		buffer += chunk;
+		length -= chunk;
+
+		if (output->length + chunk > output->size) {
+			output->length = output->size;
+		} else {
+			output->length += chunk;
+		}
+	}
+}
+
+// returns the number of bytes written. writes to a pipe, FIFO or character
+// device are non-blocking, so this is less than length if its reader doesn't
+// keep up. output that cannot be written because of an error is discarded
+static int process_write_output(Process *process, ProcessOutputStream *stream,
+                                File *file, uint8_t *buffer, int length) {
+	int fd = stream->forward_fd >= 0 ? stream->forward_fd : file_get_write_handle(file);
+	int offset = 0;
+	int rc;
+
+	while (offset < length) {
+		rc = write(fd, buffer + offset, length - offset);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			if (errno_would_block()) {
+				break;
+			}
+
+			log_warn("Could not forward output of child process (executable: %s): %s (%d)",
+			         process->executable->buffer, get_errno_name(errno), errno);
+
+			return length;
+		}
+
+		offset += rc;
+	}
+
+	return offset;
+}
+
+static void process_handle_stdout_output(void *opaque);
+static void process_handle_stderr_output(void *opaque);
+static void process_handle_stdout_writable(void *opaque);
+static void process_handle_stderr_writable(void *opaque);
+
+// keeps the output that could not be forwarded and stops reading the capture
+// pipe until the file is writable again. the capture pipe fills up then and
+// the child process is throttled, as if it wrote to the file directly
+static void process_hold_output(Process *process, ProcessOutputStream *stream,
+                                uint8_t *buffer, int length) {
+	bool is_stdout = stream == &process->output->stdout_stream;
+
+	memcpy(stream->pending, buffer, length);
+
+	stream->pending_offset = 0;
+	stream->pending_length = length;
+
+	event_remove_source(stream->fd, EVENT_SOURCE_TYPE_GENERIC);
+
+	if (event_add_source(stream->forward_fd, EVENT_SOURCE_TYPE_GENERIC, EVENT_WRITE,
+	                     is_stdout ? process_handle_stdout_writable : process_handle_stderr_writable,
+	                     process) < 0) {
+		log_error("Could not wait for file to become writable, discarding output of child process (executable: %s)",
+		          process->executable->buffer);
+
+		stream->pending_length = 0;
+
+		event_add_source(stream->fd, EVENT_SOURCE_TYPE_GENERIC, EVENT_READ,
+		                 is_stdout ? process_handle_stdout_output : process_handle_stderr_output,
+		                 process);
+	}
+}
+
+// forwards the pending output and resumes reading the capture pipe once all
+// of it is forwarded
+static void process_handle_writable(Process *process, ProcessOutputStream *stream,
+                                    File *file, EventFunction read_function) {
+	int rc;
+
+	rc = process_write_output(process, stream, file,
+	                          stream->pending + stream->pending_offset,
+	                          stream->pending_length);
+
+	stream->pending_offset += rc;
+	stream->pending_length -= rc;
+
+	if (stream->pending_length > 0) {
+		return;
+	}
+
+	event_remove_source(stream->forward_fd, EVENT_SOURCE_TYPE_GENERIC);
+
+	if (stream->fd >= 0 &&
+	    event_add_source(stream->fd, EVENT_SOURCE_TYPE_GENERIC, EVENT_READ,
+	                     read_function, process) < 0) {
+		log_error("Could not resume capturing output of child process (executable: %s)",
+		          process->executable->buffer);
+	}
+}
+
+static void process_handle_stdout_writable(void *opaque) {
+	Process *process = opaque;
+
+	process_handle_writable(process, &process->output->stdout_stream,
+	                        process->stdout, process_handle_stdout_output);
+}
+
+static void process_handle_stderr_writable(void *opaque) {
+	Process *process = opaque;
+
+	process_handle_writable(process, &process->output->stderr_stream,
+	                        process->stderr, process_handle_stderr_output);
+}
+
+// reads the available output from a capture pipe into the ring buffer and
+// forwards it to the file the child process would have written to otherwise.
+// returns the number of bytes read, 0 if there is nothing to read (anymore)
+// or if the rest is held back until the file is writable again
+static int process_handle_output(Process *process, ProcessOutputStream *stream, File *file) {
+	uint8_t buffer[PROCESS_OUTPUT_CHUNK_SIZE];
+	int length;
+	int rc;
+
+	length = read(stream->fd, buffer, sizeof(buffer));
+
+	if (length < 0) {
+		if (errno_interrupted() || errno_would_block()) {
+			return 0;
+		}
+
+		log_error("Could not read from capture pipe of child process (executable: %s): %s (%d)",
+		          process->executable->buffer, get_errno_name(errno), errno);
+	}
+
+	if (length <= 0) {
+		// all writers are gone, the child process and its children closed
+		// their stdout or stderr
+		process_output_close_read_end(process->output, stream);
+
+		return 0;
+	}
+
+	process_output_append(process->output, buffer, length);
+
+	rc = process_write_output(process, stream, file, buffer, length);
+
+	if (rc < length) {
+		// without event sources the output cannot be held back anymore
+		if (!process->output->registered) {
+			process->output->dropped_length += length - rc;
+		} else {
+			process_hold_output(process, stream, buffer + rc, length - rc);
+
+			return 0;
+		}
+	}
+
+	return length;
+}
+
+static void process_handle_stdout_output(void *opaque) {
+	Process *process = opaque;
+
+	process_handle_output(process, &process->output->stdout_stream, process->stdout);
+}
+
+static void process_handle_stderr_output(void *opaque) {
+	Process *process = opaque;
+
+	process_handle_output(process, &process->output->stderr_stream, process->stderr);
+}
+
+// stops polling the capture pipes and waiting for the files to become writable
+static void process_output_unregister(ProcessOutput *output) {
+	ProcessOutputStream *streams[2] = { &output->stdout_stream, &output->stderr_stream };
+	int i;
+
+	if (!output->registered) {
+		return;
+	}
+
+	for (i = 0; i < 2; ++i) {
+		if (streams[i]->pending_length > 0) {
+			event_remove_source(streams[i]->forward_fd, EVENT_SOURCE_TYPE_GENERIC);
+		} else if (streams[i]->fd >= 0) {
+			event_remove_source(streams[i]->fd, EVENT_SOURCE_TYPE_GENERIC);
+		}
+	}
+
+	output->registered = false;
+}
+
+static void process_drain_stream(Process *process, ProcessOutputStream *stream, File *file) {
+	int rc;
+
+	if (stream->pending_length > 0) {
+		rc = process_write_output(process, stream, file,
+		                          stream->pending + stream->pending_offset,
+		                          stream->pending_length);
+
+		process->output->dropped_length += stream->pending_length - rc;
+		stream->pending_length = 0;
+	}
+
+	while (stream->fd >= 0 && process_handle_output(process, stream, file) > 0);
+}
+
+// forwards output that is still pending in the capture pipes, so it doesn't
+// get lost if the process object is destroyed right after the child process
+// died. this cannot wait for the files to become writable anymore, output
+// that doesn't fit is dropped
+static void process_drain_output(Process *process) {
+	process_output_unregister(process->output);
+
+	process_drain_stream(process, &process->output->stdout_stream, process->stdout);
+	process_drain_stream(process, &process->output->stderr_stream, process->stderr);
+}
+
+static APIE process_output_register(Process *process) {
+	ProcessOutput *output = process->output;
+
+	if (event_add_source(output->stdout_stream.fd, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, process_handle_stdout_output, process) < 0) {
+		return API_E_INTERNAL_ERROR;
+	}
+
+	if (output->stderr_stream.fd >= 0 &&
+	    event_add_source(output->stderr_stream.fd, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, process_handle_stderr_output, process) < 0) {
+		event_remove_source(output->stdout_stream.fd, EVENT_SOURCE_TYPE_GENERIC);
+
+		return API_E_INTERNAL_ERROR;
+	}
+
+	output->registered = true;
+
+	return API_E_SUCCESS;
+}
+
+// a process group exists as long as one of its members exists. EPERM means
+// that there is a member, but it changed its user ID
+static bool process_group_exists(pid_t pgid) {
+	return kill(-pgid, 0) == 0 || errno != ESRCH;
+}
+
+static void process_finish_tree_kill(Process *process) {
+	if (process->killing_tree) {
+		timer_destroy(&process->tree_timer);
+
+		process->killing_tree = false;
+	}
+
+	// don't signal this process group ever again, its ID might get reused
+	process->pgid = 0;
+
+	log_debug("Process tree of process object (id: %u, executable: %s) is gone",
+	          process->base.id, process->executable->buffer);
+
+	if (process->tree_killed != NULL) {
+		process->tree_killed(process->tree_killed_opaque);
+	}
+
+	// only send a process-tree-killed callback if there is at least one
+	// external reference to the process object. otherwise there is no one that
+	// could be interested in this callback anyway
+	if (process->base.external_reference_count > 0) {
+		api_send_process_tree_killed_callback(process->base.id);
+	}
+}
+
+// the members of the process group are not children of redapid, except for
+// the child process itself. there is no notification if they die, so poll
+// the process group until it is empty and escalate to SIGKILL at the deadline
+static void process_handle_tree_timer(void *opaque) {
+	Process *process = opaque;
+
+	if (!process_group_exists(process->pgid)) {
+		process_finish_tree_kill(process);
+
+		return;
+	}
+
+	if (process->tree_kill_deadline > 0 && microseconds() >= process->tree_kill_deadline) {
+		log_warn("Process tree of process object (id: %u, executable: %s) is still alive, sending SIGKILL",
+		         process->base.id, process->executable->buffer);
+
+		if (kill(-process->pgid, SIGKILL) < 0 && errno != ESRCH) {
+			log_error("Could not send SIGKILL signal to process group %u: %s (%d)",
+			          process->pgid, get_errno_name(errno), errno);
+		}
+
+		process->tree_kill_deadline = 0;
+	}
+}
+
 static void process_destroy(Object *object) {
 	Process *process = (Process *)object;
+	bool forked_by_zygote = process->zygote != NULL;
 	int rc;
-	bool stuck = false;
 
-	// remove the state change pipe from the event loop to avoid sending
-	// callbacks in case the child process is still alive and has to be killed
-	event_remove_source(process->state_change_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+	// stop tracking the child process to avoid sending callbacks in case it
+	// is still alive and has to be killed
+	process_untrack(process);
 
-	// FIXME: this code here has the same race condition as process_kill
 	if (process_is_alive(process)) {
 		log_warn("Destroying process object (id: %u, executable: %s) while child process (pid: %u) is still alive",
 		         process->base.id, process->executable->buffer, process->pid);
@@ -93,148 +673,403 @@ static void process_destroy(Object *object) {
 		rc = kill(process->pid, SIGKILL);
 
 		if (rc < 0) {
-			if (errno != ESRCH) {
-				stuck = true;
-			}
-
 			log_error("Could not send SIGKILL signal to child process (executable: %s, pid: %u): %s (%d)",
 			          process->executable->buffer, process->pid, get_errno_name(errno), errno);
 		}
+
+		// the child process is not tracked anymore, reap it here. if it could
+		// not be killed then don't wait for it, it would block forever. a
+		// zygote reaps its child processes itself
+		if (!forked_by_zygote && (rc == 0 || errno == ESRCH)) {
+			while (waitpid(process->pid, NULL, 0) < 0 && errno_interrupted());
+		}
+	}
+
+	// the process tree was about to be killed anyway, don't leave the rest of
+	// it behind without anyone watching it
+	if (process->killing_tree) {
+		kill(-process->pgid, SIGKILL);
+		timer_destroy(&process->tree_timer);
+	}
+
+	if (process->output != NULL) {
+		process_drain_output(process);
+
+		if (process->output->dropped_length > 0) {
+			log_warn("Dropped %"PRIu64" byte(s) of output of child process (executable: %s)",
+			         process->output->dropped_length, process->executable->buffer);
+		}
+
+		process_output_destroy(process->output);
+	}
+
+	file_release(process->stderr);
+	file_release(process->stdout);
+	file_release(process->stdin);
+	string_unlock_and_release(process->working_directory);
+	list_unlock_and_release(process->environment);
+	list_unlock_and_release(process->arguments);
+	string_unlock_and_release(process->executable);
+
+	free(process);
+}
+static void process_signature(Object *object, char *signature) {
+	Process *process = (Process *)object;
+
+	// FIXME: add more info
+	snprintf(signature, OBJECT_MAX_SIGNATURE_LENGTH, "executable: %s",
+	         process->executable->buffer);
+}
+
+static int process_read_proc_file(pid_t pid, const char *name, char *buffer, int length) {
+	char filename[64];
+	int fd;
+	int rc;
+
+	snprintf(filename, sizeof(filename), "/proc/%u/%s", pid, name);
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	rc = robust_read(fd, buffer, length - 1);
+
+	close(fd);
+
+	if (rc < 0) {
+		return -1;
+	}
+
+	buffer[rc] = '\0';
+
+	return rc;
+}
+
+// returns the value of a "<key>: <value>" line from /proc/<pid>/status or io
+static uint64_t process_get_proc_value(const char *buffer, const char *key) {
+	const char *line = buffer;
+	int key_length = strlen(key);
+
+	while (line != NULL) {
+		if (strncmp(line, key, key_length) == 0 && line[key_length] == ':') {
+			return strtoull(line + key_length + 1, NULL, 10);
+		}
+
+		line = strchr(line, '\n');
+
+		if (line != NULL) {
+			++line;
+		}
+	}
+
+	return 0;
+}
+
+static APIE process_sample_resource_usage(Process *process) {
+	char buffer[4096];
+	char *p;
+	unsigned long long user_ticks;
+	unsigned long long system_ticks;
+	long ticks_per_second = sysconf(_SC_CLK_TCK);
+	ProcessResourceUsage *usage = &process->resource_usage;
+	APIE error_code;
+
+	// the executable name in the stat file is in parenthesis and can contain
+	// spaces and parenthesis itself, parse after the last closing parenthesis.
+	// user and system time are the 12th and 13th fields after it
+	if (process_read_proc_file(process->pid, "stat", buffer, sizeof(buffer)) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not read stat file of child process (executable: %s, pid: %u): %s (%d)",
+		          process->executable->buffer, process->pid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	p = strrchr(buffer, ')');
+
+	if (p == NULL || sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+	                        &user_ticks, &system_ticks) != 2) {
+		log_error("Could not parse stat file of child process (executable: %s, pid: %u)",
+		          process->executable->buffer, process->pid);
+
+		return API_E_INTERNAL_ERROR;
+	}
+
+	usage->user_time = user_ticks * 1000000 / ticks_per_second;
+	usage->system_time = system_ticks * 1000000 / ticks_per_second;
+
+	if (process_read_proc_file(process->pid, "status", buffer, sizeof(buffer)) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not read status file of child process (executable: %s, pid: %u): %s (%d)",
+		          process->executable->buffer, process->pid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	usage->resident_set_size = process_get_proc_value(buffer, "VmRSS");
+	usage->peak_resident_set_size = process_get_proc_value(buffer, "VmHWM");
+	usage->voluntary_context_switches = process_get_proc_value(buffer, "voluntary_ctxt_switches");
+	usage->involuntary_context_switches = process_get_proc_value(buffer, "nonvoluntary_ctxt_switches");
+
+	// the io file only exists if the kernel has I/O accounting enabled
+	if (process_read_proc_file(process->pid, "io", buffer, sizeof(buffer)) < 0) {
+		log_debug("Could not read io file of child process (executable: %s, pid: %u): %s (%d)",
+		          process->executable->buffer, process->pid, get_errno_name(errno), errno);
+	} else {
+		usage->read_bytes = process_get_proc_value(buffer, "read_bytes");
+		usage->write_bytes = process_get_proc_value(buffer, "write_bytes");
+	}
+
+	return API_E_SUCCESS;
+}
+
+// the resource usage of a dead child process is final, wait4 reports it
+static void process_set_final_resource_usage(Process *process, struct rusage *rusage) {
+	ProcessResourceUsage *usage = &process->resource_usage;
+
+	usage->user_time = (uint64_t)rusage->ru_utime.tv_sec * 1000000 + rusage->ru_utime.tv_usec;
+	usage->system_time = (uint64_t)rusage->ru_stime.tv_sec * 1000000 + rusage->ru_stime.tv_usec;
+	usage->resident_set_size = 0;
+	usage->peak_resident_set_size = rusage->ru_maxrss;
+	usage->read_bytes = (uint64_t)rusage->ru_inblock * 512; // in 512 byte blocks
+	usage->write_bytes = (uint64_t)rusage->ru_oublock * 512;
+	usage->voluntary_context_switches = rusage->ru_nvcsw;
+	usage->involuntary_context_switches = rusage->ru_nivcsw;
+}
+
+static void process_handle_state_change(Process *process, int status,
+                                        struct rusage *rusage) {
+	ProcessState state;
+	uint8_t exit_code;
+
+	if (WIFEXITED(status)) {
+		state = PROCESS_STATE_EXITED;
+		exit_code = WEXITSTATUS(status);
+
+		// the child process has limited capabilities to report errors. the
+		// coreutils env executable that executes other programs reserves
+		// three exit codes to report errors (125, 126 and 127). our child
+		// process uses the same mechanism. check for these three exit codes
+		// and change state to error if found. the downside of this approach
+		// is that these three exit codes can be used by the program to be
+		// executed as normal exit codes with a different meaning, leading
+		// to a misinterpretation here. but the coreutils env executable has
+		// the same problem, so we will live with this
+		if (exit_code == PROCESS_E_INTERNAL_ERROR ||
+		    exit_code == PROCESS_E_CANNOT_EXECUTE ||
+		    exit_code == PROCESS_E_DOES_NOT_EXIST) {
+			state = PROCESS_STATE_ERROR;
+		}
+	} else if (WIFSIGNALED(status)) {
+		state = PROCESS_STATE_KILLED;
+		exit_code = WTERMSIG(status);
+	} else if (WIFSTOPPED(status)) {
+		state = PROCESS_STATE_STOPPED;
+		exit_code = WSTOPSIG(status);
+	} else if (WIFCONTINUED(status)) {
+		state = PROCESS_STATE_RUNNING;
+		exit_code = 0; // invalid
+	} else {
+		state = PROCESS_STATE_UNKNOWN;
+		exit_code = 0; // invalid
+	}
+
+	log_debug("State of child process (executable: %s, pid: %u) changed (state: %s, exit_code: %u)",
+	          process->executable->buffer, process->pid,
+	          process_get_state_name(state), exit_code);
+
+	process->state = state;
+	process->timestamp = time(NULL);
+	process->exit_code = exit_code;
+
+	if (!process_is_alive(process)) {
+		process->pid = 0;
+
+		process_set_final_resource_usage(process, rusage);
+
+		// if nothing is left of the process group then forget about it
+		if (!process->killing_tree && process->pgid != 0 &&
+		    !process_group_exists(process->pgid)) {
+			process->pgid = 0;
+		}
+	}
+
+	if (process->state_changed != NULL) {
+		process->state_changed(process->opaque);
 	}
 
-	if (!stuck) {
-		thread_join(&process->wait_thread);
+	// only send a process-state-changed callback if there is at least one
+	// external reference to the process object. otherwise there is no one that
+	// could be interested in this callback anyway. also this logic avoids
+	// sending process-state-changed callbacks for scheduled program executions
+	if (process->base.external_reference_count > 0) {
+		api_send_process_state_changed_callback(process->base.id, process->state,
+		                                        process->timestamp, process->exit_code);
 	}
 
-	thread_destroy(&process->wait_thread);
-
-	pipe_destroy(&process->state_change_pipe);
-
-	file_release(process->stderr);
-	file_release(process->stdout);
-	file_release(process->stdin);
-	string_unlock_and_release(process->working_directory);
-	list_unlock_and_release(process->environment);
-	list_unlock_and_release(process->arguments);
-	string_unlock_and_release(process->executable);
+	if (process->release_on_death && !process_is_alive(process)) {
+		process->release_on_death = false; // only release-on-death once
 
-	free(process);
+		object_remove_internal_reference(&process->base);
+	}
 }
 
-static void process_signature(Object *object, char *signature) {
-	Process *process = (Process *)object;
-
-	// FIXME: add more info
-	snprintf(signature, OBJECT_MAX_SIGNATURE_LENGTH, "executable: %s",
-	         process->executable->buffer);
+// returns true if the child process is still tracked at the given index
+static bool process_is_tracked(Process *process, int i) {
+	return i < _processes.count && *(Process **)array_get(&_processes, i) == process;
 }
 
-static void process_wait(void *opaque) {
-	Process *process = opaque;
+static void process_reap(int i) {
+	Process *process = *(Process **)array_get(&_processes, i);
 	int status;
+	struct rusage rusage;
 	int rc;
-	ProcessStateChange change;
 
-	for (;;) {
+	while (process_is_tracked(process, i)) {
 		do {
-			rc = waitpid(process->pid, &status, WUNTRACED | WCONTINUED);
+			rc = wait4(process->pid, &status, WNOHANG | WUNTRACED | WCONTINUED, &rusage);
 		} while (rc < 0 && errno_interrupted());
 
+		if (rc == 0) {
+			break; // no state change
+		}
+
 		if (rc < 0) {
 			log_error("Could not wait for child process (executable: %s, pid: %u) state change: %s (%d)",
 			          process->executable->buffer, process->pid, get_errno_name(errno), errno);
 
+			array_remove(&_processes, i, NULL);
+
 			break;
 		}
 
-		change.timestamp = time(NULL);
-
-		if (WIFEXITED(status)) {
-			change.state = PROCESS_STATE_EXITED;
-			change.exit_code = WEXITSTATUS(status);
-
-			// the child process has limited capabilities to report errors. the
-			// coreutils env executable that executes other programs reserves
-			// three exit codes to report errors (125, 126 and 127). our child
-			// process uses the same mechanism. check for these three exit codes
-			// and change state to error if found. the downside of this approach
-			// is that these three exit codes can be used by the program to be
-			// executed as normal exit codes with a different meaning, leading
-			// to a misinterpretation here. but the coreutils env executable has
-			// the same problem, so we will live with this
-			if (change.exit_code == PROCESS_E_INTERNAL_ERROR ||
-			    change.exit_code == PROCESS_E_CANNOT_EXECUTE ||
-			    change.exit_code == PROCESS_E_DOES_NOT_EXIST) {
-				change.state = PROCESS_STATE_ERROR;
-			}
-		} else if (WIFSIGNALED(status)) {
-			change.state = PROCESS_STATE_KILLED;
-			change.exit_code = WTERMSIG(status);
-		} else if (WIFSTOPPED(status)) {
-			change.state = PROCESS_STATE_STOPPED;
-			change.exit_code = WSTOPSIG(status);
-		} else if (WIFCONTINUED(status)) {
-			change.state = PROCESS_STATE_RUNNING;
-			change.exit_code = 0; // invalid
-		} else {
-			change.state = PROCESS_STATE_UNKNOWN;
-			change.exit_code = 0; // invalid
+		// a dead child process is reaped now, stop tracking it before the
+		// state change is handled, because this might destroy the process
+		// object and can add or remove other tracked child processes
+		if (!WIFSTOPPED(status) && !WIFCONTINUED(status)) {
+			array_remove(&_processes, i, NULL);
 		}
 
-		log_debug("State of child process (executable: %s, pid: %u) changed (state: %s, exit_code: %u)",
-		          process->executable->buffer, process->pid,
-		          process_get_state_name(change.state), change.exit_code);
+		process_handle_state_change(process, status, &rusage);
+	}
+}
 
-		if (pipe_write(&process->state_change_pipe, &change, sizeof(change)) < 0) {
-			log_error("Could not write to state change pipe for child process (executable: %s, pid: %u): %s (%d)",
-			          process->executable->buffer, process->pid, get_errno_name(errno), errno);
+static void process_handle_sigchld(void *opaque) {
+	struct signalfd_siginfo info;
+	int rc;
+	int i;
+
+	(void)opaque;
+
+	// SIGCHLD is not queued, multiple state changes can be reported by a
+	// single signal. therefore, just drain the signalfd and check all tracked
+	// child processes for state changes instead of relying on ssi_pid
+	for (;;) {
+		rc = read(_sigchld_fd, &info, sizeof(info));
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			if (!errno_would_block()) {
+				log_error("Could not read from SIGCHLD signalfd: %s (%d)",
+				          get_errno_name(errno), errno);
+			}
 
 			break;
 		}
+	}
 
-		if (!process_state_is_alive(change.state)) {
-			break;
+	// iterate backwards, state changes of dead child processes remove them
+	// from the array
+	for (i = _processes.count - 1; i >= 0; --i) {
+		if (i < _processes.count) {
+			process_reap(i);
 		}
 	}
 }
 
-static void process_handle_state_change(void *opaque) {
-	Process *process = opaque;
-	ProcessStateChange change;
+int process_init(void) {
+	int phase = 0;
+	sigset_t mask;
+	int rc;
 
-	if (pipe_read(&process->state_change_pipe, &change, sizeof(change)) < 0) {
-		log_error("Could not read from state change pipe for child process (executable: %s, pid: %u): %s (%d)",
-		          process->executable->buffer, process->pid, get_errno_name(errno), errno);
+	log_debug("Initializing process subsystem");
 
-		return;
+	if (array_create(&_processes, 32, sizeof(Process *), true) < 0) {
+		log_error("Could not create process array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
 	}
 
-	process->state = change.state;
-	process->timestamp = change.timestamp;
-	process->exit_code = change.exit_code;
+	phase = 1;
 
-	if (!process_is_alive(process)) {
-		process->pid = 0;
+	// SIGCHLD has to be blocked in all threads to be reported by the signalfd.
+	// this is called before any other thread is started, all threads inherit
+	// the signal mask of the main thread
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+
+	rc = pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	if (rc != 0) {
+		log_error("Could not block SIGCHLD signal: %s (%d)",
+		          get_errno_name(rc), rc);
+
+		goto cleanup;
 	}
 
-	if (process->state_changed != NULL) {
-		process->state_changed(process->opaque);
+	phase = 2;
+
+	_sigchld_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	if (_sigchld_fd < 0) {
+		log_error("Could not create SIGCHLD signalfd: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
 	}
 
-	// only send a process-state-changed callback if there is at least one
-	// external reference to the process object. otherwise there is no one that
-	// could be interested in this callback anyway. also this logic avoids
-	// sending process-state-changed callbacks for scheduled program executions
-	if (process->base.external_reference_count > 0) {
-		api_send_process_state_changed_callback(process->base.id, change.state,
-		                                        change.timestamp, change.exit_code);
+	phase = 3;
+
+	if (event_add_source(_sigchld_fd, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, process_handle_sigchld, NULL) < 0) {
+		goto cleanup;
 	}
 
-	if (process->release_on_death && !process_is_alive(process)) {
-		process->release_on_death = false; // only release-on-death once
+	phase = 4;
 
-		object_remove_internal_reference(&process->base);
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 3:
+		close(_sigchld_fd);
+
+	case 2:
+		pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+
+	case 1:
+		array_destroy(&_processes, NULL);
+
+	default:
+		break;
 	}
+
+	return phase == 4 ? 0 : -1;
+}
+
+void process_exit(void) {
+	log_debug("Shutting down process subsystem");
+
+	event_remove_source(_sigchld_fd, EVENT_SOURCE_TYPE_GENERIC);
+	close(_sigchld_fd);
+
+	array_destroy(&_processes, NULL);
 }
 
 APIE process_fork(pid_t *pid) {
@@ -281,105 +1116,505 @@ APIE process_fork(pid_t *pid) {
 
 		sigemptyset(&action.sa_mask);
 
-		for (i = 1; i < NSIG; ++i) {
-			sigaction(i, &action, NULL);
-		}
+		for (i = 1; i < NSIG; ++i) {
+			sigaction(i, &action, NULL);
+		}
+
+		// unblock all signals in the child
+		sigemptyset(&newmask);
+
+		if (pthread_sigmask(SIG_SETMASK, &newmask, NULL) != 0) {
+			log_error("Could not unblock signals: %s (%d)",
+			          get_errno_name(errno), errno);
+
+			_exit(PROCESS_E_INTERNAL_ERROR);
+		}
+
+		return API_E_SUCCESS;
+	}
+}
+
+// groups have to be resolved with identity_get_groups before forking
+APIE process_set_identity(uid_t uid, gid_t gid, const gid_t *groups, int group_count) {
+	APIE error_code;
+
+	// set (primary) group
+	if (setregid(gid, gid) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not change real and effective group ID to %u: %s (%d)",
+		          gid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	// set (secondary) groups
+	if (setgroups(group_count, groups) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not set secondary group IDs of user ID %u: %s (%d)",
+		          uid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	// set user
+	if (setreuid(uid, uid) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not change real and effective user ID to %u: %s (%d)",
+		          uid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	return API_E_SUCCESS;
+}
+
+const char *process_get_error_code_name(ProcessE error_code) {
+	#define ERROR_CODE_NAME(code) case code: return #code
+
+	switch (error_code) {
+	ERROR_CODE_NAME(PROCESS_E_INTERNAL_ERROR);
+	ERROR_CODE_NAME(PROCESS_E_CANNOT_EXECUTE);
+	ERROR_CODE_NAME(PROCESS_E_DOES_NOT_EXIST);
+
+	default: return "<unknown>";
+	}
+
+	#undef ERROR_CODE_NAME
+}
+
+typedef struct {
+	const char *executable;
+	char **arguments;
+	char **environment;
+	const char *working_directory;
+	uid_t uid;
+	gid_t gid;
+	const gid_t *groups; // resolved by the parent, owned by the identity cache
+	int group_count;
+	int stdin_fd;
+	int stdout_fd;
+	int stderr_fd;
+	int status_fd;
+	int cgroup_fd; // cgroup.procs file of the control group to move into, or -1
+	ProcessSchedulingAttributes *scheduling; // NULL to inherit from redapid
+	const int *inherited_fds; // become file descriptors 3, 4, ...
+	int inherited_fd_count;
+} ProcessSpawnContext;
+
+typedef struct {
+	APIE error_code;
+	int error_number;
+	const char *step; // what failed, NULL on success
+} ProcessSpawnStatus;
+
+// from linux/ioprio.h, glibc has no wrapper for ioprio_set
+#define PROCESS_IOPRIO_WHO_PROCESS 1
+#define PROCESS_IOPRIO_CLASS_BE 2
+#define PROCESS_IOPRIO_CLASS_IDLE 3
+#define PROCESS_IOPRIO_CLASS_SHIFT 13
+
+// applies nice level, scheduling policy, CPU affinity and I/O priority to the
+// calling thread, which is the child process. only uses system calls
+static int process_set_scheduling_attributes(ProcessSchedulingAttributes *scheduling,
+                                             const char **step) {
+	struct sched_param param;
+	int policy;
+	cpu_set_t cpu_set;
+	int cpu;
+	int io_class;
+
+	*step = "set nice level";
+
+	if (setpriority(PRIO_PROCESS, 0, scheduling->nice) < 0) {
+		return -1;
+	}
+
+	switch (scheduling->policy) {
+	case PROCESS_SCHEDULING_POLICY_BATCH: policy = SCHED_BATCH; break;
+	case PROCESS_SCHEDULING_POLICY_IDLE:  policy = SCHED_IDLE;  break;
+	default:                              policy = SCHED_OTHER; break;
+	}
+
+	param.sched_priority = 0;
+
+	*step = "set scheduling policy";
+
+	if (sched_setscheduler(0, policy, &param) < 0) {
+		return -1;
+	}
+
+	if (scheduling->cpu_affinity != 0) {
+		CPU_ZERO(&cpu_set);
+
+		for (cpu = 0; cpu < 32; ++cpu) {
+			if ((scheduling->cpu_affinity & (1u << cpu)) != 0) {
+				CPU_SET(cpu, &cpu_set);
+			}
+		}
+
+		*step = "set CPU affinity";
+
+		if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0) {
+			return -1;
+		}
+	}
+
+	if (scheduling->io_priority_class != PROCESS_IO_PRIORITY_CLASS_NONE) {
+		if (scheduling->io_priority_class == PROCESS_IO_PRIORITY_CLASS_IDLE) {
+			io_class = PROCESS_IOPRIO_CLASS_IDLE << PROCESS_IOPRIO_CLASS_SHIFT;
+		} else {
+			io_class = (PROCESS_IOPRIO_CLASS_BE << PROCESS_IOPRIO_CLASS_SHIFT) |
+			           scheduling->io_priority_level;
+		}
+
+		*step = "set I/O priority";
+
+		if (syscall(SYS_ioprio_set, PROCESS_IOPRIO_WHO_PROCESS, 0, io_class) < 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+// the close_range syscall has the same number on all architectures, but older
+// headers don't define it
+#ifndef SYS_close_range
+	#define SYS_close_range 436
+#endif
+
+typedef struct {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+} ProcessDirent64;
+
+// closes all file descriptors starting at first_fd. the number of system
+// calls depends on the number of open file descriptors, not on the open FD
+// limit. this is used in the child process before execvpe, so it only uses
+// system calls and stack memory
+static int process_close_file_descriptors(int first_fd) {
+	int dir_fd;
+	char buffer[1024];
+	int length;
+	int offset;
+	ProcessDirent64 *dirent;
+	const char *p;
+	int fd;
+	bool closed;
+	long sc_open_max;
+
+	// Linux 5.9 and newer can do this with a single system call
+	if (syscall(SYS_close_range, first_fd, ~0U, 0) == 0) {
+		return 0;
+	}
+
+	// otherwise iterate the open file descriptors as listed in /proc/self/fd
+	dir_fd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (dir_fd >= 0) {
+		do {
+			closed = false;
+
+			while ((length = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer))) > 0) {
+				for (offset = 0; offset < length; offset += dirent->d_reclen) {
+					dirent = (ProcessDirent64 *)(buffer + offset);
+					fd = 0;
+
+					for (p = dirent->d_name; *p >= '0' && *p <= '9'; ++p) {
+						fd = fd * 10 + (*p - '0');
+					}
+
+					if (p == dirent->d_name || *p != '\0' || fd < first_fd || fd == dir_fd) {
+						continue; // "." and ".." or not to be closed
+					}
+
+					close(fd);
+
+					closed = true;
+				}
+			}
+
+			// closing file descriptors changes the directory while reading it.
+			// start over until nothing is left to close
+			if (length < 0 || (closed && lseek(dir_fd, 0, SEEK_SET) < 0)) {
+				close(dir_fd);
+
+				break;
+			}
+		} while (closed);
+
+		if (length >= 0 && !closed) {
+			close(dir_fd);
+
+			return 0;
+		}
+	}
+
+	// /proc is not mounted, fall back to closing each possible file descriptor
+	sc_open_max = sysconf(_SC_OPEN_MAX);
+
+	if (sc_open_max < 0) {
+		return -1;
+	}
+
+	for (fd = first_fd; fd < sc_open_max; ++fd) {
+		close(fd);
+	}
+
+	return 0;
+}
+
+static void process_spawn_child_error(ProcessSpawnContext *context, const char *step) {
+	ProcessSpawnStatus status;
+
+	status.error_code = api_get_error_code_from_errno();
+	status.error_number = errno;
+	status.step = step;
+
+	// notify parent in all cases. there is nothing left to do if this fails,
+	// the parent will see the status pipe closing without a status
+	robust_write(context->status_fd, &status, sizeof(status));
+
+	_exit(PROCESS_E_INTERNAL_ERROR);
+}
+
+// runs on a small dedicated stack in the memory of redapid until it calls
+// execvpe or _exit. therefore, it has to restrict itself to system calls and
+// must not log or change any state of redapid. the parent thread is suspended
+// meanwhile, so using its stack-allocated context is fine
+static int process_spawn_child(void *opaque) {
+	ProcessSpawnContext *context = opaque;
+	ProcessSpawnStatus status;
+	const char *step;
+	struct sigaction action;
+	sigset_t mask;
+	int i;
+	int inherited_fds[PROCESS_MAX_INHERITED_FDS];
+
+	// reset all signal handlers from parent so nothing unexpected can happen
+	// once signals are unblocked. the signal handlers are not shared with
+	// redapid, because clone was called without CLONE_SIGHAND
+	action.sa_handler = SIG_DFL;
+	action.sa_flags = 0;
+
+	sigemptyset(&action.sa_mask);
+
+	for (i = 1; i < NSIG; ++i) {
+		sigaction(i, &action, NULL);
+	}
+
+	// unblock all signals
+	sigemptyset(&mask);
+
+	if (pthread_sigmask(SIG_SETMASK, &mask, NULL) != 0) {
+		process_spawn_child_error(context, "unblock signals");
+	}
+
+	// become leader of a new session and process group, so the whole process
+	// tree can be signalled at once, including processes started by wrapper
+	// scripts
+	if (setsid() < 0) {
+		process_spawn_child_error(context, "create new session");
+	}
+
+	// move into control group, while still having the permission to do so
+	if (context->cgroup_fd >= 0 && write(context->cgroup_fd, "0", 1) < 0) {
+		process_spawn_child_error(context, "move into control group");
+	}
+
+	// apply scheduling attributes, while still having the permission to
+	// lower the nice level
+	if (context->scheduling != NULL &&
+	    process_set_scheduling_attributes(context->scheduling, &step) < 0) {
+		process_spawn_child_error(context, step);
+	}
+
+	// change user and groups. the glibc functions cannot be used here, they
+	// would try to change the IDs of all redapid threads
+	if (identity_set_thread_gid(context->gid) < 0) {
+		process_spawn_child_error(context, "change real and effective group ID");
+	}
+
+	if (identity_set_thread_groups(context->group_count, context->groups) < 0) {
+		process_spawn_child_error(context, "set secondary group IDs");
+	}
+
+	if (identity_set_thread_uid(context->uid) < 0) {
+		process_spawn_child_error(context, "change real and effective user ID");
+	}
+
+	// change directory
+	if (chdir(context->working_directory) < 0) {
+		process_spawn_child_error(context, "change to working directory");
+	}
+
+	// redirect stdin, stdout and stderr
+	if (dup2(context->stdin_fd, STDIN_FILENO) != STDIN_FILENO) {
+		process_spawn_child_error(context, "redirect stdin");
+	}
+
+	if (dup2(context->stdout_fd, STDOUT_FILENO) != STDOUT_FILENO) {
+		process_spawn_child_error(context, "redirect stdout");
+	}
+
+	if (dup2(context->stderr_fd, STDERR_FILENO) != STDERR_FILENO) {
+		process_spawn_child_error(context, "redirect stderr");
+	}
+
+	// notify parent
+	status.error_code = API_E_SUCCESS;
+	status.error_number = 0;
+	status.step = NULL;
+
+	if (robust_write(context->status_fd, &status, sizeof(status)) < 0) {
+		process_spawn_child_error(context, "write to status pipe");
+	}
 
-		// unblock all signals in the child
-		sigemptyset(&newmask);
+	// pass inherited file descriptors. move them above their final numbers
+	// first, so they cannot overwrite each other. the status pipe might be
+	// overwritten, so there is no way to report an error anymore
+	for (i = 0; i < context->inherited_fd_count; ++i) {
+		inherited_fds[i] = fcntl(context->inherited_fds[i], F_DUPFD,
+		                         STDERR_FILENO + 1 + context->inherited_fd_count);
 
-		if (pthread_sigmask(SIG_SETMASK, &newmask, NULL) != 0) {
-			log_error("Could not unblock signals: %s (%d)",
-			          get_errno_name(errno), errno);
+		if (inherited_fds[i] < 0) {
+			_exit(PROCESS_E_INTERNAL_ERROR);
+		}
+	}
 
+	for (i = 0; i < context->inherited_fd_count; ++i) {
+		if (dup2(inherited_fds[i], STDERR_FILENO + 1 + i) < 0) {
 			_exit(PROCESS_E_INTERNAL_ERROR);
 		}
+	}
 
-		return API_E_SUCCESS;
+	// close all other file descriptors. execvpe can still be attempted if
+	// this fails
+	process_close_file_descriptors(STDERR_FILENO + 1 + context->inherited_fd_count);
+
+	// execvpe only returns in case of an error
+	execvpe(context->executable, context->arguments, context->environment);
+
+	if (errno == ENOENT) {
+		_exit(PROCESS_E_DOES_NOT_EXIST);
+	} else {
+		_exit(PROCESS_E_CANNOT_EXECUTE);
 	}
+
+	return -1; // unreachable
 }
 
-APIE process_set_identity(uid_t uid, gid_t gid) {
-	APIE error_code;
-	struct passwd *pw;
-	gid_t groups[128]; // FIXME: maybe allocate this dynamically
-	int length = sizeof(groups) / sizeof(gid_t);
+// starts process_spawn_child in a vfork-style child process that shares the
+// memory of redapid instead of copying its page tables as fork does. this
+// keeps the spawn latency independent of the memory usage of redapid. the
+// calling thread is suspended until the child process called execvpe or _exit
+static APIE process_clone(ProcessSpawnContext *context, int argument_count, pid_t *pid) {
+	size_t stack_size;
+	void *stack;
+	sigset_t oldmask, newmask;
+	APIE error_code = API_E_SUCCESS;
+
+	// execvpe allocates a copy of the arguments on the stack to run scripts
+	// without shebang line
+	stack_size = PROCESS_SPAWN_STACK_SIZE + (argument_count + 2) * sizeof(char *);
+	stack_size = (stack_size + getpagesize() - 1) & ~((size_t)getpagesize() - 1);
 
-	// get username
-	pw = getpwuid(uid);
+	stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+	             MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
 
-	if (pw == NULL) {
+	if (stack == MAP_FAILED) {
 		error_code = api_get_error_code_from_errno();
 
-		log_error("Could not get passwd entry for user ID %u: %s (%d)",
-		          uid, get_errno_name(errno), errno);
+		log_error("Could not allocate stack for spawning child process: %s (%d)",
+		          get_errno_name(errno), errno);
 
 		return error_code;
 	}
 
-	// get (secondary) groups
-	if (getgrouplist(pw->pw_name, pw->pw_gid, groups, &length) < 0) {
-		error_code = api_get_error_code_from_errno();
+	// block signals now, so that the child process can safely disable the
+	// signal handlers without a race and no signal handler runs on its stack
+	sigfillset(&newmask);
 
-		log_error("Could not get secondary groups for user ID %u: %s (%d)",
-		          uid, get_errno_name(errno), errno);
+	if (pthread_sigmask(SIG_SETMASK, &newmask, &oldmask) != 0) {
+		log_error("Could not block signals: %s (%d)",
+		          get_errno_name(errno), errno);
 
-		return error_code;
+		munmap(stack, stack_size);
+
+		return API_E_INTERNAL_ERROR;
 	}
 
-	// set (primary) group
-	if (setregid(gid, gid) < 0) {
-		error_code = api_get_error_code_from_errno();
+	// the stack grows downwards on all supported architectures
+	*pid = clone(process_spawn_child, (char *)stack + stack_size,
+	             CLONE_VM | CLONE_VFORK | SIGCHLD, context);
 
-		log_error("Could not change real and effective group ID to %u: %s (%d)",
-		          gid, get_errno_name(errno), errno);
+	if (*pid < 0) {
+		error_code = api_get_error_code_from_errno();
 
-		return error_code;
+		log_error("Could not clone child process: %s (%d)",
+		          get_errno_name(errno), errno);
 	}
 
-	// set (secondary) groups
-	if (setgroups(length, groups) < 0) {
-		error_code = api_get_error_code_from_errno();
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 
-		log_error("Could not set secondary group IDs of user ID %u: %s (%d)",
-		          uid, get_errno_name(errno), errno);
+	munmap(stack, stack_size);
 
-		return error_code;
-	}
+	return error_code;
+}
 
-	// set user
-	if (setreuid(uid, uid) < 0) {
+// checks the status reported by the child process before calling execvpe
+static APIE process_read_spawn_status(int status_fd, const char *executable, pid_t pid) {
+	ProcessSpawnStatus status;
+	APIE error_code;
+	int rc;
+
+	rc = robust_read(status_fd, &status, sizeof(status));
+
+	if (rc < 0) {
 		error_code = api_get_error_code_from_errno();
 
-		log_error("Could not change real and effective user ID to %u: %s (%d)",
-		          uid, get_errno_name(errno), errno);
+		log_error("Could not read from status pipe for child process (executable: %s, pid: %u): %s (%d)",
+		          executable, pid, get_errno_name(errno), errno);
 
 		return error_code;
 	}
 
-	return API_E_SUCCESS;
-}
+	if (rc < (int)sizeof(status)) {
+		log_error("Child process (executable: %s, pid: %u) exited without reporting its status",
+		          executable, pid);
 
-const char *process_get_error_code_name(ProcessE error_code) {
-	#define ERROR_CODE_NAME(code) case code: return #code
+		return API_E_INTERNAL_ERROR;
+	}
 
-	switch (error_code) {
-	ERROR_CODE_NAME(PROCESS_E_INTERNAL_ERROR);
-	ERROR_CODE_NAME(PROCESS_E_CANNOT_EXECUTE);
-	ERROR_CODE_NAME(PROCESS_E_DOES_NOT_EXIST);
+	if (status.error_code != API_E_SUCCESS) {
+		log_error("Could not %s for child process (executable: %s, pid: %u): %s (%d)",
+		          status.step, executable, pid,
+		          get_errno_name(status.error_number), status.error_number);
 
-	default: return "<unknown>";
+		return status.error_code;
 	}
 
-	#undef ERROR_CODE_NAME
+	return API_E_SUCCESS;
 }
 
+// if zygote is not NULL then the child process is forked from it instead of
+// executing the executable. it inherits identity, control group and
+// scheduling attributes from the zygote, so uid, gid, cgroup and scheduling
+// are not used then
 // public API
 APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
                    ObjectID environment_id, ObjectID working_directory_id,
                    uint32_t uid, uint32_t gid, ObjectID stdin_id,
-                   ObjectID stdout_id, ObjectID stderr_id, Session *session,
-                   uint16_t object_create_flags, bool release_on_death,
+                   ObjectID stdout_id, ObjectID stderr_id, const char *cgroup,
+                   uint32_t output_buffer_size, ProcessSchedulingAttributes *scheduling,
+                   const int *inherited_fds, int inherited_fd_count, Zygote *zygote,
+                   Session *session, uint16_t object_create_flags, bool release_on_death,
                    ProcessStateChangedFunction state_changed, void *opaque,
                    ObjectID *id, Process **object) {
 	int phase = 0;
@@ -397,9 +1632,18 @@ APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
 	File *stderr;
 	pid_t pid;
 	int status_pipe[2];
-	int sc_open_max;
-	FILE *log_file;
+	ProcessOutput *output = NULL;
+	ProcessSpawnContext context;
+	char buffer[1024];
 	Process *process;
+	Process **process_ptr;
+
+	if (inherited_fd_count > PROCESS_MAX_INHERITED_FDS) {
+		log_error("Cannot pass %d file descriptors to child process, maximum is %d",
+		          inherited_fd_count, PROCESS_MAX_INHERITED_FDS);
+
+		return API_E_INVALID_PARAMETER;
+	}
 
 	// acquire and lock executable string object
 	error_code = string_get_acquired_and_locked(executable_id, &executable);
@@ -599,145 +1843,105 @@ APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
 
 	phase = 10;
 
-	// fork
-	log_debug("Forking to spawn child process (executable: %s)", executable->buffer);
-
-	error_code = process_fork(&pid);
-
-	if (error_code != API_E_SUCCESS) {
-		goto cleanup;
-	}
-
-	if (pid == 0) { // child
-		close(status_pipe[0]);
-
-		// change user and groups
-		error_code = process_set_identity(uid, gid);
+	// create capture pipes and output buffer
+	if (output_buffer_size > 0) {
+		error_code = process_output_create(&output, output_buffer_size, stdout, stderr);
 
 		if (error_code != API_E_SUCCESS) {
-			goto child_error;
+			goto cleanup;
 		}
+	}
 
-		// change directory
-		if (chdir(working_directory->buffer) < 0) {
-			error_code = api_get_error_code_from_errno();
-
-			log_error("Could not change directory to '%s' for child process (executable: %s, pid: %u): %s (%d)",
-			          working_directory->buffer, executable->buffer, getpid(), get_errno_name(errno), errno);
+	phase = 11;
 
-			goto child_error;
-		}
+	// prepare child process
+	context.executable = executable->buffer;
+	context.arguments = (char **)arguments_array.bytes;
+	context.environment = (char **)environment_array.bytes;
+	context.working_directory = working_directory->buffer;
+	context.uid = uid;
+	context.gid = gid;
+	context.stdin_fd = file_get_read_handle(stdin);
+	context.stdout_fd = output != NULL ? output->stdout_stream.write_fd : file_get_write_handle(stdout);
+	context.stderr_fd = output != NULL ? output->stderr_stream.write_fd : file_get_write_handle(stderr);
+	context.status_fd = status_pipe[1];
+	context.cgroup_fd = -1;
+	context.scheduling = scheduling;
+	context.inherited_fds = inherited_fds;
+	context.inherited_fd_count = inherited_fd_count;
+
+	// resolve groups here, getpwuid cannot be used in the child process
+	error_code = identity_get_groups(uid, &context.groups, &context.group_count);
 
-		// get open FD limit
-		sc_open_max = sysconf(_SC_OPEN_MAX);
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
 
-		if (sc_open_max < 0) {
+	if (cgroup != NULL && zygote == NULL) {
+		if (robust_snprintf(buffer, sizeof(buffer), "%s/cgroup.procs", cgroup) < 0) {
 			error_code = api_get_error_code_from_errno();
 
-			log_error("Could not get SC_OPEN_MAX value: %s (%d)",
+			log_error("Could not format control group file name: %s (%d)",
 			          get_errno_name(errno), errno);
 
-			goto child_error;
-		}
-
-		// redirect stdin
-		if (dup2(file_get_read_handle(stdin), STDIN_FILENO) != STDIN_FILENO) {
-			error_code = api_get_error_code_from_errno();
-
-			log_error("Could not redirect stdin for child process (executable: %s, pid: %u): %s (%d)",
-			          executable->buffer, getpid(), get_errno_name(errno), errno);
-
-			goto child_error;
-		}
-
-		// redirect stdout
-		if (dup2(file_get_write_handle(stdout), STDOUT_FILENO) != STDOUT_FILENO) {
-			error_code = api_get_error_code_from_errno();
-
-			log_error("Could not redirect stdout for child process (executable: %s, pid: %u): %s (%d)",
-			          executable->buffer, getpid(), get_errno_name(errno), errno);
-
-			goto child_error;
-		}
-
-		// stderr is the default log output in non-daemon mode. if this is
-		// the case then disable the log output before redirecting stderr to
-		// avoid polluting stderr for the new process
-		log_file = log_get_file();
-
-		if (log_file != NULL && fileno(log_file) == STDERR_FILENO) {
-			log_debug("Disable logging to stderr for child process (executable: %s, pid: %u)",
-			          executable->buffer, getpid());
-
-			log_set_file(NULL);
+			goto cleanup;
 		}
 
-		// redirect stderr
-		if (dup2(file_get_write_handle(stderr), STDERR_FILENO) != STDERR_FILENO) {
-			error_code = api_get_error_code_from_errno();
-
-			log_error("Could not redirect stderr for child process (executable: %s, pid: %u): %s (%d)",
-			          executable->buffer, getpid(), get_errno_name(errno), errno);
-
-			goto child_error;
-		}
+		context.cgroup_fd = open(buffer, O_WRONLY | O_CLOEXEC);
 
-		// notify parent
-		if (robust_write(status_pipe[1], &error_code, sizeof(error_code)) < 0) {
+		if (context.cgroup_fd < 0) {
 			error_code = api_get_error_code_from_errno();
 
-			log_error("Could not write to status pipe for child process (executable: %s, pid: %u): %s (%d)",
-			          executable->buffer, getpid(), get_errno_name(errno), errno);
+			log_error("Could not open '%s' for spawning child process (executable: %s): %s (%d)",
+			          buffer, executable->buffer, get_errno_name(errno), errno);
 
-			goto child_error;
-		}
-
-		// disable log output. if stderr was not the current log output then
-		// the log file is still open at this point. the next step is to close
-		// all remaining file descriptors. just for good measure disable the
-		// log output beforehand
-		log_set_file(NULL);
-
-		// close all file descriptors except the std* ones
-		for (i = STDERR_FILENO + 1; i < sc_open_max; ++i) {
-			close(i);
+			goto cleanup;
 		}
+	}
 
-		// execvpe only returns in case of an error
-		execvpe(executable->buffer, (char **)arguments_array.bytes, (char **)environment_array.bytes);
+	// clone or fork from zygote
+	if (zygote != NULL) {
+		log_debug("Forking zygote to spawn child process (executable: %s)", executable->buffer);
 
-		if (errno == ENOENT) {
-			_exit(PROCESS_E_DOES_NOT_EXIST);
-		} else {
-			_exit(PROCESS_E_CANNOT_EXECUTE);
-		}
+		error_code = zygote_fork(zygote, context.working_directory, context.arguments,
+		                         context.environment, context.stdin_fd,
+		                         context.stdout_fd, context.stderr_fd, &pid);
+	} else {
+		log_debug("Cloning to spawn child process (executable: %s)", executable->buffer);
 
-	child_error:
-		// notify parent in all cases
-		if (robust_write(status_pipe[1], &error_code, sizeof(error_code)) < 0) {
-			log_error("Could not write to status pipe for child process (executable: %s, pid: %u): %s (%d)",
-			          executable->buffer, getpid(), get_errno_name(errno), errno);
-		}
+		error_code = process_clone(&context, arguments_array.count, &pid);
+	}
 
-		close(status_pipe[1]);
+	if (context.cgroup_fd >= 0) {
+		close(context.cgroup_fd);
+	}
 
-		_exit(PROCESS_E_INTERNAL_ERROR);
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
 	}
 
-	phase = 11;
+	phase = 12;
 
-	// wait for child to start successfully
-	if (robust_read(status_pipe[0], &error_code, sizeof(error_code)) < 0) {
-		error_code = api_get_error_code_from_errno();
+	// the child process either called execvpe or _exit by now. close the write
+	// end of the status pipe, so reading from it cannot block if the child
+	// process could not report its status
+	close(status_pipe[1]);
 
-		log_error("Could not read from status pipe for child process (executable: %s, pid: %u): %s (%d)",
-		          executable->buffer, pid, get_errno_name(errno), errno);
+	status_pipe[1] = -1;
 
-		goto cleanup;
+	// same for the capture pipes, otherwise their read ends never see EOF
+	if (output != NULL) {
+		process_output_close_write_ends(output);
 	}
 
-	if (error_code != API_E_SUCCESS) {
-		goto cleanup;
+	// check if child started successfully. a zygote reports errors of its
+	// child process as exit code instead
+	if (zygote == NULL) {
+		error_code = process_read_spawn_status(status_pipe[0], executable->buffer, pid);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
 	}
 
 	// create process object
@@ -752,7 +1956,7 @@ APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
 		goto cleanup;
 	}
 
-	phase = 12;
+	phase = 13;
 
 	// setup process object
 	process->executable = executable;
@@ -771,25 +1975,47 @@ APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
 	process->state = PROCESS_STATE_RUNNING;
 	process->timestamp = time(NULL);
 	process->exit_code = 0; // invalid
+	process->output = output;
+	process->pgid = pid; // the child process is the process group leader
+	process->killing_tree = false;
+	process->tree_kill_deadline = 0;
+	process->tree_killed = NULL;
+	process->tree_killed_opaque = NULL;
+	process->zygote = zygote;
+
+	// track child process for state changes
+	if (zygote != NULL) {
+		error_code = zygote_track(zygote, process);
 
-	if (pipe_create(&process->state_change_pipe, 0) < 0) {
-		error_code = api_get_error_code_from_errno();
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+	} else {
+		process_ptr = array_append(&_processes);
 
-		log_error("Could not create state change pipe child process (executable: %s, pid: %u): %s (%d)",
-		          executable->buffer, pid, get_errno_name(errno), errno);
+		if (process_ptr == NULL) {
+			error_code = api_get_error_code_from_errno();
 
-		goto cleanup;
-	}
+			log_error("Could not append to process array: %s (%d)",
+			          get_errno_name(errno), errno);
 
-	phase = 13;
+			goto cleanup;
+		}
 
-	if (event_add_source(process->state_change_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC,
-	                     EVENT_READ, process_handle_state_change, process) < 0) {
-		goto cleanup;
+		*process_ptr = process;
 	}
 
 	phase = 14;
 
+	// start capturing stdout and stderr
+	if (output != NULL) {
+		error_code = process_output_register(process);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
 	// create process object
 	error_code = object_create(&process->base,
 	                           OBJECT_TYPE_PROCESS,
@@ -813,9 +2039,6 @@ APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
 		*object = process;
 	}
 
-	// start thread to wait for child process state changes
-	thread_create(&process->wait_thread, process_wait, process);
-
 	log_debug("Spawned process object (id: %u, executable: %s, pid: %u)",
 	          process->base.id, executable->buffer, process->pid);
 
@@ -827,16 +2050,22 @@ APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
 cleanup:
 	switch (phase) { // no breaks, all cases fall through intentionally
 	case 14:
-		event_remove_source(process->state_change_pipe.read_end, EVENT_SOURCE_TYPE_GENERIC);
+		process_untrack(process);
 
 	case 13:
-		pipe_destroy(&process->state_change_pipe);
+		free(process);
 
 	case 12:
-		free(process);
+		kill(pid, SIGKILL);
+
+		if (zygote == NULL) {
+			while (waitpid(pid, NULL, 0) < 0 && errno_interrupted());
+		}
 
 	case 11:
-		kill(pid, SIGKILL);
+		if (output != NULL) {
+			process_output_destroy(output);
+		}
 
 	case 10:
 		close(status_pipe[0]);
@@ -881,11 +2110,9 @@ APIE process_kill(Process *process, ProcessSignal signal) {
 	int rc;
 	APIE error_code;
 
-	// FIXME: here is a race condition, because the child process might already
-	//        be dead at this point, but the process state didn't get updated
-	//        yet. this can result in trying to kill a process that's not
-	//        existing anymore. or even worse, the process ID has already been
-	//        reused and an unrelated process gets killed here
+	// the child process is reaped by the event loop thread, together with
+	// updating its state. if it died meanwhile, but the state didn't get
+	// updated yet, then it's a zombie and its process ID cannot be reused
 	if (!process_is_alive(process)) {
 		log_warn("Cannot send signal (number: %d) to an already dead child process (executable: %s)",
 		         signal, process->executable->buffer);
@@ -907,6 +2134,81 @@ APIE process_kill(Process *process, ProcessSignal signal) {
 	return API_E_SUCCESS;
 }
 
+// public API
+APIE process_kill_tree(Process *process, ProcessSignal signal, uint32_t timeout,
+                       ProcessTreeKilledFunction tree_killed, void *opaque) {
+	APIE error_code;
+
+	process->tree_killed = tree_killed;
+	process->tree_killed_opaque = opaque;
+
+	if (process->pgid == 0 || !process_group_exists(process->pgid)) {
+		process_finish_tree_kill(process);
+
+		return API_E_SUCCESS;
+	}
+
+	if (kill(-process->pgid, signal) < 0) {
+		if (errno == ESRCH) {
+			process_finish_tree_kill(process);
+
+			return API_E_SUCCESS;
+		}
+
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not send signal (number: %d) to process group %u (executable: %s): %s (%d)",
+		          signal, process->pgid, process->executable->buffer,
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	// stopped members cannot handle a signal like SIGTERM, resume them
+	if (signal != PROCESS_SIGNAL_KILL && signal != PROCESS_SIGNAL_STOP &&
+	    signal != PROCESS_SIGNAL_CONTINUE) {
+		kill(-process->pgid, SIGCONT);
+	}
+
+	if (signal == PROCESS_SIGNAL_KILL || timeout == 0) {
+		process->tree_kill_deadline = 0;
+	} else if (!process->killing_tree || process->tree_kill_deadline > 0) {
+		process->tree_kill_deadline = microseconds() + (uint64_t)timeout * 1000;
+	}
+
+	if (process->killing_tree) {
+		return API_E_SUCCESS; // already polling
+	}
+
+	if (timer_create_(&process->tree_timer, process_handle_tree_timer, process) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create process tree timer: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	if (timer_configure(&process->tree_timer, PROCESS_TREE_POLL_INTERVAL * 1000,
+	                    PROCESS_TREE_POLL_INTERVAL * 1000) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not start process tree timer: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		timer_destroy(&process->tree_timer);
+
+		return error_code;
+	}
+
+	process->killing_tree = true;
+
+	log_debug("Killing process tree of process object (id: %u, executable: %s) with signal (number: %d)",
+	          process->base.id, process->executable->buffer, signal);
+
+	return API_E_SUCCESS;
+}
+
 // public API
 APIE process_get_command(Process *process, Session *session, ObjectID *executable_id,
                          ObjectID *arguments_id, ObjectID *environment_id,
@@ -1045,6 +2347,133 @@ APIE process_get_state(Process *process, uint8_t *state, uint64_t *timestamp,
 	return API_E_SUCCESS;
 }
 
+// public API
+APIE process_get_resource_usage(Process *process, uint64_t *user_time,
+                                uint64_t *system_time, uint32_t *resident_set_size,
+                                uint32_t *peak_resident_set_size, uint64_t *read_bytes,
+                                uint64_t *write_bytes, uint32_t *voluntary_context_switches,
+                                uint32_t *involuntary_context_switches) {
+	ProcessResourceUsage *usage = &process->resource_usage;
+	uint64_t now;
+	APIE error_code;
+
+	// sample a running child process at most once per interval, regardless
+	// of how many clients are polling. for a dead child process the final
+	// resource usage got stored when it was reaped
+	if (process_is_alive(process)) {
+		now = microseconds();
+
+		if (process->resource_usage_timestamp == 0 ||
+		    now >= process->resource_usage_timestamp + (uint64_t)PROCESS_RESOURCE_USAGE_INTERVAL * 1000) {
+			error_code = process_sample_resource_usage(process);
+
+			if (error_code != API_E_SUCCESS) {
+				return error_code;
+			}
+
+			process->resource_usage_timestamp = now;
+		}
+	}
+
+	*user_time = usage->user_time;
+	*system_time = usage->system_time;
+	*resident_set_size = usage->resident_set_size;
+	*peak_resident_set_size = usage->peak_resident_set_size;
+	*read_bytes = usage->read_bytes;
+	*write_bytes = usage->write_bytes;
+	*voluntary_context_switches = usage->voluntary_context_switches;
+	*involuntary_context_switches = usage->involuntary_context_switches;
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE process_get_output_tail(Process *process, uint32_t max_length,
+                             Session *session, ObjectID *output_string_id) {
+	ProcessOutput *output = process->output;
+	uint32_t length;
+	uint32_t start;
+	uint32_t chunk;
+	char *buffer;
+	APIE error_code;
+
+	if (output == NULL) {
+		log_warn("Cannot get output tail of process object (id: %u, executable: %s) without output buffer",
+		         process->base.id, process->executable->buffer);
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	length = output->length < max_length ? output->length : max_length;
+	start = (output->end + output->size - length) % output->size;
+	buffer = malloc(length > 0 ? length : 1);
+
+	if (buffer == NULL) {
+		log_error("Could not allocate %u byte output tail buffer: %s (%d)",
+		          length, get_errno_name(ENOMEM), ENOMEM);
+
+		return API_E_NO_FREE_MEMORY;
+	}
+
+	chunk = output->size - start;
+
+	if (chunk > length) {
+		chunk = length;
+	}
+
+	memcpy(buffer, output->buffer + start, chunk);
+	memcpy(buffer + chunk, output->buffer, length - chunk);
+
+	// the output might contain NULL bytes, don't cut it off at the first one
+	error_code = string_wrap_with_length(buffer, length, session, OBJECT_CREATE_FLAG_EXTERNAL,
+	                                     output_string_id, NULL);
+
+	free(buffer);
+
+	return error_code;
+}
+
 bool process_is_alive(Process *process) {
 	return process_state_is_alive(process->state);
 }
+
+// for child processes that are not children of redapid and are reaped by
+// someone else, e.g. by a zygote
+void process_report_state_change(Process *process, int status, struct rusage *rusage) {
+	process_handle_state_change(process, status, rusage);
+}
+
+APIE process_validate_scheduling_attributes(ProcessSchedulingAttributes *scheduling) {
+	if (scheduling->nice < PROCESS_MIN_NICE || scheduling->nice > PROCESS_MAX_NICE) {
+		log_warn("Nice level %d is out of range [%d..%d]",
+		         scheduling->nice, PROCESS_MIN_NICE, PROCESS_MAX_NICE);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	if (scheduling->policy != PROCESS_SCHEDULING_POLICY_NORMAL &&
+	    scheduling->policy != PROCESS_SCHEDULING_POLICY_BATCH &&
+	    scheduling->policy != PROCESS_SCHEDULING_POLICY_IDLE) {
+		log_warn("Invalid scheduling policy %d", scheduling->policy);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (scheduling->io_priority_class != PROCESS_IO_PRIORITY_CLASS_NONE &&
+	    scheduling->io_priority_class != PROCESS_IO_PRIORITY_CLASS_BEST_EFFORT &&
+	    scheduling->io_priority_class != PROCESS_IO_PRIORITY_CLASS_IDLE) {
+		log_warn("Invalid I/O priority class %d", scheduling->io_priority_class);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	if (scheduling->io_priority_level < 0 ||
+	    scheduling->io_priority_level > PROCESS_MAX_IO_PRIORITY_LEVEL) {
+		log_warn("I/O priority level %d is out of range [0..%d]",
+		         scheduling->io_priority_level, PROCESS_MAX_IO_PRIORITY_LEVEL);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	return API_E_SUCCESS;
+}
@@ -22,9 +22,10 @@
 #ifndef REDAPID_PROCESS_H
 #define REDAPID_PROCESS_H
 
+#include <sys/resource.h>
 #include <sys/types.h>
 
-#include <daemonlib/threads.h>
+#include <daemonlib/timer.h>
 
 #include "file.h"
 #include "list.h"
@@ -58,7 +59,72 @@ typedef enum {
 	PROCESS_E_DOES_NOT_EXIST = 127  // EXIT_ENOENT: could not find executable to exec
 } ProcessE;
 
+typedef enum {
+	PROCESS_SCHEDULING_POLICY_NORMAL = 0, // SCHED_OTHER
+	PROCESS_SCHEDULING_POLICY_BATCH,      // SCHED_BATCH: CPU-bound, never preempts others on wakeup
+	PROCESS_SCHEDULING_POLICY_IDLE        // SCHED_IDLE: only runs if nothing else wants to run
+} ProcessSchedulingPolicy;
+
+typedef enum {
+	PROCESS_IO_PRIORITY_CLASS_NONE = 0,    // derived from the nice level
+	PROCESS_IO_PRIORITY_CLASS_BEST_EFFORT, // with io_priority_level 0 (highest) to 7 (lowest)
+	PROCESS_IO_PRIORITY_CLASS_IDLE         // only gets disk time if no one else needs it
+} ProcessIOPriorityClass;
+
+#define PROCESS_MIN_NICE -20
+#define PROCESS_MAX_NICE 19
+#define PROCESS_MAX_IO_PRIORITY_LEVEL 7
+
+#define PROCESS_RESOURCE_USAGE_INTERVAL 1000 // milliseconds, between samples of a running process
+#define PROCESS_MAX_OUTPUT_BUFFER_SIZE (1024 * 1024) // bytes
+#define PROCESS_TREE_POLL_INTERVAL 100 // milliseconds, between checks if a process group is gone
+#define PROCESS_MAX_INHERITED_FDS 4 // passed to the child process as file descriptors 3, 4, ...
+
+typedef struct _Zygote Zygote;
+
 typedef void (*ProcessStateChangedFunction)(void *opaque);
+typedef void (*ProcessTreeKilledFunction)(void *opaque);
+
+typedef struct {
+	uint64_t user_time; // microseconds
+	uint64_t system_time; // microseconds
+	uint32_t resident_set_size; // KiB, 0 for a dead process
+	uint32_t peak_resident_set_size; // KiB
+	uint64_t read_bytes; // from storage
+	uint64_t write_bytes; // to storage
+	uint32_t voluntary_context_switches;
+	uint32_t involuntary_context_switches;
+} ProcessResourceUsage;
+
+typedef struct {
+	int nice; // PROCESS_MIN_NICE to PROCESS_MAX_NICE
+	ProcessSchedulingPolicy policy;
+	uint32_t cpu_affinity; // bitmask of the CPUs to run on, 0 for all
+	ProcessIOPriorityClass io_priority_class;
+	int io_priority_level; // 0 to PROCESS_MAX_IO_PRIORITY_LEVEL, only for PROCESS_IO_PRIORITY_CLASS_BEST_EFFORT
+} ProcessSchedulingAttributes;
+
+#define PROCESS_OUTPUT_CHUNK_SIZE 4096 // bytes
+
+typedef struct {
+	int fd; // read end of the capture pipe, -1 if closed or shared with stdout
+	int write_fd; // write end, only open until the child process is spawned
+	int forward_fd; // private non-blocking descriptor of a non-regular file, -1 otherwise
+	uint8_t pending[PROCESS_OUTPUT_CHUNK_SIZE]; // read, but not forwarded yet
+	int pending_offset;
+	int pending_length; // the read end is not polled while this is > 0
+} ProcessOutputStream;
+
+typedef struct {
+	uint8_t *buffer; // ring buffer of the most recent stdout and stderr output
+	uint32_t size;
+	uint32_t end; // index after the most recent byte
+	uint32_t length; // number of valid bytes, <= size
+	ProcessOutputStream stdout_stream;
+	ProcessOutputStream stderr_stream;
+	uint64_t dropped_length; // bytes not forwarded, because the process object got destroyed
+	bool registered; // read ends are added as event sources
+} ProcessOutput;
 
 typedef struct {
 	Object base;
@@ -79,23 +145,38 @@ typedef struct {
 	ProcessState state;
 	uint64_t timestamp;
 	uint8_t exit_code;
-	Pipe state_change_pipe;
-	Thread wait_thread;
+	ProcessResourceUsage resource_usage; // cached sample or final usage
+	uint64_t resource_usage_timestamp; // microseconds, 0 if never sampled
+	ProcessOutput *output; // NULL if stdout and stderr are not captured
+	pid_t pgid; // process group and session of the child process, 0 once the group is gone
+	bool killing_tree;
+	Timer tree_timer; // only created while killing_tree is true
+	uint64_t tree_kill_deadline; // microseconds, 0 if not escalating to SIGKILL (anymore)
+	ProcessTreeKilledFunction tree_killed;
+	void *tree_killed_opaque;
+	Zygote *zygote; // forked the child process, NULL if it is a child of redapid or dead
 } Process;
 
+int process_init(void);
+void process_exit(void);
+
 APIE process_fork(pid_t *pid);
-APIE process_set_identity(uid_t uid, gid_t gid);
+APIE process_set_identity(uid_t uid, gid_t gid, const gid_t *groups, int group_count);
 
 const char *process_get_error_code_name(ProcessE error_code);
 
 APIE process_spawn(ObjectID executable_id, ObjectID arguments_id,
                    ObjectID environment_id, ObjectID working_directory_id,
                    uint32_t uid, uint32_t gid, ObjectID stdin_id,
-                   ObjectID stdout_id, ObjectID stderr_id, Session *session,
-                   uint16_t object_create_flags, bool release_on_death,
+                   ObjectID stdout_id, ObjectID stderr_id, const char *cgroup,
+                   uint32_t output_buffer_size, ProcessSchedulingAttributes *scheduling,
+                   const int *inherited_fds, int inherited_fd_count, Zygote *zygote,
+                   Session *session, uint16_t object_create_flags, bool release_on_death,
                    ProcessStateChangedFunction state_changed, void *opaque,
                    ObjectID *id, Process **object);
 APIE process_kill(Process *process, ProcessSignal signal);
+APIE process_kill_tree(Process *process, ProcessSignal signal, uint32_t timeout,
+                       ProcessTreeKilledFunction tree_killed, void *opaque);
 
 APIE process_get_command(Process *process, Session *session, ObjectID *executable_id,
                          ObjectID *arguments_id, ObjectID *environment_id,
@@ -106,7 +187,17 @@ APIE process_get_stdio(Process *process, Session *session, ObjectID *stdin_id,
                        ObjectID *stdout_id, ObjectID *stderr_id);
 APIE process_get_state(Process *process, uint8_t *state, uint64_t *timestamp,
                        uint8_t *exit_code);
+APIE process_get_resource_usage(Process *process, uint64_t *user_time,
+                                uint64_t *system_time, uint32_t *resident_set_size,
+                                uint32_t *peak_resident_set_size, uint64_t *read_bytes,
+                                uint64_t *write_bytes, uint32_t *voluntary_context_switches,
+                                uint32_t *involuntary_context_switches);
+APIE process_get_output_tail(Process *process, uint32_t max_length,
+                             Session *session, ObjectID *output_string_id);
 
 bool process_is_alive(Process *process);
+void process_report_state_change(Process *process, int status, struct rusage *rusage);
+
+APIE process_validate_scheduling_attributes(ProcessSchedulingAttributes *scheduling);
 
 #endif // REDAPID_PROCESS_H
@@ -33,8 +33,10 @@
 
 #include "acl.h"
 #include "api.h"
+#include "cgroup.h"
 #include "directory.h"
 #include "inventory.h"
+#include "purge.h"
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
@@ -512,13 +514,14 @@ APIE program_purge(Program *program, uint32_t cookie) {
 	// shutdown scheduler, this will also kill any remaining process
 	program_scheduler_shutdown(&program->scheduler);
 
-	// move program root directory to /tmp/purged-program-<identifier>-<timestamp>
+	// move program root directory to /tmp/purged-program-<identifier>-<timestamp>,
+	// the purge subsystem removes it from there in the background
 	if (gettimeofday(&timestamp, NULL) < 0) {
 		timestamp.tv_sec = time(NULL);
 		timestamp.tv_usec = getpid();
 	}
 
-	if (robust_snprintf(tmp, sizeof(tmp), "/tmp/purged-program-%s-%llu%06llu",
+	if (robust_snprintf(tmp, sizeof(tmp), PURGE_DIRECTORY"/"PURGE_NAME_PREFIX"%s-%llu%06llu",
 	                    program->identifier->buffer,
 	                    (unsigned long long)timestamp.tv_sec,
 	                    (unsigned long long)timestamp.tv_usec) < 0) {
@@ -533,7 +536,7 @@ APIE program_purge(Program *program, uint32_t cookie) {
 	while (counter < 1000) {
 		if (rename(program->root_directory->buffer, tmp) < 0) {
 			if (errno == ENOTEMPTY || errno == EEXIST) {
-				if (robust_snprintf(tmp, sizeof(tmp), "/tmp/purged-%s-%llu%06llu-%u",
+				if (robust_snprintf(tmp, sizeof(tmp), PURGE_DIRECTORY"/"PURGE_NAME_PREFIX"%s-%llu%06llu-%u",
 				                    program->identifier->buffer,
 				                    (unsigned long long)timestamp.tv_sec,
 				                    (unsigned long long)timestamp.tv_usec,
@@ -558,6 +561,8 @@ APIE program_purge(Program *program, uint32_t cookie) {
 			return error_code;
 		}
 
+		purge_add(tmp);
+
 		program->purged = true;
 
 		log_debug("Purged program object (id: %u, identifier: %s)",
@@ -723,6 +728,7 @@ APIE program_set_command(Program *program, ObjectID executable_id,
 	list_unlock_and_release(backup.environment);
 	string_unlock_and_release(backup.working_directory);
 
+	program_scheduler_retire_zygote(&program->scheduler);
 	program_scheduler_update(&program->scheduler, false);
 
 cleanup:
@@ -1241,6 +1247,307 @@ APIE program_get_schedule(Program *program, Session *session,
 	return API_E_SUCCESS;
 }
 
+// public API
+APIE program_set_limits(Program *program, uint32_t cpu_max, uint64_t memory_max,
+                        uint64_t io_max, uint32_t pids_max) {
+	ProgramConfig backup;
+	APIE error_code;
+	CgroupLimits limits;
+	char cgroup[CGROUP_MAX_NAME_LENGTH];
+
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	// backup config
+	memcpy(&backup, &program->config, sizeof(backup));
+
+	// set new values
+	program->config.cpu_max = cpu_max;
+	program->config.memory_max = memory_max;
+	program->config.io_max = io_max;
+	program->config.pids_max = pids_max;
+
+	// save modified config
+	error_code = program_config_save(&program->config);
+
+	if (error_code != API_E_SUCCESS) {
+		memcpy(&program->config, &backup, sizeof(program->config));
+
+		return error_code;
+	}
+
+	// apply new limits to a running process right away. otherwise they are
+	// applied on the next spawn
+	if (cgroup_is_available() &&
+	    program->scheduler.last_spawned_process != NULL &&
+	    process_is_alive(program->scheduler.last_spawned_process)) {
+		limits.cpu_max = cpu_max;
+		limits.memory_max = memory_max;
+		limits.io_max = io_max;
+		limits.pids_max = pids_max;
+
+		error_code = cgroup_prepare(program->identifier->buffer, &limits,
+		                            program->root_directory->buffer,
+		                            cgroup, sizeof(cgroup));
+
+		if (error_code != API_E_SUCCESS) {
+			return error_code;
+		}
+	}
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE program_get_limits(Program *program, uint32_t *cpu_max, uint64_t *memory_max,
+                        uint64_t *io_max, uint32_t *pids_max) {
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	*cpu_max = program->config.cpu_max;
+	*memory_max = program->config.memory_max;
+	*io_max = program->config.io_max;
+	*pids_max = program->config.pids_max;
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE program_set_output_buffer_size(Program *program, uint32_t output_buffer_size) {
+	uint32_t backup;
+	APIE error_code;
+
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	if (output_buffer_size > PROCESS_MAX_OUTPUT_BUFFER_SIZE) {
+		log_warn("Output buffer size of %u bytes exceeds maximum of %u bytes",
+		         output_buffer_size, PROCESS_MAX_OUTPUT_BUFFER_SIZE);
+
+		return API_E_OUT_OF_RANGE;
+	}
+
+	// backup config
+	backup = program->config.output_buffer_size;
+
+	// set new value, it applies on the next spawn
+	program->config.output_buffer_size = output_buffer_size;
+
+	// save modified config
+	error_code = program_config_save(&program->config);
+
+	if (error_code != API_E_SUCCESS) {
+		program->config.output_buffer_size = backup;
+
+		return error_code;
+	}
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE program_get_output_buffer_size(Program *program, uint32_t *output_buffer_size) {
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	*output_buffer_size = program->config.output_buffer_size;
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE program_set_scheduling_attributes(Program *program, int8_t nice, uint8_t policy,
+                                       uint32_t cpu_affinity, uint8_t io_priority_class,
+                                       uint8_t io_priority_level) {
+	ProcessSchedulingAttributes scheduling;
+	ProcessSchedulingAttributes backup;
+	APIE error_code;
+
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	scheduling.nice = nice;
+	scheduling.policy = policy;
+	scheduling.cpu_affinity = cpu_affinity;
+	scheduling.io_priority_class = io_priority_class;
+	scheduling.io_priority_level = io_priority_level;
+
+	error_code = process_validate_scheduling_attributes(&scheduling);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	// backup config
+	memcpy(&backup, &program->config.scheduling, sizeof(backup));
+
+	// set new values, they apply on the next spawn
+	memcpy(&program->config.scheduling, &scheduling, sizeof(scheduling));
+
+	// save modified config
+	error_code = program_config_save(&program->config);
+
+	if (error_code != API_E_SUCCESS) {
+		memcpy(&program->config.scheduling, &backup, sizeof(backup));
+
+		return error_code;
+	}
+
+	// a running zygote still has the old values
+	if (memcmp(&backup, &scheduling, sizeof(backup)) != 0) {
+		program_scheduler_retire_zygote(&program->scheduler);
+	}
+
+	program_scheduler_update(&program->scheduler, false);
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE program_get_scheduling_attributes(Program *program, int8_t *nice, uint8_t *policy,
+                                       uint32_t *cpu_affinity, uint8_t *io_priority_class,
+                                       uint8_t *io_priority_level) {
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	*nice = program->config.scheduling.nice;
+	*policy = program->config.scheduling.policy;
+	*cpu_affinity = program->config.scheduling.cpu_affinity;
+	*io_priority_class = program->config.scheduling.io_priority_class;
+	*io_priority_level = program->config.scheduling.io_priority_level;
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE program_set_zygote(Program *program, tfpbool enabled, ObjectID modules_id) {
+	int phase = 0;
+	APIE error_code;
+	List *modules;
+	ProgramConfig backup;
+
+	if (program->purged) {
+		error_code = API_E_PROGRAM_IS_PURGED;
+
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		goto cleanup;
+	}
+
+	// lock new modules list object
+	error_code = list_get_acquired_and_locked(modules_id, OBJECT_TYPE_STRING,
+	                                          &modules);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	// backup config
+	memcpy(&backup, &program->config, sizeof(backup));
+
+	// set new values
+	program->config.zygote = enabled ? true : false;
+	program->config.zygote_modules = modules;
+
+	phase = 2;
+
+	// save modified config
+	error_code = program_config_save(&program->config);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	// unlock old objects
+	list_unlock_and_release(backup.zygote_modules);
+
+	program_scheduler_retire_zygote(&program->scheduler);
+	program_scheduler_update(&program->scheduler, false);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 2:
+		memcpy(&program->config, &backup, sizeof(program->config));
+
+	case 1:
+		list_unlock_and_release(modules);
+
+	default:
+		break;
+	}
+
+	return phase == 3 ? API_E_SUCCESS : error_code;
+}
+
+// public API
+APIE program_get_zygote(Program *program, Session *session, tfpbool *enabled,
+                        ObjectID *modules_id) {
+	APIE error_code;
+
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	error_code = object_add_external_reference(&program->config.zygote_modules->base, session);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	*enabled = program->config.zygote ? 1 : 0;
+	*modules_id = program->config.zygote_modules->base.id;
+
+	return API_E_SUCCESS;
+}
+
+// public API
+APIE program_get_resource_usage(Program *program, uint64_t *cpu_time,
+                                uint64_t *memory_usage, uint64_t *memory_peak,
+                                uint64_t *read_bytes, uint64_t *write_bytes,
+                                uint32_t *process_count) {
+	if (program->purged) {
+		log_warn("Program object (id: %u, identifier: %s) is purged",
+		         program->base.id, program->identifier->buffer);
+
+		return API_E_PROGRAM_IS_PURGED;
+	}
+
+	return cgroup_get_usage(program->identifier->buffer, cpu_time, memory_usage,
+	                        memory_peak, read_bytes, write_bytes, process_count);
+}
+
 // public API
 APIE program_get_scheduler_state(Program *program, Session *session,
                                  uint8_t *state, uint64_t *timestamp,
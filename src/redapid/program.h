@@ -86,6 +86,26 @@ APIE program_get_schedule(Program *program, Session *session,
                           uint32_t *start_interval,
                           ObjectID *start_fields_id);
 
+APIE program_set_limits(Program *program, uint32_t cpu_max, uint64_t memory_max,
+                        uint64_t io_max, uint32_t pids_max);
+APIE program_get_limits(Program *program, uint32_t *cpu_max, uint64_t *memory_max,
+                        uint64_t *io_max, uint32_t *pids_max);
+APIE program_set_output_buffer_size(Program *program, uint32_t output_buffer_size);
+APIE program_get_output_buffer_size(Program *program, uint32_t *output_buffer_size);
+APIE program_set_scheduling_attributes(Program *program, int8_t nice, uint8_t policy,
+                                       uint32_t cpu_affinity, uint8_t io_priority_class,
+                                       uint8_t io_priority_level);
+APIE program_get_scheduling_attributes(Program *program, int8_t *nice, uint8_t *policy,
+                                       uint32_t *cpu_affinity, uint8_t *io_priority_class,
+                                       uint8_t *io_priority_level);
+APIE program_set_zygote(Program *program, tfpbool enabled, ObjectID modules_id);
+APIE program_get_zygote(Program *program, Session *session, tfpbool *enabled,
+                        ObjectID *modules_id);
+APIE program_get_resource_usage(Program *program, uint64_t *cpu_time,
+                                uint64_t *memory_usage, uint64_t *memory_peak,
+                                uint64_t *read_bytes, uint64_t *write_bytes,
+                                uint32_t *process_count);
+
 APIE program_get_scheduler_state(Program *program, Session *session,
                                  uint8_t *state, uint64_t *timestamp,
                                  ObjectID *message_id);
@@ -32,6 +32,7 @@
 
 #include "api.h"
 #include "inventory.h"
+#include "process.h"
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
@@ -56,6 +57,20 @@ static EnumValueName _start_mode_enum_value_names[] = {
 	{ -1,                           NULL }
 };
 
+static EnumValueName _scheduling_policy_enum_value_names[] = {
+	{ PROCESS_SCHEDULING_POLICY_NORMAL, "normal" },
+	{ PROCESS_SCHEDULING_POLICY_BATCH,  "batch" },
+	{ PROCESS_SCHEDULING_POLICY_IDLE,   "idle" },
+	{ -1,                               NULL }
+};
+
+static EnumValueName _io_priority_class_enum_value_names[] = {
+	{ PROCESS_IO_PRIORITY_CLASS_NONE,        "none" },
+	{ PROCESS_IO_PRIORITY_CLASS_BEST_EFFORT, "best_effort" },
+	{ PROCESS_IO_PRIORITY_CLASS_IDLE,        "idle" },
+	{ -1,                                    NULL }
+};
+
 static void program_custom_option_unlock_and_release(void *item) {
 	ProgramCustomOption *custom_option = item;
 
@@ -79,6 +94,22 @@ static int program_config_get_start_mode_value(const char *name, int *mode) {
 	return enum_get_value(_start_mode_enum_value_names, name, mode, true);
 }
 
+static const char *program_config_get_scheduling_policy_name(int policy) {
+	return enum_get_name(_scheduling_policy_enum_value_names, policy, "<unknown>");
+}
+
+static int program_config_get_scheduling_policy_value(const char *name, int *policy) {
+	return enum_get_value(_scheduling_policy_enum_value_names, name, policy, true);
+}
+
+static const char *program_config_get_io_priority_class_name(int io_class) {
+	return enum_get_name(_io_priority_class_enum_value_names, io_class, "<unknown>");
+}
+
+static int program_config_get_io_priority_class_value(const char *name, int *io_class) {
+	return enum_get_value(_io_priority_class_enum_value_names, name, io_class, true);
+}
+
 static APIE program_config_set_empty(ProgramConfig *program_config,
                                      ConfFile *conf_file, const char *name) {
 	APIE error_code;
@@ -265,6 +296,57 @@ error:
 	*value = default_value;
 }
 
+static APIE program_config_set_signed_integer(ProgramConfig *program_config,
+                                              ConfFile *conf_file, const char *name,
+                                              int64_t value) {
+	APIE error_code;
+	char buffer[128];
+
+	snprintf(buffer, sizeof(buffer), "%lld", (long long int)value);
+
+	if (conf_file_set_option_value(conf_file, name, buffer) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not set '%s' option in '%s': %s (%d)",
+		          name, program_config->filename, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	return API_E_SUCCESS;
+}
+
+static void program_config_get_signed_integer(ProgramConfig *program_config,
+                                              ConfFile *conf_file, const char *name,
+                                              int64_t *value, int64_t default_value) {
+	const char *string = conf_file_get_option_value(conf_file, name);
+	char *end = NULL;
+	long long int tmp;
+
+	if (string == NULL) {
+		*value = default_value;
+
+		return;
+	}
+
+	errno = 0;
+	tmp = strtoll(string, &end, 10);
+
+	if (errno != 0) {
+		log_warn("Could not parse integer from value of '%s' option in '%s', using default value instead: %s (%d)",
+		         name, program_config->filename, get_errno_name(errno), errno);
+
+		*value = default_value;
+	} else if (end == NULL || *end != '\0') {
+		log_warn("Value of '%s' option in '%s' has a non-numerical suffix, using default value instead",
+		         name, program_config->filename);
+
+		*value = default_value;
+	} else {
+		*value = tmp;
+	}
+}
+
 static APIE program_config_set_boolean(ProgramConfig *program_config,
                                        ConfFile *conf_file, const char *name,
                                        bool value) {
@@ -458,6 +540,7 @@ APIE program_config_create(ProgramConfig *program_config, const char *filename)
 	List *environment;
 	String *working_directory;
 	Array *custom_options;
+	List *zygote_modules;
 
 	// get empty executable stock string object
 	error_code = inventory_get_stock_string("", &executable);
@@ -526,6 +609,18 @@ APIE program_config_create(ProgramConfig *program_config, const char *filename)
 
 	phase = 6;
 
+	// create zygote modules list object
+	error_code = list_allocate(0, NULL,
+	                           OBJECT_CREATE_FLAG_INTERNAL |
+	                           OBJECT_CREATE_FLAG_LOCKED,
+	                           NULL, &zygote_modules);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 7;
+
 	// initalize all members
 	program_config->filename = strdup(filename);
 
@@ -538,7 +633,7 @@ APIE program_config_create(ProgramConfig *program_config, const char *filename)
 		goto cleanup;
 	}
 
-	phase = 7;
+	phase = 8;
 
 	program_config->executable = executable;
 	program_config->arguments = arguments;
@@ -554,10 +649,25 @@ APIE program_config_create(ProgramConfig *program_config, const char *filename)
 	program_config->continue_after_error = false;
 	program_config->start_interval = 0;
 	program_config->start_fields = NULL;
+	program_config->cpu_max = 0;
+	program_config->memory_max = 0;
+	program_config->io_max = 0;
+	program_config->pids_max = 0;
+	program_config->output_buffer_size = 0;
+	program_config->scheduling.nice = 0;
+	program_config->scheduling.policy = PROCESS_SCHEDULING_POLICY_NORMAL;
+	program_config->scheduling.cpu_affinity = 0;
+	program_config->scheduling.io_priority_class = PROCESS_IO_PRIORITY_CLASS_NONE;
+	program_config->scheduling.io_priority_level = 0;
+	program_config->zygote = false;
+	program_config->zygote_modules = zygote_modules;
 	program_config->custom_options = custom_options;
 
 cleanup:
 	switch (phase) { // no breaks, all cases fall through intentionally
+	case 7:
+		list_unlock_and_release(zygote_modules);
+
 	case 6:
 		array_destroy(custom_options, program_custom_option_unlock_and_release);
 
@@ -580,7 +690,7 @@ cleanup:
 		break;
 	}
 
-	return phase == 7 ? API_E_SUCCESS : error_code;
+	return phase == 8 ? API_E_SUCCESS : error_code;
 }
 
 void program_config_destroy(ProgramConfig *program_config) {
@@ -588,6 +698,8 @@ void program_config_destroy(ProgramConfig *program_config) {
 	              program_custom_option_unlock_and_release);
 	free(program_config->custom_options);
 
+	list_unlock_and_release(program_config->zygote_modules);
+
 	if (program_config->start_mode == PROGRAM_START_MODE_CRON) {
 		string_unlock_and_release(program_config->start_fields);
 	}
@@ -629,6 +741,18 @@ APIE program_config_load(ProgramConfig *program_config) {
 	bool continue_after_error;
 	uint64_t start_interval;
 	String *start_fields;
+	uint64_t cpu_max;
+	uint64_t memory_max;
+	uint64_t io_max;
+	uint64_t pids_max;
+	uint64_t output_buffer_size;
+	int64_t nice;
+	int scheduling_policy;
+	uint64_t cpu_affinity;
+	int io_priority_class;
+	uint64_t io_priority_level;
+	bool zygote;
+	List *zygote_modules;
 	Array *custom_options;
 	const char *custom_name;
 	const char *custom_value;
@@ -858,6 +982,106 @@ APIE program_config_load(ProgramConfig *program_config) {
 
 	phase = 9;
 
+	// get cpu_max
+	program_config_get_integer(program_config, &conf_file, "cpu_max",
+	                           &cpu_max, 0);
+
+	if (cpu_max > UINT32_MAX) {
+		log_warn("Invalid 'cpu_max' option in '%s', using default value instead",
+		         program_config->filename);
+
+		cpu_max = 0;
+	}
+
+	// get memory_max
+	program_config_get_integer(program_config, &conf_file, "memory_max",
+	                           &memory_max, 0);
+
+	// get io_max
+	program_config_get_integer(program_config, &conf_file, "io_max",
+	                           &io_max, 0);
+
+	// get pids_max
+	program_config_get_integer(program_config, &conf_file, "pids_max",
+	                           &pids_max, 0);
+
+	if (pids_max > UINT32_MAX) {
+		log_warn("Invalid 'pids_max' option in '%s', using default value instead",
+		         program_config->filename);
+
+		pids_max = 0;
+	}
+
+	// get output_buffer_size
+	program_config_get_integer(program_config, &conf_file, "output_buffer_size",
+	                           &output_buffer_size, 0);
+
+	if (output_buffer_size > PROCESS_MAX_OUTPUT_BUFFER_SIZE) {
+		log_warn("Invalid 'output_buffer_size' option in '%s', using default value instead",
+		         program_config->filename);
+
+		output_buffer_size = 0;
+	}
+
+	// get nice
+	program_config_get_signed_integer(program_config, &conf_file, "nice",
+	                                  &nice, 0);
+
+	if (nice < PROCESS_MIN_NICE || nice > PROCESS_MAX_NICE) {
+		log_warn("Invalid 'nice' option in '%s', using default value instead",
+		         program_config->filename);
+
+		nice = 0;
+	}
+
+	// get scheduling_policy
+	program_config_get_symbol(program_config, &conf_file,
+	                          "scheduling_policy", &scheduling_policy,
+	                          PROCESS_SCHEDULING_POLICY_NORMAL,
+	                          program_config_get_scheduling_policy_value);
+
+	// get cpu_affinity
+	program_config_get_integer(program_config, &conf_file, "cpu_affinity",
+	                           &cpu_affinity, 0);
+
+	if (cpu_affinity > UINT32_MAX) {
+		log_warn("Invalid 'cpu_affinity' option in '%s', using default value instead",
+		         program_config->filename);
+
+		cpu_affinity = 0;
+	}
+
+	// get io_priority_class
+	program_config_get_symbol(program_config, &conf_file,
+	                          "io_priority_class", &io_priority_class,
+	                          PROCESS_IO_PRIORITY_CLASS_NONE,
+	                          program_config_get_io_priority_class_value);
+
+	// get io_priority_level
+	program_config_get_integer(program_config, &conf_file, "io_priority_level",
+	                           &io_priority_level, 0);
+
+	if (io_priority_level > PROCESS_MAX_IO_PRIORITY_LEVEL) {
+		log_warn("Invalid 'io_priority_level' option in '%s', using default value instead",
+		         program_config->filename);
+
+		io_priority_level = 0;
+	}
+
+	// get zygote
+	program_config_get_boolean(program_config, &conf_file, "zygote",
+	                           &zygote, false);
+
+	// get zygote_modules
+	error_code = program_config_get_string_list(program_config, &conf_file,
+	                                            "zygote_modules", &zygote_modules);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 10;
+
 	// get custom.* options
 	custom_options = calloc(1, sizeof(Array));
 
@@ -870,7 +1094,7 @@ APIE program_config_load(ProgramConfig *program_config) {
 		goto cleanup;
 	}
 
-	phase = 10;
+	phase = 11;
 
 	if (array_create(custom_options, 32, sizeof(ProgramCustomOption), true) < 0) {
 		error_code = api_get_error_code_from_errno();
@@ -881,7 +1105,7 @@ APIE program_config_load(ProgramConfig *program_config) {
 		goto cleanup;
 	}
 
-	phase = 11;
+	phase = 12;
 
 	if (conf_file_get_first_option(&conf_file, &custom_name, &custom_value, &cookie)) {
 		do {
@@ -932,7 +1156,7 @@ APIE program_config_load(ProgramConfig *program_config) {
 		} while (conf_file_get_next_option(&conf_file, &custom_name, &custom_value, &cookie));
 	}
 
-	phase = 12;
+	phase = 13;
 
 	// unlock/destroy old objects
 	string_unlock_and_release(program_config->executable);
@@ -956,6 +1180,8 @@ APIE program_config_load(ProgramConfig *program_config) {
 		string_unlock_and_release(program_config->start_fields);
 	}
 
+	list_unlock_and_release(program_config->zygote_modules);
+
 	array_destroy(program_config->custom_options,
 	              program_custom_option_unlock_and_release);
 	free(program_config->custom_options);
@@ -975,18 +1201,33 @@ APIE program_config_load(ProgramConfig *program_config) {
 	program_config->continue_after_error = continue_after_error;
 	program_config->start_interval = start_interval;
 	program_config->start_fields = start_fields;
+	program_config->cpu_max = cpu_max;
+	program_config->memory_max = memory_max;
+	program_config->io_max = io_max;
+	program_config->pids_max = pids_max;
+	program_config->output_buffer_size = output_buffer_size;
+	program_config->scheduling.nice = nice;
+	program_config->scheduling.policy = scheduling_policy;
+	program_config->scheduling.cpu_affinity = cpu_affinity;
+	program_config->scheduling.io_priority_class = io_priority_class;
+	program_config->scheduling.io_priority_level = io_priority_level;
+	program_config->zygote = zygote;
+	program_config->zygote_modules = zygote_modules;
 	program_config->custom_options = custom_options;
 
 	conf_file_destroy(&conf_file);
 
 cleanup:
 	switch (phase) { // no breaks, all cases fall through intentionally
-	case 11:
+	case 12:
 		array_destroy(custom_options, program_custom_option_unlock_and_release);
 
-	case 10:
+	case 11:
 		free(custom_options);
 
+	case 10:
+		list_unlock_and_release(zygote_modules);
+
 	case 9:
 		if (start_mode == PROGRAM_START_MODE_CRON) {
 			string_unlock_and_release(start_fields);
@@ -1026,7 +1267,7 @@ cleanup:
 		break;
 	}
 
-	return phase == 12 ? API_E_SUCCESS : error_code;
+	return phase == 13 ? API_E_SUCCESS : error_code;
 }
 
 APIE program_config_save(ProgramConfig *program_config) {
@@ -1205,6 +1446,116 @@ APIE program_config_save(ProgramConfig *program_config) {
 		goto cleanup;
 	}
 
+	// set cpu_max
+	error_code = program_config_set_integer(program_config, &conf_file,
+	                                        "cpu_max",
+	                                        program_config->cpu_max, 10, 0);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set memory_max
+	error_code = program_config_set_integer(program_config, &conf_file,
+	                                        "memory_max",
+	                                        program_config->memory_max, 10, 0);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set io_max
+	error_code = program_config_set_integer(program_config, &conf_file,
+	                                        "io_max",
+	                                        program_config->io_max, 10, 0);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set pids_max
+	error_code = program_config_set_integer(program_config, &conf_file,
+	                                        "pids_max",
+	                                        program_config->pids_max, 10, 0);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set output_buffer_size
+	error_code = program_config_set_integer(program_config, &conf_file,
+	                                        "output_buffer_size",
+	                                        program_config->output_buffer_size, 10, 0);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set nice
+	error_code = program_config_set_signed_integer(program_config, &conf_file,
+	                                               "nice",
+	                                               program_config->scheduling.nice);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set scheduling_policy
+	error_code = program_config_set_symbol(program_config, &conf_file,
+	                                       "scheduling_policy",
+	                                       program_config->scheduling.policy,
+	                                       program_config_get_scheduling_policy_name);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set cpu_affinity
+	error_code = program_config_set_integer(program_config, &conf_file,
+	                                        "cpu_affinity",
+	                                        program_config->scheduling.cpu_affinity, 2, 4);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set io_priority_class
+	error_code = program_config_set_symbol(program_config, &conf_file,
+	                                       "io_priority_class",
+	                                       program_config->scheduling.io_priority_class,
+	                                       program_config_get_io_priority_class_name);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set io_priority_level
+	error_code = program_config_set_integer(program_config, &conf_file,
+	                                        "io_priority_level",
+	                                        program_config->scheduling.io_priority_level, 10, 0);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set zygote
+	error_code = program_config_set_boolean(program_config, &conf_file,
+	                                        "zygote",
+	                                        program_config->zygote);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	// set zygote_modules
+	error_code = program_config_set_string_list(program_config, &conf_file,
+	                                            "zygote_modules",
+	                                            program_config->zygote_modules);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
 	// set custom.* options
 	conf_file_remove_option(&conf_file, "custom.", true);
 
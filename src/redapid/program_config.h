@@ -28,6 +28,7 @@
 #include <daemonlib/array.h>
 
 #include "list.h"
+#include "process.h"
 #include "string.h"
 
 typedef enum {
@@ -71,6 +72,14 @@ typedef struct {
 	bool continue_after_error;
 	uint32_t start_interval; // seconds
 	String *start_fields; // only != NULL if start_mode == PROGRAM_START_MODE_CRON
+	uint32_t cpu_max; // percent of one CPU core, 0 for no limit
+	uint64_t memory_max; // bytes, 0 for no limit
+	uint64_t io_max; // bytes per second, 0 for no limit
+	uint32_t pids_max; // 0 for no limit
+	uint32_t output_buffer_size; // bytes of recent stdout and stderr output kept in memory, 0 to disable
+	ProcessSchedulingAttributes scheduling;
+	bool zygote; // fork starts from a pre-started interpreter, if applicable
+	List *zygote_modules; // imported by the zygote before the first fork
 	Array *custom_options;
 } ProgramConfig;
 
@@ -37,6 +37,7 @@
 #include "program_scheduler.h"
 
 #include "api.h"
+#include "cgroup.h"
 #include "cron.h"
 #include "directory.h"
 #include "inventory.h"
@@ -45,6 +46,9 @@
 
 static LogSource _log_source = LOG_SOURCE_INITIALIZER;
 
+#define PROGRAM_SCHEDULER_LOG_PREALLOCATION_LENGTH (256 * 1024)
+#define PROGRAM_SCHEDULER_KILL_TIMEOUT 5000 // milliseconds, until SIGTERM is escalated to SIGKILL on shutdown
+
 extern bool _x11_enabled;
 
 static void program_scheduler_start(ProgramScheduler *program_scheduler);
@@ -105,11 +109,42 @@ static void program_scheduler_handle_error(ProgramScheduler *program_scheduler,
 	program_scheduler_stop(program_scheduler, message);
 }
 
+// the continuous logs are preallocated for the output of the next process only.
+// once it is gone the unused part is released again, but not while the process
+// might still be writing to the logs
+static void program_scheduler_release_log_preallocation(ProgramScheduler *program_scheduler,
+                                                        bool release) {
+	File **logs[2] = {
+		&program_scheduler->preallocated_stdout_log,
+		&program_scheduler->preallocated_stderr_log
+	};
+	int i;
+
+	for (i = 0; i < 2; ++i) {
+		if (*logs[i] == NULL) {
+			continue;
+		}
+
+		if (release) {
+			file_release_preallocation(*logs[i]);
+		}
+
+		object_remove_internal_reference(&(*logs[i])->base);
+
+		*logs[i] = NULL;
+	}
+}
+
 static void program_scheduler_handle_process_state_change(void *opaque) {
 	ProgramScheduler *program_scheduler = opaque;
 	Program *program = containerof(program_scheduler, Program, scheduler);
 	bool spawn = false;
 
+	if (program_scheduler->last_spawned_process != NULL &&
+	    !process_is_alive(program_scheduler->last_spawned_process)) {
+		program_scheduler_release_log_preallocation(program_scheduler, true);
+	}
+
 	if (program_scheduler->state != PROGRAM_SCHEDULER_STATE_RUNNING) {
 		return;
 	}
@@ -203,6 +238,82 @@ static void program_scheduler_handle_cron(void *opaque) {
 	}
 }
 
+static APIE program_scheduler_prepare_cgroup(ProgramScheduler *program_scheduler,
+                                             char *cgroup, int length) {
+	Program *program = containerof(program_scheduler, Program, scheduler);
+	CgroupLimits limits;
+
+	limits.cpu_max = program->config.cpu_max;
+	limits.memory_max = program->config.memory_max;
+	limits.io_max = program->config.io_max;
+	limits.pids_max = program->config.pids_max;
+
+	return cgroup_prepare(program->identifier->buffer, &limits,
+	                      program->root_directory->buffer, cgroup, length);
+}
+
+// start the zygote ahead of time, so that the next spawn doesn't have to wait
+// for the interpreter to start and to import the configured modules. the
+// zygote runs in the control group and with the identity and scheduling
+// attributes of the program, its child processes inherit them
+static void program_scheduler_prepare_zygote(ProgramScheduler *program_scheduler) {
+	Program *program = containerof(program_scheduler, Program, scheduler);
+	APIE error_code;
+	char cgroup[CGROUP_MAX_NAME_LENGTH];
+
+	if (program_scheduler->shutdown ||
+	    program_scheduler->state != PROGRAM_SCHEDULER_STATE_RUNNING ||
+	    !program->config.zygote ||
+	    !zygote_is_applicable(program->config.executable, program->config.arguments)) {
+		program_scheduler_retire_zygote(program_scheduler);
+
+		return;
+	}
+
+	if (program_scheduler->zygote != NULL) {
+		// don't restart a zygote that cannot import its modules, it would
+		// fail again. it's replaced when the settings change
+		if (zygote_is_alive(program_scheduler->zygote) ||
+		    zygote_has_failed(program_scheduler->zygote)) {
+			return;
+		}
+
+		program_scheduler_retire_zygote(program_scheduler);
+	}
+
+	if (program_scheduler->absolute_working_directory == NULL) {
+		return; // filesystem is not prepared yet
+	}
+
+	if (cgroup_is_available()) {
+		error_code = program_scheduler_prepare_cgroup(program_scheduler,
+		                                              cgroup, sizeof(cgroup));
+
+		if (error_code != API_E_SUCCESS) {
+			log_warn("Could not prepare control group for zygote of program object (identifier: %s): %s (%d)",
+			         program->identifier->buffer, api_get_error_code_name(error_code), error_code);
+
+			return;
+		}
+	}
+
+	error_code = zygote_create(program->config.executable->base.id,
+	                           program->config.zygote_modules,
+	                           program->config.environment->base.id,
+	                           program_scheduler->absolute_working_directory->base.id,
+	                           1000, 1000,
+	                           cgroup_is_available() ? cgroup : NULL,
+	                           &program->config.scheduling,
+	                           &program_scheduler->zygote);
+
+	if (error_code != API_E_SUCCESS) {
+		log_warn("Could not start zygote for program object (identifier: %s), spawning without it: %s (%d)",
+		         program->identifier->buffer, api_get_error_code_name(error_code), error_code);
+
+		program_scheduler->zygote = NULL;
+	}
+}
+
 static void program_scheduler_start(ProgramScheduler *program_scheduler) {
 	Program *program = containerof(program_scheduler, Program, scheduler);
 	APIE error_code;
@@ -217,6 +328,10 @@ static void program_scheduler_start(ProgramScheduler *program_scheduler) {
 	program_scheduler_set_state(program_scheduler, PROGRAM_SCHEDULER_STATE_RUNNING,
 	                            time(NULL), NULL);
 
+	if (program->config.start_mode != PROGRAM_START_MODE_NEVER) {
+		program_scheduler_prepare_zygote(program_scheduler);
+	}
+
 	switch (program->config.start_mode) {
 	case PROGRAM_START_MODE_NEVER:
 		program_scheduler_stop(program_scheduler, NULL);
@@ -311,6 +426,8 @@ static void program_scheduler_stop(ProgramScheduler *program_scheduler,
 		program_scheduler->cron_active = false;
 	}
 
+	program_scheduler_retire_zygote(program_scheduler);
+
 	program_scheduler_set_state(program_scheduler, PROGRAM_SCHEDULER_STATE_STOPPED,
 	                            time(NULL), message);
 }
@@ -700,7 +817,8 @@ static File *program_scheduler_prepare_individual_log(ProgramScheduler *program_
 
 static File *program_scheduler_prepare_continuous_log(ProgramScheduler *program_scheduler,
                                                       struct timeval timestamp,
-                                                      const char *suffix) {
+                                                      const char *suffix,
+                                                      File **preallocated_log) {
 	struct tm localized_timestamp;
 	char iso8601dt[64] = "unknown";
 	char iso8601usec[16] = "";
@@ -709,6 +827,7 @@ static File *program_scheduler_prepare_continuous_log(ProgramScheduler *program_
 	APIE error_code;
 	String *name;
 	File *file;
+	off_t length;
 
 	// format ISO 8601 date, time and timezone offset
 	if (localtime_r(&timestamp.tv_sec, &localized_timestamp) != NULL) {
@@ -781,6 +900,20 @@ static File *program_scheduler_prepare_continuous_log(ProgramScheduler *program_
 		return NULL;
 	}
 
+	// preallocate space for the upcoming output without changing the file
+	// length to reduce fragmentation of the log file. this is an optimization
+	// only, errors are non-fatal. the unused space is released again after
+	// the process exited
+	length = lseek(file->fd, 0, SEEK_CUR);
+
+	if (length >= 0 &&
+	    file_set_size_hint(file, (uint64_t)length + PROGRAM_SCHEDULER_LOG_PREALLOCATION_LENGTH,
+	                       FILE_SIZE_HINT_FLAG_KEEP_SIZE) == API_E_SUCCESS) {
+		object_add_internal_reference(&file->base);
+
+		*preallocated_log = file;
+	}
+
 	return file;
 }
 
@@ -842,7 +975,8 @@ static File *program_scheduler_prepare_stdout(ProgramScheduler *program_schedule
 		return program_scheduler_prepare_individual_log(program_scheduler, timestamp, "stdout");
 
 	case PROGRAM_STDIO_REDIRECTION_CONTINUOUS_LOG:
-		return program_scheduler_prepare_continuous_log(program_scheduler, timestamp, "stdout");
+		return program_scheduler_prepare_continuous_log(program_scheduler, timestamp, "stdout",
+		                                                &program_scheduler->preallocated_stdout_log);
 
 	case PROGRAM_STDIO_REDIRECTION_STDOUT: // should never be reachable
 		program_scheduler_handle_error(program_scheduler, true,
@@ -917,7 +1051,8 @@ static File *program_scheduler_prepare_stderr(ProgramScheduler *program_schedule
 		return program_scheduler_prepare_individual_log(program_scheduler, timestamp, "stderr");
 
 	case PROGRAM_STDIO_REDIRECTION_CONTINUOUS_LOG:
-		return program_scheduler_prepare_continuous_log(program_scheduler, timestamp, "stderr");
+		return program_scheduler_prepare_continuous_log(program_scheduler, timestamp, "stderr",
+		                                                &program_scheduler->preallocated_stderr_log);
 
 	case PROGRAM_STDIO_REDIRECTION_STDOUT:
 		object_add_internal_reference(&stdout->base);
@@ -1012,7 +1147,10 @@ APIE program_scheduler_create(ProgramScheduler *program_scheduler,
 	program_scheduler->waiting_for_brickd = !network_is_brickd_connected();
 	program_scheduler->timer_active = false;
 	program_scheduler->cron_active = false;
+	program_scheduler->zygote = NULL;
 	program_scheduler->last_spawned_process = NULL;
+	program_scheduler->preallocated_stdout_log = NULL;
+	program_scheduler->preallocated_stderr_log = NULL;
 	program_scheduler->last_spawned_timestamp = 0;
 	program_scheduler->state = PROGRAM_SCHEDULER_STATE_STOPPED;
 	program_scheduler->timestamp = time(NULL);
@@ -1068,7 +1206,19 @@ cleanup:
 void program_scheduler_destroy(ProgramScheduler *program_scheduler) {
 	program_scheduler_shutdown(program_scheduler);
 
+	// a process that is still alive might still write to the logs
+	program_scheduler_release_log_preallocation(program_scheduler,
+	                                            program_scheduler->last_spawned_process == NULL ||
+	                                            !process_is_alive(program_scheduler->last_spawned_process));
+
 	if (program_scheduler->last_spawned_process != NULL) {
+		// the process object might outlive the scheduler, don't wait for a
+		// clean exit anymore and stop reporting to the scheduler
+		if (program_scheduler->last_spawned_process->killing_tree) {
+			process_kill_tree(program_scheduler->last_spawned_process,
+			                  PROCESS_SIGNAL_KILL, 0, NULL, NULL);
+		}
+
 		object_remove_internal_reference(&program_scheduler->last_spawned_process->base);
 	}
 
@@ -1146,6 +1296,18 @@ void program_scheduler_update(ProgramScheduler *program_scheduler, bool try_star
 	}
 }
 
+// has to be called if the command, the environment, the working directory,
+// the scheduling attributes or the zygote config changed. the zygote was
+// started with the old config, it's started again with the new config on the
+// next spawn
+void program_scheduler_retire_zygote(ProgramScheduler *program_scheduler) {
+	if (program_scheduler->zygote != NULL) {
+		zygote_retire(program_scheduler->zygote);
+
+		program_scheduler->zygote = NULL;
+	}
+}
+
 void program_scheduler_continue(ProgramScheduler *program_scheduler) {
 	Program *program = containerof(program_scheduler, Program, scheduler);
 
@@ -1159,7 +1321,18 @@ void program_scheduler_continue(ProgramScheduler *program_scheduler) {
 	}
 }
 
+// the whole process tree of the last spawned process is gone, its control
+// group is not needed anymore
+static void program_scheduler_handle_process_tree_killed(void *opaque) {
+	ProgramScheduler *program_scheduler = opaque;
+	Program *program = containerof(program_scheduler, Program, scheduler);
+
+	cgroup_remove(program->identifier->buffer);
+}
+
 void program_scheduler_shutdown(ProgramScheduler *program_scheduler) {
+	Program *program = containerof(program_scheduler, Program, scheduler);
+
 	if (program_scheduler->shutdown) {
 		return;
 	}
@@ -1168,9 +1341,14 @@ void program_scheduler_shutdown(ProgramScheduler *program_scheduler) {
 
 	program_scheduler_stop(program_scheduler, NULL);
 
-	if (program_scheduler->last_spawned_process != NULL &&
-	    process_is_alive(program_scheduler->last_spawned_process)) {
-		process_kill(program_scheduler->last_spawned_process, PROCESS_SIGNAL_KILL);
+	// give the process tree a chance to exit cleanly, programs started by a
+	// wrapper script would leave their actual processes running otherwise
+	if (program_scheduler->last_spawned_process == NULL ||
+	    process_kill_tree(program_scheduler->last_spawned_process,
+	                      PROCESS_SIGNAL_TERMINATE, PROGRAM_SCHEDULER_KILL_TIMEOUT,
+	                      program_scheduler_handle_process_tree_killed,
+	                      program_scheduler) != API_E_SUCCESS) {
+		cgroup_remove(program->identifier->buffer);
 	}
 }
 
@@ -1182,6 +1360,8 @@ void program_scheduler_spawn_process(ProgramScheduler *program_scheduler) {
 	File *stderr;
 	Program *program = containerof(program_scheduler, Program, scheduler);
 	struct timeval timestamp;
+	char cgroup[CGROUP_MAX_NAME_LENGTH];
+	bool spawned = false;
 	Process *process;
 
 	program_scheduler_abort_observer(program_scheduler);
@@ -1192,6 +1372,9 @@ void program_scheduler_spawn_process(ProgramScheduler *program_scheduler) {
 		}
 	}
 
+	// a previous spawn attempt might have failed after preallocating the logs
+	program_scheduler_release_log_preallocation(program_scheduler, true);
+
 	// prepare stdin
 	stdin = program_scheduler_prepare_stdin(program_scheduler);
 
@@ -1225,17 +1408,70 @@ void program_scheduler_spawn_process(ProgramScheduler *program_scheduler) {
 
 	phase = 3;
 
+	// prepare control group
+	if (cgroup_is_available()) {
+		error_code = program_scheduler_prepare_cgroup(program_scheduler,
+		                                              cgroup, sizeof(cgroup));
+
+		if (error_code != API_E_SUCCESS) {
+			program_scheduler_handle_error(program_scheduler, false,
+			                               "Could not prepare control group: %s (%d)",
+			                               api_get_error_code_name(error_code), error_code);
+
+			goto cleanup;
+		}
+	}
+
+	// fork process from zygote, if it's ready. otherwise don't wait for it
+	if (program_scheduler->zygote != NULL && !zygote_is_ready(program_scheduler->zygote)) {
+		if (zygote_has_failed(program_scheduler->zygote)) {
+			log_warn("Zygote of program object (identifier: %s) could not import its modules, spawning process normally",
+			         program->identifier->buffer);
+		} else {
+			log_debug("Zygote of program object (identifier: %s) is not ready, spawning process normally",
+			          program->identifier->buffer);
+		}
+	} else if (program_scheduler->zygote != NULL) {
+		error_code = process_spawn(program->config.executable->base.id,
+		                           program->config.arguments->base.id,
+		                           program->config.environment->base.id,
+		                           program_scheduler->absolute_working_directory->base.id,
+		                           1000, 1000,
+		                           stdin->base.id, stdout->base.id, stderr->base.id,
+		                           NULL, program->config.output_buffer_size, NULL,
+		                           NULL, 0, program_scheduler->zygote,
+		                           NULL, OBJECT_CREATE_FLAG_INTERNAL, false,
+		                           program_scheduler_handle_process_state_change,
+		                           program_scheduler,
+		                           NULL, &process);
+
+		if (error_code == API_E_SUCCESS) {
+			spawned = true;
+		} else {
+			log_warn("Could not fork process from zygote for program object (identifier: %s), spawning it normally instead: %s (%d)",
+			         program->identifier->buffer, api_get_error_code_name(error_code), error_code);
+
+			program_scheduler_retire_zygote(program_scheduler);
+		}
+	}
+
 	// spawn process
-	error_code = process_spawn(program->config.executable->base.id,
-	                           program->config.arguments->base.id,
-	                           program->config.environment->base.id,
-	                           program_scheduler->absolute_working_directory->base.id,
-	                           1000, 1000,
-	                           stdin->base.id, stdout->base.id, stderr->base.id,
-	                           NULL, OBJECT_CREATE_FLAG_INTERNAL, false,
-	                           program_scheduler_handle_process_state_change,
-	                           program_scheduler,
-	                           NULL, &process);
+	if (!spawned) {
+		error_code = process_spawn(program->config.executable->base.id,
+		                           program->config.arguments->base.id,
+		                           program->config.environment->base.id,
+		                           program_scheduler->absolute_working_directory->base.id,
+		                           1000, 1000,
+		                           stdin->base.id, stdout->base.id, stderr->base.id,
+		                           cgroup_is_available() ? cgroup : NULL,
+		                           program->config.output_buffer_size,
+		                           &program->config.scheduling,
+		                           NULL, 0, NULL,
+		                           NULL, OBJECT_CREATE_FLAG_INTERNAL, false,
+		                           program_scheduler_handle_process_state_change,
+		                           program_scheduler,
+		                           NULL, &process);
+	}
 
 	if (error_code != API_E_SUCCESS) {
 		program_scheduler_handle_error(program_scheduler, false,
@@ -1256,6 +1492,9 @@ void program_scheduler_spawn_process(ProgramScheduler *program_scheduler) {
 
 	program_scheduler->process_spawned(program_scheduler->opaque);
 
+	// replace a zygote that died or was retired, for the next spawn
+	program_scheduler_prepare_zygote(program_scheduler);
+
 	object_remove_internal_reference(&stdin->base);
 	object_remove_internal_reference(&stdout->base);
 	object_remove_internal_reference(&stderr->base);
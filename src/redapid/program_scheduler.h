@@ -27,6 +27,7 @@
 #include "process.h"
 #include "process_monitor.h"
 #include "program_config.h"
+#include "zygote.h"
 
 typedef void (*ProgramSchedulerProcessSpawnedFunction)(void *opaque);
 typedef void (*ProgramSchedulerStateChangedFunction)(void *opaque);
@@ -66,7 +67,10 @@ typedef struct {
 	bool waiting_for_brickd;
 	bool timer_active;
 	bool cron_active;
+	Zygote *zygote; // only != NULL if zygote mode is enabled and applicable while running
 	Process *last_spawned_process; // == NULL until the first process spawned
+	File *preallocated_stdout_log; // continuous stdout log with space preallocated for the last spawned process
+	File *preallocated_stderr_log; // continuous stderr log with space preallocated for the last spawned process
 	uint64_t last_spawned_timestamp;
 	ProgramSchedulerState state;
 	uint64_t timestamp;
@@ -80,6 +84,7 @@ APIE program_scheduler_create(ProgramScheduler *program_scheduler,
 void program_scheduler_destroy(ProgramScheduler *program_scheduler);
 
 void program_scheduler_update(ProgramScheduler *program_scheduler, bool try_start);
+void program_scheduler_retire_zygote(ProgramScheduler *program_scheduler);
 void program_scheduler_continue(ProgramScheduler *program_scheduler);
 void program_scheduler_shutdown(ProgramScheduler *program_scheduler);
 
@@ -0,0 +1,441 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * purge.c: Incremental deletion of purged program directories
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * purging a program moves its root directory to /tmp/purged-program-*. the
+ * moved trees are removed here one entry at a time, driven by a timer. each
+ * timer tick performs a limited number of file system operations, so that
+ * removing a large tree neither blocks the event loop for long nor saturates
+ * the SD card. the trees are not tracked on disk, instead /tmp is scanned for
+ * leftover trees on startup, so an interrupted removal resumes after restart.
+ */
+
+#define _GNU_SOURCE // for O_CLOEXEC from fcntl.h
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <daemonlib/array.h>
+#include <daemonlib/log.h>
+#include <daemonlib/timer.h>
+#include <daemonlib/utils.h>
+
+#include "purge.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+typedef struct {
+	char *name; // relative to the parent frame, absolute for the first frame
+	DIR *dp;
+} PurgeFrame;
+
+static Array _pending; // char pointers, absolute names of trees to be removed
+static Array _frames; // PurgeFrame, open directories of the tree being removed
+static Timer _timer;
+static bool _timer_armed = false;
+static uint64_t _removed_count = 0;
+static uint32_t _error_count = 0;
+
+static void purge_destroy_name(void *item) {
+	free(*(char **)item);
+}
+
+static void purge_destroy_frame(void *item) {
+	PurgeFrame *frame = item;
+
+	closedir(frame->dp);
+	free(frame->name);
+}
+
+static const char *purge_get_root_name(void) {
+	return ((PurgeFrame *)array_get(&_frames, 0))->name;
+}
+
+static int purge_get_parent_fd(void) {
+	if (_frames.count == 0) {
+		return AT_FDCWD;
+	}
+
+	return dirfd(((PurgeFrame *)array_get(&_frames, _frames.count - 1))->dp);
+}
+
+static void purge_push_frame(const char *name) {
+	int parent_fd = purge_get_parent_fd();
+	int fd;
+	DIR *dp;
+	char *name_copy;
+	PurgeFrame *frame;
+
+	if (_frames.count >= PURGE_MAX_DEPTH) {
+		log_warn("Not descending into '%s' of purged program directory '%s', it is nested too deeply",
+		         name, purge_get_root_name());
+
+		++_error_count;
+
+		return;
+	}
+
+	fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+	if (fd < 0) {
+		if (errno != ENOENT) {
+			log_error("Could not open directory '%s' for removal: %s (%d)",
+			          name, get_errno_name(errno), errno);
+
+			++_error_count;
+		}
+
+		return;
+	}
+
+	dp = fdopendir(fd);
+
+	if (dp == NULL) {
+		log_error("Could not open directory '%s' for removal: %s (%d)",
+		          name, get_errno_name(errno), errno);
+
+		close(fd);
+
+		++_error_count;
+
+		return;
+	}
+
+	name_copy = strdup(name);
+
+	if (name_copy == NULL) {
+		log_error("Could not duplicate directory name: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		closedir(dp);
+
+		++_error_count;
+
+		return;
+	}
+
+	frame = array_append(&_frames);
+
+	if (frame == NULL) {
+		log_error("Could not append to purge frame array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		free(name_copy);
+		closedir(dp);
+
+		++_error_count;
+
+		return;
+	}
+
+	frame->name = name_copy;
+	frame->dp = dp;
+}
+
+// removes the directory of the last frame, it is empty by now. the directory
+// stays open until after the removal, this is fine on Linux
+static void purge_pop_frame(void) {
+	PurgeFrame *frame = array_get(&_frames, _frames.count - 1);
+	int parent_fd = _frames.count > 1
+	              ? dirfd(((PurgeFrame *)array_get(&_frames, _frames.count - 2))->dp)
+	              : AT_FDCWD;
+
+	if (unlinkat(parent_fd, frame->name, AT_REMOVEDIR) < 0) {
+		if (errno != ENOENT) {
+			log_error("Could not remove directory '%s' of purged program directory '%s': %s (%d)",
+			          frame->name, purge_get_root_name(), get_errno_name(errno), errno);
+
+			++_error_count;
+		}
+	} else {
+		++_removed_count;
+	}
+
+	if (_frames.count == 1) {
+		log_debug("Finished removing purged program directory '%s'", frame->name);
+	}
+
+	array_remove(&_frames, _frames.count - 1, purge_destroy_frame);
+}
+
+// returns the number of performed file system operations
+static int purge_remove_next_entry(void) {
+	PurgeFrame *frame = array_get(&_frames, _frames.count - 1);
+	struct dirent *dirent;
+	int fd;
+
+	errno = 0;
+	dirent = readdir(frame->dp);
+
+	if (dirent == NULL) {
+		if (errno != 0) {
+			log_error("Could not get next entry of directory '%s' of purged program directory '%s': %s (%d)",
+			          frame->name, purge_get_root_name(), get_errno_name(errno), errno);
+
+			++_error_count;
+		}
+
+		purge_pop_frame();
+
+		return 1;
+	}
+
+	if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+		return 0;
+	}
+
+	if (dirent->d_type == DT_DIR) {
+		purge_push_frame(dirent->d_name);
+
+		return 1;
+	}
+
+	fd = dirfd(frame->dp);
+
+	if (unlinkat(fd, dirent->d_name, 0) < 0) {
+		// the file system doesn't report entry types, unlinking a directory
+		// fails with EISDIR on Linux
+		if (dirent->d_type == DT_UNKNOWN && (errno == EISDIR || errno == EPERM)) {
+			purge_push_frame(dirent->d_name);
+
+			return 2;
+		}
+
+		if (errno != ENOENT) {
+			log_error("Could not remove '%s' of purged program directory '%s': %s (%d)",
+			          dirent->d_name, purge_get_root_name(), get_errno_name(errno), errno);
+
+			++_error_count;
+		}
+	} else {
+		++_removed_count;
+	}
+
+	return 1;
+}
+
+static void purge_open_next_tree(void) {
+	char *name = *(char **)array_get(&_pending, 0);
+
+	array_remove(&_pending, 0, NULL);
+
+	log_debug("Starting to remove purged program directory '%s'", name);
+
+	purge_push_frame(name);
+
+	free(name);
+}
+
+static void purge_handle_timer(void *opaque) {
+	int budget = PURGE_MAX_OPERATIONS_PER_SECOND * PURGE_INTERVAL / 1000;
+
+	(void)opaque;
+
+	while (budget > 0) {
+		if (_frames.count == 0) {
+			if (_pending.count == 0) {
+				timer_configure(&_timer, 0, 0);
+
+				_timer_armed = false;
+
+				return;
+			}
+
+			purge_open_next_tree();
+
+			--budget;
+
+			continue;
+		}
+
+		budget -= purge_remove_next_entry();
+	}
+}
+
+static void purge_find_leftovers(void) {
+	DIR *dp;
+	struct dirent *dirent;
+	char buffer[1024];
+	int count = 0;
+
+	dp = opendir(PURGE_DIRECTORY);
+
+	if (dp == NULL) {
+		log_warn("Could not open directory '"PURGE_DIRECTORY"' to find purged program directories: %s (%d)",
+		         get_errno_name(errno), errno);
+
+		return;
+	}
+
+	for (;;) {
+		errno = 0;
+		dirent = readdir(dp);
+
+		if (dirent == NULL) {
+			if (errno != 0) {
+				log_warn("Could not get next entry of directory '"PURGE_DIRECTORY"': %s (%d)",
+				         get_errno_name(errno), errno);
+			}
+
+			break;
+		}
+
+		if (strncmp(dirent->d_name, PURGE_NAME_PREFIX, strlen(PURGE_NAME_PREFIX)) != 0 ||
+		    (dirent->d_type != DT_DIR && dirent->d_type != DT_UNKNOWN)) {
+			continue;
+		}
+
+		if (robust_snprintf(buffer, sizeof(buffer), PURGE_DIRECTORY"/%s", dirent->d_name) < 0) {
+			log_warn("Could not format purged program directory name: %s (%d)",
+			         get_errno_name(errno), errno);
+
+			continue;
+		}
+
+		purge_add(buffer);
+
+		++count;
+	}
+
+	closedir(dp);
+
+	if (count > 0) {
+		log_info("Resuming removal of %d purged program director%s",
+		         count, count == 1 ? "y" : "ies");
+	}
+}
+
+int purge_init(void) {
+	int phase = 0;
+
+	log_debug("Initializing purge subsystem");
+
+	if (array_create(&_pending, 8, sizeof(char *), true) < 0) {
+		log_error("Could not create pending purged program directory array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	if (array_create(&_frames, 16, sizeof(PurgeFrame), true) < 0) {
+		log_error("Could not create purge frame array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	if (timer_create_(&_timer, purge_handle_timer, NULL) < 0) {
+		log_error("Could not create purge timer: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	purge_find_leftovers();
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 2:
+		array_destroy(&_frames, NULL);
+
+	case 1:
+		array_destroy(&_pending, NULL);
+
+	default:
+		break;
+	}
+
+	return phase == 3 ? 0 : -1;
+}
+
+void purge_exit(void) {
+	log_debug("Shutting down purge subsystem");
+
+	if (_pending.count > 0 || _frames.count > 0) {
+		log_info("Postponing removal of %d purged program director%s until next start",
+		         _pending.count + (_frames.count > 0 ? 1 : 0),
+		         _pending.count + (_frames.count > 0 ? 1 : 0) == 1 ? "y" : "ies");
+	}
+
+	timer_destroy(&_timer);
+
+	array_destroy(&_frames, purge_destroy_frame);
+	array_destroy(&_pending, purge_destroy_name);
+}
+
+void purge_add(const char *name) {
+	char **name_ptr;
+	char *name_copy;
+
+	name_copy = strdup(name);
+
+	if (name_copy == NULL) {
+		log_error("Could not duplicate purged program directory name: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return;
+	}
+
+	name_ptr = array_append(&_pending);
+
+	if (name_ptr == NULL) {
+		log_error("Could not append to pending purged program directory array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		free(name_copy);
+
+		return;
+	}
+
+	*name_ptr = name_copy;
+
+	if (!_timer_armed) {
+		if (timer_configure(&_timer, (uint64_t)PURGE_INTERVAL * 1000,
+		                    (uint64_t)PURGE_INTERVAL * 1000) < 0) {
+			log_error("Could not start purge timer: %s (%d)",
+			          get_errno_name(errno), errno);
+
+			return;
+		}
+
+		_timer_armed = true;
+	}
+}
+
+// public API
+APIE purge_get_progress(uint32_t *pending_count, uint64_t *removed_count,
+                        uint32_t *error_count) {
+	*pending_count = _pending.count + (_frames.count > 0 ? 1 : 0);
+	*removed_count = _removed_count;
+	*error_count = _error_count;
+
+	return API_E_SUCCESS;
+}
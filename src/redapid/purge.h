@@ -0,0 +1,44 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * purge.h: Incremental deletion of purged program directories
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_PURGE_H
+#define REDAPID_PURGE_H
+
+#include <stdint.h>
+
+#include "api_error.h"
+
+#define PURGE_DIRECTORY "/tmp"
+#define PURGE_NAME_PREFIX "purged-program-"
+
+#define PURGE_MAX_OPERATIONS_PER_SECOND 200
+#define PURGE_INTERVAL 100 // milliseconds
+#define PURGE_MAX_DEPTH 128
+
+int purge_init(void);
+void purge_exit(void);
+
+void purge_add(const char *name);
+
+APIE purge_get_progress(uint32_t *pending_count, uint64_t *removed_count,
+                        uint32_t *error_count);
+
+#endif // REDAPID_PURGE_H
@@ -0,0 +1,343 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * read_cache.c: Shared read cache for regular files
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * read-only file objects for the same version of a regular file share one
+ * cache entry. a version is identified by device, inode, modification time
+ * and length. a file object only acquires an entry on its first read, so
+ * opens that never read (e.g. for stdin of a process) don't take up space in
+ * the cache. the buffer of an entry is filled lazily in READ_CACHE_FILL_LENGTH
+ * chunks as it is read, so reading a large file doesn't block the event loop.
+ * a repeated download of the same file is then served from memory.
+ *
+ * the buffers are allocated instead of mmap'ed on purpose. if a mapped file
+ * gets truncated by another process then accessing the mapping beyond the new
+ * end-of-file raises SIGBUS and would kill redapid.
+ *
+ * writes through redapid mark the entries of the written inode as stale. a
+ * modification by another process changes modification time or length, so
+ * the next open doesn't match the old entry anymore. stale entries stay valid
+ * for the file objects already using them and are freed after their release.
+ */
+
+#define _GNU_SOURCE // for posix_fadvise from fcntl.h
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <daemonlib/array.h>
+#include <daemonlib/log.h>
+#include <daemonlib/utils.h>
+
+#include "read_cache.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+static Array _entries; // ReadCacheEntry pointers
+static off_t _total_length = 0;
+static uint64_t _use_counter = 0;
+
+static void read_cache_destroy_entry(void *item) {
+	ReadCacheEntry *entry = *(ReadCacheEntry **)item;
+
+	_total_length -= entry->length;
+
+	free(entry->buffer);
+	free(entry);
+}
+
+static void read_cache_remove_entry(int i) {
+	ReadCacheEntry *entry = *(ReadCacheEntry **)array_get(&_entries, i);
+
+	log_debug("Removing read cache entry (device: %u, inode: %llu, length: %lld)",
+	          (unsigned int)entry->device, (unsigned long long)entry->inode,
+	          (long long)entry->length);
+
+	array_remove(&_entries, i, read_cache_destroy_entry);
+}
+
+// removes unused entries, least recently used first, until length bytes
+// fit into the cache. returns false if this is not possible
+static bool read_cache_make_room(off_t length) {
+	int i;
+	int candidate;
+	ReadCacheEntry *entry;
+	ReadCacheEntry *oldest;
+
+	while (_total_length + length > READ_CACHE_MAX_LENGTH) {
+		candidate = -1;
+		oldest = NULL;
+
+		for (i = 0; i < _entries.count; ++i) {
+			entry = *(ReadCacheEntry **)array_get(&_entries, i);
+
+			if (entry->reference_count > 0) {
+				continue;
+			}
+
+			if (oldest == NULL || entry->last_used < oldest->last_used) {
+				candidate = i;
+				oldest = entry;
+			}
+		}
+
+		if (candidate < 0) {
+			return false;
+		}
+
+		read_cache_remove_entry(candidate);
+	}
+
+	return true;
+}
+
+int read_cache_init(void) {
+	log_debug("Initializing read cache subsystem");
+
+	if (array_create(&_entries, 32, sizeof(ReadCacheEntry *), true) < 0) {
+		log_error("Could not create read cache entry array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+void read_cache_exit(void) {
+	int i;
+	ReadCacheEntry *entry;
+
+	log_debug("Shutting down read cache subsystem");
+
+	for (i = 0; i < _entries.count; ++i) {
+		entry = *(ReadCacheEntry **)array_get(&_entries, i);
+
+		if (entry->reference_count > 0) {
+			log_warn("Destroying read cache entry (device: %u, inode: %llu) while it is still used %d time(s)",
+			         (unsigned int)entry->device, (unsigned long long)entry->inode,
+			         entry->reference_count);
+		}
+	}
+
+	array_destroy(&_entries, read_cache_destroy_entry);
+}
+
+// returns NULL if the file cannot be cached
+ReadCacheEntry *read_cache_acquire(IOHandle fd, struct stat *st) {
+	int i;
+	ReadCacheEntry *entry;
+	ReadCacheEntry **entry_ptr;
+
+	if (!S_ISREG(st->st_mode) || st->st_size == 0 ||
+	    st->st_size > READ_CACHE_MAX_ENTRY_LENGTH) {
+		return NULL;
+	}
+
+	// iterate backwards to allow removal of outdated entries
+	for (i = _entries.count - 1; i >= 0; --i) {
+		entry = *(ReadCacheEntry **)array_get(&_entries, i);
+
+		if (entry->device != st->st_dev || entry->inode != st->st_ino) {
+			continue;
+		}
+
+		if (!entry->stale &&
+		    entry->modification_time.tv_sec == st->st_mtim.tv_sec &&
+		    entry->modification_time.tv_nsec == st->st_mtim.tv_nsec &&
+		    entry->length == st->st_size) {
+			++entry->reference_count;
+			entry->last_used = ++_use_counter;
+
+			return entry;
+		}
+
+		// the file was modified, the entry is outdated
+		entry->stale = true;
+
+		if (entry->reference_count == 0) {
+			read_cache_remove_entry(i);
+		}
+	}
+
+	if (!read_cache_make_room(st->st_size)) {
+		log_debug("Read cache is full, not caching file (device: %u, inode: %llu, length: %lld)",
+		          (unsigned int)st->st_dev, (unsigned long long)st->st_ino,
+		          (long long)st->st_size);
+
+		return NULL;
+	}
+
+	entry = calloc(1, sizeof(ReadCacheEntry));
+
+	if (entry == NULL) {
+		log_error("Could not allocate read cache entry: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return NULL;
+	}
+
+	entry->buffer = malloc(st->st_size);
+
+	if (entry->buffer == NULL) {
+		log_error("Could not allocate read cache buffer: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		free(entry);
+
+		return NULL;
+	}
+
+	entry_ptr = array_append(&_entries);
+
+	if (entry_ptr == NULL) {
+		log_error("Could not append to read cache entry array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		free(entry->buffer);
+		free(entry);
+
+		return NULL;
+	}
+
+	*entry_ptr = entry;
+
+	entry->device = st->st_dev;
+	entry->inode = st->st_ino;
+	entry->modification_time = st->st_mtim;
+	entry->length = st->st_size;
+	entry->filled_length = 0;
+	entry->reference_count = 1;
+	entry->stale = false;
+	entry->last_used = ++_use_counter;
+
+	_total_length += entry->length;
+
+	// the buffer is filled front to back, tell the kernel to read ahead
+	if (entry->length > READ_CACHE_FILL_LENGTH) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	log_debug("Added read cache entry (device: %u, inode: %llu, length: %lld)",
+	          (unsigned int)entry->device, (unsigned long long)entry->inode,
+	          (long long)entry->length);
+
+	return entry;
+}
+
+void read_cache_release(ReadCacheEntry *entry) {
+	int i;
+
+	--entry->reference_count;
+
+	if (entry->reference_count > 0 || !entry->stale) {
+		return;
+	}
+
+	for (i = 0; i < _entries.count; ++i) {
+		if (*(ReadCacheEntry **)array_get(&_entries, i) == entry) {
+			read_cache_remove_entry(i);
+
+			break;
+		}
+	}
+}
+
+// sets errno on error
+int read_cache_read(ReadCacheEntry *entry, IOHandle fd, off_t offset,
+                    void *buffer, int length) {
+	off_t fill_end;
+	ssize_t rc;
+
+	if (offset >= entry->length) {
+		return 0;
+	}
+
+	if (length > entry->length - offset) {
+		length = entry->length - offset;
+	}
+
+	if (offset + length > entry->filled_length) {
+		fill_end = offset + length + READ_CACHE_FILL_LENGTH - 1;
+		fill_end -= fill_end % READ_CACHE_FILL_LENGTH;
+
+		if (fill_end > entry->length) {
+			fill_end = entry->length;
+		}
+
+		while (entry->filled_length < fill_end) {
+			rc = pread(fd, entry->buffer + entry->filled_length,
+			           fill_end - entry->filled_length, entry->filled_length);
+
+			if (rc < 0) {
+				if (errno_interrupted()) {
+					continue;
+				}
+
+				return -1;
+			}
+
+			if (rc == 0) {
+				// the file got truncated by someone else, don't hand out
+				// this entry anymore and serve what is available
+				entry->stale = true;
+
+				break;
+			}
+
+			entry->filled_length += rc;
+		}
+
+		if (offset >= entry->filled_length) {
+			return 0;
+		}
+
+		if (offset + length > entry->filled_length) {
+			length = entry->filled_length - offset;
+		}
+	}
+
+	memcpy(buffer, entry->buffer + offset, length);
+
+	return length;
+}
+
+void read_cache_invalidate(dev_t device, ino_t inode) {
+	int i;
+	ReadCacheEntry *entry;
+
+	for (i = _entries.count - 1; i >= 0; --i) {
+		entry = *(ReadCacheEntry **)array_get(&_entries, i);
+
+		if (entry->device != device || entry->inode != inode) {
+			continue;
+		}
+
+		entry->stale = true;
+
+		if (entry->reference_count == 0) {
+			read_cache_remove_entry(i);
+		}
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * read_cache.h: Shared read cache for regular files
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_READ_CACHE_H
+#define REDAPID_READ_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <daemonlib/io.h>
+
+#define READ_CACHE_MAX_LENGTH (32 * 1024 * 1024) // all entries together
+#define READ_CACHE_MAX_ENTRY_LENGTH (8 * 1024 * 1024)
+#define READ_CACHE_FILL_LENGTH (64 * 1024)
+
+typedef struct {
+	dev_t device;
+	ino_t inode;
+	struct timespec modification_time;
+	off_t length;
+	uint8_t *buffer;
+	off_t filled_length; // buffer[0..filled_length - 1] is valid
+	int reference_count;
+	bool stale; // don't hand out to new users anymore
+	uint64_t last_used;
+} ReadCacheEntry;
+
+int read_cache_init(void);
+void read_cache_exit(void);
+
+ReadCacheEntry *read_cache_acquire(IOHandle fd, struct stat *st);
+void read_cache_release(ReadCacheEntry *entry);
+
+int read_cache_read(ReadCacheEntry *entry, IOHandle fd, off_t offset,
+                    void *buffer, int length);
+
+void read_cache_invalidate(dev_t device, ino_t inode);
+
+#endif // REDAPID_READ_CACHE_H
@@ -178,7 +178,14 @@ cleanup:
 
 APIE string_wrap(const char *buffer, Session *session,
                  uint32_t object_create_flags, ObjectID *id, String **object) {
-	uint32_t length = strlen(buffer);
+	return string_wrap_with_length(buffer, strlen(buffer), session,
+	                               object_create_flags, id, object);
+}
+
+// buffer doesn't have to be NULL-terminated and can contain NULL bytes, e.g.
+// for binary process output. string_get_chunk reports them as is
+APIE string_wrap_with_length(const char *buffer, uint32_t length, Session *session,
+                             uint32_t object_create_flags, ObjectID *id, String **object) {
 	APIE error_code;
 	String *string;
 
@@ -38,6 +38,8 @@ typedef struct {
 
 APIE string_wrap(const char *buffer, Session *session,
                  uint32_t object_create_flags, ObjectID *id, String **object);
+APIE string_wrap_with_length(const char *buffer, uint32_t length, Session *session,
+                             uint32_t object_create_flags, ObjectID *id, String **object);
 APIE string_asprintf(Session *session, uint32_t object_create_flags,
                      ObjectID *id, String **object, const char *format, ...) ATTRIBUTE_FMT_PRINTF(5, 6);
 APIE string_allocate(uint32_t reserve, char *buffer, Session *session, ObjectID *id);
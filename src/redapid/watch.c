@@ -0,0 +1,638 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * watch.c: Watch object implementation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * all watch objects and internal consumers share one inotify instance. inotify
+ * itself returns the same watch descriptor if the same inode is added multiple
+ * times, so watch objects and internal consumers for the same inode share one
+ * inotify watch. all watches are added with the same inotify mask, the events
+ * are filtered by the consumers. the references to each inotify watch are
+ * counted, the inotify watch is removed when its last reference is removed.
+ * internal consumers might add inotify watches from other threads, therefore
+ * the references are protected by a mutex.
+ *
+ * occurring events are collected per watch object and reported together after
+ * WATCH_COALESCING_DELAY milliseconds. this turns a burst of modifications
+ * (e.g. a log file being written line by line) into a single callback.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <daemonlib/array.h>
+#include <daemonlib/event.h>
+#include <daemonlib/log.h>
+#include <daemonlib/threads.h>
+#include <daemonlib/timer.h>
+#include <daemonlib/utils.h>
+
+#include "watch.h"
+
+#include "api.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+#define WATCH_INOTIFY_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+                            IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | \
+                            IN_MOVE_SELF | IN_EXCL_UNLINK)
+
+#define WATCH_SIGNATURE_FORMAT "id: %u, name: %s, events: 0x%04X, wd: %d"
+
+#define watch_expand_signature(watch) (watch)->base.id, \
+	(watch)->name->buffer, (watch)->events, (watch)->wd
+
+typedef struct {
+	int wd;
+	WatchInotifyFunction function;
+	void *opaque;
+	int reference_count;
+} WatchInotifyReference;
+
+static int _inotify_fd = -1;
+static Mutex _references_mutex; // protects _references
+static Array _references; // WatchInotifyReference items
+static Array _watches; // all watch objects, no matter if the inotify watch is still valid
+static Timer _coalescing_timer;
+static bool _coalescing_timer_armed = false;
+
+static uint16_t watch_get_events_from_mask(uint32_t mask) {
+	uint16_t events = 0;
+
+	if ((mask & IN_MODIFY) != 0) {
+		events |= WATCH_EVENT_MODIFIED;
+	}
+
+	if ((mask & IN_CREATE) != 0) {
+		events |= WATCH_EVENT_CREATED;
+	}
+
+	if ((mask & (IN_DELETE | IN_DELETE_SELF)) != 0) {
+		events |= WATCH_EVENT_DELETED;
+	}
+
+	if ((mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF)) != 0) {
+		events |= WATCH_EVENT_MOVED;
+	}
+
+	return events;
+}
+
+static void watch_send_events_occurred_callback(Watch *watch, uint16_t events) {
+	// only send a watch-events-occurred callback if there is at least one
+	// external reference to the watch object. otherwise there is no one that
+	// could be interested in this callback anyway
+	if (watch->base.external_reference_count > 0) {
+		api_send_watch_events_occurred_callback(watch->base.id, events);
+	}
+}
+
+static void watch_report_pending_events(void *opaque) {
+	int i;
+	Watch *watch;
+	uint16_t events;
+
+	(void)opaque;
+
+	_coalescing_timer_armed = false;
+
+	for (i = 0; i < _watches.count; ++i) {
+		watch = *(Watch **)array_get(&_watches, i);
+
+		if (watch->pending_events == 0) {
+			continue;
+		}
+
+		events = watch->pending_events;
+		watch->pending_events = 0;
+
+		log_debug("Reporting events 0x%04X for watch object ("WATCH_SIGNATURE_FORMAT")",
+		          events, watch_expand_signature(watch));
+
+		watch_send_events_occurred_callback(watch, events);
+	}
+}
+
+static void watch_add_pending_events(Watch *watch, uint16_t events) {
+	events &= watch->events;
+
+	if (events == 0) {
+		return;
+	}
+
+	watch->pending_events |= events;
+
+	if (!_coalescing_timer_armed) {
+		if (timer_configure(&_coalescing_timer, WATCH_COALESCING_DELAY * 1000, 0) < 0) {
+			log_error("Could not start watch coalescing timer: %s (%d)",
+			          get_errno_name(errno), errno);
+
+			// report the events immediately instead
+			watch_report_pending_events(NULL);
+
+			return;
+		}
+
+		_coalescing_timer_armed = true;
+	}
+}
+
+// handles the inotify events for all watch objects
+static void watch_handle_inotify_event(int wd, uint32_t mask, const char *name,
+                                       void *opaque) {
+	int i;
+	Watch *watch;
+	uint16_t events;
+
+	(void)name;
+	(void)opaque;
+
+	if ((mask & IN_Q_OVERFLOW) != 0) {
+		// some events got lost, report everything
+		events = WATCH_EVENT_ALL;
+	} else {
+		events = watch_get_events_from_mask(mask);
+	}
+
+	for (i = 0; i < _watches.count; ++i) {
+		watch = *(Watch **)array_get(&_watches, i);
+
+		if (watch->wd != wd) {
+			continue;
+		}
+
+		if ((mask & IN_IGNORED) != 0) {
+			log_debug("Inotify watch for watch object ("WATCH_SIGNATURE_FORMAT") got removed",
+			          watch_expand_signature(watch));
+
+			watch->wd = -1;
+		}
+
+		watch_add_pending_events(watch, events);
+	}
+}
+
+// passes the event to the consumers of its inotify watch. an overflow of the
+// inotify event queue is passed to the consumers of all inotify watches
+static void watch_dispatch_inotify_event(struct inotify_event *event) {
+	int i;
+	WatchInotifyReference *reference;
+
+	mutex_lock(&_references_mutex);
+
+	for (i = 0; i < _references.count; ++i) {
+		reference = array_get(&_references, i);
+
+		if ((event->mask & IN_Q_OVERFLOW) == 0 && reference->wd != event->wd) {
+			continue;
+		}
+
+		reference->function(reference->wd, event->mask,
+		                    event->len > 0 ? event->name : NULL, reference->opaque);
+	}
+
+	// the kernel removed the inotify watch, because the inode was deleted or
+	// its file system was unmounted. the references to it are gone as well
+	if ((event->mask & IN_IGNORED) != 0) {
+		for (i = _references.count - 1; i >= 0; --i) {
+			reference = array_get(&_references, i);
+
+			if (reference->wd == event->wd) {
+				array_remove(&_references, i, NULL);
+			}
+		}
+	}
+
+	mutex_unlock(&_references_mutex);
+}
+
+static void watch_handle_inotify(void *opaque) {
+	// inotify events have to be read with the alignment of struct inotify_event
+	uint8_t buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t length;
+	ssize_t offset;
+	struct inotify_event *event;
+
+	(void)opaque;
+
+	for (;;) {
+		length = read(_inotify_fd, buffer, sizeof(buffer));
+
+		if (length < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			if (!errno_would_block()) {
+				log_error("Could not read from inotify instance: %s (%d)",
+				          get_errno_name(errno), errno);
+			}
+
+			return;
+		}
+
+		if (length == 0) {
+			return;
+		}
+
+		for (offset = 0; offset < length;
+		     offset += (ssize_t)sizeof(struct inotify_event) + event->len) {
+			event = (struct inotify_event *)(buffer + offset);
+
+			if ((event->mask & IN_Q_OVERFLOW) != 0) {
+				log_warn("Inotify event queue overflowed");
+			}
+
+			watch_dispatch_inotify_event(event);
+		}
+	}
+}
+
+// expects _references_mutex to be locked
+static void watch_remove_unreferenced_inotify_watch(int wd) {
+	int i;
+
+	for (i = 0; i < _references.count; ++i) {
+		if (((WatchInotifyReference *)array_get(&_references, i))->wd == wd) {
+			return;
+		}
+	}
+
+	// the inotify watch might already be removed by the kernel, ignore errors
+	inotify_rm_watch(_inotify_fd, wd);
+}
+
+static void watch_destroy(Object *object) {
+	Watch *watch = (Watch *)object;
+	int i;
+
+	if (watch->wd >= 0) {
+		watch_remove_inotify_watch(watch->wd, watch_handle_inotify_event, NULL);
+	}
+
+	for (i = 0; i < _watches.count; ++i) {
+		if (*(Watch **)array_get(&_watches, i) == watch) {
+			array_remove(&_watches, i, NULL);
+
+			break;
+		}
+	}
+
+	string_unlock_and_release(watch->name);
+
+	free(watch);
+}
+
+static void watch_signature(Object *object, char *signature) {
+	Watch *watch = (Watch *)object;
+
+	snprintf(signature, OBJECT_MAX_SIGNATURE_LENGTH, "name: %s, events: 0x%04X, wd: %d",
+	         watch->name->buffer, watch->events, watch->wd);
+}
+
+int watch_init(void) {
+	int phase = 0;
+
+	log_debug("Initializing watch subsystem");
+
+	// create watch array
+	if (array_create(&_watches, 32, sizeof(Watch *), true) < 0) {
+		log_error("Could not create watch array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	// create inotify reference array
+	if (array_create(&_references, 32, sizeof(WatchInotifyReference), true) < 0) {
+		log_error("Could not create inotify reference array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	mutex_create(&_references_mutex);
+
+	phase = 2;
+
+	// create inotify instance
+	_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (_inotify_fd < 0) {
+		log_error("Could not create inotify instance: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	if (event_add_source(_inotify_fd, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, watch_handle_inotify, NULL) < 0) {
+		goto cleanup;
+	}
+
+	phase = 4;
+
+	// create coalescing timer
+	if (timer_create_(&_coalescing_timer, watch_report_pending_events, NULL) < 0) {
+		log_error("Could not create watch coalescing timer: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 5;
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 4:
+		event_remove_source(_inotify_fd, EVENT_SOURCE_TYPE_GENERIC);
+
+	case 3:
+		close(_inotify_fd);
+
+	case 2:
+		mutex_destroy(&_references_mutex);
+		array_destroy(&_references, NULL);
+
+	case 1:
+		array_destroy(&_watches, NULL);
+
+	default:
+		break;
+	}
+
+	return phase == 5 ? 0 : -1;
+}
+
+void watch_exit(void) {
+	log_debug("Shutting down watch subsystem");
+
+	if (_watches.count > 0) {
+		log_warn("Shutting down watch subsystem while %d watch object(s) are still existing",
+		         _watches.count);
+	}
+
+	timer_destroy(&_coalescing_timer);
+
+	event_remove_source(_inotify_fd, EVENT_SOURCE_TYPE_GENERIC);
+	close(_inotify_fd);
+
+	mutex_destroy(&_references_mutex);
+	array_destroy(&_references, NULL);
+
+	array_destroy(&_watches, NULL);
+}
+
+// can be called from any thread. adds an inotify watch for name and a
+// reference to it for function and opaque. flags can contain IN_ONLYDIR and
+// IN_DONT_FOLLOW. returns the watch descriptor, sets errno on error
+int watch_add_inotify_watch(const char *name, uint32_t flags,
+                            WatchInotifyFunction function, void *opaque) {
+	int wd;
+	int i;
+	WatchInotifyReference *reference;
+	int saved_errno;
+
+	mutex_lock(&_references_mutex);
+
+	// if the inode is already watched then inotify returns the existing watch
+	// descriptor, the mask is the same for all inotify watches
+	wd = inotify_add_watch(_inotify_fd, name, WATCH_INOTIFY_MASK | flags);
+
+	if (wd < 0) {
+		mutex_unlock(&_references_mutex);
+
+		return -1;
+	}
+
+	for (i = 0; i < _references.count; ++i) {
+		reference = array_get(&_references, i);
+
+		if (reference->wd == wd && reference->function == function &&
+		    reference->opaque == opaque) {
+			++reference->reference_count;
+
+			mutex_unlock(&_references_mutex);
+
+			return wd;
+		}
+	}
+
+	reference = array_append(&_references);
+
+	if (reference == NULL) {
+		saved_errno = errno;
+
+		watch_remove_unreferenced_inotify_watch(wd);
+
+		mutex_unlock(&_references_mutex);
+
+		errno = saved_errno;
+
+		return -1;
+	}
+
+	reference->wd = wd;
+	reference->function = function;
+	reference->opaque = opaque;
+	reference->reference_count = 1;
+
+	mutex_unlock(&_references_mutex);
+
+	return wd;
+}
+
+// can be called from any thread. removes a reference added by
+// watch_add_inotify_watch. references to an inotify watch that got removed
+// by the kernel are already gone
+void watch_remove_inotify_watch(int wd, WatchInotifyFunction function,
+                                void *opaque) {
+	int i;
+	WatchInotifyReference *reference;
+
+	mutex_lock(&_references_mutex);
+
+	for (i = 0; i < _references.count; ++i) {
+		reference = array_get(&_references, i);
+
+		if (reference->wd != wd || reference->function != function ||
+		    reference->opaque != opaque) {
+			continue;
+		}
+
+		if (--reference->reference_count == 0) {
+			array_remove(&_references, i, NULL);
+
+			watch_remove_unreferenced_inotify_watch(wd);
+		}
+
+		break;
+	}
+
+	mutex_unlock(&_references_mutex);
+}
+
+// public API
+APIE watch_path(ObjectID name_id, uint16_t events, Session *session,
+                uint16_t object_create_flags, ObjectID *id, Watch **object) {
+	int phase = 0;
+	APIE error_code;
+	String *name;
+	Watch *watch;
+	Watch **watch_ptr;
+
+	if (events == 0 || (events & ~WATCH_EVENT_ALL) != 0) {
+		log_warn("Invalid watch events 0x%04X", events);
+
+		return API_E_INVALID_PARAMETER;
+	}
+
+	// acquire and lock name string object
+	error_code = string_get_acquired_and_locked(name_id, &name);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	if (*name->buffer != '/') {
+		error_code = API_E_INVALID_PARAMETER;
+
+		log_warn("Cannot watch relative path '%s'", name->buffer);
+
+		goto cleanup;
+	}
+
+	// allocate watch object
+	watch = calloc(1, sizeof(Watch));
+
+	if (watch == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate watch object: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	watch->name = name;
+	watch->events = events;
+	watch->pending_events = 0;
+	watch->wd = -1;
+
+	// add inotify watch
+	watch->wd = watch_add_inotify_watch(name->buffer, 0,
+	                                    watch_handle_inotify_event, NULL);
+
+	if (watch->wd < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not add inotify watch for '%s': %s (%d)",
+		          name->buffer, get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	// append to watch array
+	watch_ptr = array_append(&_watches);
+
+	if (watch_ptr == NULL) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not append to watch array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	*watch_ptr = watch;
+
+	phase = 4;
+
+	// create watch object
+	error_code = object_create(&watch->base, OBJECT_TYPE_WATCH, session,
+	                           object_create_flags, watch_destroy, watch_signature);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 5;
+
+	if (id != NULL) {
+		*id = watch->base.id;
+	}
+
+	if (object != NULL) {
+		*object = watch;
+	}
+
+	log_debug("Created watch object ("WATCH_SIGNATURE_FORMAT")",
+	          watch_expand_signature(watch));
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 4:
+		array_remove(&_watches, _watches.count - 1, NULL);
+
+	case 3:
+		watch_remove_inotify_watch(watch->wd, watch_handle_inotify_event, NULL);
+
+	case 2:
+		free(watch);
+
+	case 1:
+		string_unlock_and_release(name);
+
+	default:
+		break;
+	}
+
+	return phase == 5 ? API_E_SUCCESS : error_code;
+}
+
+// public API
+APIE watch_get_info(Watch *watch, Session *session, ObjectID *name_id,
+                    uint16_t *events) {
+	APIE error_code = object_add_external_reference(&watch->name->base, session);
+
+	if (error_code != API_E_SUCCESS) {
+		return error_code;
+	}
+
+	*name_id = watch->name->base.id;
+	*events = watch->events;
+
+	return API_E_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * watch.h: Watch object implementation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_WATCH_H
+#define REDAPID_WATCH_H
+
+#include "object.h"
+#include "string.h"
+
+typedef enum { // bitmask
+	WATCH_EVENT_MODIFIED = 0x0001,
+	WATCH_EVENT_CREATED  = 0x0002,
+	WATCH_EVENT_DELETED  = 0x0004,
+	WATCH_EVENT_MOVED    = 0x0008
+} WatchEvent;
+
+#define WATCH_EVENT_ALL (WATCH_EVENT_MODIFIED | \
+                         WATCH_EVENT_CREATED | \
+                         WATCH_EVENT_DELETED | \
+                         WATCH_EVENT_MOVED)
+
+#define WATCH_COALESCING_DELAY 50 // milliseconds
+
+// called from the event loop thread with the event of an inotify watch added
+// by watch_add_inotify_watch. name is the name of the affected entry of a
+// watched directory, or NULL. if the inotify event queue overflowed then this
+// is called for every inotify watch with mask IN_Q_OVERFLOW and name NULL.
+// it must not add or remove inotify watches
+typedef void (*WatchInotifyFunction)(int wd, uint32_t mask, const char *name,
+                                     void *opaque);
+
+typedef struct {
+	Object base;
+
+	String *name;
+	uint16_t events; // requested events
+	uint16_t pending_events; // occurred, but not yet reported events
+	int wd; // inotify watch descriptor, -1 if the watch was removed by the kernel
+} Watch;
+
+int watch_init(void);
+void watch_exit(void);
+
+int watch_add_inotify_watch(const char *name, uint32_t flags,
+                            WatchInotifyFunction function, void *opaque);
+void watch_remove_inotify_watch(int wd, WatchInotifyFunction function,
+                                void *opaque);
+
+APIE watch_path(ObjectID name_id, uint16_t events, Session *session,
+                uint16_t object_create_flags, ObjectID *id, Watch **object);
+
+APIE watch_get_info(Watch *watch, Session *session, ObjectID *name_id,
+                    uint16_t *events);
+
+#endif // REDAPID_WATCH_H
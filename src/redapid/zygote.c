@@ -0,0 +1,982 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * zygote.c: Pre-started interpreter that forks scheduled program starts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * a zygote is a pre-started interpreter that already imported the modules a
+ * program needs. scheduled starts of the program are forked from the zygote
+ * instead of starting a new interpreter each time. only Python 3.5 or newer is
+ * supported, it can receive file descriptors over a Unix socket and can run a
+ * script file in a forked child process as if it was started directly.
+ *
+ * the zygote is spawned as a normal child process with the identity, control
+ * group, scheduling attributes, environment and working directory of the
+ * program. it gets two sockets as file descriptors 3 and 4:
+ *
+ * the control socket carries the ready reports. the zygote forks a spare
+ * child process ahead of time. once the spare child process is the leader of
+ * its own session the zygote reports its process ID together with a socket
+ * to the spare child process. a fork request with the working directory,
+ * arguments, environment and stdin, stdout and stderr of the new child
+ * process is sent to this socket without waiting for a reply, so a slow or
+ * stuck zygote cannot block the event loop. until the next ready report
+ * arrives the zygote is not ready and the caller spawns directly instead. if
+ * the zygote cannot import one of the modules then it reports this on the
+ * control socket instead and exits.
+ *
+ * the event socket carries the state changes of the child processes. they are
+ * children of the zygote, not of redapid. therefore, the zygote reaps them and
+ * reports their wait status and resource usage.
+ *
+ * a retired zygote gets its control socket and the socket to its spare child
+ * process closed. it stops forking, the spare child process exits, but the
+ * zygote keeps reporting until its last child process is gone, then it exits.
+ * if a zygote dies unexpectedly then the kernel kills its remaining child
+ * processes, because nothing would report their state changes anymore. they
+ * have SIGKILL as parent death signal. redapid cannot kill them itself, they
+ * got reparented to init and their process IDs might already be reused.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <daemonlib/event.h>
+#include <daemonlib/log.h>
+#include <daemonlib/utils.h>
+
+#include "zygote.h"
+
+#include "api.h"
+#include "file.h"
+#include "inventory.h"
+
+static LogSource _log_source = LOG_SOURCE_INITIALIZER;
+
+#define ZYGOTE_CONTROL_FD 3
+#define ZYGOTE_EVENT_FD 4
+
+typedef enum {
+	ZYGOTE_MESSAGE_READY = 1, // pid is the spare child process, its socket is attached
+	ZYGOTE_MESSAGE_PRELOAD_FAILED, // value is the index of the module
+	ZYGOTE_MESSAGE_STATE_CHANGED // value is the wait status
+} ZygoteMessageType;
+
+#include <daemonlib/packed_begin.h>
+
+// struct format '=Iii7Q' on the Python side
+typedef struct {
+	uint32_t type;
+	int32_t pid;
+	int32_t value;
+	uint64_t user_time; // microseconds
+	uint64_t system_time; // microseconds
+	uint64_t max_resident_set_size; // KiB
+	uint64_t read_blocks; // 512 byte blocks
+	uint64_t write_blocks; // 512 byte blocks
+	uint64_t voluntary_context_switches;
+	uint64_t involuntary_context_switches;
+} ATTRIBUTE_PACKED ZygoteMessage;
+
+#include <daemonlib/packed_end.h>
+
+// the modules to import are passed as arguments. the zygote keeps one spare
+// child process forked ahead of time. the spare child process already is the
+// leader of its own session and waits on its own request socket, that is
+// passed to redapid with the ready report. a fork request consists of
+// NUL-terminated fields: unbuffered flag, argument count, working directory,
+// arguments (script file first) and environment. the request buffer size has
+// to match ZYGOTE_MAX_REQUEST_LENGTH. once the spare child process took its
+// request the zygote forks the next one. the spare child process checks the
+// parent process ID after setting the parent death signal, because the zygote
+// might have died before
+static const char *_helper =
+	"import array, ctypes, io, os, select, signal, socket, struct, sys\n"
+	"PR_SET_PDEATHSIG = 1\n"
+	"libc = ctypes.CDLL(None, use_errno=True)\n"
+	"zygote = os.getpid()\n"
+	"message = struct.Struct('=Iii7Q')\n"
+	"control = socket.fromfd(3, socket.AF_UNIX, socket.SOCK_SEQPACKET)\n"
+	"events = socket.fromfd(4, socket.AF_UNIX, socket.SOCK_SEQPACKET)\n"
+	"os.close(3)\n"
+	"os.close(4)\n"
+	"control.setblocking(True)\n"
+	"events.setblocking(True)\n"
+	"for index, name in enumerate(sys.argv[1:]):\n"
+	"    try:\n"
+	"        __import__(name)\n"
+	"    except BaseException:\n"
+	"        control.send(message.pack(2, 0, index, 0, 0, 0, 0, 0, 0, 0))\n"
+	"        sys.exit(0)\n"
+	"def report(pid, status, usage):\n"
+	"    events.send(message.pack(3, pid, status, int(usage.ru_utime * 1000000),\n"
+	"                             int(usage.ru_stime * 1000000), usage.ru_maxrss,\n"
+	"                             usage.ru_inblock, usage.ru_oublock,\n"
+	"                             usage.ru_nvcsw, usage.ru_nivcsw))\n"
+	"def reap(signum, frame):\n"
+	"    while True:\n"
+	"        try:\n"
+	"            pid, status, usage = os.wait4(-1, os.WNOHANG | os.WUNTRACED | os.WCONTINUED)\n"
+	"        except ChildProcessError:\n"
+	"            return\n"
+	"        if pid == 0:\n"
+	"            return\n"
+	"        report(pid, status, usage)\n"
+	"signal.signal(signal.SIGCHLD, reap)\n"
+	"job = None\n"
+	"spare = None\n"
+	"while job is None:\n"
+	"    if spare is None:\n"
+	"        request_socket, spare_socket = socket.socketpair(socket.AF_UNIX, socket.SOCK_SEQPACKET)\n"
+	"        ready_read, ready_write = os.pipe()\n"
+	"        try:\n"
+	"            pid = os.fork()\n"
+	"        except OSError:\n"
+	"            pid = -1\n"
+	"        if pid == 0:\n"
+	"            try:\n"
+	"                signal.signal(signal.SIGCHLD, signal.SIG_DFL)\n"
+	"                control.close()\n"
+	"                events.close()\n"
+	"                request_socket.close()\n"
+	"                os.close(ready_read)\n"
+	"                os.setsid()\n"
+	"                if libc.prctl(PR_SET_PDEATHSIG, signal.SIGKILL) != 0 or os.getppid() != zygote:\n"
+	"                    os._exit(125)\n"
+	"                os.write(ready_write, b'1')\n"
+	"                fds = array.array('i')\n"
+	"                request, ancillary, flags, address = spare_socket.recvmsg(64 * 1024, socket.CMSG_SPACE(3 * fds.itemsize))\n"
+	"            except BaseException:\n"
+	"                os._exit(125)\n"
+	"            if not request:\n"
+	"                os._exit(0)\n"
+	"            for level, kind, data in ancillary:\n"
+	"                if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:\n"
+	"                    fds.frombytes(data[:len(data) - len(data) % fds.itemsize])\n"
+	"            spare_socket.close()\n"
+	"            os.close(ready_write)\n"
+	"            job = request, fds.tolist()\n"
+	"            break\n"
+	"        spare_socket.close()\n"
+	"        os.close(ready_write)\n"
+	"        if pid > 0 and os.read(ready_read, 1):\n"
+	"            spare = ready_read\n"
+	"            control.sendmsg([message.pack(1, pid, 0, 0, 0, 0, 0, 0, 0, 0)],\n"
+	"                            [(socket.SOL_SOCKET, socket.SCM_RIGHTS, array.array('i', [request_socket.fileno()]))])\n"
+	"        else:\n"
+	"            os.close(ready_read)\n"
+	"        request_socket.close()\n"
+	"    readable = select.select([control] if spare is None else [control, spare], [], [],\n"
+	"                             1 if spare is None else None)[0]\n"
+	"    if control in readable:\n"
+	"        break\n"
+	"    if spare is not None and spare in readable:\n"
+	"        os.close(spare)\n"
+	"        spare = None\n"
+	"if job is None:\n"
+	"    signal.signal(signal.SIGCHLD, signal.SIG_DFL)\n"
+	"    while True:\n"
+	"        try:\n"
+	"            report(*os.wait4(-1, os.WUNTRACED | os.WCONTINUED))\n"
+	"        except ChildProcessError:\n"
+	"            sys.exit(0)\n"
+	"request, fds = job\n"
+	"fields = request[:-1].split(b'\\0')\n"
+	"count = int(fields[1])\n"
+	"try:\n"
+	"    for target, fd in enumerate(fds):\n"
+	"        os.dup2(fd, target)\n"
+	"        os.close(fd)\n"
+	"    os.chdir(fields[2])\n"
+	"except OSError:\n"
+	"    os._exit(125)\n"
+	"os.environb.clear()\n"
+	"for entry in fields[3 + count:]:\n"
+	"    name, separator, value = entry.partition(b'=')\n"
+	"    if separator:\n"
+	"        os.environb[name] = value\n"
+	"sys.argv = [os.fsdecode(argument) for argument in fields[3:3 + count]]\n"
+	"sys.path[0] = os.path.dirname(os.path.abspath(sys.argv[0]))\n"
+	"if fields[0] == b'1':\n"
+	"    sys.stdout = io.TextIOWrapper(open(1, 'wb', 0, closefd=False), sys.stdout.encoding,\n"
+	"                                  sys.stdout.errors, write_through=True)\n"
+	"    sys.stderr = io.TextIOWrapper(open(2, 'wb', 0, closefd=False), sys.stderr.encoding,\n"
+	"                                  sys.stderr.errors, write_through=True)\n"
+	"import runpy\n"
+	"runpy.run_path(sys.argv[0], run_name='__main__')\n";
+
+static void zygote_close_event_socket(Zygote *zygote) {
+	if (zygote->event_fd < 0) {
+		return;
+	}
+
+	event_remove_source(zygote->event_fd, EVENT_SOURCE_TYPE_GENERIC);
+	close(zygote->event_fd);
+
+	zygote->event_fd = -1;
+}
+
+// the spare child process exits once its socket is closed
+static void zygote_close_request_socket(Zygote *zygote) {
+	if (zygote->request_fd < 0) {
+		return;
+	}
+
+	close(zygote->request_fd);
+
+	zygote->request_fd = -1;
+}
+
+static void zygote_close_control_socket(Zygote *zygote) {
+	zygote_close_request_socket(zygote);
+
+	if (zygote->control_fd < 0) {
+		return;
+	}
+
+	event_remove_source(zygote->control_fd, EVENT_SOURCE_TYPE_GENERIC);
+	close(zygote->control_fd);
+
+	zygote->control_fd = -1;
+}
+
+static void zygote_destroy(Zygote *zygote) {
+	log_debug("Destroying zygote (executable: %s)", zygote->process->executable->buffer);
+
+	zygote_close_event_socket(zygote);
+	zygote_close_control_socket(zygote);
+
+	array_destroy(&zygote->children, NULL);
+
+	object_remove_internal_reference(&zygote->process->base);
+
+	free(zygote);
+}
+
+static void zygote_destroy_if_done(Zygote *zygote) {
+	if (zygote->retired && !zygote->dispatching && !process_is_alive(zygote->process)) {
+		zygote_destroy(zygote);
+	}
+}
+
+// stops tracking a child process. afterwards the process object doesn't
+// refer to the zygote anymore, so it might outlive the zygote
+static Process *zygote_forget(Zygote *zygote, int i) {
+	Process *process = *(Process **)array_get(&zygote->children, i);
+
+	array_remove(&zygote->children, i, NULL);
+
+	process->zygote = NULL;
+
+	return process;
+}
+
+static void zygote_handle_state_change(Zygote *zygote, ZygoteMessage *message) {
+	int i;
+	Process *process;
+	struct rusage rusage;
+
+	for (i = 0; i < zygote->children.count; ++i) {
+		process = *(Process **)array_get(&zygote->children, i);
+
+		if (process->pid == message->pid) {
+			break;
+		}
+	}
+
+	// unknown child processes were killed by process_destroy before
+	if (i == zygote->children.count) {
+		return;
+	}
+
+	memset(&rusage, 0, sizeof(rusage));
+
+	rusage.ru_utime.tv_sec = message->user_time / 1000000;
+	rusage.ru_utime.tv_usec = message->user_time % 1000000;
+	rusage.ru_stime.tv_sec = message->system_time / 1000000;
+	rusage.ru_stime.tv_usec = message->system_time % 1000000;
+	rusage.ru_maxrss = message->max_resident_set_size;
+	rusage.ru_inblock = message->read_blocks;
+	rusage.ru_oublock = message->write_blocks;
+	rusage.ru_nvcsw = message->voluntary_context_switches;
+	rusage.ru_nivcsw = message->involuntary_context_switches;
+
+	// a dead child process is reaped by now, stop tracking it before the
+	// state change is handled, like process_reap does
+	if (!WIFSTOPPED(message->value) && !WIFCONTINUED(message->value)) {
+		zygote_forget(zygote, i);
+	}
+
+	process_report_state_change(process, message->value, &rusage);
+}
+
+// the state change callbacks can retire the zygote. it is not destroyed
+// while dispatching, because the caller still uses it afterwards
+static void zygote_read_events(Zygote *zygote) {
+	ZygoteMessage message;
+	int rc;
+
+	zygote->dispatching = true;
+
+	while (zygote->event_fd >= 0) {
+		rc = recv(zygote->event_fd, &message, sizeof(message), 0);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			if (!errno_would_block()) {
+				log_error("Could not receive from zygote (executable: %s) event socket: %s (%d)",
+				          zygote->process->executable->buffer, get_errno_name(errno), errno);
+			}
+
+			break;
+		}
+
+		if (rc == 0) {
+			// the zygote is gone, all its reports are read
+			zygote_close_event_socket(zygote);
+
+			break;
+		}
+
+		if (rc != (int)sizeof(message)) {
+			log_warn("Ignoring zygote (executable: %s) report with invalid length %d",
+			         zygote->process->executable->buffer, rc);
+
+			continue;
+		}
+
+		if (message.type != ZYGOTE_MESSAGE_STATE_CHANGED) {
+			log_warn("Ignoring zygote (executable: %s) report with invalid type %u",
+			         zygote->process->executable->buffer, message.type);
+
+			continue;
+		}
+
+		zygote_handle_state_change(zygote, &message);
+	}
+
+	zygote->dispatching = false;
+}
+
+static void zygote_handle_events(void *opaque) {
+	Zygote *zygote = opaque;
+
+	zygote_read_events(zygote);
+	zygote_destroy_if_done(zygote);
+}
+
+static void zygote_handle_preload_failure(Zygote *zygote, int index) {
+	Array *modules = &zygote->process->arguments->items;
+	const char *module = "<unknown>";
+
+	// the arguments are -c <helper> <module>...
+	if (index >= 0 && 2 + index < modules->count) {
+		module = (*(String **)array_get(modules, 2 + index))->buffer;
+	}
+
+	log_warn("Zygote (executable: %s, pid: %u) could not import module '%s', not forking from it",
+	         zygote->process->executable->buffer, zygote->process->pid, module);
+
+	zygote->preload_failed = true;
+
+	zygote_close_control_socket(zygote);
+}
+
+static void zygote_handle_control(void *opaque) {
+	Zygote *zygote = opaque;
+	ZygoteMessage message;
+	struct iovec iovec;
+	struct msghdr msghdr;
+	union {
+		struct cmsghdr header; // for alignment
+		char buffer[CMSG_SPACE(sizeof(int))];
+	} ancillary;
+	struct cmsghdr *cmsghdr;
+	int request_fd;
+	int rc;
+
+	while (zygote->control_fd >= 0) {
+		iovec.iov_base = &message;
+		iovec.iov_len = sizeof(message);
+
+		memset(&msghdr, 0, sizeof(msghdr));
+
+		msghdr.msg_iov = &iovec;
+		msghdr.msg_iovlen = 1;
+		msghdr.msg_control = ancillary.buffer;
+		msghdr.msg_controllen = sizeof(ancillary.buffer);
+
+		rc = recvmsg(zygote->control_fd, &msghdr, MSG_CMSG_CLOEXEC);
+
+		if (rc < 0) {
+			if (errno_interrupted()) {
+				continue;
+			}
+
+			if (!errno_would_block()) {
+				log_error("Could not receive from zygote (executable: %s) control socket: %s (%d)",
+				          zygote->process->executable->buffer, get_errno_name(errno), errno);
+			}
+
+			return;
+		}
+
+		if (rc == 0) {
+			// the zygote is gone, its death is handled as usual
+			zygote_close_control_socket(zygote);
+
+			return;
+		}
+
+		request_fd = -1;
+		cmsghdr = CMSG_FIRSTHDR(&msghdr);
+
+		if (cmsghdr != NULL && cmsghdr->cmsg_level == SOL_SOCKET &&
+		    cmsghdr->cmsg_type == SCM_RIGHTS && cmsghdr->cmsg_len == CMSG_LEN(sizeof(int))) {
+			memcpy(&request_fd, CMSG_DATA(cmsghdr), sizeof(int));
+		}
+
+		if (rc != (int)sizeof(message)) {
+			log_warn("Ignoring zygote (executable: %s) report with invalid length %d",
+			         zygote->process->executable->buffer, rc);
+		} else if (message.type == ZYGOTE_MESSAGE_PRELOAD_FAILED) {
+			zygote_handle_preload_failure(zygote, message.value);
+		} else if (message.type != ZYGOTE_MESSAGE_READY || message.pid <= 0 || request_fd < 0) {
+			log_warn("Ignoring zygote (executable: %s) report with invalid type %u",
+			         zygote->process->executable->buffer, message.type);
+		} else {
+			log_debug("Zygote (executable: %s, pid: %u) is ready with spare child process (pid: %d)",
+			          zygote->process->executable->buffer, zygote->process->pid, message.pid);
+
+			zygote_close_request_socket(zygote);
+
+			zygote->request_fd = request_fd;
+			zygote->spare_pid = message.pid;
+
+			continue;
+		}
+
+		if (request_fd >= 0) {
+			close(request_fd);
+		}
+	}
+}
+
+static void zygote_handle_process_state_change(void *opaque) {
+	Zygote *zygote = opaque;
+	Process *process;
+	struct rusage rusage;
+
+	if (process_is_alive(zygote->process)) {
+		return;
+	}
+
+	// a preload failure might not be read yet
+	zygote_handle_control(zygote);
+	zygote_close_control_socket(zygote);
+
+	if ((!zygote->retired && !zygote->preload_failed) ||
+	    zygote->process->state != PROCESS_STATE_EXITED ||
+	    zygote->process->exit_code != 0) {
+		log_warn("Zygote (executable: %s) died unexpectedly (state: %u, exit_code: %u)",
+		         zygote->process->executable->buffer, zygote->process->state,
+		         zygote->process->exit_code);
+	}
+
+	// reports sent before the zygote died might not be read yet
+	zygote_read_events(zygote);
+	zygote_close_event_socket(zygote);
+
+	// nothing reports the state changes of the remaining child processes
+	// anymore. the kernel killed them, because of their parent death signal
+	zygote->dispatching = true;
+
+	memset(&rusage, 0, sizeof(rusage));
+
+	while (zygote->children.count > 0) {
+		process = zygote_forget(zygote, zygote->children.count - 1);
+
+		log_warn("Orphaned child process (executable: %s, pid: %u) of zygote got killed",
+		         process->executable->buffer, process->pid);
+
+		process_report_state_change(process, SIGKILL, &rusage);
+	}
+
+	zygote->dispatching = false;
+
+	zygote_destroy_if_done(zygote);
+}
+
+static int zygote_append_field(char *request, int *length, const char *field) {
+	int field_length = strlen(field) + 1;
+
+	if (*length + field_length > ZYGOTE_MAX_REQUEST_LENGTH) {
+		errno = E2BIG;
+
+		return -1;
+	}
+
+	memcpy(request + *length, field, field_length);
+
+	*length += field_length;
+
+	return 0;
+}
+
+// the interpreter has to be python3, optionally with version suffix. -u is
+// the only supported interpreter option, it has to be followed by the script
+// file name
+bool zygote_is_applicable(String *executable, List *arguments) {
+	const char *name = strrchr(executable->buffer, '/');
+	const char *argument;
+	int i;
+
+	name = name != NULL ? name + 1 : executable->buffer;
+
+	if (strncmp(name, "python3", 7) != 0 ||
+	    strspn(name + 7, "0123456789.") != strlen(name + 7)) {
+		return false;
+	}
+
+	for (i = 0; i < arguments->items.count; ++i) {
+		argument = (*(String **)array_get(&arguments->items, i))->buffer;
+
+		if (strcmp(argument, "-u") != 0) {
+			return *argument != '-' && *argument != '\0';
+		}
+	}
+
+	return false;
+}
+
+APIE zygote_create(ObjectID executable_id, List *modules, ObjectID environment_id,
+                   ObjectID working_directory_id, uint32_t uid, uint32_t gid,
+                   const char *cgroup, ProcessSchedulingAttributes *scheduling,
+                   Zygote **zygote) {
+	int phase = 0;
+	APIE error_code;
+	int control_pair[2];
+	int event_pair[2];
+	List *arguments;
+	String *argument;
+	int i;
+	String *dev_null_file_name;
+	File *dev_null;
+	int inherited_fds[2];
+
+	*zygote = calloc(1, sizeof(Zygote));
+
+	if (*zygote == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate zygote: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		goto cleanup;
+	}
+
+	phase = 1;
+
+	if (array_create(&(*zygote)->children, 8, sizeof(Process *), true) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create zygote child process array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 2;
+
+	// create control and event sockets, only redapid's ends are non-blocking,
+	// an unresponsive zygote must not block redapid
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, control_pair) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create zygote control socket pair: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 3;
+
+	if (fcntl(control_pair[0], F_SETFL, O_NONBLOCK) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not enable non-blocking mode for zygote control socket: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, event_pair) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not create zygote event socket pair: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	phase = 4;
+
+	if (fcntl(event_pair[0], F_SETFL, O_NONBLOCK) < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not enable non-blocking mode for zygote event socket: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		goto cleanup;
+	}
+
+	// create arguments list: -c <helper> <module>...
+	error_code = list_allocate(2 + modules->items.count, NULL,
+	                           OBJECT_CREATE_FLAG_INTERNAL, NULL, &arguments);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 5;
+
+	for (i = -2; i < modules->items.count; ++i) {
+		error_code = string_wrap(i == -2 ? "-c" :
+		                         i == -1 ? _helper :
+		                         (*(String **)array_get(&modules->items, i))->buffer,
+		                         NULL, OBJECT_CREATE_FLAG_INTERNAL, NULL, &argument);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+
+		error_code = list_append_to(arguments, argument->base.id);
+
+		object_remove_internal_reference(&argument->base);
+
+		if (error_code != API_E_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	// the zygote doesn't use stdio, the child processes get their own
+	error_code = inventory_get_stock_string("/dev/null", &dev_null_file_name);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	error_code = file_open(dev_null_file_name->base.id, FILE_FLAG_READ_WRITE, 0,
+	                       1000, 1000, NULL, OBJECT_CREATE_FLAG_INTERNAL, NULL, &dev_null);
+
+	string_unlock_and_release(dev_null_file_name);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 6;
+
+	(*zygote)->control_fd = control_pair[0];
+	(*zygote)->event_fd = event_pair[0];
+	(*zygote)->request_fd = -1;
+	(*zygote)->spare_pid = 0;
+	(*zygote)->preload_failed = false;
+	(*zygote)->retired = false;
+	(*zygote)->dispatching = false;
+
+	if (event_add_source((*zygote)->event_fd, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, zygote_handle_events, *zygote) < 0) {
+		error_code = API_E_INTERNAL_ERROR;
+
+		goto cleanup;
+	}
+
+	phase = 7;
+
+	if (event_add_source((*zygote)->control_fd, EVENT_SOURCE_TYPE_GENERIC,
+	                     EVENT_READ, zygote_handle_control, *zygote) < 0) {
+		error_code = API_E_INTERNAL_ERROR;
+
+		goto cleanup;
+	}
+
+	phase = 8;
+
+	// spawn zygote
+	inherited_fds[ZYGOTE_CONTROL_FD - STDERR_FILENO - 1] = control_pair[1];
+	inherited_fds[ZYGOTE_EVENT_FD - STDERR_FILENO - 1] = event_pair[1];
+
+	error_code = process_spawn(executable_id, arguments->base.id, environment_id,
+	                           working_directory_id, uid, gid, dev_null->base.id,
+	                           dev_null->base.id, dev_null->base.id, cgroup, 0,
+	                           scheduling, inherited_fds, 2, NULL, NULL,
+	                           OBJECT_CREATE_FLAG_INTERNAL, false,
+	                           zygote_handle_process_state_change, *zygote,
+	                           NULL, &(*zygote)->process);
+
+	if (error_code != API_E_SUCCESS) {
+		goto cleanup;
+	}
+
+	phase = 9;
+
+	log_debug("Spawned zygote (executable: %s, pid: %u)",
+	          (*zygote)->process->executable->buffer, (*zygote)->process->pid);
+
+	// the zygote owns its ends of the sockets now
+	close(control_pair[1]);
+	close(event_pair[1]);
+
+	file_release(dev_null);
+	object_remove_internal_reference(&arguments->base);
+
+cleanup:
+	switch (phase) { // no breaks, all cases fall through intentionally
+	case 8:
+		event_remove_source((*zygote)->control_fd, EVENT_SOURCE_TYPE_GENERIC);
+
+	case 7:
+		event_remove_source((*zygote)->event_fd, EVENT_SOURCE_TYPE_GENERIC);
+
+	case 6:
+		file_release(dev_null);
+
+	case 5:
+		object_remove_internal_reference(&arguments->base);
+
+	case 4:
+		close(event_pair[0]);
+		close(event_pair[1]);
+
+	case 3:
+		close(control_pair[0]);
+		close(control_pair[1]);
+
+	case 2:
+		array_destroy(&(*zygote)->children, NULL);
+
+	case 1:
+		free(*zygote);
+
+	default:
+		break;
+	}
+
+	return phase == 9 ? API_E_SUCCESS : error_code;
+}
+
+// the zygote is not used for new forks anymore. its child processes are
+// still reported, it exits and gets destroyed after the last one is gone
+void zygote_retire(Zygote *zygote) {
+	if (zygote->retired) {
+		return;
+	}
+
+	log_debug("Retiring zygote (executable: %s, pid: %u)",
+	          zygote->process->executable->buffer, zygote->process->pid);
+
+	zygote->retired = true;
+
+	zygote_close_control_socket(zygote);
+	zygote_destroy_if_done(zygote);
+}
+
+bool zygote_is_alive(Zygote *zygote) {
+	return process_is_alive(zygote->process);
+}
+
+// only ready while a spare child process waits for a fork request
+bool zygote_is_ready(Zygote *zygote) {
+	return zygote->request_fd >= 0 && !zygote->retired && zygote_is_alive(zygote);
+}
+
+bool zygote_has_failed(Zygote *zygote) {
+	return zygote->preload_failed;
+}
+
+// arguments includes the executable and interpreter options, like for execvpe
+APIE zygote_fork(Zygote *zygote, const char *working_directory, char **arguments,
+                 char **environment, int stdin_fd, int stdout_fd, int stderr_fd,
+                 pid_t *pid) {
+	APIE error_code;
+	bool unbuffered = false;
+	int argument_count;
+	int i;
+	char buffer[32];
+	char *request;
+	int length = 0;
+	struct iovec iovec;
+	struct msghdr msghdr;
+	union {
+		struct cmsghdr header; // for alignment
+		char buffer[CMSG_SPACE(3 * sizeof(int))];
+	} ancillary;
+	struct cmsghdr *cmsghdr;
+	int *fds;
+	int rc;
+
+	if (!zygote_is_ready(zygote)) {
+		log_warn("Cannot fork from zygote (executable: %s) that is not ready",
+		         zygote->process->executable->buffer);
+
+		return API_E_INVALID_OPERATION;
+	}
+
+	// skip executable and interpreter options
+	for (i = 1; arguments[i] != NULL && strcmp(arguments[i], "-u") == 0; ++i) {
+		unbuffered = true;
+	}
+
+	arguments += i;
+
+	for (argument_count = 0; arguments[argument_count] != NULL; ++argument_count);
+
+	// format request
+	request = malloc(ZYGOTE_MAX_REQUEST_LENGTH);
+
+	if (request == NULL) {
+		error_code = API_E_NO_FREE_MEMORY;
+
+		log_error("Could not allocate zygote fork request: %s (%d)",
+		          get_errno_name(ENOMEM), ENOMEM);
+
+		return error_code;
+	}
+
+	snprintf(buffer, sizeof(buffer), "%d", argument_count);
+
+	if (zygote_append_field(request, &length, unbuffered ? "1" : "0") < 0 ||
+	    zygote_append_field(request, &length, buffer) < 0 ||
+	    zygote_append_field(request, &length, working_directory) < 0) {
+		goto format_error;
+	}
+
+	for (i = 0; i < argument_count; ++i) {
+		if (zygote_append_field(request, &length, arguments[i]) < 0) {
+			goto format_error;
+		}
+	}
+
+	for (i = 0; environment[i] != NULL; ++i) {
+		if (zygote_append_field(request, &length, environment[i]) < 0) {
+			goto format_error;
+		}
+	}
+
+	// send request with stdin, stdout and stderr attached
+	iovec.iov_base = request;
+	iovec.iov_len = length;
+
+	memset(&msghdr, 0, sizeof(msghdr));
+
+	msghdr.msg_iov = &iovec;
+	msghdr.msg_iovlen = 1;
+	msghdr.msg_control = ancillary.buffer;
+	msghdr.msg_controllen = sizeof(ancillary.buffer);
+
+	cmsghdr = CMSG_FIRSTHDR(&msghdr);
+	cmsghdr->cmsg_level = SOL_SOCKET;
+	cmsghdr->cmsg_type = SCM_RIGHTS;
+	cmsghdr->cmsg_len = CMSG_LEN(3 * sizeof(int));
+
+	fds = (int *)CMSG_DATA(cmsghdr);
+	fds[0] = stdin_fd;
+	fds[1] = stdout_fd;
+	fds[2] = stderr_fd;
+
+	// the spare child process reads the request, nothing is waited for
+	do {
+		rc = sendmsg(zygote->request_fd, &msghdr, MSG_NOSIGNAL | MSG_DONTWAIT);
+	} while (rc < 0 && errno_interrupted());
+
+	free(request);
+
+	// the spare child process is used up either way, the zygote forks the
+	// next one once this one took the request or exited
+	zygote_close_request_socket(zygote);
+
+	if (rc < 0) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not send fork request to spare child process (pid: %d) of zygote (executable: %s, pid: %u): %s (%d)",
+		          zygote->spare_pid, zygote->process->executable->buffer,
+		          zygote->process->pid, get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	*pid = zygote->spare_pid;
+
+	return API_E_SUCCESS;
+
+format_error:
+	error_code = api_get_error_code_from_errno();
+
+	log_error("Could not format zygote fork request (executable: %s): %s (%d)",
+	          zygote->process->executable->buffer, get_errno_name(errno), errno);
+
+	free(request);
+
+	return error_code;
+}
+
+APIE zygote_track(Zygote *zygote, Process *process) {
+	Process **process_ptr;
+	APIE error_code;
+
+	process_ptr = array_append(&zygote->children);
+
+	if (process_ptr == NULL) {
+		error_code = api_get_error_code_from_errno();
+
+		log_error("Could not append to zygote child process array: %s (%d)",
+		          get_errno_name(errno), errno);
+
+		return error_code;
+	}
+
+	*process_ptr = process;
+
+	return API_E_SUCCESS;
+}
+
+void zygote_untrack(Zygote *zygote, Process *process) {
+	int i;
+
+	for (i = 0; i < zygote->children.count; ++i) {
+		if (*(Process **)array_get(&zygote->children, i) == process) {
+			zygote_forget(zygote, i);
+
+			return;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * redapid
+ * Copyright (C) 2015 Matthias Bolte <matthias@tinkerforge.com>
+ *
+ * zygote.h: Pre-started interpreter that forks scheduled program starts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef REDAPID_ZYGOTE_H
+#define REDAPID_ZYGOTE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <daemonlib/array.h>
+
+#include "list.h"
+#include "process.h"
+#include "string.h"
+
+#define ZYGOTE_MAX_REQUEST_LENGTH (64 * 1024) // bytes, for working directory, arguments and environment
+
+struct _Zygote {
+	Process *process; // the interpreter, spawned as a normal child process
+	int control_fd; // ready and preload failure reports, -1 once retired or dead
+	int event_fd; // state change reports, -1 once the zygote is dead
+	int request_fd; // fork request socket of the spare child process, -1 if there is none
+	pid_t spare_pid; // the spare child process, valid if request_fd is not -1
+	bool preload_failed; // a module could not be imported, the zygote exits
+	bool retired; // not used for new forks anymore, freed once dead
+	bool dispatching; // reports are being handled, don't free yet
+	Array children; // Process pointers forked by the zygote and not yet dead
+};
+
+bool zygote_is_applicable(String *executable, List *arguments);
+
+APIE zygote_create(ObjectID executable_id, List *modules, ObjectID environment_id,
+                   ObjectID working_directory_id, uint32_t uid, uint32_t gid,
+                   const char *cgroup, ProcessSchedulingAttributes *scheduling,
+                   Zygote **zygote);
+void zygote_retire(Zygote *zygote);
+
+bool zygote_is_alive(Zygote *zygote);
+bool zygote_is_ready(Zygote *zygote);
+bool zygote_has_failed(Zygote *zygote);
+
+APIE zygote_fork(Zygote *zygote, const char *working_directory, char **arguments,
+                 char **environment, int stdin_fd, int stdout_fd, int stderr_fd,
+                 pid_t *pid);
+
+APIE zygote_track(Zygote *zygote, Process *process);
+void zygote_untrack(Zygote *zygote, Process *process);
+
+#endif // REDAPID_ZYGOTE_H
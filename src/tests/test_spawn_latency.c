@@ -0,0 +1,388 @@
+// spawns short-lived /bin/true processes sequentially and in batches with
+// different stdio redirections and reports p50/p99/max latencies of:
+//
+//   spawn:    red_spawn_process request until its response, the process is
+//             running at this point (clone, identity change and exec done)
+//   callback: red_spawn_process response until the PROCESS_STATE_CHANGED
+//             callback for the exit arrives, including the negligible
+//             runtime of /bin/true
+//
+// usage: ./a.out [<count> [<batch-size>]], defaults to 100 and 8
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "ip_connection.h"
+#include "brick_red.h"
+
+#define HOST "localhost"
+#define PORT 4223
+#define UID "3hG6BK" // Change to your UID
+
+#include "utils.c"
+
+typedef struct {
+	bool active;
+	bool done;
+	uint8_t state;
+	uint64_t requested;
+	uint64_t spawned;
+	uint64_t exited;
+} Spawn;
+
+typedef struct {
+	const char *name;
+	uint16_t stdin_fid;
+	uint16_t stdout_fid;
+	uint16_t stderr_fid;
+} Redirection;
+
+static Spawn spawns[65536]; // indexed by process ID
+static int pending;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t monotonic_microseconds(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int compare_uint64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// nearest-rank percentile of a sorted array
+static uint64_t percentile(uint64_t *values, int count, int p) {
+	int rank = (p * count + 99) / 100;
+
+	return values[rank > 0 ? rank - 1 : 0];
+}
+
+static void process_state_changed(uint16_t process_id, uint8_t state, uint64_t timestamp,
+                                  uint8_t exit_code, void *user_data) {
+	uint64_t now = monotonic_microseconds();
+	Spawn *spawn = &spawns[process_id];
+
+	(void)timestamp;
+	(void)exit_code;
+	(void)user_data;
+
+	if (state == RED_PROCESS_STATE_RUNNING) {
+		return;
+	}
+
+	pthread_mutex_lock(&mutex);
+
+	// the callback might arrive before red_spawn_process returned
+	if (spawn->active && !spawn->done) {
+		--pending;
+
+		pthread_cond_signal(&cond);
+	}
+
+	spawn->done = true;
+	spawn->state = state;
+	spawn->exited = now;
+
+	pthread_mutex_unlock(&mutex);
+}
+
+static void report(const char *name, int batch_size, uint64_t *spawn_latencies,
+                   uint64_t *callback_latencies, int count, int failed) {
+	qsort(spawn_latencies, count, sizeof(uint64_t), compare_uint64);
+	qsort(callback_latencies, count, sizeof(uint64_t), compare_uint64);
+
+	printf("%-10s batch %3d: spawn p50 %7.3f ms, p99 %7.3f ms, max %7.3f ms | "
+	       "callback p50 %7.3f ms, p99 %7.3f ms, max %7.3f ms | failed %d\n",
+	       name, batch_size,
+	       percentile(spawn_latencies, count, 50) / 1000.0,
+	       percentile(spawn_latencies, count, 99) / 1000.0,
+	       spawn_latencies[count - 1] / 1000.0,
+	       percentile(callback_latencies, count, 50) / 1000.0,
+	       percentile(callback_latencies, count, 99) / 1000.0,
+	       callback_latencies[count - 1] / 1000.0,
+	       failed);
+}
+
+static int run(RED *red, Redirection *redirection, int count, int batch_size,
+               uint16_t command_sid, uint16_t arguments_lid, uint16_t environment_lid,
+               uint16_t working_directory_sid, uint16_t session_id) {
+	uint64_t *spawn_latencies = calloc(count, sizeof(uint64_t));
+	uint64_t *callback_latencies = calloc(count, sizeof(uint64_t));
+	uint16_t *pids = calloc(batch_size, sizeof(uint16_t));
+	int measured = 0;
+	int failed = 0;
+	int started = 0;
+	int batch;
+	int i;
+	int rc;
+	uint8_t ec;
+	uint16_t pid;
+	uint64_t requested;
+	uint64_t spawned;
+	Spawn *spawn;
+
+	if (spawn_latencies == NULL || callback_latencies == NULL || pids == NULL) {
+		printf("out of memory\n");
+		goto cleanup;
+	}
+
+	while (started < count) {
+		batch = count - started < batch_size ? count - started : batch_size;
+
+		for (i = 0; i < batch; ++i) {
+			requested = monotonic_microseconds();
+			rc = red_spawn_process(red, command_sid, arguments_lid, environment_lid,
+			                       working_directory_sid, 1000, 1000,
+			                       redirection->stdin_fid, redirection->stdout_fid,
+			                       redirection->stderr_fid, session_id, &ec, &pid);
+			spawned = monotonic_microseconds();
+
+			pids[i] = 0;
+
+			if (rc < 0) {
+				printf("red_spawn_process -> rc %d\n", rc);
+				++failed;
+				continue;
+			}
+			if (ec != 0) {
+				printf("red_spawn_process -> ec %u\n", ec);
+				++failed;
+				continue;
+			}
+
+			pthread_mutex_lock(&mutex);
+
+			spawn = &spawns[pid];
+			spawn->active = true;
+			spawn->requested = requested;
+			spawn->spawned = spawned;
+
+			// the callback might already have arrived, keep its result
+			if (!spawn->done || spawn->exited < requested) {
+				spawn->done = false;
+				++pending;
+			}
+
+			pthread_mutex_unlock(&mutex);
+
+			pids[i] = pid;
+		}
+
+		pthread_mutex_lock(&mutex);
+
+		while (pending > 0) {
+			pthread_cond_wait(&cond, &mutex);
+		}
+
+		pthread_mutex_unlock(&mutex);
+
+		for (i = 0; i < batch; ++i) {
+			if (pids[i] == 0) {
+				continue;
+			}
+
+			spawn = &spawns[pids[i]];
+
+			if (spawn->state != RED_PROCESS_STATE_EXITED) {
+				++failed;
+			} else {
+				spawn_latencies[measured] = spawn->spawned - spawn->requested;
+				callback_latencies[measured] = spawn->exited > spawn->spawned ? spawn->exited - spawn->spawned : 0;
+				++measured;
+			}
+
+			spawn->active = false;
+			spawn->done = false;
+
+			release_object(red, pids[i], session_id, "process");
+		}
+
+		started += batch;
+	}
+
+	if (measured > 0) {
+		report(redirection->name, batch_size, spawn_latencies, callback_latencies, measured, failed);
+	} else {
+		printf("%-10s batch %3d: no process exited successfully, failed %d\n",
+		       redirection->name, batch_size, failed);
+	}
+
+cleanup:
+	free(pids);
+	free(callback_latencies);
+	free(spawn_latencies);
+
+	return failed > 0 ? -1 : 0;
+}
+
+int main(int argc, char **argv) {
+	uint8_t ec;
+	int rc;
+	int count = argc > 1 ? atoi(argv[1]) : 100;
+	int batch_size = argc > 2 ? atoi(argv[2]) : 8;
+	int i;
+
+	if (count < 1 || batch_size < 1) {
+		printf("usage: %s [<count> [<batch-size>]]\n", argv[0]);
+		return -1;
+	}
+
+	// Create IP connection
+	IPConnection ipcon;
+	ipcon_create(&ipcon);
+
+	// Create device object
+	RED red;
+	red_create(&red, UID, &ipcon);
+
+	// Connect to brickd
+	rc = ipcon_connect(&ipcon, HOST, PORT);
+	if (rc < 0) {
+		printf("ipcon_connect -> rc %d\n", rc);
+		return -1;
+	}
+
+	uint16_t session_id;
+	if (create_session(&red, 600, &session_id) < 0) {
+		return -1;
+	}
+
+	uint16_t command_sid;
+	if (allocate_string(&red, "/bin/true", session_id, &command_sid) < 0) {
+		goto cleanup;
+	}
+
+	uint16_t arguments_lid;
+	rc = red_allocate_list(&red, 0, session_id, &ec, &arguments_lid);
+	if (rc < 0) {
+		printf("red_allocate_list -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_allocate_list -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	uint16_t environment_lid;
+	rc = red_allocate_list(&red, 0, session_id, &ec, &environment_lid);
+	if (rc < 0) {
+		printf("red_allocate_list -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_allocate_list -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	uint16_t working_directory_sid;
+	if (allocate_string(&red, "/tmp", session_id, &working_directory_sid) < 0) {
+		goto cleanup;
+	}
+
+	uint16_t null_sid;
+	if (allocate_string(&red, "/dev/null", session_id, &null_sid) < 0) {
+		goto cleanup;
+	}
+
+	uint16_t log_sid;
+	if (allocate_string(&red, "/tmp/spawn_latency.log", session_id, &log_sid) < 0) {
+		goto cleanup;
+	}
+
+	uint16_t null_read_fid;
+	rc = red_open_file(&red, null_sid, RED_FILE_FLAG_READ_ONLY, 0, 0, 0, session_id, &ec, &null_read_fid);
+	if (rc < 0) {
+		printf("red_open_file -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_open_file -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	uint16_t null_write_fid;
+	rc = red_open_file(&red, null_sid, RED_FILE_FLAG_WRITE_ONLY, 0, 0, 0, session_id, &ec, &null_write_fid);
+	if (rc < 0) {
+		printf("red_open_file -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_open_file -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	uint16_t log_fid;
+	rc = red_open_file(&red, log_sid, RED_FILE_FLAG_WRITE_ONLY | RED_FILE_FLAG_CREATE | RED_FILE_FLAG_APPEND,
+	                   0644, 1000, 1000, session_id, &ec, &log_fid);
+	if (rc < 0) {
+		printf("red_open_file -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_open_file -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	uint16_t stdin_pipe_fid;
+	rc = red_create_pipe(&red, RED_PIPE_FLAG_NON_BLOCKING_WRITE, 0, session_id, &ec, &stdin_pipe_fid);
+	if (rc < 0) {
+		printf("red_create_pipe -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_create_pipe -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	uint16_t stdout_pipe_fid;
+	rc = red_create_pipe(&red, RED_PIPE_FLAG_NON_BLOCKING_READ, 0, session_id, &ec, &stdout_pipe_fid);
+	if (rc < 0) {
+		printf("red_create_pipe -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_create_pipe -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	Redirection redirections[] = {
+		{ "dev-null", null_read_fid, null_write_fid, null_write_fid },
+		{ "file", null_read_fid, log_fid, log_fid },
+		{ "pipe", stdin_pipe_fid, stdout_pipe_fid, stdout_pipe_fid }
+	};
+
+	red_register_callback(&red, RED_CALLBACK_PROCESS_STATE_CHANGED, process_state_changed, NULL);
+
+	printf("spawning %d processes per run\n", count);
+
+	for (i = 0; i < (int)(sizeof(redirections) / sizeof(redirections[0])); ++i) {
+		run(&red, &redirections[i], count, 1, command_sid, arguments_lid,
+		    environment_lid, working_directory_sid, session_id);
+
+		if (batch_size > 1) {
+			run(&red, &redirections[i], count, batch_size, command_sid, arguments_lid,
+			    environment_lid, working_directory_sid, session_id);
+		}
+	}
+
+cleanup:
+	// releases all objects created for this session
+	expire_session(&red, session_id);
+
+	red_destroy(&red);
+	ipcon_destroy(&ipcon);
+
+	return 0;
+}
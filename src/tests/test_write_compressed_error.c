@@ -0,0 +1,346 @@
+// writes a stream of uncompressed blocks with write_file_async_compressed and
+// a write window to a non-blocking pipe that is too small for the whole
+// stream. the blocks are split across the 61 byte packets. writing the fifth
+// block fails with WOULD_BLOCK. the acknowledged length has to end at the
+// boundary of the fourth block and resending from there after draining the
+// pipe has to produce the original data without gaps or duplicates
+//
+// the bindings don't know write_file_async_compressed, set_file_write_window
+// and the async_file_writes_acknowledged callback yet, the packets for them
+// are built here
+
+#define IPCON_EXPOSE_INTERNALS
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "ip_connection.h"
+#include "brick_red.h"
+
+#define HOST "localhost"
+#define PORT 4223
+#define UID "3hG6BK" // Change to your UID
+
+#include "utils.c"
+
+#define FUNCTION_WRITE_FILE_ASYNC_COMPRESSED 70
+#define FUNCTION_SET_FILE_WRITE_WINDOW 74
+#define CALLBACK_ASYNC_FILE_WRITES_ACKNOWLEDGED 75
+
+#define PIPE_LENGTH 4096
+#define BLOCK_LENGTH 1000
+#define BLOCK_COUNT 6
+#define STREAM_BLOCK_LENGTH (8 + BLOCK_LENGTH)
+#define STREAM_LENGTH (BLOCK_COUNT * STREAM_BLOCK_LENGTH)
+#define PACKET_LENGTH 61
+
+#define ATTRIBUTE_PACKED __attribute__((packed))
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint8_t buffer[PACKET_LENGTH];
+	uint8_t length_to_write;
+} ATTRIBUTE_PACKED WriteFileAsyncCompressed_;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint32_t acknowledge_length;
+	uint16_t acknowledge_interval;
+} ATTRIBUTE_PACKED SetFileWriteWindow_;
+
+typedef struct {
+	PacketHeader header;
+	uint8_t error_code;
+} ATTRIBUTE_PACKED SetFileWriteWindowResponse_;
+
+typedef struct {
+	PacketHeader header;
+	uint16_t file_id;
+	uint8_t error_code;
+	uint64_t length_written;
+} ATTRIBUTE_PACKED AsyncFileWritesAcknowledgedCallback_;
+
+static uint8_t stream[STREAM_LENGTH];
+static bool acknowledged;
+static uint8_t acknowledged_error_code;
+static uint64_t acknowledged_length;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static uint8_t expected_byte(int block, int offset) {
+	return (uint8_t)((block * BLOCK_LENGTH + offset) % 251);
+}
+
+static void callback_wrapper_async_file_writes_acknowledged(DevicePrivate *device_p, Packet *packet) {
+	AsyncFileWritesAcknowledgedCallback_ *callback = (AsyncFileWritesAcknowledgedCallback_ *)packet;
+
+	(void)device_p;
+
+	pthread_mutex_lock(&mutex);
+
+	acknowledged = true;
+	acknowledged_error_code = callback->error_code;
+	acknowledged_length = leconvert_uint64_from(callback->length_written);
+
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+static int wait_for_acknowledgement(uint8_t *error_code, uint64_t *length_written) {
+	struct timespec deadline;
+	int rc = 0;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+
+	deadline.tv_sec += 5;
+
+	pthread_mutex_lock(&mutex);
+
+	while (!acknowledged && rc == 0) {
+		rc = pthread_cond_timedwait(&cond, &mutex, &deadline);
+	}
+
+	if (acknowledged) {
+		*error_code = acknowledged_error_code;
+		*length_written = acknowledged_length;
+		acknowledged = false;
+		rc = 0;
+	} else {
+		printf("no async_file_writes_acknowledged callback\n");
+		rc = -1;
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	return rc;
+}
+
+static int set_file_write_window(RED *red, uint16_t fid, uint32_t acknowledge_length,
+                                 uint16_t acknowledge_interval) {
+	DevicePrivate *device_p = red->p;
+	SetFileWriteWindow_ request;
+	SetFileWriteWindowResponse_ response;
+	int rc;
+
+	rc = packet_header_create(&request.header, sizeof(request), FUNCTION_SET_FILE_WRITE_WINDOW,
+	                          device_p->ipcon_p, device_p);
+	if (rc < 0) {
+		printf("packet_header_create -> rc %d\n", rc);
+		return -1;
+	}
+
+	request.file_id = leconvert_uint16_to(fid);
+	request.acknowledge_length = leconvert_uint32_to(acknowledge_length);
+	request.acknowledge_interval = leconvert_uint16_to(acknowledge_interval);
+
+	rc = device_send_request(device_p, (Packet *)&request, (Packet *)&response);
+	if (rc < 0) {
+		printf("set_file_write_window -> rc %d\n", rc);
+		return -1;
+	}
+	if (response.error_code != 0) {
+		printf("set_file_write_window -> ec %u\n", response.error_code);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int write_stream(RED *red, uint16_t fid, int offset) {
+	DevicePrivate *device_p = red->p;
+	WriteFileAsyncCompressed_ request;
+	int length;
+	int rc;
+
+	while (offset < STREAM_LENGTH) {
+		length = STREAM_LENGTH - offset < PACKET_LENGTH ? STREAM_LENGTH - offset : PACKET_LENGTH;
+
+		rc = packet_header_create(&request.header, sizeof(request), FUNCTION_WRITE_FILE_ASYNC_COMPRESSED,
+		                          device_p->ipcon_p, device_p);
+		if (rc < 0) {
+			printf("packet_header_create -> rc %d\n", rc);
+			return -1;
+		}
+
+		request.file_id = leconvert_uint16_to(fid);
+		memset(request.buffer, 0, sizeof(request.buffer));
+		memcpy(request.buffer, stream + offset, length);
+		request.length_to_write = length;
+
+		rc = device_send_request(device_p, (Packet *)&request, NULL);
+		if (rc < 0) {
+			printf("write_file_async_compressed -> rc %d\n", rc);
+			return -1;
+		}
+
+		offset += length;
+	}
+
+	return 0;
+}
+
+static int read_and_verify(RED *red, uint16_t fid, int first_block, int block_count) {
+	uint8_t buffer[62];
+	uint8_t length_read;
+	uint8_t ec;
+	int length = block_count * BLOCK_LENGTH;
+	int position = 0;
+	int rc;
+	int i;
+
+	while (position < length) {
+		rc = red_read_file(red, fid, length - position < 62 ? length - position : 62,
+		                   &ec, buffer, &length_read);
+		if (rc < 0) {
+			printf("red_read_file -> rc %d\n", rc);
+			return -1;
+		}
+		if (ec != 0) {
+			printf("red_read_file -> ec %u\n", ec);
+			return -1;
+		}
+
+		for (i = 0; i < length_read; ++i, ++position) {
+			if (buffer[i] != expected_byte(first_block, position)) {
+				printf("wrong byte at offset %d of block %d\n",
+				       position % BLOCK_LENGTH, first_block + position / BLOCK_LENGTH);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int main() {
+	uint8_t ec;
+	int rc;
+	int i;
+	int k;
+	int result = -1;
+	uint64_t length_written;
+	uint8_t *block;
+
+	// every block is stored uncompressed, compressed_length is 0
+	for (i = 0; i < BLOCK_COUNT; ++i) {
+		block = stream + i * STREAM_BLOCK_LENGTH;
+
+		*(uint32_t *)block = leconvert_uint32_to(BLOCK_LENGTH);
+		*(uint32_t *)(block + 4) = 0;
+
+		for (k = 0; k < BLOCK_LENGTH; ++k) {
+			block[8 + k] = expected_byte(i, k);
+		}
+	}
+
+	// Create IP connection
+	IPConnection ipcon;
+	ipcon_create(&ipcon);
+
+	// Create device object
+	RED red;
+	red_create(&red, UID, &ipcon);
+
+	red.p->response_expected[FUNCTION_WRITE_FILE_ASYNC_COMPRESSED] = DEVICE_RESPONSE_EXPECTED_FALSE;
+	red.p->response_expected[FUNCTION_SET_FILE_WRITE_WINDOW] = DEVICE_RESPONSE_EXPECTED_ALWAYS_TRUE;
+	red.p->response_expected[CALLBACK_ASYNC_FILE_WRITES_ACKNOWLEDGED] = DEVICE_RESPONSE_EXPECTED_ALWAYS_FALSE;
+	red.p->callback_wrappers[CALLBACK_ASYNC_FILE_WRITES_ACKNOWLEDGED] = callback_wrapper_async_file_writes_acknowledged;
+
+	// Connect to brickd
+	rc = ipcon_connect(&ipcon, HOST, PORT);
+	if (rc < 0) {
+		printf("ipcon_connect -> rc %d\n", rc);
+		return -1;
+	}
+
+	uint16_t session_id;
+	if (create_session(&red, 60, &session_id) < 0) {
+		return -1;
+	}
+
+	// writes of a block are smaller than PIPE_BUF, so they either fit into the
+	// pipe completely or fail without writing anything
+	uint16_t fid;
+	rc = red_create_pipe(&red, RED_PIPE_FLAG_NON_BLOCKING_WRITE, PIPE_LENGTH, session_id, &ec, &fid);
+	if (rc < 0) {
+		printf("red_create_pipe -> rc %d\n", rc);
+		goto cleanup;
+	}
+	if (ec != 0) {
+		printf("red_create_pipe -> ec %u\n", ec);
+		goto cleanup;
+	}
+
+	// acknowledge_length is larger than the stream, only the error and the
+	// interval trigger an acknowledgement
+	if (set_file_write_window(&red, fid, 65536, 250) < 0) {
+		goto cleanup;
+	}
+
+	if (write_stream(&red, fid, 0) < 0 || wait_for_acknowledgement(&ec, &length_written) < 0) {
+		goto cleanup;
+	}
+
+	printf("first pass -> ec %u, length_written %llu\n", ec, (unsigned long long)length_written);
+
+	if (ec == 0) {
+		printf("expected a write error, pipe is larger than %d byte(s)?\n", PIPE_LENGTH);
+		goto cleanup;
+	}
+
+	// the error occurs in the middle of a packet, the acknowledged length has
+	// to end at the last completely written block nonetheless
+	if (length_written != (PIPE_LENGTH / BLOCK_LENGTH) * STREAM_BLOCK_LENGTH) {
+		printf("expected length_written %d\n", (PIPE_LENGTH / BLOCK_LENGTH) * STREAM_BLOCK_LENGTH);
+		goto cleanup;
+	}
+
+	if (read_and_verify(&red, fid, 0, length_written / STREAM_BLOCK_LENGTH) < 0) {
+		goto cleanup;
+	}
+
+	// resend from the acknowledged position
+	if (set_file_write_window(&red, fid, 65536, 250) < 0) {
+		goto cleanup;
+	}
+
+	if (write_stream(&red, fid, length_written) < 0) {
+		goto cleanup;
+	}
+
+	i = length_written / STREAM_BLOCK_LENGTH;
+
+	if (wait_for_acknowledgement(&ec, &length_written) < 0) {
+		goto cleanup;
+	}
+
+	printf("second pass -> ec %u, length_written %llu\n", ec, (unsigned long long)length_written);
+
+	if (ec != 0 || length_written != (uint64_t)(BLOCK_COUNT - i) * STREAM_BLOCK_LENGTH) {
+		printf("expected ec 0, length_written %d\n", (BLOCK_COUNT - i) * STREAM_BLOCK_LENGTH);
+		goto cleanup;
+	}
+
+	if (read_and_verify(&red, fid, i, BLOCK_COUNT - i) < 0) {
+		goto cleanup;
+	}
+
+	printf("success\n");
+
+	result = 0;
+
+cleanup:
+	// releases all objects created for this session
+	expire_session(&red, session_id);
+
+	red_destroy(&red);
+	ipcon_destroy(&ipcon);
+
+	return result;
+}